@@ -0,0 +1,159 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Container/Hash.h"
+#include "../Container/Swap.h"
+
+#include <cstring>
+
+namespace Atomic
+{
+
+/// Control byte of a flat hash container slot that has never been used.
+static const unsigned char FLAT_HASH_EMPTY = 0;
+/// Control byte of a flat hash container slot whose element has been erased.
+static const unsigned char FLAT_HASH_DELETED = 1;
+/// Control byte flag of an occupied slot. The low 7 bits hold a fragment of the element's hash.
+static const unsigned char FLAT_HASH_OCCUPIED = 0x80;
+/// Minimum slot count of a flat hash container.
+static const unsigned FLAT_HASH_MIN_CAPACITY = 8;
+
+/// Flat hash set/map base class. Elements are stored in one contiguous slot array and located by linear probing, with a separate control byte per slot. Erasing marks the slot instead of moving other elements, so iterators to other elements stay valid; inserting may reallocate and invalidates all iterators.
+class FlatHashBase
+{
+public:
+    /// Construct.
+    FlatHashBase() :
+        ctrl_(0),
+        capacity_(0),
+        size_(0),
+        deleted_(0),
+        shift_(0)
+    {
+    }
+
+    /// Return number of elements.
+    unsigned Size() const { return size_; }
+
+    /// Return number of slots.
+    unsigned Capacity() const { return capacity_; }
+
+    /// Return whether has no elements.
+    bool Empty() const { return size_ == 0; }
+
+protected:
+    /// Swap with another flat hash set or map.
+    void Swap(FlatHashBase& rhs)
+    {
+        Atomic::Swap(ctrl_, rhs.ctrl_);
+        Atomic::Swap(capacity_, rhs.capacity_);
+        Atomic::Swap(size_, rhs.size_);
+        Atomic::Swap(deleted_, rhs.deleted_);
+        Atomic::Swap(shift_, rhs.shift_);
+    }
+
+    /// Scramble a hash value so that sequential keys such as IDs spread evenly over the slots.
+    static unsigned Mix(unsigned hash) { return hash * 2654435769u; }
+
+    /// Return the control byte for an occupied slot from a scrambled hash.
+    static unsigned char Fragment(unsigned mixed) { return (unsigned char)(FLAT_HASH_OCCUPIED | (mixed & 0x7f)); }
+
+    /// Return the first slot to probe from a scrambled hash. Capacity must be nonzero.
+    unsigned HomeSlot(unsigned mixed) const { return mixed >> shift_; }
+
+    /// Return the slot following the given slot.
+    unsigned NextSlot(unsigned index) const { return (index + 1) & (capacity_ - 1); }
+
+    /// Return whether the slot array must be rebuilt before inserting. Erased slots count toward the load, as probing has to step over them.
+    bool NeedRehash() const { return (size_ + deleted_ + 1) * 8 > capacity_ * 7; }
+
+    /// Return the slot count to rebuild with before inserting: keep the live elements at most 3/4 of the slots.
+    unsigned NextCapacity(unsigned numElements) const
+    {
+        unsigned newCapacity = capacity_ ? capacity_ : FLAT_HASH_MIN_CAPACITY;
+        while (numElements * 4 > newCapacity * 3)
+            newCapacity <<= 1;
+        return newCapacity;
+    }
+
+    /// Return the first occupied slot at or after the given slot, or capacity if none.
+    unsigned NextOccupied(unsigned index) const
+    {
+        while (index < capacity_ && !(ctrl_[index] & FLAT_HASH_OCCUPIED))
+            ++index;
+        return index;
+    }
+
+    /// Return the last occupied slot before the given slot, or capacity if none.
+    unsigned PrevOccupied(unsigned index) const
+    {
+        while (index > 0)
+        {
+            --index;
+            if (ctrl_[index] & FLAT_HASH_OCCUPIED)
+                return index;
+        }
+        return capacity_;
+    }
+
+    /// Allocate zeroed control bytes for a new slot count, which must be a power of two. Returns the old control bytes.
+    unsigned char* AllocateControl(unsigned newCapacity)
+    {
+        unsigned char* oldCtrl = ctrl_;
+        ctrl_ = new unsigned char[newCapacity];
+        memset(ctrl_, FLAT_HASH_EMPTY, newCapacity);
+        capacity_ = newCapacity;
+        deleted_ = 0;
+        shift_ = 32;
+        for (unsigned i = newCapacity; i > 1; i >>= 1)
+            --shift_;
+        return oldCtrl;
+    }
+
+    /// Mark a slot erased. If the following slot has never been used, no probe sequence continues past this one and it can be marked empty instead.
+    void MarkErased(unsigned index)
+    {
+        if (ctrl_[NextSlot(index)] == FLAT_HASH_EMPTY)
+            ctrl_[index] = FLAT_HASH_EMPTY;
+        else
+        {
+            ctrl_[index] = FLAT_HASH_DELETED;
+            ++deleted_;
+        }
+        --size_;
+    }
+
+    /// Control bytes.
+    unsigned char* ctrl_;
+    /// Number of slots, zero or a power of two.
+    unsigned capacity_;
+    /// Number of elements.
+    unsigned size_;
+    /// Number of erased slots.
+    unsigned deleted_;
+    /// Right shift from a scrambled hash to the home slot.
+    unsigned shift_;
+};
+
+}
@@ -0,0 +1,523 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Container/FlatHashBase.h"
+#include "../Container/Pair.h"
+#include "../Container/Vector.h"
+
+#include <cassert>
+#include <new>
+
+namespace Atomic
+{
+
+/// Hash map template class with open addressing. Keys and values are stored in one contiguous array, which makes lookups and iteration cache-friendly compared to HashMap, at the cost of not preserving insertion order. Unlike HashMap, inserting invalidates iterators.
+template <class T, class U> class FlatHashMap : public FlatHashBase
+{
+public:
+    typedef T KeyType;
+    typedef U ValueType;
+
+    /// Flat hash map key-value pair with const key.
+    class KeyValue
+    {
+    public:
+        /// Construct with key and default value.
+        explicit KeyValue(const T& first) :
+            first_(first),
+            second_()
+        {
+        }
+
+        /// Construct with key and value.
+        KeyValue(const T& first, const U& second) :
+            first_(first),
+            second_(second)
+        {
+        }
+
+        /// Copy-construct.
+        KeyValue(const KeyValue& value) :
+            first_(value.first_),
+            second_(value.second_)
+        {
+        }
+
+        /// Test for equality with another pair.
+        bool operator ==(const KeyValue& rhs) const { return first_ == rhs.first_ && second_ == rhs.second_; }
+
+        /// Test for inequality with another pair.
+        bool operator !=(const KeyValue& rhs) const { return first_ != rhs.first_ || second_ != rhs.second_; }
+
+        /// Key.
+        const T first_;
+        /// Value.
+        U second_;
+
+    private:
+        /// Prevent assignment.
+        KeyValue& operator =(const KeyValue& rhs);
+    };
+
+    /// Flat hash map iterator.
+    class Iterator
+    {
+    public:
+        /// Construct.
+        Iterator() :
+            map_(0),
+            index_(0)
+        {
+        }
+
+        /// Construct with a map and slot index.
+        Iterator(FlatHashMap* map, unsigned index) :
+            map_(map),
+            index_(index)
+        {
+        }
+
+        /// Preincrement the slot index.
+        Iterator& operator ++()
+        {
+            index_ = map_->NextOccupied(index_ + 1);
+            return *this;
+        }
+
+        /// Postincrement the slot index.
+        Iterator operator ++(int)
+        {
+            Iterator it = *this;
+            index_ = map_->NextOccupied(index_ + 1);
+            return it;
+        }
+
+        /// Predecrement the slot index.
+        Iterator& operator --()
+        {
+            index_ = map_->PrevOccupied(index_);
+            return *this;
+        }
+
+        /// Postdecrement the slot index.
+        Iterator operator --(int)
+        {
+            Iterator it = *this;
+            index_ = map_->PrevOccupied(index_);
+            return it;
+        }
+
+        /// Test for equality with another iterator.
+        bool operator ==(const Iterator& rhs) const { return index_ == rhs.index_ && map_ == rhs.map_; }
+
+        /// Test for inequality with another iterator.
+        bool operator !=(const Iterator& rhs) const { return index_ != rhs.index_ || map_ != rhs.map_; }
+
+        /// Point to the pair.
+        KeyValue* operator ->() const { return map_->Slots() + index_; }
+
+        /// Dereference the pair.
+        KeyValue& operator *() const { return map_->Slots()[index_]; }
+
+        /// Map.
+        FlatHashMap* map_;
+        /// Slot index.
+        unsigned index_;
+    };
+
+    /// Flat hash map const iterator.
+    class ConstIterator
+    {
+    public:
+        /// Construct.
+        ConstIterator() :
+            map_(0),
+            index_(0)
+        {
+        }
+
+        /// Construct with a map and slot index.
+        ConstIterator(const FlatHashMap* map, unsigned index) :
+            map_(map),
+            index_(index)
+        {
+        }
+
+        /// Construct from a non-const iterator.
+        ConstIterator(const Iterator& rhs) :
+            map_(rhs.map_),
+            index_(rhs.index_)
+        {
+        }
+
+        /// Assign from a non-const iterator.
+        ConstIterator& operator =(const Iterator& rhs)
+        {
+            map_ = rhs.map_;
+            index_ = rhs.index_;
+            return *this;
+        }
+
+        /// Preincrement the slot index.
+        ConstIterator& operator ++()
+        {
+            index_ = map_->NextOccupied(index_ + 1);
+            return *this;
+        }
+
+        /// Postincrement the slot index.
+        ConstIterator operator ++(int)
+        {
+            ConstIterator it = *this;
+            index_ = map_->NextOccupied(index_ + 1);
+            return it;
+        }
+
+        /// Predecrement the slot index.
+        ConstIterator& operator --()
+        {
+            index_ = map_->PrevOccupied(index_);
+            return *this;
+        }
+
+        /// Postdecrement the slot index.
+        ConstIterator operator --(int)
+        {
+            ConstIterator it = *this;
+            index_ = map_->PrevOccupied(index_);
+            return it;
+        }
+
+        /// Test for equality with another iterator.
+        bool operator ==(const ConstIterator& rhs) const { return index_ == rhs.index_ && map_ == rhs.map_; }
+
+        /// Test for inequality with another iterator.
+        bool operator !=(const ConstIterator& rhs) const { return index_ != rhs.index_ || map_ != rhs.map_; }
+
+        /// Point to the pair.
+        const KeyValue* operator ->() const { return map_->Slots() + index_; }
+
+        /// Dereference the pair.
+        const KeyValue& operator *() const { return map_->Slots()[index_]; }
+
+        /// Map.
+        const FlatHashMap* map_;
+        /// Slot index.
+        unsigned index_;
+    };
+
+    /// Construct empty.
+    FlatHashMap() :
+        slots_(0)
+    {
+    }
+
+    /// Construct from another map.
+    FlatHashMap(const FlatHashMap<T, U>& map) :
+        slots_(0)
+    {
+        if (map.Size())
+        {
+            Reserve(map.Size());
+            Insert(map);
+        }
+    }
+
+    /// Destruct.
+    ~FlatHashMap()
+    {
+        Clear();
+        delete[] ctrl_;
+        delete[] slots_;
+    }
+
+    /// Assign a map.
+    FlatHashMap& operator =(const FlatHashMap<T, U>& rhs)
+    {
+        // In case of self-assignment do nothing
+        if (&rhs != this)
+        {
+            Clear();
+            Insert(rhs);
+        }
+        return *this;
+    }
+
+    /// Add-assign a pair.
+    FlatHashMap& operator +=(const Pair<T, U>& rhs)
+    {
+        Insert(rhs);
+        return *this;
+    }
+
+    /// Add-assign a map.
+    FlatHashMap& operator +=(const FlatHashMap<T, U>& rhs)
+    {
+        Insert(rhs);
+        return *this;
+    }
+
+    /// Index the map. Create a new pair if key not found.
+    U& operator [](const T& key)
+    {
+        unsigned index = FindSlot(key);
+        if (index == capacity_)
+            index = InsertNew(key, 0);
+        return Slots()[index].second_;
+    }
+
+    /// Index the map. Return null if key is not found, does not create a new pair.
+    U* operator [](const T& key) const
+    {
+        unsigned index = FindSlot(key);
+        return index != capacity_ ? &Slots()[index].second_ : 0;
+    }
+
+    /// Insert a pair. Return an iterator to it. Replaces the value if the key already exists.
+    Iterator Insert(const Pair<T, U>& pair)
+    {
+        unsigned index = FindSlot(pair.first_);
+        if (index != capacity_)
+            Slots()[index].second_ = pair.second_;
+        else
+            index = InsertNew(pair.first_, &pair.second_);
+        return Iterator(this, index);
+    }
+
+    /// Insert a map.
+    void Insert(const FlatHashMap<T, U>& map)
+    {
+        for (ConstIterator it = map.Begin(); it != map.End(); ++it)
+            Insert(MakePair(it->first_, it->second_));
+    }
+
+    /// Erase a pair by key. Return true if was found.
+    bool Erase(const T& key)
+    {
+        unsigned index = FindSlot(key);
+        if (index == capacity_)
+            return false;
+
+        EraseSlot(index);
+        return true;
+    }
+
+    /// Erase a pair by iterator. Return iterator to the next pair.
+    Iterator Erase(const Iterator& it)
+    {
+        assert(it.map_ == this && it.index_ < capacity_);
+        EraseSlot(it.index_);
+        return Iterator(this, NextOccupied(it.index_ + 1));
+    }
+
+    /// Clear the map. Keeps the slot array allocated.
+    void Clear()
+    {
+        if (size_)
+        {
+            KeyValue* slots = Slots();
+            for (unsigned i = 0; i < capacity_; ++i)
+            {
+                if (ctrl_[i] & FLAT_HASH_OCCUPIED)
+                    (slots + i)->~KeyValue();
+            }
+        }
+
+        if (capacity_)
+            memset(ctrl_, FLAT_HASH_EMPTY, capacity_);
+        size_ = 0;
+        deleted_ = 0;
+    }
+
+    /// Ensure that the given number of pairs can be held without rebuilding the slot array.
+    void Reserve(unsigned numElements)
+    {
+        // Keep below the maximum load with room for one more insert
+        unsigned newCapacity = capacity_ ? capacity_ : FLAT_HASH_MIN_CAPACITY;
+        while ((numElements + 1) * 8 > newCapacity * 7)
+            newCapacity <<= 1;
+        if (newCapacity != capacity_)
+            Rehash(newCapacity);
+    }
+
+    /// Swap with another map.
+    void Swap(FlatHashMap<T, U>& map)
+    {
+        FlatHashBase::Swap(map);
+        Atomic::Swap(slots_, map.slots_);
+    }
+
+    /// Return iterator to the pair with key, or end iterator if not found.
+    Iterator Find(const T& key) { return Iterator(this, FindSlot(key)); }
+
+    /// Return const iterator to the pair with key, or end iterator if not found.
+    ConstIterator Find(const T& key) const { return ConstIterator(this, FindSlot(key)); }
+
+    /// Return whether contains a pair with key.
+    bool Contains(const T& key) const { return FindSlot(key) != capacity_; }
+
+    /// Try to copy value to output. Return true if was found.
+    bool TryGetValue(const T& key, U& out) const
+    {
+        unsigned index = FindSlot(key);
+        if (index == capacity_)
+            return false;
+
+        out = Slots()[index].second_;
+        return true;
+    }
+
+    /// Return all the keys.
+    Vector<T> Keys() const
+    {
+        Vector<T> result;
+        result.Reserve(size_);
+        for (ConstIterator it = Begin(); it != End(); ++it)
+            result.Push(it->first_);
+        return result;
+    }
+
+    /// Return all the values.
+    Vector<U> Values() const
+    {
+        Vector<U> result;
+        result.Reserve(size_);
+        for (ConstIterator it = Begin(); it != End(); ++it)
+            result.Push(it->second_);
+        return result;
+    }
+
+    /// Return iterator to the beginning.
+    Iterator Begin() { return Iterator(this, NextOccupied(0)); }
+
+    /// Return iterator to the beginning.
+    ConstIterator Begin() const { return ConstIterator(this, NextOccupied(0)); }
+
+    /// Return iterator to the end.
+    Iterator End() { return Iterator(this, capacity_); }
+
+    /// Return iterator to the end.
+    ConstIterator End() const { return ConstIterator(this, capacity_); }
+
+private:
+    /// Return the slot array.
+    KeyValue* Slots() const { return reinterpret_cast<KeyValue*>(slots_); }
+
+    /// Return the slot index of a key, or capacity if not found.
+    unsigned FindSlot(const T& key) const
+    {
+        if (!size_)
+            return capacity_;
+
+        unsigned mixed = Mix(MakeHash(key));
+        unsigned char fragment = Fragment(mixed);
+        KeyValue* slots = Slots();
+
+        // At least one slot is always left empty, so the probe terminates
+        for (unsigned index = HomeSlot(mixed); ; index = NextSlot(index))
+        {
+            unsigned char ctrl = ctrl_[index];
+            if (ctrl == FLAT_HASH_EMPTY)
+                return capacity_;
+            if (ctrl == fragment && slots[index].first_ == key)
+                return index;
+        }
+    }
+
+    /// Insert a key that does not exist yet, with a value or a default value if null. Return the slot index.
+    unsigned InsertNew(const T& key, const U* value)
+    {
+        if (NeedRehash())
+            Rehash(NextCapacity(size_ + 1));
+
+        unsigned mixed = Mix(MakeHash(key));
+        unsigned index = HomeSlot(mixed);
+        while (ctrl_[index] & FLAT_HASH_OCCUPIED)
+            index = NextSlot(index);
+
+        if (ctrl_[index] == FLAT_HASH_DELETED)
+            --deleted_;
+        ctrl_[index] = Fragment(mixed);
+
+        KeyValue* slot = Slots() + index;
+        if (value)
+            new(slot) KeyValue(key, *value);
+        else
+            new(slot) KeyValue(key);
+
+        ++size_;
+        return index;
+    }
+
+    /// Destruct the pair in a slot and mark the slot erased.
+    void EraseSlot(unsigned index)
+    {
+        (Slots() + index)->~KeyValue();
+        MarkErased(index);
+    }
+
+    /// Rebuild the slot array with a new slot count, dropping erased slots.
+    void Rehash(unsigned newCapacity)
+    {
+        unsigned oldCapacity = capacity_;
+        unsigned char* oldCtrl = AllocateControl(newCapacity);
+        KeyValue* oldSlots = Slots();
+        unsigned char* oldStorage = slots_;
+
+        slots_ = new unsigned char[newCapacity * sizeof(KeyValue)];
+        KeyValue* slots = Slots();
+
+        for (unsigned i = 0; i < oldCapacity; ++i)
+        {
+            if (!(oldCtrl[i] & FLAT_HASH_OCCUPIED))
+                continue;
+
+            KeyValue* oldSlot = oldSlots + i;
+            unsigned mixed = Mix(MakeHash(oldSlot->first_));
+            unsigned index = HomeSlot(mixed);
+            while (ctrl_[index] != FLAT_HASH_EMPTY)
+                index = NextSlot(index);
+
+            ctrl_[index] = Fragment(mixed);
+            new(slots + index) KeyValue(*oldSlot);
+            oldSlot->~KeyValue();
+        }
+
+        delete[] oldCtrl;
+        delete[] oldStorage;
+    }
+
+    /// Slot storage.
+    unsigned char* slots_;
+};
+
+template <class T, class U> typename Atomic::FlatHashMap<T, U>::ConstIterator begin(const Atomic::FlatHashMap<T, U>& v) { return v.Begin(); }
+
+template <class T, class U> typename Atomic::FlatHashMap<T, U>::ConstIterator end(const Atomic::FlatHashMap<T, U>& v) { return v.End(); }
+
+template <class T, class U> typename Atomic::FlatHashMap<T, U>::Iterator begin(Atomic::FlatHashMap<T, U>& v) { return v.Begin(); }
+
+template <class T, class U> typename Atomic::FlatHashMap<T, U>::Iterator end(Atomic::FlatHashMap<T, U>& v) { return v.End(); }
+
+}
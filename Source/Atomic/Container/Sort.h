@@ -141,4 +141,73 @@ template <class T, class U> void Sort(RandomAccessIterator<T> begin, RandomAcces
     InsertionSort(begin, end, compare);
 }
 
+// ATOMIC BEGIN
+
+/// Radix sort element: an unsigned integer key and the value it sorts.
+template <class T> struct RadixSortEntry
+{
+    /// Sort key.
+    unsigned long long key_;
+    /// Value.
+    T value_;
+};
+
+/// Sort entries in ascending key order using a stable least significant byte first radix sort. Only the lowest numKeyBytes
+/// bytes of the keys are compared, and byte positions where all keys are equal are skipped. The temporary array must hold
+/// count entries; the result is always in the entries array.
+template <class T> void RadixSort(RadixSortEntry<T>* entries, RadixSortEntry<T>* temp, unsigned count, unsigned numKeyBytes = 8)
+{
+    if (count < 2)
+        return;
+    if (numKeyBytes > 8)
+        numKeyBytes = 8;
+
+    // Histogram all bytes in a single pass
+    unsigned counts[8][256];
+    for (unsigned i = 0; i < numKeyBytes; ++i)
+    {
+        for (unsigned j = 0; j < 256; ++j)
+            counts[i][j] = 0;
+    }
+    for (unsigned i = 0; i < count; ++i)
+    {
+        unsigned long long key = entries[i].key_;
+        for (unsigned j = 0; j < numKeyBytes; ++j)
+            ++counts[j][(key >> (j * 8)) & 0xff];
+    }
+
+    RadixSortEntry<T>* src = entries;
+    RadixSortEntry<T>* dest = temp;
+    for (unsigned i = 0; i < numKeyBytes; ++i)
+    {
+        unsigned* byteCounts = counts[i];
+        unsigned shift = i * 8;
+
+        // Skip the byte if it is the same in every key
+        if (byteCounts[(src[0].key_ >> shift) & 0xff] == count)
+            continue;
+
+        unsigned offset = 0;
+        for (unsigned j = 0; j < 256; ++j)
+        {
+            unsigned byteCount = byteCounts[j];
+            byteCounts[j] = offset;
+            offset += byteCount;
+        }
+
+        for (unsigned j = 0; j < count; ++j)
+            dest[byteCounts[(src[j].key_ >> shift) & 0xff]++] = src[j];
+
+        Swap(src, dest);
+    }
+
+    if (src != entries)
+    {
+        for (unsigned i = 0; i < count; ++i)
+            entries[i] = src[i];
+    }
+}
+
+// ATOMIC END
+
 }
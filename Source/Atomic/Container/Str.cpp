@@ -417,18 +417,33 @@ String::Iterator String::Erase(const String::Iterator& start, const String::Iter
 
 void String::Resize(unsigned newLength)
 {
-    if (!capacity_)
+// ATOMIC BEGIN
+    if (!IsAllocated())
     {
         // If zero length requested, do not allocate buffer yet
-        if (!newLength)
+        if (!newLength && buffer_ == &endZero)
             return;
 
-        // Calculate initial capacity
-        capacity_ = newLength + 1;
-        if (capacity_ < MIN_CAPACITY)
-            capacity_ = MIN_CAPACITY;
+        if (newLength < STRING_SHORT_BUFFER_SIZE)
+        {
+            // Fits in the short buffer, no allocation needed
+            buffer_ = shortBuffer_;
+        }
+        else
+        {
+            // Calculate initial capacity
+            unsigned capacity = newLength + 1;
+            if (capacity < MIN_CAPACITY)
+                capacity = MIN_CAPACITY;
+
+            char* newBuffer = new char[capacity];
+            // Move the existing data first, as the capacity shares storage with the short buffer
+            if (length_)
+                CopyChars(newBuffer, buffer_, length_);
 
-        buffer_ = new char[capacity_];
+            capacity_ = capacity;
+            buffer_ = newBuffer;
+        }
     }
     else
     {
@@ -447,6 +462,7 @@ void String::Resize(unsigned newLength)
             buffer_ = newBuffer;
         }
     }
+// ATOMIC END
 
     buffer_[newLength] = 0;
     length_ = newLength;
@@ -456,14 +472,32 @@ void String::Reserve(unsigned newCapacity)
 {
     if (newCapacity < length_ + 1)
         newCapacity = length_ + 1;
-    if (newCapacity == capacity_)
+    if (newCapacity == Capacity())
         return;
 
+// ATOMIC BEGIN
+    if (newCapacity <= STRING_SHORT_BUFFER_SIZE)
+    {
+        // Move to the short buffer, releasing the allocated buffer if any
+        if (IsAllocated())
+        {
+            char* oldBuffer = buffer_;
+            CopyChars(shortBuffer_, oldBuffer, length_ + 1);
+            delete[] oldBuffer;
+        }
+        else if (buffer_ == &endZero)
+            shortBuffer_[0] = 0;
+
+        buffer_ = shortBuffer_;
+        return;
+    }
+
     char* newBuffer = new char[newCapacity];
     // Move the existing data to the new buffer, then delete the old buffer
     CopyChars(newBuffer, buffer_, length_ + 1);
-    if (capacity_)
+    if (IsAllocated())
         delete[] buffer_;
+// ATOMIC END
 
     capacity_ = newCapacity;
     buffer_ = newBuffer;
@@ -471,7 +505,9 @@ void String::Reserve(unsigned newCapacity)
 
 void String::Compact()
 {
-    if (capacity_)
+// ATOMIC BEGIN
+    if (IsAllocated())
+// ATOMIC END
         Reserve(length_ + 1);
 }
 
@@ -482,9 +518,24 @@ void String::Clear()
 
 void String::Swap(String& str)
 {
+// ATOMIC BEGIN
+    // Short buffers live inside the objects, so swap their contents and re-point the buffers
+    bool thisShort = buffer_ == shortBuffer_;
+    bool otherShort = str.buffer_ == str.shortBuffer_;
+
+    char temp[STRING_SHORT_BUFFER_SIZE];
+    memcpy(temp, shortBuffer_, STRING_SHORT_BUFFER_SIZE);
+    memcpy(shortBuffer_, str.shortBuffer_, STRING_SHORT_BUFFER_SIZE);
+    memcpy(str.shortBuffer_, temp, STRING_SHORT_BUFFER_SIZE);
+
     Atomic::Swap(length_, str.length_);
-    Atomic::Swap(capacity_, str.capacity_);
     Atomic::Swap(buffer_, str.buffer_);
+
+    if (otherShort)
+        buffer_ = shortBuffer_;
+    if (thisShort)
+        str.buffer_ = str.shortBuffer_;
+// ATOMIC END
 }
 
 String String::Substring(unsigned pos) const
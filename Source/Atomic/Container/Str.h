@@ -33,6 +33,10 @@ namespace Atomic
 
 static const int CONVERSION_BUFFER_LENGTH = 128;
 static const int MATRIX_CONVERSION_BUFFER_LENGTH = 256;
+// ATOMIC BEGIN
+/// Size of the in-place buffer for short strings, including the end zero. Uses the space of the capacity and padding up to two pointers, so that String stays within the Variant value size: 12 bytes in a 64-bit build, 4 bytes in a 32-bit build.
+static const unsigned STRING_SHORT_BUFFER_SIZE = (unsigned)(2 * sizeof(void*) - sizeof(unsigned));
+// ATOMIC END
 
 class WString;
 
@@ -148,7 +152,7 @@ public:
     /// Destruct.
     ~String()
     {
-        if (capacity_)
+        if (IsAllocated())
             delete[] buffer_;
     }
 
@@ -402,7 +406,7 @@ public:
     unsigned Length() const { return length_; }
 
     /// Return buffer capacity.
-    unsigned Capacity() const { return capacity_; }
+    unsigned Capacity() const { return IsAllocated() ? capacity_ : (buffer_ != &endZero ? STRING_SHORT_BUFFER_SIZE : 0); }
 
     /// Return whether the string is empty.
     bool Empty() const { return length_ == 0; }
@@ -514,11 +518,23 @@ private:
     /// Replace a substring with another substring.
     void Replace(unsigned pos, unsigned length, const char* srcStart, unsigned srcLength);
 
+// ATOMIC BEGIN
+    /// Return whether the buffer is heap-allocated, as opposed to the shared end zero or the short buffer.
+    bool IsAllocated() const { return buffer_ != &endZero && buffer_ != shortBuffer_; }
+// ATOMIC END
+
     /// String length.
     unsigned length_;
-    /// Capacity, zero if buffer not allocated.
-    unsigned capacity_;
-    /// String buffer, null if not allocated.
+// ATOMIC BEGIN
+    union
+    {
+        /// Capacity of the heap-allocated buffer. Only valid if the buffer is allocated.
+        unsigned capacity_;
+        /// In-place buffer for short strings.
+        char shortBuffer_[STRING_SHORT_BUFFER_SIZE];
+    };
+// ATOMIC END
+    /// String buffer. Points to the end zero if empty, or to the short buffer if the string fits in it.
     char* buffer_;
 
     /// End zero for empty strings.
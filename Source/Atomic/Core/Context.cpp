@@ -39,6 +39,11 @@
 namespace Atomic
 {
 
+// ATOMIC BEGIN
+/// Maximum number of free event data maps kept in the pool.
+static const unsigned MAX_POOLED_EVENT_DATA_MAPS = 32;
+// ATOMIC END
+
 #ifndef MINI_URHO
 // Keeps track of how many times SDL was initialised so we know when to call SDL_Quit().
 static int sdlInitCounter = 0;
@@ -152,12 +157,18 @@ Context::~Context()
     for (PODVector<VariantMap*>::Iterator i = eventDataMaps_.Begin(); i != eventDataMaps_.End(); ++i)
         delete *i;
     eventDataMaps_.Clear();
+
+// ATOMIC BEGIN
+    for (PODVector<VariantMap*>::Iterator i = eventDataMapPool_.Begin(); i != eventDataMapPool_.End(); ++i)
+        delete *i;
+    eventDataMapPool_.Clear();
+// ATOMIC END
 }
 
 // ATOMIC BEGIN
 SharedPtr<Object> Context::CreateObject(StringHash objectType, const XMLElement& source)
 {
-    HashMap<StringHash, SharedPtr<ObjectFactory> >::ConstIterator i = factories_.Find(objectType);
+    FlatHashMap<StringHash, SharedPtr<ObjectFactory> >::ConstIterator i = factories_.Find(objectType);
     if (i != factories_.End())
         return i->second_->CreateObject(source);
     else
@@ -238,6 +249,35 @@ VariantMap& Context::GetEventDataMap()
     return ret;
 }
 
+// ATOMIC BEGIN
+
+VariantMap* Context::AcquireEventDataMap()
+{
+    if (eventDataMapPool_.Empty())
+        return new VariantMap();
+
+    VariantMap* map = eventDataMapPool_.Back();
+    eventDataMapPool_.Pop();
+    return map;
+}
+
+void Context::ReleaseEventDataMap(VariantMap* map)
+{
+    if (!map)
+        return;
+
+    if (eventDataMapPool_.Size() >= MAX_POOLED_EVENT_DATA_MAPS)
+    {
+        delete map;
+        return;
+    }
+
+    map->Clear();
+    eventDataMapPool_.Push(map);
+}
+
+// ATOMIC END
+
 #ifndef MINI_URHO
 bool Context::RequireSDL(unsigned int sdlFlags)
 {
@@ -373,7 +413,7 @@ const String& Context::GetTypeName(StringHash objectType) const
     // ATOMIC BEGIN
 
     // Search factories to find the hash-to-name mapping
-    HashMap<StringHash, SharedPtr<ObjectFactory> >::ConstIterator i = factories_.Find(objectType);
+    FlatHashMap<StringHash, SharedPtr<ObjectFactory> >::ConstIterator i = factories_.Find(objectType);
     return i != factories_.End() ? i->second_->GetFactoryTypeName() : String::EMPTY;
     
     // ATOMIC END
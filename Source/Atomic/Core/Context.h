@@ -23,6 +23,9 @@
 #pragma once
 
 #include "../Container/HashSet.h"
+// ATOMIC BEGIN
+#include "../Container/FlatHashMap.h"
+// ATOMIC END
 #include "../Core/Attribute.h"
 #include "../Core/Object.h"
 
@@ -115,6 +118,12 @@ public:
     void UpdateAttributeDefaultValue(StringHash objectType, const char* name, const Variant& defaultValue);
     /// Return a preallocated map for event data. Used for optimization to avoid constant re-allocation of event data maps.
     VariantMap& GetEventDataMap();
+// ATOMIC BEGIN
+    /// Acquire an event data map from the pool. Used by script bindings and other code that needs an event data map outliving the current nesting level. Must be returned with ReleaseEventDataMap(). Main thread only.
+    VariantMap* AcquireEventDataMap();
+    /// Clear an event data map and return it to the pool. The map keeps its node allocator and buckets, so refilling it does not allocate.
+    void ReleaseEventDataMap(VariantMap* map);
+// ATOMIC END
     /// Initialises the specified SDL systems, if not already. Returns true if successful. This call must be matched with ReleaseSDL() when SDL functions are no longer required, even if this call fails.
     bool RequireSDL(unsigned int sdlFlags);
     /// Indicate that you are done with using SDL. Must be called after using RequireSDL().
@@ -159,7 +168,7 @@ public:
     const HashMap<StringHash, SharedPtr<Object> >& GetSubsystems() const { return subsystems_; }
 
     /// Return all object factories.
-    const HashMap<StringHash, SharedPtr<ObjectFactory> >& GetObjectFactories() const { return factories_; }
+    const FlatHashMap<StringHash, SharedPtr<ObjectFactory> >& GetObjectFactories() const { return factories_; }
 
     /// Return all object categories.
     const HashMap<String, Vector<StringHash> >& GetObjectCategories() const { return objectCategories_; }
@@ -227,6 +236,8 @@ public:
     // hook for listening into events
     void AddGlobalEventListener(GlobalEventListener* listener) { globalEventListeners_.Push(listener); }
     void RemoveGlobalEventListener(GlobalEventListener* listener) { globalEventListeners_.Erase(globalEventListeners_.Find(listener)); }
+    /// Return whether any global event listeners are registered.
+    bool HasGlobalEventListeners() const { return !globalEventListeners_.Empty(); }
 
     // ATOMIC END
 
@@ -250,7 +261,7 @@ private:
     void SetEventHandler(EventHandler* handler) { eventHandler_ = handler; }
 
     /// Object factories.
-    HashMap<StringHash, SharedPtr<ObjectFactory> > factories_;
+    FlatHashMap<StringHash, SharedPtr<ObjectFactory> > factories_;
     /// Subsystems.
     HashMap<StringHash, SharedPtr<Object> > subsystems_;
     /// Attribute descriptions per object type.
@@ -290,10 +301,52 @@ private:
 
     PODVector<GlobalEventListener*> globalEventListeners_;
     bool editorContext_;
+    /// Free pooled event data maps.
+    PODVector<VariantMap*> eventDataMapPool_;
     // ATOMIC END
 
 };
 
+// ATOMIC BEGIN
+
+/// Event data map acquired from the context pool for the lifetime of the scope.
+class ATOMIC_API ScopedEventDataMap
+{
+public:
+    /// Construct and acquire a map.
+    ScopedEventDataMap(Context* context) :
+        context_(context),
+        map_(context->AcquireEventDataMap())
+    {
+    }
+
+    /// Destruct and return the map to the pool.
+    ~ScopedEventDataMap()
+    {
+        context_->ReleaseEventDataMap(map_);
+    }
+
+    /// Return the map.
+    VariantMap& Get() const { return *map_; }
+    /// Return the map.
+    VariantMap& operator *() const { return *map_; }
+    /// Point to the map.
+    VariantMap* operator ->() const { return map_; }
+
+private:
+    /// Prevent copy construction.
+    ScopedEventDataMap(const ScopedEventDataMap& rhs);
+    /// Prevent assignment.
+    ScopedEventDataMap& operator =(const ScopedEventDataMap& rhs);
+
+    /// Context.
+    Context* context_;
+    /// Acquired map.
+    VariantMap* map_;
+};
+
+// ATOMIC END
+
 template <class T> void Context::RegisterFactory() { RegisterFactory(new ObjectFactoryImpl<T>(this)); }
 
 template <class T> void Context::RegisterFactory(const char* category)
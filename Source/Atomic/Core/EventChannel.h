@@ -0,0 +1,220 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Container/Ptr.h"
+#include "../Core/Object.h"
+
+namespace Atomic
+{
+
+/// Internal helper class for invoking a typed event channel handler.
+template <class T> class EventChannelHandler
+{
+public:
+    /// Construct with receiver.
+    EventChannelHandler(Object* receiver) :
+        receiver_(receiver)
+    {
+    }
+
+    /// Destruct.
+    virtual ~EventChannelHandler() { }
+
+    /// Invoke the handler function.
+    virtual void Invoke(const T& data) = 0;
+
+    /// Return receiver, null if it has been destroyed.
+    Object* GetReceiver() const { return receiver_.Get(); }
+
+    /// Return whether the receiver has been destroyed.
+    bool IsExpired() const { return receiver_.Expired(); }
+
+protected:
+    /// Event receiver.
+    WeakPtr<Object> receiver_;
+};
+
+/// Template implementation of the typed event channel handler invoke helper (stores a function pointer of specific class).
+template <class T, class R> class EventChannelHandlerImpl : public EventChannelHandler<T>
+{
+public:
+    typedef void (R::*HandlerFunctionPtr)(const T&);
+
+    /// Construct with receiver and function pointers.
+    EventChannelHandlerImpl(R* receiver, HandlerFunctionPtr function) :
+        EventChannelHandler<T>(receiver),
+        function_(function)
+    {
+        assert(receiver);
+        assert(function_);
+    }
+
+    /// Invoke the handler function.
+    virtual void Invoke(const T& data)
+    {
+        R* receiver = static_cast<R*>(this->receiver_.Get());
+        (receiver->*function_)(data);
+    }
+
+private:
+    /// Class-specific pointer to handler function.
+    HandlerFunctionPtr function_;
+};
+
+/// Typed event channel for high-frequency events. Bypasses the VariantMap construction and the receiver hash map lookups of Object::SendEvent: the payload is passed by const reference straight to a flat array of handlers. Main thread only, like SendEvent.
+template <class T> class EventChannel
+{
+public:
+    /// Construct.
+    EventChannel() :
+        sendDepth_(0),
+        dirty_(false)
+    {
+    }
+
+    /// Destruct.
+    ~EventChannel()
+    {
+        for (unsigned i = 0; i < handlers_.Size(); ++i)
+            delete handlers_[i];
+    }
+
+    /// Subscribe a receiver's member function. A receiver may hold only one subscription per channel; subscribing again replaces the previous handler.
+    template <class R> void Subscribe(R* receiver, void (R::*function)(const T&))
+    {
+        Unsubscribe(receiver);
+        handlers_.Push(new EventChannelHandlerImpl<T, R>(receiver, function));
+    }
+
+    /// Unsubscribe a receiver. Safe to call during Send().
+    void Unsubscribe(Object* receiver)
+    {
+        for (unsigned i = 0; i < handlers_.Size(); ++i)
+        {
+            EventChannelHandler<T>* handler = handlers_[i];
+            if (handler && handler->GetReceiver() == receiver)
+            {
+                RemoveAt(i);
+                return;
+            }
+        }
+    }
+
+    /// Unsubscribe all receivers. Safe to call during Send().
+    void Clear()
+    {
+        for (unsigned i = 0; i < handlers_.Size(); ++i)
+        {
+            delete handlers_[i];
+            handlers_[i] = 0;
+        }
+
+        if (sendDepth_)
+            dirty_ = true;
+        else
+            handlers_.Clear();
+    }
+
+    /// Send the payload to all subscribed receivers in subscription order. Receivers subscribed during the send are also invoked.
+    void Send(const T& data)
+    {
+        ++sendDepth_;
+
+        // Note: size is re-read on each iteration, as handlers may be added during the send
+        for (unsigned i = 0; i < handlers_.Size(); ++i)
+        {
+            EventChannelHandler<T>* handler = handlers_[i];
+            // Holes may exist if receivers were removed during the send
+            if (!handler)
+                continue;
+
+            if (handler->IsExpired())
+            {
+                RemoveAt(i);
+                continue;
+            }
+
+            handler->Invoke(data);
+        }
+
+        if (--sendDepth_ == 0 && dirty_)
+            Compact();
+    }
+
+    /// Return whether there are subscribed receivers.
+    bool HasSubscribers() const { return GetNumSubscribers() != 0; }
+
+    /// Return number of subscribed receivers.
+    unsigned GetNumSubscribers() const
+    {
+        unsigned count = 0;
+        for (unsigned i = 0; i < handlers_.Size(); ++i)
+        {
+            if (handlers_[i])
+                ++count;
+        }
+        return count;
+    }
+
+private:
+    /// Prevent copy construction.
+    EventChannel(const EventChannel& rhs);
+    /// Prevent assignment.
+    EventChannel& operator =(const EventChannel& rhs);
+
+    /// Remove the handler at index. Leaves a hole if a send is in progress.
+    void RemoveAt(unsigned index)
+    {
+        delete handlers_[index];
+        if (sendDepth_)
+        {
+            handlers_[index] = 0;
+            dirty_ = true;
+        }
+        else
+            handlers_.Erase(index);
+    }
+
+    /// Remove holes left by removals during a send.
+    void Compact()
+    {
+        unsigned dest = 0;
+        for (unsigned i = 0; i < handlers_.Size(); ++i)
+        {
+            if (handlers_[i])
+                handlers_[dest++] = handlers_[i];
+        }
+        handlers_.Resize(dest);
+        dirty_ = false;
+    }
+
+    /// Handlers in subscription order.
+    PODVector<EventChannelHandler<T>*> handlers_;
+    /// Nesting depth of sends in progress.
+    unsigned sendDepth_;
+    /// Holes exist in the handler array.
+    bool dirty_;
+};
+
+}
@@ -314,9 +314,18 @@ void Object::SendEvent(StringHash eventType, VariantMap& eventData)
     // Make a weak pointer to self to check for destruction during event handling
     WeakPtr<Object> self(this);
     Context* context = context_;
-    HashSet<Object*> processed;
 
 // ATOMIC BEGIN
+    // Fast path: if nobody listens to the event, skip the sender bookkeeping altogether
+    EventReceiverGroup* specificGroup = context->GetEventReceivers(this, eventType);
+    bool hadNonSpecificReceivers = context->GetEventReceivers(eventType) != 0;
+    if (!specificGroup && !hadNonSpecificReceivers && !context->HasGlobalEventListeners())
+        return;
+
+    // The specific receivers only need to be recorded if there are also non-specific receivers
+    bool trackProcessed = specificGroup && hadNonSpecificReceivers;
+    HashSet<Object*> processed;
+
     context->GlobalBeginSendEvent(this, eventType, eventData);
 // ATOMIC END
 
@@ -324,7 +333,10 @@ void Object::SendEvent(StringHash eventType, VariantMap& eventData)
 
     // Check first the specific event receivers
     // Note: group is held alive with a shared ptr, as it may get destroyed along with the sender
-    SharedPtr<EventReceiverGroup> group(context->GetEventReceivers(this, eventType));
+    SharedPtr<EventReceiverGroup> group(specificGroup);
+// ATOMIC BEGIN
+    SharedPtr<EventReceiverGroup> specific(group);
+// ATOMIC END
     if (group)
     {
         group->BeginSendEvent();
@@ -346,7 +358,10 @@ void Object::SendEvent(StringHash eventType, VariantMap& eventData)
                 return;
             }
 
-            processed.Insert(receiver);
+// ATOMIC BEGIN
+            if (trackProcessed)
+                processed.Insert(receiver);
+// ATOMIC END
         }
 
         group->EndSendEvent();
@@ -358,7 +373,9 @@ void Object::SendEvent(StringHash eventType, VariantMap& eventData)
     {
         group->BeginSendEvent();
 
-        if (processed.Empty())
+// ATOMIC BEGIN
+        if (!specific)
+// ATOMIC END
         {
             for (unsigned i = 0; i < group->receivers_.Size(); ++i)
             {
@@ -382,8 +399,11 @@ void Object::SendEvent(StringHash eventType, VariantMap& eventData)
             for (unsigned i = 0; i < group->receivers_.Size(); ++i)
             {
                 Object* receiver = group->receivers_[i];
-                if (!receiver || processed.Contains(receiver))
+// ATOMIC BEGIN
+                // If the non-specific group was created during the send, fall back to checking the specific group
+                if (!receiver || (trackProcessed ? processed.Contains(receiver) : specific->receivers_.Contains(receiver)))
                     continue;
+// ATOMIC END
 
                 receiver->OnEvent(this, eventType, eventData);
 
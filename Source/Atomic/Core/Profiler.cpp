@@ -23,6 +23,9 @@
 #include "../Precompiled.h"
 
 #include "../Core/Profiler.h"
+// ATOMIC BEGIN
+#include "../IO/Serializer.h"
+// ATOMIC END
 
 #include <cstdio>
 
@@ -31,11 +34,21 @@
 namespace Atomic
 {
 
+// ATOMIC BEGIN
+static const unsigned DEFAULT_TIMELINE_CAPACITY = 16384;
+// ATOMIC END
+
 Profiler::Profiler(Context* context) :
     Object(context),
     current_(0),
     root_(0),
-    intervalFrames_(0)
+    intervalFrames_(0),
+    // ATOMIC BEGIN
+    numTimelines_(0),
+    timelineCapacity_(DEFAULT_TIMELINE_CAPACITY),
+    frameNumber_(0),
+    timelineEnabled_(false)
+    // ATOMIC END
 {
     current_ = root_ = new ProfilerBlock(0, "RunFrame");
 }
@@ -44,6 +57,11 @@ Profiler::~Profiler()
 {
     delete root_;
     root_ = 0;
+
+    // ATOMIC BEGIN
+    for (unsigned i = 0; i < numTimelines_; ++i)
+        delete timelines_[i];
+    // ATOMIC END
 }
 
 void Profiler::BeginFrame()
@@ -61,6 +79,9 @@ void Profiler::EndFrame()
     ++intervalFrames_;
     root_->EndFrame();
     current_ = root_;
+    // ATOMIC BEGIN
+    ++frameNumber_;
+    // ATOMIC END
 }
 
 void Profiler::BeginInterval()
@@ -141,4 +162,85 @@ void Profiler::PrintData(ProfilerBlock* block, String& output, unsigned depth, u
         PrintData(*i, output, depth, maxDepth, showUnused, showTotal);
 }
 
+// ATOMIC BEGIN
+
+ProfilerThreadTimeline* Profiler::GetThreadTimeline()
+{
+    ThreadID threadID = Thread::GetCurrentThreadID();
+
+    // Lookup is lock-free, as timelines are never removed and a slot is filled before the count is published
+    unsigned numTimelines = numTimelines_.load(std::memory_order_acquire);
+    for (unsigned i = 0; i < numTimelines; ++i)
+    {
+        if (timelines_[i]->threadID_ == threadID)
+            return timelines_[i];
+    }
+
+    MutexLock lock(timelinesMutex_);
+
+    numTimelines = numTimelines_.load(std::memory_order_relaxed);
+    if (numTimelines >= PROFILER_TIMELINE_MAX_THREADS)
+        return 0;
+
+    // Main thread is always shown first
+    unsigned index = Thread::IsMainThread() ? 0 : numTimelines + 1;
+    timelines_[numTimelines] = new ProfilerThreadTimeline(threadID, index, timelineCapacity_);
+    numTimelines_.store(numTimelines + 1, std::memory_order_release);
+
+    return timelines_[numTimelines];
+}
+
+bool Profiler::SaveTimeline(Serializer& dest, unsigned firstFrame, unsigned lastFrame) const
+{
+    String output("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    char line[256];
+    bool first = true;
+
+    unsigned numTimelines = numTimelines_.load(std::memory_order_acquire);
+    for (unsigned i = 0; i < numTimelines; ++i)
+    {
+        const ProfilerThreadTimeline* timeline = timelines_[i];
+
+        if (timeline->index_)
+            sprintf(line, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"Thread %u\"}}",
+                first ? "" : ",\n", timeline->index_, timeline->index_);
+        else
+            sprintf(line, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"Main\"}}",
+                first ? "" : ",\n");
+        output += String(line);
+        first = false;
+
+        // Walk the events still held in the ring buffer, oldest first
+        unsigned head = timeline->head_.load(std::memory_order_acquire);
+        unsigned capacity = timeline->events_.Size();
+        unsigned start = head > capacity ? head - capacity : 0;
+
+        for (unsigned j = start; j < head; ++j)
+        {
+            const ProfilerTimelineEvent& event = timeline->events_[j % capacity];
+            if (event.end_ < event.begin_ || event.frame_ < firstFrame || event.frame_ > lastFrame)
+                continue;
+
+            // Block names come from code and resource names, but escape them for valid JSON regardless
+            String name;
+            for (const char* c = event.name_; *c; ++c)
+            {
+                if (*c == '"' || *c == '\\')
+                    name += '\\';
+                name += *c;
+            }
+
+            sprintf(line, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%lld,\"dur\":%lld,\"args\":{\"frame\":%u}}",
+                name.CString(), timeline->index_, event.begin_, event.end_ - event.begin_, event.frame_);
+            output += String(line);
+        }
+    }
+
+    output += "\n]}\n";
+
+    return dest.Write(output.CString(), output.Length()) == output.Length();
+}
+
+// ATOMIC END
+
 }
@@ -22,13 +22,101 @@
 
 #pragma once
 
+// ATOMIC BEGIN
+#include <atomic>
+// ATOMIC END
+
 #include "../Container/Str.h"
+#include "../Core/Mutex.h"
 #include "../Core/Thread.h"
 #include "../Core/Timer.h"
 
 namespace Atomic
 {
 
+// ATOMIC BEGIN
+
+class Serializer;
+
+/// Maximum length of a block name stored in the timeline, including the terminator.
+static const unsigned PROFILER_TIMELINE_NAME_LENGTH = 48;
+/// Maximum number of threads recorded in the timeline.
+static const unsigned PROFILER_TIMELINE_MAX_THREADS = 64;
+
+/// Timeline record of one profiling block execution.
+struct ProfilerTimelineEvent
+{
+    /// Block name, truncated if necessary.
+    char name_[PROFILER_TIMELINE_NAME_LENGTH];
+    /// Begin time in microseconds since the profiler was created.
+    long long begin_;
+    /// End time in microseconds since the profiler was created, or negative if the block is still open.
+    long long end_;
+    /// Profiler frame number on which the block began.
+    unsigned frame_;
+    /// Nesting depth within the thread.
+    unsigned depth_;
+};
+
+/// Ring buffer of timeline events for one thread. Written only by the owning thread without locking; the oldest events are overwritten when full.
+class ATOMIC_API ProfilerThreadTimeline
+{
+public:
+    /// Construct with the owning thread, its timeline index and event capacity.
+    ProfilerThreadTimeline(ThreadID threadID, unsigned index, unsigned capacity) :
+        threadID_(threadID),
+        index_(index),
+        head_(0)
+    {
+        events_.Resize(Max(capacity, 1U));
+    }
+
+    /// Record the beginning of a block.
+    void Begin(const char* name, long long time, unsigned frame)
+    {
+        unsigned sequence = head_.load(std::memory_order_relaxed);
+        ProfilerTimelineEvent& event = events_[sequence % events_.Size()];
+
+        unsigned length = Min(String::CStringLength(name), PROFILER_TIMELINE_NAME_LENGTH - 1);
+        memcpy(event.name_, name, length);
+        event.name_[length] = 0;
+        event.begin_ = time;
+        event.end_ = -1;
+        event.frame_ = frame;
+        event.depth_ = openEvents_.Size();
+
+        openEvents_.Push(sequence);
+        head_.store(sequence + 1, std::memory_order_release);
+    }
+
+    /// Record the end of the innermost open block.
+    void End(long long time)
+    {
+        if (openEvents_.Empty())
+            return;
+
+        unsigned sequence = openEvents_.Back();
+        openEvents_.Pop();
+
+        // Skip if already overwritten by newer events
+        if (head_.load(std::memory_order_relaxed) - sequence <= events_.Size())
+            events_[sequence % events_.Size()].end_ = time;
+    }
+
+    /// Owning thread ID.
+    ThreadID threadID_;
+    /// Timeline index, 0 for the main thread.
+    unsigned index_;
+    /// Event ring buffer.
+    PODVector<ProfilerTimelineEvent> events_;
+    /// Total number of events recorded.
+    std::atomic<unsigned> head_;
+    /// Sequence numbers of the currently open blocks.
+    PODVector<unsigned> openEvents_;
+};
+
+// ATOMIC END
+
 /// Profiling data for one block in the profiling tree.
 class ATOMIC_API ProfilerBlock
 {
@@ -182,7 +270,16 @@ public:
     /// Begin timing a profiling block.
     void BeginBlock(const char* name)
     {
-        // Profiler supports only the main thread currently
+        // ATOMIC BEGIN
+        if (timelineEnabled_)
+        {
+            ProfilerThreadTimeline* timeline = GetThreadTimeline();
+            if (timeline)
+                timeline->Begin(name, timelineTimer_.GetUSec(false), frameNumber_);
+        }
+        // ATOMIC END
+
+        // The block hierarchy is collected only for the main thread, other threads are recorded in the timeline
         if (!Thread::IsMainThread())
             return;
 
@@ -193,6 +290,15 @@ public:
     /// End timing the current profiling block.
     void EndBlock()
     {
+        // ATOMIC BEGIN
+        if (timelineEnabled_)
+        {
+            ProfilerThreadTimeline* timeline = GetThreadTimeline();
+            if (timeline)
+                timeline->End(timelineTimer_.GetUSec(false));
+        }
+        // ATOMIC END
+
         if (!Thread::IsMainThread())
             return;
 
@@ -215,6 +321,22 @@ public:
     /// Return the root profiling block.
     const ProfilerBlock* GetRootBlock() { return root_; }
 
+    // ATOMIC BEGIN
+    /// Enable or disable recording blocks of all threads into per-thread timelines.
+    void SetTimelineEnabled(bool enable) { timelineEnabled_ = enable; }
+    /// Set the event capacity of thread timelines created from now on.
+    void SetTimelineCapacity(unsigned capacity) { timelineCapacity_ = Max(capacity, 1U); }
+    /// Write the recorded timelines of the specified frame range as Chrome trace event JSON, viewable in chrome://tracing or Perfetto. Should be called from the main thread while worker threads are idle. Return true if successful.
+    bool SaveTimeline(Serializer& dest, unsigned firstFrame = 0, unsigned lastFrame = M_MAX_UNSIGNED) const;
+
+    /// Return whether timeline recording is enabled.
+    bool GetTimelineEnabled() const { return timelineEnabled_; }
+    /// Return the timeline event capacity per thread.
+    unsigned GetTimelineCapacity() const { return timelineCapacity_; }
+    /// Return the current profiler frame number.
+    unsigned GetFrameNumber() const { return frameNumber_; }
+    // ATOMIC END
+
 protected:
     /// Return profiling data as text output for a specified profiling block.
     void PrintData(ProfilerBlock* block, String& output, unsigned depth, unsigned maxDepth, bool showUnused, bool showTotal) const;
@@ -225,6 +347,26 @@ protected:
     ProfilerBlock* root_;
     /// Frames in the current interval.
     unsigned intervalFrames_;
+
+    // ATOMIC BEGIN
+    /// Return the calling thread's timeline, creating it on first use. Return null if the thread limit has been reached.
+    ProfilerThreadTimeline* GetThreadTimeline();
+
+    /// Thread timelines, only appended to.
+    ProfilerThreadTimeline* timelines_[PROFILER_TIMELINE_MAX_THREADS];
+    /// Number of thread timelines.
+    std::atomic<unsigned> numTimelines_;
+    /// Timeline creation mutex.
+    Mutex timelinesMutex_;
+    /// Timer for timeline timestamps, shared by all threads.
+    HiresTimer timelineTimer_;
+    /// Timeline event capacity per thread.
+    unsigned timelineCapacity_;
+    /// Frame number, incremented at the end of each profiling frame.
+    volatile unsigned frameNumber_;
+    /// Timeline recording flag.
+    volatile bool timelineEnabled_;
+    // ATOMIC END
 };
 
 /// Helper class for automatically beginning and ending a profiling block
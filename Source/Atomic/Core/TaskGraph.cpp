@@ -0,0 +1,191 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../Precompiled.h"
+
+#include "../Core/Context.h"
+#include "../Core/TaskGraph.h"
+#include "../Core/Thread.h"
+#include "../IO/Log.h"
+
+#include "../DebugNew.h"
+
+namespace Atomic
+{
+
+TaskGraph::TaskGraph(Context* context) :
+    Object(context)
+{
+    workQueue_ = GetSubsystem<WorkQueue>();
+}
+
+TaskGraph::~TaskGraph()
+{
+}
+
+unsigned TaskGraph::AddTask(const TaskFunction& function)
+{
+    tasks_.Resize(tasks_.Size() + 1);
+    tasks_.Back().function_ = function;
+    return tasks_.Size() - 1;
+}
+
+unsigned TaskGraph::AddParallelTask(unsigned begin, unsigned end, unsigned grain, const ParallelForFunction& function)
+{
+    tasks_.Resize(tasks_.Size() + 1);
+    Task& task = tasks_.Back();
+    task.rangeFunction_ = function;
+    task.begin_ = begin;
+    task.end_ = end;
+    task.grain_ = grain;
+    return tasks_.Size() - 1;
+}
+
+bool TaskGraph::AddDependency(unsigned task, unsigned dependency)
+{
+    if (task >= tasks_.Size() || dependency >= tasks_.Size() || task == dependency)
+    {
+        ATOMIC_LOGERROR("Invalid task graph dependency");
+        return false;
+    }
+
+    tasks_[dependency].dependents_.Push(task);
+    ++tasks_[task].numDependencies_;
+    return true;
+}
+
+void TaskGraph::Clear()
+{
+    tasks_.Clear();
+}
+
+bool TaskGraph::Run(unsigned priority)
+{
+    if (tasks_.Empty())
+        return true;
+
+    if (!workQueue_)
+    {
+        ATOMIC_LOGERROR("No work queue subsystem, can not run task graph");
+        return false;
+    }
+
+    if (!IsAcyclic())
+    {
+        ATOMIC_LOGERROR("Task graph has a dependency cycle, can not run");
+        return false;
+    }
+
+    unsigned numTasks = tasks_.Size();
+    pendingDependencies_ = new std::atomic<unsigned>[numTasks];
+    items_.Resize(numTasks);
+
+    SharedPtr<WorkItem> join = workQueue_->GetJoinItem(priority);
+
+    for (unsigned i = 0; i < numTasks; ++i)
+    {
+        pendingDependencies_[i] = tasks_[i].numDependencies_;
+
+        SharedPtr<WorkItem>& item = items_[i];
+        item = workQueue_->GetFreeItem();
+        item->priority_ = priority;
+        item->workFunction_ = TaskWork;
+        item->start_ = (void*)(size_t)i;
+        item->aux_ = this;
+        item->parent_ = join;
+    }
+
+    // Queue the roots. The rest are queued by their last finishing dependency
+    for (unsigned i = 0; i < numTasks; ++i)
+    {
+        if (!tasks_[i].numDependencies_)
+            workQueue_->QueueItem(items_[i]);
+    }
+
+    workQueue_->FinishItem(join);
+    workQueue_->WaitForItem(join);
+
+    for (unsigned i = 0; i < numTasks; ++i)
+        workQueue_->ReturnToPool(items_[i]);
+    workQueue_->ReturnToPool(join);
+
+    items_.Clear();
+    pendingDependencies_.Reset();
+
+    // Same as in WorkQueue::Complete(), pause worker threads if no work remains
+    if (Thread::IsMainThread() && workQueue_->GetNumThreads() && !workQueue_->GetNumQueuedItems())
+        workQueue_->Pause();
+
+    return true;
+}
+
+void TaskGraph::TaskWork(const WorkItem* item, unsigned threadIndex)
+{
+    TaskGraph* graph = reinterpret_cast<TaskGraph*>(item->aux_);
+    const Task& task = graph->tasks_[(unsigned)(size_t)item->start_];
+
+    if (task.function_)
+        task.function_(threadIndex);
+    else if (task.rangeFunction_)
+        graph->workQueue_->ParallelFor(task.begin_, task.end_, task.grain_, task.rangeFunction_, item->priority_);
+
+    // Queue dependents whose last dependency this was. This item is still pending, so the graph can not finish meanwhile
+    for (unsigned i = 0; i < task.dependents_.Size(); ++i)
+    {
+        unsigned dependent = task.dependents_[i];
+        if (graph->pendingDependencies_[dependent].fetch_sub(1) == 1)
+            graph->workQueue_->QueueItem(graph->items_[dependent]);
+    }
+}
+
+bool TaskGraph::IsAcyclic() const
+{
+    // Kahn's algorithm: every task must become ready once its dependencies have been visited
+    PODVector<unsigned> remaining(tasks_.Size());
+    PODVector<unsigned> ready;
+
+    for (unsigned i = 0; i < tasks_.Size(); ++i)
+    {
+        remaining[i] = tasks_[i].numDependencies_;
+        if (!remaining[i])
+            ready.Push(i);
+    }
+
+    unsigned numVisited = 0;
+    while (!ready.Empty())
+    {
+        unsigned index = ready.Back();
+        ready.Pop();
+        ++numVisited;
+
+        const PODVector<unsigned>& dependents = tasks_[index].dependents_;
+        for (unsigned i = 0; i < dependents.Size(); ++i)
+        {
+            if (!--remaining[dependents[i]])
+                ready.Push(dependents[i]);
+        }
+    }
+
+    return numVisited == tasks_.Size();
+}
+
+}
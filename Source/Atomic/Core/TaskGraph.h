@@ -0,0 +1,103 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Container/ArrayPtr.h"
+#include "../Core/WorkQueue.h"
+
+namespace Atomic
+{
+
+/// Task function. Called with the executing thread index (0 = main thread.)
+typedef std::function<void(unsigned)> TaskFunction;
+
+/// Dependency graph of tasks executed by the work queue. A task is queued as soon as all the tasks it depends on have finished, so that dependent stages can overlap without a full barrier between them.
+class ATOMIC_API TaskGraph : public Object
+{
+    ATOMIC_OBJECT(TaskGraph, Object)
+
+public:
+    /// Construct.
+    TaskGraph(Context* context);
+    /// Destruct.
+    virtual ~TaskGraph();
+
+    /// Add a task and return its index.
+    unsigned AddTask(const TaskFunction& function);
+    /// Add a task which executes the function on the index range [begin, end) in parallel, see WorkQueue::ParallelFor(). Return its index.
+    unsigned AddParallelTask(unsigned begin, unsigned end, unsigned grain, const ParallelForFunction& function);
+    /// Add an edge: the task will not start before the dependency has finished. Return false if either index is invalid.
+    bool AddDependency(unsigned task, unsigned dependency);
+    /// Remove all tasks and edges.
+    void Clear();
+    /// Execute all tasks respecting the dependencies and return once all have finished. The calling thread participates. Return false if the graph has a cycle, in which case nothing is executed.
+    bool Run(unsigned priority = M_MAX_UNSIGNED);
+
+    /// Return number of tasks.
+    unsigned GetNumTasks() const { return tasks_.Size(); }
+
+private:
+    /// Task node.
+    struct Task
+    {
+        /// Construct.
+        Task() :
+            begin_(0),
+            end_(0),
+            grain_(0),
+            numDependencies_(0)
+        {
+        }
+
+        /// Single task function.
+        TaskFunction function_;
+        /// Range function for parallel tasks.
+        ParallelForFunction rangeFunction_;
+        /// Range begin for parallel tasks.
+        unsigned begin_;
+        /// Range end for parallel tasks.
+        unsigned end_;
+        /// Range grain size for parallel tasks.
+        unsigned grain_;
+        /// Indices of tasks which depend on this one.
+        PODVector<unsigned> dependents_;
+        /// Number of tasks this one depends on.
+        unsigned numDependencies_;
+    };
+
+    /// Work function for a task.
+    static void TaskWork(const WorkItem* item, unsigned threadIndex);
+    /// Return whether all tasks can be reached in dependency order.
+    bool IsAcyclic() const;
+
+    /// Tasks.
+    Vector<Task> tasks_;
+    /// Work items for the tasks during Run().
+    Vector<SharedPtr<WorkItem> > items_;
+    /// Number of unfinished dependencies per task during Run().
+    SharedArrayPtr<std::atomic<unsigned> > pendingDependencies_;
+    /// Work queue subsystem.
+    WeakPtr<WorkQueue> workQueue_;
+};
+
+}
@@ -591,7 +591,8 @@ public:
     Variant& operator =(const char* rhs)
     {
         SetType(VAR_STRING);
-        *(reinterpret_cast<String*>(&value_)) = String(rhs);
+        // Assign in place to reuse the existing string buffer instead of constructing a temporary
+        *(reinterpret_cast<String*>(&value_)) = rhs;
         return *this;
     }
 
@@ -40,7 +40,8 @@ public:
     /// Construct.
     WorkerThread(WorkQueue* owner, unsigned index) :
         owner_(owner),
-        index_(index)
+        index_(index),
+        threadID_(0)
     {
     }
 
@@ -49,21 +50,120 @@ public:
     {
         // Init FPU state first
         InitFPU();
+        threadID_ = GetCurrentThreadID();
         owner_->ProcessItems(index_);
     }
 
     /// Return thread index.
     unsigned GetIndex() const { return index_; }
+    /// Return OS thread ID. Valid once the thread function has started.
+    ThreadID GetThreadID() const { return threadID_; }
 
 private:
     /// Work queue.
     WorkQueue* owner_;
     /// Thread index.
     unsigned index_;
+    /// OS thread ID.
+    volatile ThreadID threadID_;
 };
 
+// ATOMIC BEGIN
+
+/// Prioritized work item deque owned by one thread. The owner takes items from the front; other threads steal from the back when the deque holds only one priority level, so that forked children stay local to the owner.
+class WorkDeque : public RefCounted
+{
+    ATOMIC_REFCOUNTED(WorkDeque)
+
+public:
+    /// Insert an item before existing items of the same or lower priority.
+    void Push(WorkItem* item)
+    {
+        MutexLock lock(mutex_);
+
+        for (List<WorkItem*>::Iterator i = items_.Begin(); i != items_.End(); ++i)
+        {
+            if ((*i)->priority_ <= item->priority_)
+            {
+                items_.Insert(i, item);
+                return;
+            }
+        }
+
+        items_.Push(item);
+    }
+
+    /// Take the highest priority item if it has at least the specified priority. Return null if none.
+    WorkItem* Pop(unsigned priority)
+    {
+        MutexLock lock(mutex_);
+
+        if (items_.Empty() || items_.Front()->priority_ < priority)
+            return 0;
+
+        WorkItem* item = items_.Front();
+        items_.PopFront();
+        return item;
+    }
+
+    /// Steal an item with at least the specified priority on behalf of another thread. Return null if none.
+    WorkItem* Steal(unsigned priority)
+    {
+        // Do not block on a busy deque, the thief can try the next one instead
+        if (!mutex_.TryAcquire())
+            return 0;
+
+        WorkItem* item = 0;
+        if (!items_.Empty() && items_.Front()->priority_ >= priority)
+        {
+            if (items_.Back()->priority_ == items_.Front()->priority_)
+            {
+                item = items_.Back();
+                items_.Pop();
+            }
+            else
+            {
+                item = items_.Front();
+                items_.PopFront();
+            }
+        }
+
+        mutex_.Release();
+        return item;
+    }
+
+    /// Remove a specific item. Return true if it was queued.
+    bool Remove(WorkItem* item)
+    {
+        MutexLock lock(mutex_);
+
+        List<WorkItem*>::Iterator i = items_.Find(item);
+        if (i == items_.End())
+            return false;
+
+        items_.Erase(i);
+        return true;
+    }
+
+    /// Return whether is empty. Unsynchronized, for use by the main thread when there are no worker threads.
+    bool Empty() const { return items_.Empty(); }
+
+private:
+    /// Queued items in descending priority order.
+    List<WorkItem*> items_;
+    /// Deque mutex.
+    Mutex mutex_;
+};
+
+// ATOMIC END
+
 WorkQueue::WorkQueue(Context* context) :
     Object(context),
+    // ATOMIC BEGIN
+    numQueued_(0),
+    numForeignItems_(0),
+    nextDeque_(0),
+    // ATOMIC END
     shutDown_(false),
     pausing_(false),
     paused_(false),
@@ -72,6 +172,11 @@ WorkQueue::WorkQueue(Context* context) :
     lastSize_(0),
     maxNonThreadedWorkMs_(5)
 {
+    // ATOMIC BEGIN
+    // Main thread deque
+    deques_.Push(SharedPtr<WorkDeque>(new WorkDeque()));
+    // ATOMIC END
+
     SubscribeToEvent(E_BEGINFRAME, ATOMIC_HANDLER(WorkQueue, HandleBeginFrame));
 }
 
@@ -96,6 +201,14 @@ void WorkQueue::CreateThreads(unsigned numThreads)
     // Start threads in paused mode
     Pause();
 
+    // ATOMIC BEGIN
+    profiler_ = GetSubsystem<Profiler>();
+
+    // Create the deques before any thread runs, as the threads steal from each other
+    for (unsigned i = 0; i < numThreads; ++i)
+        deques_.Push(SharedPtr<WorkDeque>(new WorkDeque()));
+    // ATOMIC END
+
     for (unsigned i = 0; i < numThreads; ++i)
     {
         SharedPtr<WorkerThread> thread(new WorkerThread(this, i + 1));
@@ -109,6 +222,11 @@ void WorkQueue::CreateThreads(unsigned numThreads)
 
 SharedPtr<WorkItem> WorkQueue::GetFreeItem()
 {
+    // ATOMIC BEGIN
+    // Items may also be requested from within work functions
+    MutexLock lock(poolMutex_);
+    // ATOMIC END
+
     if (poolItems_.Size() > 0)
     {
         SharedPtr<WorkItem> item = poolItems_.Front();
@@ -132,65 +250,147 @@ void WorkQueue::AddWorkItem(SharedPtr<WorkItem> item)
         return;
     }
 
-    // Check for duplicate items.
-    assert(!workItems_.Contains(item));
+    // ATOMIC BEGIN
+
+    if (Thread::IsMainThread())
+    {
+        // Check for duplicate items.
+        assert(!workItems_.Contains(item));
+
+        // Push to the main thread list to keep item alive
+        workItems_.Push(item);
+    }
+    else
+    {
+        // Keep alive until the main thread collects the item
+        {
+            MutexLock lock(foreignItemsMutex_);
+            foreignItems_.Push(item);
+        }
+        numForeignItems_.fetch_add(1);
+    }
+
+    QueueItem(item);
+
+    // ATOMIC END
+}
+
+// ATOMIC BEGIN
 
-    // Push to the main thread list to keep item alive
-    // Clear completed flag in case item is reused
-    workItems_.Push(item);
+void WorkQueue::QueueItem(WorkItem* item)
+{
+    // Clear completed flag in case item is reused. The item counts as one pending job of its own, and as one of its parent's
     item->completed_ = false;
+    item->pendingJobs_.fetch_add(1);
+    if (item->parent_)
+        item->parent_->pendingJobs_.fetch_add(1);
 
-    // Make sure worker threads' list is safe to modify
-    if (threads_.Size() && !paused_)
-        queueMutex_.Acquire();
+    if (Thread::IsMainThread())
+    {
+        // Spread items from the main thread evenly, the main thread will steal back while completing
+        deques_[nextDeque_++ % deques_.Size()]->Push(item);
+        numQueued_.fetch_add(1);
 
-    // Find position for new item
-    if (queue_.Empty())
-        queue_.Push(item);
+        // Resume worker threads. Only the main thread may hold the pause mutex
+        if (threads_.Size())
+            Resume();
+    }
     else
     {
-        bool inserted = false;
+        // Queue to the calling worker's own deque for locality
+        deques_[GetCurrentThreadIndex()]->Push(item);
+        numQueued_.fetch_add(1);
+    }
+}
 
-        for (List<WorkItem*>::Iterator i = queue_.Begin(); i != queue_.End(); ++i)
-        {
-            if ((*i)->priority_ <= item->priority_)
-            {
-                queue_.Insert(i, item);
-                inserted = true;
-                break;
-            }
-        }
+SharedPtr<WorkItem> WorkQueue::GetJoinItem(unsigned priority)
+{
+    SharedPtr<WorkItem> item = GetFreeItem();
+    item->priority_ = priority;
+    item->completed_ = false;
+    item->pendingJobs_ = 1;
+    return item;
+}
+
+/// Work function for ParallelFor subranges.
+static void ParallelForWork(const WorkItem* item, unsigned threadIndex)
+{
+    const ParallelForFunction& function = *reinterpret_cast<const ParallelForFunction*>(item->aux_);
+    function((unsigned)(size_t)item->start_, (unsigned)(size_t)item->end_, threadIndex);
+}
+
+void WorkQueue::ParallelFor(unsigned begin, unsigned end, unsigned grain, const ParallelForFunction& function, unsigned priority)
+{
+    if (end <= begin)
+        return;
+
+    unsigned count = end - begin;
+    grain = Max(grain, 1U);
 
-        if (!inserted)
-            queue_.Push(item);
+    // A few subranges per thread lets work stealing even out uneven costs, but no smaller than the grain size
+    unsigned numRanges = Min((count + grain - 1) / grain, (threads_.Size() + 1) * 4);
+    if (numRanges <= 1 || threads_.Empty())
+    {
+        function(begin, end, GetCurrentThreadIndex());
+        return;
     }
 
-    if (threads_.Size())
+    unsigned rangeSize = count / numRanges;
+    unsigned remainder = count % numRanges;
+
+    SharedPtr<WorkItem> join = GetJoinItem(priority);
+    Vector<SharedPtr<WorkItem> > items(numRanges);
+
+    unsigned start = begin;
+    for (unsigned i = 0; i < numRanges; ++i)
     {
-        queueMutex_.Release();
-        paused_ = false;
+        unsigned rangeEnd = start + rangeSize + (i < remainder ? 1 : 0);
+
+        SharedPtr<WorkItem>& item = items[i];
+        item = GetFreeItem();
+        item->priority_ = priority;
+        item->workFunction_ = ParallelForWork;
+        item->start_ = (void*)(size_t)start;
+        item->end_ = (void*)(size_t)rangeEnd;
+        item->aux_ = const_cast<ParallelForFunction*>(&function);
+        item->parent_ = join;
+        QueueItem(item);
+
+        start = rangeEnd;
     }
+
+    // Release the join item's own hold, then help until all subranges have finished
+    FinishItem(join);
+    WaitForItem(join);
+
+    for (unsigned i = 0; i < items.Size(); ++i)
+        ReturnToPool(items[i]);
+    ReturnToPool(join);
+
+    // Same as in Complete(), pause worker threads if no work remains
+    if (Thread::IsMainThread() && !numQueued_.load())
+        Pause();
 }
 
+// ATOMIC END
+
 bool WorkQueue::RemoveWorkItem(SharedPtr<WorkItem> item)
 {
     if (!item)
         return false;
 
-    MutexLock lock(queueMutex_);
-
     // Can only remove successfully if the item was not yet taken by threads for execution
-    List<WorkItem*>::Iterator i = queue_.Find(item.Get());
-    if (i != queue_.End())
+    List<SharedPtr<WorkItem> >::Iterator j = workItems_.Find(item);
+    if (j != workItems_.End())
     {
-        List<SharedPtr<WorkItem> >::Iterator j = workItems_.Find(item);
-        if (j != workItems_.End())
+        // ATOMIC BEGIN
+        if (RemoveFromDeques(item))
         {
-            queue_.Erase(i);
             ReturnToPool(item);
             workItems_.Erase(j);
             return true;
         }
+        // ATOMIC END
     }
 
     return false;
@@ -198,22 +398,21 @@ bool WorkQueue::RemoveWorkItem(SharedPtr<WorkItem> item)
 
 unsigned WorkQueue::RemoveWorkItems(const Vector<SharedPtr<WorkItem> >& items)
 {
-    MutexLock lock(queueMutex_);
     unsigned removed = 0;
 
     for (Vector<SharedPtr<WorkItem> >::ConstIterator i = items.Begin(); i != items.End(); ++i)
     {
-        List<WorkItem*>::Iterator j = queue_.Find(i->Get());
-        if (j != queue_.End())
+        List<SharedPtr<WorkItem> >::Iterator k = workItems_.Find(*i);
+        if (k != workItems_.End())
         {
-            List<SharedPtr<WorkItem> >::Iterator k = workItems_.Find(*i);
-            if (k != workItems_.End())
+            // ATOMIC BEGIN
+            if (RemoveFromDeques(k->Get()))
             {
-                queue_.Erase(j);
                 ReturnToPool(*k);
                 workItems_.Erase(k);
                 ++removed;
             }
+            // ATOMIC END
         }
     }
 
@@ -226,7 +425,7 @@ void WorkQueue::Pause()
     {
         pausing_ = true;
 
-        queueMutex_.Acquire();
+        pauseMutex_.Acquire();
         paused_ = true;
 
         pausing_ = false;
@@ -237,7 +436,7 @@ void WorkQueue::Resume()
 {
     if (paused_)
     {
-        queueMutex_.Release();
+        pauseMutex_.Release();
         paused_ = false;
     }
 }
@@ -251,50 +450,71 @@ void WorkQueue::Complete(unsigned priority)
     {
         Resume();
 
-        // Take work items also in the main thread until queue empty or no high-priority items anymore
-        while (!queue_.Empty())
-        {
-            queueMutex_.Acquire();
-            if (!queue_.Empty() && queue_.Front()->priority_ >= priority)
-            {
-                WorkItem* item = queue_.Front();
-                queue_.PopFront();
-                queueMutex_.Release();
-                item->workFunction_(item, 0);
-                item->completed_ = true;
-            }
-            else
-            {
-                queueMutex_.Release();
-                break;
-            }
-        }
-
-        // Wait for threaded work to complete
+        // ATOMIC BEGIN
+        // Take work items also in the main thread, stealing from the workers when the own deque runs dry,
+        // until all high-priority work has completed
         while (!IsCompleted(priority))
         {
+            WorkItem* item = GetNextItem(0, priority);
+            if (item)
+                ExecuteItem(item, 0);
         }
 
         // If no work at all remaining, pause worker threads by leaving the mutex locked
-        if (queue_.Empty())
+        if (!numQueued_.load())
             Pause();
+        // ATOMIC END
     }
     else
     {
         // No worker threads: ensure all high-priority items are completed in the main thread
-        while (!queue_.Empty() && queue_.Front()->priority_ >= priority)
-        {
-            WorkItem* item = queue_.Front();
-            queue_.PopFront();
-            item->workFunction_(item, 0);
-            item->completed_ = true;
-        }
+        // ATOMIC BEGIN
+        while (WorkItem* item = deques_[0]->Pop(priority))
+            ExecuteItem(item, 0);
+        // ATOMIC END
     }
 
     PurgeCompleted(priority);
     completing_ = false;
 }
 
+// ATOMIC BEGIN
+
+void WorkQueue::WaitForItem(WorkItem* item)
+{
+    if (!item)
+        return;
+
+    unsigned threadIndex = GetCurrentThreadIndex();
+
+    // Help with queued work instead of idling, but do not pick up lower priority work which could stall the caller
+    while (!item->completed_)
+    {
+        WorkItem* next = GetNextItem(threadIndex, item->priority_);
+        if (next)
+            ExecuteItem(next, threadIndex);
+        else
+            Time::Sleep(0);
+    }
+}
+
+unsigned WorkQueue::GetCurrentThreadIndex() const
+{
+    if (Thread::IsMainThread())
+        return 0;
+
+    ThreadID id = Thread::GetCurrentThreadID();
+    for (unsigned i = 0; i < threads_.Size(); ++i)
+    {
+        if (threads_[i]->GetThreadID() == id)
+            return threads_[i]->GetIndex();
+    }
+
+    return 0;
+}
+
+// ATOMIC END
+
 bool WorkQueue::IsCompleted(unsigned priority) const
 {
     for (List<SharedPtr<WorkItem> >::ConstIterator i = workItems_.Begin(); i != workItems_.End(); ++i)
@@ -303,6 +523,19 @@ bool WorkQueue::IsCompleted(unsigned priority) const
             return false;
     }
 
+    // ATOMIC BEGIN
+    if (numForeignItems_.load())
+    {
+        MutexLock lock(foreignItemsMutex_);
+
+        for (List<SharedPtr<WorkItem> >::ConstIterator i = foreignItems_.Begin(); i != foreignItems_.End(); ++i)
+        {
+            if ((*i)->priority_ >= priority && !(*i)->completed_)
+                return false;
+        }
+    }
+    // ATOMIC END
+
     return true;
 }
 
@@ -319,30 +552,114 @@ void WorkQueue::ProcessItems(unsigned threadIndex)
             Time::Sleep(0);
         else
         {
-            queueMutex_.Acquire();
-            if (!queue_.Empty())
+            // ATOMIC BEGIN
+            WorkItem* item = GetNextItem(threadIndex, 0);
+            if (item)
             {
                 wasActive = true;
-
-                WorkItem* item = queue_.Front();
-                queue_.PopFront();
-                queueMutex_.Release();
-                item->workFunction_(item, threadIndex);
-                item->completed_ = true;
+                ExecuteItem(item, threadIndex);
             }
             else
             {
                 wasActive = false;
 
-                queueMutex_.Release();
+                // Block here while the main thread holds the pause mutex
+                pauseMutex_.Acquire();
+                pauseMutex_.Release();
                 Time::Sleep(0);
             }
+            // ATOMIC END
         }
     }
 }
 
+// ATOMIC BEGIN
+
+WorkItem* WorkQueue::GetNextItem(unsigned threadIndex, unsigned priority)
+{
+    // Avoid touching any deque mutex when idle
+    if (!numQueued_.load())
+        return 0;
+
+    WorkItem* item = deques_[threadIndex]->Pop(priority);
+
+    if (!item)
+    {
+        unsigned numDeques = deques_.Size();
+        for (unsigned i = 1; i < numDeques && !item; ++i)
+            item = deques_[(threadIndex + i) % numDeques]->Steal(priority);
+    }
+
+    if (item)
+        numQueued_.fetch_sub(1);
+
+    return item;
+}
+
+void WorkQueue::ExecuteItem(WorkItem* item, unsigned threadIndex)
+{
+#ifdef ATOMIC_PROFILING
+    // Blocks are recorded from worker threads only into the timeline, so skip the overhead unless it is enabled
+    AutoProfileBlock profileBlock(profiler_ && profiler_->GetTimelineEnabled() ? profiler_.Get() : 0, "WorkItem");
+#endif
+
+    item->workFunction_(item, threadIndex);
+    FinishItem(item);
+}
+
+void WorkQueue::FinishItem(WorkItem* item)
+{
+    while (item)
+    {
+        // Read the parent first, as the item may be purged as soon as it is flagged completed
+        WorkItem* parent = item->parent_;
+        if (item->pendingJobs_.fetch_sub(1) != 1)
+            break;
+
+        item->completed_ = true;
+        item = parent;
+    }
+}
+
+bool WorkQueue::RemoveFromDeques(WorkItem* item)
+{
+    for (unsigned i = 0; i < deques_.Size(); ++i)
+    {
+        if (deques_[i]->Remove(item))
+        {
+            numQueued_.fetch_sub(1);
+
+            // Release the item's own pending job, and through it the hold on its parent
+            WorkItem* parent = item->parent_;
+            item->pendingJobs_.fetch_sub(1);
+            FinishItem(parent);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkQueue::CollectForeignItems()
+{
+    if (!numForeignItems_.load())
+        return;
+
+    MutexLock lock(foreignItemsMutex_);
+
+    numForeignItems_.fetch_sub(foreignItems_.Size());
+    workItems_.Insert(workItems_.End(), foreignItems_);
+    foreignItems_.Clear();
+}
+
+// ATOMIC END
+
 void WorkQueue::PurgeCompleted(unsigned priority)
 {
+    // ATOMIC BEGIN
+    CollectForeignItems();
+    // ATOMIC END
+
     // Purge completed work items and send completion events. Do not signal items lower than priority threshold,
     // as those may be user submitted and lead to eg. scene manipulation that could happen in the middle of the
     // render update, which is not allowed
@@ -369,6 +686,10 @@ void WorkQueue::PurgeCompleted(unsigned priority)
 
 void WorkQueue::PurgePool()
 {
+    // ATOMIC BEGIN
+    MutexLock lock(poolMutex_);
+    // ATOMIC END
+
     unsigned currentSize = poolItems_.Size();
     int difference = lastSize_ - currentSize;
 
@@ -395,6 +716,12 @@ void WorkQueue::ReturnToPool(SharedPtr<WorkItem>& item)
         item->priority_ = M_MAX_UNSIGNED;
         item->sendEvent_ = false;
         item->completed_ = false;
+        // ATOMIC BEGIN
+        item->parent_ = 0;
+        item->pendingJobs_ = 0;
+
+        MutexLock lock(poolMutex_);
+        // ATOMIC END
 
         poolItems_.Push(item);
     }
@@ -403,19 +730,24 @@ void WorkQueue::ReturnToPool(SharedPtr<WorkItem>& item)
 void WorkQueue::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
 {
     // If no worker threads, complete low-priority work here
-    if (threads_.Empty() && !queue_.Empty())
+    // ATOMIC BEGIN
+    if (threads_.Empty() && !deques_[0]->Empty())
+    // ATOMIC END
     {
         ATOMIC_PROFILE(CompleteWorkNonthreaded);
 
         HiresTimer timer;
 
-        while (!queue_.Empty() && timer.GetUSec(false) < maxNonThreadedWorkMs_ * 1000)
+        // ATOMIC BEGIN
+        while (timer.GetUSec(false) < maxNonThreadedWorkMs_ * 1000)
         {
-            WorkItem* item = queue_.Front();
-            queue_.PopFront();
-            item->workFunction_(item, 0);
-            item->completed_ = true;
+            WorkItem* item = deques_[0]->Pop(0);
+            if (!item)
+                break;
+            numQueued_.fetch_sub(1);
+            ExecuteItem(item, 0);
         }
+        // ATOMIC END
     }
 
     // Complete and signal items down to the lowest priority
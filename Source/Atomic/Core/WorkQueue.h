@@ -22,6 +22,11 @@
 
 #pragma once
 
+// ATOMIC BEGIN
+#include <atomic>
+#include <functional>
+// ATOMIC END
+
 #include "../Container/List.h"
 #include "../Core/Mutex.h"
 #include "../Core/Object.h"
@@ -36,6 +41,13 @@ ATOMIC_EVENT(E_WORKITEMCOMPLETED, WorkItemCompleted)
 }
 
 class WorkerThread;
+// ATOMIC BEGIN
+class WorkDeque;
+class Profiler;
+
+/// Range function for WorkQueue::ParallelFor. Called with the subrange begin and end indices and the executing thread index (0 = main thread.)
+typedef std::function<void(unsigned, unsigned, unsigned)> ParallelForFunction;
+// ATOMIC END
 
 /// Work queue item.
 struct WorkItem : public RefCounted
@@ -50,6 +62,10 @@ public:
         priority_(0),
         sendEvent_(false),
         completed_(false),
+        // ATOMIC BEGIN
+        parent_(0),
+        pendingJobs_(0),
+        // ATOMIC END
         pooled_(false)
     {
     }
@@ -68,8 +84,16 @@ public:
     bool sendEvent_;
     /// Completed flag.
     volatile bool completed_;
+    // ATOMIC BEGIN
+    /// Parent item, which will not be flagged completed until this item has completed. Must be set before the item is added to the queue, and the parent must not have finished executing yet.
+    WorkItem* parent_;
+    // ATOMIC END
 
 private:
+    // ATOMIC BEGIN
+    /// Number of unfinished jobs: the item itself while queued or executing, plus its unfinished children.
+    std::atomic<int> pendingJobs_;
+    // ATOMIC END
     bool pooled_;
 };
 
@@ -79,6 +103,9 @@ class ATOMIC_API WorkQueue : public Object
     ATOMIC_OBJECT(WorkQueue, Object);
 
     friend class WorkerThread;
+    // ATOMIC BEGIN
+    friend class TaskGraph;
+    // ATOMIC END
 
 public:
     /// Construct.
@@ -90,7 +117,7 @@ public:
     void CreateThreads(unsigned numThreads);
     /// Get pointer to an usable WorkItem from the item pool. Allocate one if no more free items.
     SharedPtr<WorkItem> GetFreeItem();
-    /// Add a work item and resume worker threads.
+    /// Add a work item and resume worker threads. Can also be called from within a work function to fork child items.
     void AddWorkItem(SharedPtr<WorkItem> item);
     /// Remove a work item before it has started executing. Return true if successfully removed.
     bool RemoveWorkItem(SharedPtr<WorkItem> item);
@@ -102,6 +129,12 @@ public:
     void Resume();
     /// Finish all queued work which has at least the specified priority. Main thread will also execute priority work. Pause worker threads if no more work remains.
     void Complete(unsigned priority);
+    // ATOMIC BEGIN
+    /// Execute queued work of at least the item's priority in the calling thread until the specified item and all of its children have completed. Can be called from the main thread or from within a work function.
+    void WaitForItem(WorkItem* item);
+    /// Split the index range [begin, end) into subranges of at least grain indices, execute the function on them in parallel and return once all have finished. The calling thread participates. Can be nested within work functions.
+    void ParallelFor(unsigned begin, unsigned end, unsigned grain, const ParallelForFunction& function, unsigned priority = M_MAX_UNSIGNED);
+    // ATOMIC END
 
     /// Set the pool telerance before it starts deleting pool items.
     void SetTolerance(int tolerance) { tolerance_ = tolerance; }
@@ -116,6 +149,12 @@ public:
     bool IsCompleted(unsigned priority) const;
     /// Return whether the queue is currently completing work in the main thread.
     bool IsCompleting() const { return completing_; }
+    // ATOMIC BEGIN
+    /// Return the work queue thread index of the calling thread: 0 for the main thread or any thread not owned by the queue.
+    unsigned GetCurrentThreadIndex() const;
+    /// Return number of items queued and not yet taken for execution.
+    unsigned GetNumQueuedItems() const { return (unsigned)numQueued_.load(); }
+    // ATOMIC END
 
     /// Return the pool tolerance.
     int GetTolerance() const { return tolerance_; }
@@ -132,6 +171,22 @@ private:
     void PurgePool();
     /// Return a work item to the pool.
     void ReturnToPool(SharedPtr<WorkItem>& item);
+    // ATOMIC BEGIN
+    /// Take the next item with at least the specified priority, first from the thread's own deque, then by stealing from the other threads' deques. Return null if none available.
+    WorkItem* GetNextItem(unsigned threadIndex, unsigned priority);
+    /// Execute an item in the given thread and mark it finished.
+    void ExecuteItem(WorkItem* item, unsigned threadIndex);
+    /// Decrement an item's pending job count and flag it and its ancestors completed as their counts reach zero.
+    void FinishItem(WorkItem* item);
+    /// Remove a not yet started item from whichever deque it is queued in. Return true if found.
+    bool RemoveFromDeques(WorkItem* item);
+    /// Move items added from other threads into the main thread item collection.
+    void CollectForeignItems();
+    /// Return a pooled item for tracking internal item groups. It is not queued itself and holds one pending job, released by FinishItem() once all children have been queued.
+    SharedPtr<WorkItem> GetJoinItem(unsigned priority);
+    /// Queue an item without the main thread bookkeeping of AddWorkItem(). Used for items whose lifetime is managed by the caller.
+    void QueueItem(WorkItem* item);
+    // ATOMIC END
     /// Handle frame start event. Purge completed work from the main thread queue, and perform work if no threads at all.
     void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
 
@@ -141,15 +196,31 @@ private:
     List<SharedPtr<WorkItem> > poolItems_;
     /// Work item collection. Accessed only by the main thread.
     List<SharedPtr<WorkItem> > workItems_;
-    /// Work item prioritized queue for worker threads. Pointers are guaranteed to be valid (point to workItems.)
-    List<WorkItem*> queue_;
-    /// Worker queue mutex.
-    Mutex queueMutex_;
+    // ATOMIC BEGIN
+    /// Per-thread prioritized work deques, index 0 belonging to the main thread. Pointers are guaranteed to be valid (point to workItems_ or foreignItems_.)
+    Vector<SharedPtr<WorkDeque> > deques_;
+    /// Work items added from other than the main thread, waiting to be moved to workItems_.
+    List<SharedPtr<WorkItem> > foreignItems_;
+    /// Foreign item collection mutex.
+    mutable Mutex foreignItemsMutex_;
+    /// Work item pool mutex.
+    Mutex poolMutex_;
+    /// Pause mutex. Locked while paused to prevent idle worker threads using up CPU time.
+    Mutex pauseMutex_;
+    /// Number of items queued in all deques.
+    std::atomic<int> numQueued_;
+    /// Number of items added from other than the main thread and not yet collected.
+    std::atomic<int> numForeignItems_;
+    /// Round-robin deque index for items added from the main thread.
+    unsigned nextDeque_;
+    /// Profiler subsystem for recording work item execution in the timeline of each thread.
+    WeakPtr<Profiler> profiler_;
+    // ATOMIC END
     /// Shutting down flag.
     volatile bool shutDown_;
-    /// Pausing flag. Indicates the worker threads should not contend for the queue mutex.
+    /// Pausing flag. Indicates the worker threads should not contend for the pause mutex.
     volatile bool pausing_;
-    /// Paused flag. Indicates the queue mutex being locked to prevent worker threads using up CPU time.
+    /// Paused flag. Indicates the pause mutex being locked to prevent worker threads using up CPU time.
     bool paused_;
     /// Completing work in the main thread flag.
     bool completing_;
@@ -38,6 +38,10 @@
 #include "../Graphics/Octree.h"
 #include "../Graphics/VertexBuffer.h"
 #include "../IO/Log.h"
+// ATOMIC BEGIN
+#include "../Graphics/Renderer.h"
+#include "../Metrics/Metrics.h"
+// ATOMIC END
 #include "../Resource/ResourceCache.h"
 #include "../Resource/ResourceEvents.h"
 #include "../Scene/Scene.h"
@@ -75,6 +79,10 @@ AnimatedModel::AnimatedModel(Context* context) :
     animationLodBias_(1.0f),
     animationLodTimer_(-1.0f),
     animationLodDistance_(0.0f),
+    // ATOMIC BEGIN
+    boneLodDistance_(0.0f),
+    boneLodLevel_(0),
+    // ATOMIC END
     updateInvisible_(false),
     animationDirty_(false),
     animationOrderDirty_(false),
@@ -117,6 +125,9 @@ void AnimatedModel::RegisterObject(Context* context)
     ATOMIC_ACCESSOR_ATTRIBUTE("Shadow Distance", GetShadowDistance, SetShadowDistance, float, 0.0f, AM_DEFAULT);
     ATOMIC_ACCESSOR_ATTRIBUTE("LOD Bias", GetLodBias, SetLodBias, float, 1.0f, AM_DEFAULT);
     ATOMIC_ACCESSOR_ATTRIBUTE("Animation LOD Bias", GetAnimationLodBias, SetAnimationLodBias, float, 1.0f, AM_DEFAULT);
+    // ATOMIC BEGIN
+    ATOMIC_ACCESSOR_ATTRIBUTE("Bone LOD Distance", GetBoneLodDistance, SetBoneLodDistance, float, 0.0f, AM_DEFAULT);
+    // ATOMIC END
     ATOMIC_COPY_BASE_ATTRIBUTES(Drawable);
     ATOMIC_MIXED_ACCESSOR_ATTRIBUTE("Bone Animation Enabled", GetBonesEnabledAttr, SetBonesEnabledAttr, VariantVector,
         Variant::emptyVariantVector, AM_FILE | AM_NOEDIT);
@@ -604,6 +615,16 @@ void AnimatedModel::SetUpdateInvisible(bool enable)
     MarkNetworkUpdate();
 }
 
+// ATOMIC BEGIN
+
+void AnimatedModel::SetBoneLodDistance(float distance)
+{
+    boneLodDistance_ = Max(distance, 0.0f);
+    MarkNetworkUpdate();
+}
+
+// ATOMIC END
+
 
 void AnimatedModel::SetMorphWeight(unsigned index, float weight)
 {
@@ -1345,13 +1366,18 @@ void AnimatedModel::SetGeometryBoneMappings()
 
 void AnimatedModel::UpdateAnimation(const FrameInfo& frame)
 {
+    // ATOMIC BEGIN
+    Renderer* renderer = GetSubsystem<Renderer>();
+    const float lodBias = renderer ? animationLodBias_ * renderer->GetAnimationLodBias() : animationLodBias_;
+    // ATOMIC END
+
     // If using animation LOD, accumulate time and see if it is time to update
-    if (animationLodBias_ > 0.0f && animationLodDistance_ > 0.0f)
+    if (lodBias > 0.0f && animationLodDistance_ > 0.0f)
     {
         // Perform the first update always regardless of LOD timer
         if (animationLodTimer_ >= 0.0f)
         {
-            animationLodTimer_ += animationLodBias_ * frame.timeStep_ * ANIMATION_LOD_BASESCALE;
+            animationLodTimer_ += lodBias * frame.timeStep_ * ANIMATION_LOD_BASESCALE;
             if (animationLodTimer_ >= animationLodDistance_)
                 animationLodTimer_ = fmodf(animationLodTimer_, animationLodDistance_);
             else
@@ -1361,6 +1387,17 @@ void AnimatedModel::UpdateAnimation(const FrameInfo& frame)
             animationLodTimer_ = 0.0f;
     }
 
+    // ATOMIC BEGIN
+    // Bone LOD levels are spaced evenly in the same LOD distance that throttles the update rate
+    boneLodLevel_ = 0;
+    if (renderer && animationLodDistance_ > 0.0f)
+    {
+        float boneLodDistance = boneLodDistance_ > 0.0f ? boneLodDistance_ : renderer->GetBoneLodDistance();
+        if (boneLodDistance > 0.0f)
+            boneLodLevel_ = (unsigned)Min(animationLodDistance_ / boneLodDistance, (float)renderer->GetMaxBoneLodLevel());
+    }
+    // ATOMIC END
+
     ApplyAnimation();
 }
 
@@ -1384,8 +1421,18 @@ void AnimatedModel::ApplyAnimation()
         // skeleton_.ResetSilent();
         // ATOMIC END
 
+        // ATOMIC BEGIN
+        unsigned numAppliedTracks = 0;
         for (Vector<SharedPtr<AnimationState> >::Iterator i = animationStates_.Begin(); i != animationStates_.End(); ++i)
+        {
             (*i)->Apply();
+            numAppliedTracks += (*i)->GetNumAppliedTracks();
+        }
+
+        Metrics* metrics = GetSubsystem<Metrics>();
+        if (metrics && numAppliedTracks)
+            metrics->AddToCounter(METRICID_BONES_EVALUATED, numAppliedTracks);
+        // ATOMIC END
 
         // Skeleton reset and animations apply the node transforms "silently" to avoid repeated marking dirty. Mark dirty now
         node_->MarkDirty();
@@ -88,6 +88,10 @@ public:
     void SetAnimationLodBias(float bias);
     /// Set whether to update animation and the bounding box when not visible. Recommended to enable for physically controlled models like ragdolls.
     void SetUpdateInvisible(bool enable);
+    // ATOMIC BEGIN
+    /// Set LOD distance per bone LOD level. Each level stops evaluating one more level of leaf bones, up to the renderer's maximum bone LOD level. Zero (default) uses the renderer's bone LOD distance.
+    void SetBoneLodDistance(float distance);
+    // ATOMIC END
     /// Set vertex morph weight by index.
     void SetMorphWeight(unsigned index, float weight);
     /// Set vertex morph weight by name.
@@ -123,6 +127,14 @@ public:
     /// Return whether to update animation when not visible.
     bool GetUpdateInvisible() const { return updateInvisible_; }
 
+    // ATOMIC BEGIN
+    /// Return LOD distance per bone LOD level.
+    float GetBoneLodDistance() const { return boneLodDistance_; }
+
+    /// Return current bone LOD level. Bones with fewer levels below them are not evaluated.
+    unsigned GetBoneLodLevel() const { return boneLodLevel_; }
+    // ATOMIC END
+
     /// Return all vertex morphs.
     const Vector<ModelMorph>& GetMorphs() const { return morphs_; }
 
@@ -249,6 +261,12 @@ private:
     float animationLodTimer_;
     /// Animation LOD distance, the minimum of all LOD view distances last frame.
     float animationLodDistance_;
+    // ATOMIC BEGIN
+    /// LOD distance per bone LOD level.
+    float boneLodDistance_;
+    /// Current bone LOD level.
+    unsigned boneLodLevel_;
+    // ATOMIC END
     /// Update animation when invisible flag.
     bool updateInvisible_;
     /// Animation dirty flag.
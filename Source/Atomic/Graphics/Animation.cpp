@@ -49,8 +49,176 @@ inline bool CompareKeyFrames(AnimationKeyFrame& lhs, AnimationKeyFrame& rhs)
     return lhs.time_ < rhs.time_;
 }
 
+// ATOMIC BEGIN
+
+/// Largest quantization step count of a compressed value.
+static const float QUANTIZE_MAX = 65535.0f;
+/// Largest quantization step count of a compressed rotation component, which leaves the high bit free.
+static const float QUANTIZE_ROTATION_MAX = 32767.0f;
+/// Magnitude bound of the three smallest components of a unit quaternion.
+static const float ROTATION_COMPONENT_RANGE = 0.70710678f;
+/// Largest keyframe time error in seconds of quantized times. Longer clips keep their times at full precision.
+static const float TIME_TOLERANCE = 0.0005f;
+
+/// Quantize a value within a range of the given step.
+static unsigned short QuantizeValue(float value, float min, float step)
+{
+    return step > 0.0f ? (unsigned short)Clamp(RoundToInt((value - min) / step), 0, (int)QUANTIZE_MAX) : 0;
+}
+
+/// Calculate the quantization range of a vector channel over the kept keyframes.
+static void GetQuantizationRange(const Vector<AnimationKeyFrame>& keyFrames, const PODVector<unsigned>& kept,
+    Vector3 AnimationKeyFrame::*channel, Vector3& min, Vector3& step)
+{
+    min = keyFrames[kept[0]].*channel;
+    Vector3 max = min;
+    for (unsigned i = 1; i < kept.Size(); ++i)
+    {
+        const Vector3& value = keyFrames[kept[i]].*channel;
+        min = Vector3(Min(min.x_, value.x_), Min(min.y_, value.y_), Min(min.z_, value.z_));
+        max = Vector3(Max(max.x_, value.x_), Max(max.y_, value.y_), Max(max.z_, value.z_));
+    }
+    step = (max - min) / QUANTIZE_MAX;
+}
+
+/// Quantize a vector channel value.
+static unsigned short* QuantizeVector(unsigned short* dest, const Vector3& value, const Vector3& min, const Vector3& step)
+{
+    *dest++ = QuantizeValue(value.x_, min.x_, step.x_);
+    *dest++ = QuantizeValue(value.y_, min.y_, step.y_);
+    *dest++ = QuantizeValue(value.z_, min.z_, step.z_);
+    return dest;
+}
+
+/// Decode a quantized vector channel value.
+static Vector3 DequantizeVector(const unsigned short* src, const Vector3& min, const Vector3& step)
+{
+    return min + step * Vector3(src[0], src[1], src[2]);
+}
+
+/// Store floats at full precision as two values each.
+static unsigned short* StoreFloats(unsigned short* dest, const float* values, unsigned count)
+{
+    memcpy(dest, values, count * sizeof(float));
+    return dest + count * sizeof(float) / sizeof(unsigned short);
+}
+
+/// Load floats stored at full precision.
+static const unsigned short* LoadFloats(const unsigned short* src, float* values, unsigned count)
+{
+    memcpy(values, src, count * sizeof(float));
+    return src + count * sizeof(float) / sizeof(unsigned short);
+}
+
+/// Quantize a rotation to its three smallest components. The index of the largest component goes to the high bits
+/// of the first two values; the largest component is made positive and reconstructed from unit length.
+static unsigned short* QuantizeRotation(unsigned short* dest, const Quaternion& rotation)
+{
+    Quaternion normalized = rotation.Normalized();
+    const float* data = normalized.Data();
+    unsigned largest = 0;
+    for (unsigned i = 1; i < 4; ++i)
+    {
+        if (Abs(data[i]) > Abs(data[largest]))
+            largest = i;
+    }
+
+    const float sign = data[largest] < 0.0f ? -1.0f : 1.0f;
+    unsigned j = 0;
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        if (i == largest)
+            continue;
+        float value = Clamp(data[i] * sign, -ROTATION_COMPONENT_RANGE, ROTATION_COMPONENT_RANGE);
+        unsigned short bits = (unsigned short)RoundToInt((value + ROTATION_COMPONENT_RANGE) * (QUANTIZE_ROTATION_MAX * 0.5f /
+            ROTATION_COMPONENT_RANGE));
+        if (j < 2)
+            bits |= ((largest >> j) & 1) << 15;
+        dest[j++] = bits;
+    }
+
+    return dest + 3;
+}
+
+/// Decode a rotation quantized to its three smallest components.
+static Quaternion DequantizeRotation(const unsigned short* src)
+{
+    const float scale = 2.0f * ROTATION_COMPONENT_RANGE / QUANTIZE_ROTATION_MAX;
+    unsigned largest = (src[0] >> 15) | ((src[1] >> 15) << 1);
+    float data[4];
+    float sumSquares = 0.0f;
+    unsigned j = 0;
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        if (i == largest)
+            continue;
+        float value = (src[j++] & 0x7fff) * scale - ROTATION_COMPONENT_RANGE;
+        data[i] = value;
+        sumSquares += value * value;
+    }
+    data[largest] = sqrtf(Max(1.0f - sumSquares, 0.0f));
+
+    return Quaternion(data[0], data[1], data[2], data[3]).Normalized();
+}
+
+/// Return the number of values per compressed keyframe for a channel mask and the mask of channels kept at full precision.
+static unsigned char GetCompressedStride(unsigned char channelMask, unsigned char fullPrecisionMask)
+{
+    unsigned char stride = (fullPrecisionMask & FULL_PRECISION_TIME) ? 2 : 1;
+    if (channelMask & CHANNEL_POSITION)
+        stride += (fullPrecisionMask & CHANNEL_POSITION) ? 6 : 3;
+    if (channelMask & CHANNEL_ROTATION)
+        stride += (fullPrecisionMask & CHANNEL_ROTATION) ? 8 : 3;
+    if (channelMask & CHANNEL_SCALE)
+        stride += (fullPrecisionMask & CHANNEL_SCALE) ? 6 : 3;
+    return stride;
+}
+
+/// Return the angle in degrees between two rotations. Uses the chord length, as the arc cosine of the dot product
+/// cannot resolve angles near the quantization step in single precision.
+static float GetRotationError(const Quaternion& lhs, const Quaternion& rhs)
+{
+    Quaternion normalized = rhs.Normalized();
+    if (lhs.DotProduct(normalized) < 0.0f)
+        normalized = -normalized;
+    return 4.0f * Asin(Min(sqrtf((lhs - normalized).LengthSquared()) * 0.5f, 1.0f));
+}
+
+/// Return whether interpolating between two keyframes reproduces the keyframes between them within the tolerances.
+static bool CanInterpolate(const Vector<AnimationKeyFrame>& keyFrames, unsigned from, unsigned to, unsigned char channelMask,
+    float positionTolerance, float rotationTolerance, float scaleTolerance)
+{
+    const AnimationKeyFrame& start = keyFrames[from];
+    const AnimationKeyFrame& end = keyFrames[to];
+    float timeInterval = end.time_ - start.time_;
+
+    for (unsigned i = from + 1; i < to; ++i)
+    {
+        const AnimationKeyFrame& keyFrame = keyFrames[i];
+        float t = timeInterval > 0.0f ? (keyFrame.time_ - start.time_) / timeInterval : 1.0f;
+
+        if ((channelMask & CHANNEL_POSITION) &&
+            (start.position_.Lerp(end.position_, t) - keyFrame.position_).Length() > positionTolerance)
+            return false;
+        if ((channelMask & CHANNEL_ROTATION) &&
+            GetRotationError(start.rotation_.Slerp(end.rotation_, t), keyFrame.rotation_) > rotationTolerance)
+            return false;
+        if ((channelMask & CHANNEL_SCALE) &&
+            (start.scale_.Lerp(end.scale_, t) - keyFrame.scale_).Length() > scaleTolerance)
+            return false;
+    }
+
+    return true;
+}
+
+// ATOMIC END
+
 void AnimationTrack::SetKeyFrame(unsigned index, const AnimationKeyFrame& keyFrame)
 {
+    // ATOMIC BEGIN
+    Decompress();
+    // ATOMIC END
+
     if (index < keyFrames_.Size())
     {
         keyFrames_[index] = keyFrame;
@@ -62,6 +230,10 @@ void AnimationTrack::SetKeyFrame(unsigned index, const AnimationKeyFrame& keyFra
 
 void AnimationTrack::AddKeyFrame(const AnimationKeyFrame& keyFrame)
 {
+    // ATOMIC BEGIN
+    Decompress();
+    // ATOMIC END
+
     bool needSort = keyFrames_.Size() ? keyFrames_.Back().time_ > keyFrame.time_ : false;
     keyFrames_.Push(keyFrame);
     if (needSort)
@@ -70,18 +242,31 @@ void AnimationTrack::AddKeyFrame(const AnimationKeyFrame& keyFrame)
 
 void AnimationTrack::InsertKeyFrame(unsigned index, const AnimationKeyFrame& keyFrame)
 {
+    // ATOMIC BEGIN
+    Decompress();
+    // ATOMIC END
+
     keyFrames_.Insert(index, keyFrame);
     Atomic::Sort(keyFrames_.Begin(), keyFrames_.End(), CompareKeyFrames);
 }
 
 void AnimationTrack::RemoveKeyFrame(unsigned index)
 {
+    // ATOMIC BEGIN
+    Decompress();
+    // ATOMIC END
+
     keyFrames_.Erase(index);
 }
 
 void AnimationTrack::RemoveAllKeyFrames()
 {
     keyFrames_.Clear();
+    // ATOMIC BEGIN
+    compressedKeys_.Clear();
+    compressedStride_ = 0;
+    fullPrecisionMask_ = 0;
+    // ATOMIC END
 }
 
 AnimationKeyFrame* AnimationTrack::GetKeyFrame(unsigned index)
@@ -94,18 +279,161 @@ void AnimationTrack::GetKeyFrameIndex(float time, unsigned& index) const
     if (time < 0.0f)
         time = 0.0f;
 
-    if (index >= keyFrames_.Size())
-        index = keyFrames_.Size() - 1;
+    // ATOMIC BEGIN
+    const unsigned numKeyFrames = GetNumKeyFrames();
+
+    if (index >= numKeyFrames)
+        index = numKeyFrames - 1;
 
     // Check for being too far ahead
-    while (index && time < keyFrames_[index].time_)
+    while (index && time < GetKeyFrameTime(index))
         --index;
 
     // Check for being too far behind
-    while (index < keyFrames_.Size() - 1 && time >= keyFrames_[index + 1].time_)
+    while (index < numKeyFrames - 1 && time >= GetKeyFrameTime(index + 1))
         ++index;
+    // ATOMIC END
+}
+
+// ATOMIC BEGIN
+
+void AnimationTrack::Compress(float length, float positionTolerance, float rotationTolerance, float scaleTolerance)
+{
+    if (IsCompressed() || keyFrames_.Empty())
+        return;
+
+    // Keep the first and last keyframes so that looping wraps around unchanged. Extend each interpolated span until a
+    // keyframe in between would fall outside the tolerances
+    const unsigned numKeyFrames = keyFrames_.Size();
+    PODVector<unsigned> kept;
+    kept.Push(0);
+    for (unsigned i = 2; i < numKeyFrames; ++i)
+    {
+        if (!CanInterpolate(keyFrames_, kept.Back(), i, channelMask_, positionTolerance, rotationTolerance, scaleTolerance))
+            kept.Push(i - 1);
+    }
+    if (numKeyFrames > 1)
+        kept.Push(numKeyFrames - 1);
+
+    timeStep_ = Max(length, keyFrames_.Back().time_) / QUANTIZE_MAX;
+    if (channelMask_ & CHANNEL_POSITION)
+        GetQuantizationRange(keyFrames_, kept, &AnimationKeyFrame::position_, positionMin_, positionStep_);
+    if (channelMask_ & CHANNEL_SCALE)
+        GetQuantizationRange(keyFrames_, kept, &AnimationKeyFrame::scale_, scaleMin_, scaleStep_);
+
+    // Keep a channel at full precision if quantizing any kept keyframe would exceed its tolerance, for example a
+    // position range so large that one 16-bit step is longer than the position tolerance. In long clips the time step
+    // grows past the time tolerance and can put distinct keyframes on the same step, so keep the times as well
+    fullPrecisionMask_ = 0;
+    unsigned short quantized[3];
+    for (unsigned i = 0; i < kept.Size(); ++i)
+    {
+        const AnimationKeyFrame& keyFrame = keyFrames_[kept[i]];
+        unsigned short time = QuantizeValue(keyFrame.time_, 0.0f, timeStep_);
+        if (Abs(time * timeStep_ - keyFrame.time_) > TIME_TOLERANCE ||
+            (i && time == QuantizeValue(keyFrames_[kept[i - 1]].time_, 0.0f, timeStep_)))
+            fullPrecisionMask_ |= FULL_PRECISION_TIME;
+        if ((channelMask_ & CHANNEL_POSITION) && (DequantizeVector(QuantizeVector(quantized, keyFrame.position_, positionMin_,
+            positionStep_) - 3, positionMin_, positionStep_) - keyFrame.position_).Length() > positionTolerance)
+            fullPrecisionMask_ |= CHANNEL_POSITION;
+        if ((channelMask_ & CHANNEL_ROTATION) && GetRotationError(DequantizeRotation(QuantizeRotation(quantized,
+            keyFrame.rotation_) - 3), keyFrame.rotation_) > rotationTolerance)
+            fullPrecisionMask_ |= CHANNEL_ROTATION;
+        if ((channelMask_ & CHANNEL_SCALE) && (DequantizeVector(QuantizeVector(quantized, keyFrame.scale_, scaleMin_,
+            scaleStep_) - 3, scaleMin_, scaleStep_) - keyFrame.scale_).Length() > scaleTolerance)
+            fullPrecisionMask_ |= CHANNEL_SCALE;
+    }
+
+    compressedStride_ = GetCompressedStride(channelMask_, fullPrecisionMask_);
+    compressedKeys_.Resize(kept.Size() * compressedStride_);
+    unsigned short* dest = &compressedKeys_[0];
+    for (unsigned i = 0; i < kept.Size(); ++i)
+    {
+        const AnimationKeyFrame& keyFrame = keyFrames_[kept[i]];
+        if (fullPrecisionMask_ & FULL_PRECISION_TIME)
+            dest = StoreFloats(dest, &keyFrame.time_, 1);
+        else
+            *dest++ = QuantizeValue(keyFrame.time_, 0.0f, timeStep_);
+        if (channelMask_ & CHANNEL_POSITION)
+        {
+            dest = (fullPrecisionMask_ & CHANNEL_POSITION) ? StoreFloats(dest, keyFrame.position_.Data(), 3) :
+                QuantizeVector(dest, keyFrame.position_, positionMin_, positionStep_);
+        }
+        if (channelMask_ & CHANNEL_ROTATION)
+        {
+            dest = (fullPrecisionMask_ & CHANNEL_ROTATION) ? StoreFloats(dest, keyFrame.rotation_.Data(), 4) :
+                QuantizeRotation(dest, keyFrame.rotation_);
+        }
+        if (channelMask_ & CHANNEL_SCALE)
+        {
+            dest = (fullPrecisionMask_ & CHANNEL_SCALE) ? StoreFloats(dest, keyFrame.scale_.Data(), 3) :
+                QuantizeVector(dest, keyFrame.scale_, scaleMin_, scaleStep_);
+        }
+    }
+
+    keyFrames_.Clear();
+    keyFrames_.Compact();
+}
+
+void AnimationTrack::Decompress()
+{
+    if (!IsCompressed())
+        return;
+
+    keyFrames_.Resize(GetNumKeyFrames());
+    for (unsigned i = 0; i < keyFrames_.Size(); ++i)
+        DecodeKeyFrame(i, keyFrames_[i]);
+
+    compressedKeys_.Clear();
+    compressedKeys_.Compact();
+    compressedStride_ = 0;
+    fullPrecisionMask_ = 0;
 }
 
+void AnimationTrack::DecodeKeyFrame(unsigned index, AnimationKeyFrame& dest) const
+{
+    if (!compressedStride_)
+    {
+        dest = keyFrames_[index];
+        return;
+    }
+
+    const unsigned short* src = &compressedKeys_[index * compressedStride_];
+    if (fullPrecisionMask_ & FULL_PRECISION_TIME)
+        src = LoadFloats(src, &dest.time_, 1);
+    else
+        dest.time_ = *src++ * timeStep_;
+    if (channelMask_ & CHANNEL_POSITION)
+    {
+        if (fullPrecisionMask_ & CHANNEL_POSITION)
+            src = LoadFloats(src, &dest.position_.x_, 3);
+        else
+        {
+            dest.position_ = DequantizeVector(src, positionMin_, positionStep_);
+            src += 3;
+        }
+    }
+    if (channelMask_ & CHANNEL_ROTATION)
+    {
+        if (fullPrecisionMask_ & CHANNEL_ROTATION)
+            src = LoadFloats(src, &dest.rotation_.w_, 4);
+        else
+        {
+            dest.rotation_ = DequantizeRotation(src);
+            src += 3;
+        }
+    }
+    if (channelMask_ & CHANNEL_SCALE)
+    {
+        if (fullPrecisionMask_ & CHANNEL_SCALE)
+            LoadFloats(src, &dest.scale_.x_, 3);
+        else
+            dest.scale_ = DequantizeVector(src, scaleMin_, scaleStep_);
+    }
+}
+
+// ATOMIC END
+
 Animation::Animation(Context* context) :
     Resource(context),
     length_(0.f)
@@ -126,8 +454,11 @@ bool Animation::BeginLoad(Deserializer& source)
     unsigned memoryUse = sizeof(Animation);
 
     // Check ID
-    if (source.ReadFileID() != "UANI")
+    // ATOMIC BEGIN
+    String fileID = source.ReadFileID();
+    if (fileID != "UANI" && fileID != "UANC")
     {
+    // ATOMIC END
         ATOMIC_LOGERROR(source.GetName() + " is not a valid animation file");
         return false;
     }
@@ -138,32 +469,42 @@ bool Animation::BeginLoad(Deserializer& source)
     length_ = source.ReadFloat();
     tracks_.Clear();
 
-    unsigned tracks = source.ReadUInt();
-    memoryUse += tracks * sizeof(AnimationTrack);
-
-    // Read tracks
-    for (unsigned i = 0; i < tracks; ++i)
+    // ATOMIC BEGIN
+    if (fileID == "UANC")
     {
-        AnimationTrack* newTrack = CreateTrack(source.ReadString());
-        newTrack->channelMask_ = source.ReadUByte();
-
-        unsigned keyFrames = source.ReadUInt();
-        newTrack->keyFrames_.Resize(keyFrames);
-        memoryUse += keyFrames * sizeof(AnimationKeyFrame);
+        ReadCompressedTracks(source);
+        memoryUse += GetTracksMemoryUse();
+    }
+    else
+    {
+        unsigned tracks = source.ReadUInt();
+        memoryUse += tracks * sizeof(AnimationTrack);
 
-        // Read keyframes of the track
-        for (unsigned j = 0; j < keyFrames; ++j)
+        // Read tracks
+        for (unsigned i = 0; i < tracks; ++i)
         {
-            AnimationKeyFrame& newKeyFrame = newTrack->keyFrames_[j];
-            newKeyFrame.time_ = source.ReadFloat();
-            if (newTrack->channelMask_ & CHANNEL_POSITION)
-                newKeyFrame.position_ = source.ReadVector3();
-            if (newTrack->channelMask_ & CHANNEL_ROTATION)
-                newKeyFrame.rotation_ = source.ReadQuaternion();
-            if (newTrack->channelMask_ & CHANNEL_SCALE)
-                newKeyFrame.scale_ = source.ReadVector3();
+            AnimationTrack* newTrack = CreateTrack(source.ReadString());
+            newTrack->channelMask_ = source.ReadUByte();
+
+            unsigned keyFrames = source.ReadUInt();
+            newTrack->keyFrames_.Resize(keyFrames);
+            memoryUse += keyFrames * sizeof(AnimationKeyFrame);
+
+            // Read keyframes of the track
+            for (unsigned j = 0; j < keyFrames; ++j)
+            {
+                AnimationKeyFrame& newKeyFrame = newTrack->keyFrames_[j];
+                newKeyFrame.time_ = source.ReadFloat();
+                if (newTrack->channelMask_ & CHANNEL_POSITION)
+                    newKeyFrame.position_ = source.ReadVector3();
+                if (newTrack->channelMask_ & CHANNEL_ROTATION)
+                    newKeyFrame.rotation_ = source.ReadQuaternion();
+                if (newTrack->channelMask_ & CHANNEL_SCALE)
+                    newKeyFrame.scale_ = source.ReadVector3();
+            }
         }
     }
+    // ATOMIC END
 
     // Optionally read triggers from an XML file
     ResourceCache* cache = GetSubsystem<ResourceCache>();
@@ -223,12 +564,20 @@ bool Animation::BeginLoad(Deserializer& source)
 
 bool Animation::Save(Serializer& dest) const
 {
+    // ATOMIC BEGIN
     // Write ID, name and length
-    dest.WriteFileID("UANI");
+    const bool compressed = IsCompressed();
+    dest.WriteFileID(compressed ? "UANC" : "UANI");
     dest.WriteString(animationName_);
     dest.WriteFloat(length_);
 
     // Write tracks
+    if (compressed)
+        WriteCompressedTracks(dest);
+    else
+    {
+    // ATOMIC END
+
     dest.WriteUInt(tracks_.Size());
     for (HashMap<StringHash, AnimationTrack>::ConstIterator i = tracks_.Begin(); i != tracks_.End(); ++i)
     {
@@ -251,6 +600,10 @@ bool Animation::Save(Serializer& dest) const
         }
     }
 
+    // ATOMIC BEGIN
+    }
+    // ATOMIC END
+
     // If triggers have been defined, write an XML file for them
     if (triggers_.Size())
     {
@@ -428,6 +781,105 @@ void Animation::SetTracks(const Vector<AnimationTrack>& tracks)
 
 }
 
+void Animation::Compress(float positionTolerance, float rotationTolerance, float scaleTolerance)
+{
+    for (HashMap<StringHash, AnimationTrack>::Iterator i = tracks_.Begin(); i != tracks_.End(); ++i)
+        i->second_.Compress(length_, positionTolerance, rotationTolerance, scaleTolerance);
+
+    SetMemoryUse(sizeof(Animation) + GetTracksMemoryUse() + triggers_.Size() * sizeof(AnimationTriggerPoint));
+}
+
+bool Animation::IsCompressed() const
+{
+    for (HashMap<StringHash, AnimationTrack>::ConstIterator i = tracks_.Begin(); i != tracks_.End(); ++i)
+    {
+        if (i->second_.IsCompressed())
+            return true;
+    }
+
+    return false;
+}
+
+void Animation::ReadCompressedTracks(Deserializer& source)
+{
+    unsigned tracks = source.ReadUInt();
+
+    for (unsigned i = 0; i < tracks; ++i)
+    {
+        AnimationTrack* newTrack = CreateTrack(source.ReadString());
+        newTrack->channelMask_ = source.ReadUByte();
+        newTrack->fullPrecisionMask_ = source.ReadUByte();
+        unsigned keyFrames = source.ReadUInt();
+        newTrack->compressedStride_ = keyFrames ? GetCompressedStride(newTrack->channelMask_, newTrack->fullPrecisionMask_) : 0;
+        newTrack->timeStep_ = source.ReadFloat();
+        if (newTrack->channelMask_ & CHANNEL_POSITION)
+        {
+            newTrack->positionMin_ = source.ReadVector3();
+            newTrack->positionStep_ = source.ReadVector3();
+        }
+        if (newTrack->channelMask_ & CHANNEL_SCALE)
+        {
+            newTrack->scaleMin_ = source.ReadVector3();
+            newTrack->scaleStep_ = source.ReadVector3();
+        }
+
+        newTrack->compressedKeys_.Resize(keyFrames * newTrack->compressedStride_);
+        if (newTrack->compressedKeys_.Size())
+            source.Read(&newTrack->compressedKeys_[0], newTrack->compressedKeys_.Size() * sizeof(unsigned short));
+    }
+}
+
+void Animation::WriteCompressedTracks(Serializer& dest) const
+{
+    dest.WriteUInt(tracks_.Size());
+
+    for (HashMap<StringHash, AnimationTrack>::ConstIterator i = tracks_.Begin(); i != tracks_.End(); ++i)
+    {
+        const AnimationTrack* track = &i->second_;
+        AnimationTrack quantized;
+        if (!track->IsCompressed())
+        {
+            // Zero tolerance only drops keyframes that interpolation reproduces exactly, and only quantizes exact channels
+            quantized = *track;
+            quantized.Compress(length_, 0.0f, 0.0f, 0.0f);
+            track = &quantized;
+        }
+
+        dest.WriteString(track->name_);
+        dest.WriteUByte(track->channelMask_);
+        dest.WriteUByte(track->fullPrecisionMask_);
+        dest.WriteUInt(track->GetNumKeyFrames());
+        dest.WriteFloat(track->timeStep_);
+        if (track->channelMask_ & CHANNEL_POSITION)
+        {
+            dest.WriteVector3(track->positionMin_);
+            dest.WriteVector3(track->positionStep_);
+        }
+        if (track->channelMask_ & CHANNEL_SCALE)
+        {
+            dest.WriteVector3(track->scaleMin_);
+            dest.WriteVector3(track->scaleStep_);
+        }
+
+        if (track->compressedKeys_.Size())
+            dest.Write(&track->compressedKeys_[0], track->compressedKeys_.Size() * sizeof(unsigned short));
+    }
+}
+
+unsigned Animation::GetTracksMemoryUse() const
+{
+    unsigned memoryUse = 0;
+
+    for (HashMap<StringHash, AnimationTrack>::ConstIterator i = tracks_.Begin(); i != tracks_.End(); ++i)
+    {
+        const AnimationTrack& track = i->second_;
+        memoryUse += sizeof(AnimationTrack) + track.keyFrames_.Capacity() * sizeof(AnimationKeyFrame) +
+            track.compressedKeys_.Capacity() * sizeof(unsigned short);
+    }
+
+    return memoryUse;
+}
+
 // ATOMIC END
 
 
@@ -50,12 +50,30 @@ struct AnimationKeyFrame
     Vector3 scale_;
 };
 
+// ATOMIC BEGIN
+
+/// Default position error tolerance when compressing animation tracks.
+static const float DEFAULT_POSITION_TOLERANCE = 0.0005f;
+/// Default rotation error tolerance in degrees when compressing animation tracks.
+static const float DEFAULT_ROTATION_TOLERANCE = 0.05f;
+/// Default scale error tolerance when compressing animation tracks.
+static const float DEFAULT_SCALE_TOLERANCE = 0.0005f;
+/// Full precision mask bit of a compressed animation track that stores its keyframe times as floats.
+static const unsigned char FULL_PRECISION_TIME = 0x80;
+
+// ATOMIC END
+
 /// Skeletal animation track, stores keyframes of a single bone.
 struct ATOMIC_API AnimationTrack
 {
     /// Construct.
     AnimationTrack() :
-        channelMask_(0)
+        channelMask_(0),
+        // ATOMIC BEGIN
+        compressedStride_(0),
+        fullPrecisionMask_(0),
+        timeStep_(0.0f)
+        // ATOMIC END
     {
     }
 
@@ -70,13 +88,45 @@ struct ATOMIC_API AnimationTrack
     /// Remove all keyframes.
     void RemoveAllKeyFrames();
 
-    /// Return keyframe at index, or null if not found.
+    /// Return keyframe at index, or null if not found or the track is compressed.
     AnimationKeyFrame* GetKeyFrame(unsigned index);
     /// Return number of keyframes.
-    unsigned GetNumKeyFrames() const { return keyFrames_.Size(); }
+    unsigned GetNumKeyFrames() const { return compressedStride_ ? compressedKeys_.Size() / compressedStride_ : keyFrames_.Size(); }
     /// Return keyframe index based on time and previous index.
     void GetKeyFrameIndex(float time, unsigned& index) const;
 
+    // ATOMIC BEGIN
+
+    /// Compress the keyframes of an animation with the given length. Keyframes that interpolating their neighbours
+    /// reproduces within the tolerances are dropped, and the rest are quantized to 16 bits per component. Channels whose
+    /// quantization error would exceed the tolerance are kept at full precision instead. Rotation tolerance is in degrees.
+    /// The uncompressed keyframes are released.
+    void Compress(float length, float positionTolerance = DEFAULT_POSITION_TOLERANCE,
+        float rotationTolerance = DEFAULT_ROTATION_TOLERANCE, float scaleTolerance = DEFAULT_SCALE_TOLERANCE);
+    /// Decompress the keyframes back to full precision.
+    void Decompress();
+    /// Return keyframe at index decoded from either storage form. Index must be valid.
+    void DecodeKeyFrame(unsigned index, AnimationKeyFrame& dest) const;
+    /// Return keyframe time at index. Index must be valid.
+    float GetKeyFrameTime(unsigned index) const
+    {
+        if (!compressedStride_)
+            return keyFrames_[index].time_;
+
+        const unsigned short* src = &compressedKeys_[index * compressedStride_];
+        if (fullPrecisionMask_ & FULL_PRECISION_TIME)
+        {
+            float time;
+            memcpy(&time, src, sizeof time);
+            return time;
+        }
+        return *src * timeStep_;
+    }
+    /// Return whether the keyframes are stored compressed.
+    bool IsCompressed() const { return compressedStride_ != 0; }
+
+    // ATOMIC END
+
     /// Bone or scene node name.
     String name_;
     /// Name hash.
@@ -85,6 +135,27 @@ struct ATOMIC_API AnimationTrack
     unsigned char channelMask_;
     /// Keyframes.
     Vector<AnimationKeyFrame> keyFrames_;
+    // ATOMIC BEGIN
+    /// Compressed keyframes. Each holds the quantized time followed by the included channels: three components per
+    /// position and scale, and the smallest three components of the rotation with the index of the largest one
+    /// in their high bits. Channels in the full precision mask hold their floats instead, as does the time if the mask
+    /// includes FULL_PRECISION_TIME.
+    PODVector<unsigned short> compressedKeys_;
+    /// Number of values per compressed keyframe, or zero if not compressed.
+    unsigned char compressedStride_;
+    /// Bitmask of channels stored in the compressed keyframes as full precision floats (two values per component.)
+    unsigned char fullPrecisionMask_;
+    /// Time per quantization step.
+    float timeStep_;
+    /// Position quantization range minimum.
+    Vector3 positionMin_;
+    /// Position per quantization step.
+    Vector3 positionStep_;
+    /// Scale quantization range minimum.
+    Vector3 scaleMin_;
+    /// Scale per quantization step.
+    Vector3 scaleStep_;
+    // ATOMIC END
 };
 
 /// %Animation trigger point.
@@ -185,6 +256,11 @@ public:
 
     /// Set all animation tracks.
     void SetTracks(const Vector<AnimationTrack>& tracks);
+    /// Compress all tracks with the same tolerances. Rotation tolerance is in degrees. Saving writes the compressed format afterward.
+    void Compress(float positionTolerance = DEFAULT_POSITION_TOLERANCE, float rotationTolerance = DEFAULT_ROTATION_TOLERANCE,
+        float scaleTolerance = DEFAULT_SCALE_TOLERANCE);
+    /// Return whether any track is stored compressed.
+    bool IsCompressed() const;
 
     // ATOMIC END
 
@@ -199,6 +275,15 @@ private:
     HashMap<StringHash, AnimationTrack> tracks_;
     /// Animation trigger points.
     Vector<AnimationTriggerPoint> triggers_;
+
+    // ATOMIC BEGIN
+    /// Read tracks in the compressed format.
+    void ReadCompressedTracks(Deserializer& source);
+    /// Write tracks in the compressed format. Uncompressed tracks keep all keyframes, and their channels are kept at full precision unless quantization is exact.
+    void WriteCompressedTracks(Serializer& dest) const;
+    /// Recalculate memory use of the tracks.
+    unsigned GetTracksMemoryUse() const;
+    // ATOMIC END
 };
 
 }
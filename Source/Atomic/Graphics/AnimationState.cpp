@@ -27,6 +27,9 @@
 #include "../Graphics/AnimationState.h"
 #include "../Graphics/DrawableEvents.h"
 #include "../IO/Log.h"
+// ATOMIC BEGIN
+#include "../Math/MathSIMD.h"
+// ATOMIC END
 
 #include "../DebugNew.h"
 
@@ -53,7 +56,10 @@ AnimationState::AnimationState(AnimatedModel* model, Animation* animation) :
     weight_(0.0f),
     time_(0.0f),
     layer_(0),
-    blendingMode_(ABM_LERP)
+    blendingMode_(ABM_LERP),
+    // ATOMIC BEGIN
+    numAppliedTracks_(0)
+    // ATOMIC END
 {
     // Set default start bone (use all tracks.)
     SetStartBone(0);
@@ -67,7 +73,10 @@ AnimationState::AnimationState(Node* node, Animation* animation) :
     weight_(1.0f),
     time_(0.0f),
     layer_(0),
-    blendingMode_(ABM_LERP)
+    blendingMode_(ABM_LERP),
+    // ATOMIC BEGIN
+    numAppliedTracks_(0)
+    // ATOMIC END
 {
     if (animation_)
     {
@@ -447,6 +456,10 @@ float AnimationState::GetLength() const
 
 void AnimationState::Apply()
 {
+    // ATOMIC BEGIN
+    numAppliedTracks_ = 0;
+    // ATOMIC END
+
     if (!animation_ || !IsEnabled())
         return;
 
@@ -458,6 +471,19 @@ void AnimationState::Apply()
 
 void AnimationState::ApplyToModel()
 {
+    // ATOMIC BEGIN
+    const unsigned boneLodLevel = model_->GetBoneLodLevel();
+
+    // Lerp blending samples all tracks first, then interpolates and blends each channel in one batch
+    const bool batched = blendingMode_ == ABM_LERP;
+    if (batched)
+    {
+        positionSamples_.Clear();
+        rotationSamples_.Clear();
+        scaleSamples_.Clear();
+    }
+    // ATOMIC END
+
     for (Vector<AnimationStateTrack>::Iterator i = stateTracks_.Begin(); i != stateTracks_.End(); ++i)
     {
         AnimationStateTrack& stateTrack = *i;
@@ -467,8 +493,23 @@ void AnimationState::ApplyToModel()
         if (Equals(finalWeight, 0.0f) || !stateTrack.bone_->animated_)
             continue;
             
-        ApplyTrack(stateTrack, finalWeight, true);
+        // ATOMIC BEGIN
+        // Bones dropped by bone LOD keep their last pose
+        if (stateTrack.bone_->lodHeight_ < boneLodLevel)
+            continue;
+
+        ++numAppliedTracks_;
+        if (batched)
+            SampleTrack(stateTrack, finalWeight);
+        else
+            ApplyTrack(stateTrack, finalWeight, true);
+        // ATOMIC END
     }
+
+    // ATOMIC BEGIN
+    if (batched)
+        ApplySamples();
+    // ATOMIC END
 }
 
 void AnimationState::ApplyToNodes()
@@ -476,35 +517,26 @@ void AnimationState::ApplyToNodes()
     // When applying to a node hierarchy, can only use full weight (nothing to blend to)
     for (Vector<AnimationStateTrack>::Iterator i = stateTracks_.Begin(); i != stateTracks_.End(); ++i)
         ApplyTrack(*i, 1.0f, false);
+
+    // ATOMIC BEGIN
+    numAppliedTracks_ = stateTracks_.Size();
+    // ATOMIC END
 }
 
 void AnimationState::ApplyTrack(AnimationStateTrack& stateTrack, float weight, bool silent)
 {
-    const AnimationTrack* track = stateTrack.track_;
-    Node* node = stateTrack.node_;
-
-    if (track->keyFrames_.Empty() || !node)
+    // ATOMIC BEGIN
+    AnimationKeyFrame decoded[2];
+    const AnimationKeyFrame* keyFrame;
+    const AnimationKeyFrame* nextKeyFrame;
+    float t;
+    if (!GetKeyFrames(stateTrack, decoded, keyFrame, nextKeyFrame, t))
         return;
 
-    unsigned& frame = stateTrack.keyFrame_;
-    track->GetKeyFrameIndex(time_, frame);
-
-    // Check if next frame to interpolate to is valid, or if wrapping is needed (looping animation only)
-    unsigned nextFrame = frame + 1;
-    bool interpolate = true;
-    if (nextFrame >= track->keyFrames_.Size())
-    {
-        if (!looped_)
-        {
-            nextFrame = frame;
-            interpolate = false;
-        }
-        else
-            nextFrame = 0;
-    }
-
-    const AnimationKeyFrame* keyFrame = &track->keyFrames_[frame];
-    unsigned char channelMask = track->channelMask_;
+    Node* node = stateTrack.node_;
+    bool interpolate = nextKeyFrame != keyFrame;
+    unsigned char channelMask = stateTrack.track_->channelMask_;
+    // ATOMIC END
 
     Vector3 newPosition;
     Quaternion newRotation;
@@ -512,12 +544,6 @@ void AnimationState::ApplyTrack(AnimationStateTrack& stateTrack, float weight, b
 
     if (interpolate)
     {
-        const AnimationKeyFrame* nextKeyFrame = &track->keyFrames_[nextFrame];
-        float timeInterval = nextKeyFrame->time_ - keyFrame->time_;
-        if (timeInterval < 0.0f)
-            timeInterval += animation_->GetLength();
-        float t = timeInterval > 0.0f ? (time_ - keyFrame->time_) / timeInterval : 1.0f;
-
         if (channelMask & CHANNEL_POSITION)
             newPosition = keyFrame->position_.Lerp(nextKeyFrame->position_, t);
         if (channelMask & CHANNEL_ROTATION)
@@ -588,4 +614,133 @@ void AnimationState::ApplyTrack(AnimationStateTrack& stateTrack, float weight, b
     }
 }
 
+// ATOMIC BEGIN
+
+bool AnimationState::GetKeyFrames(AnimationStateTrack& stateTrack, AnimationKeyFrame* decoded, const AnimationKeyFrame*& keyFrame,
+    const AnimationKeyFrame*& nextKeyFrame, float& t)
+{
+    const AnimationTrack* track = stateTrack.track_;
+    const unsigned numKeyFrames = track->GetNumKeyFrames();
+
+    if (!numKeyFrames || !stateTrack.node_)
+        return false;
+
+    unsigned& frame = stateTrack.keyFrame_;
+    track->GetKeyFrameIndex(time_, frame);
+
+    // Check if next frame to interpolate to is valid, or if wrapping is needed (looping animation only)
+    unsigned nextFrame = frame + 1;
+    if (nextFrame >= numKeyFrames)
+        nextFrame = looped_ ? 0 : frame;
+
+    if (track->IsCompressed())
+    {
+        // Decode only the key frames being interpolated
+        track->DecodeKeyFrame(frame, decoded[0]);
+        keyFrame = &decoded[0];
+        if (nextFrame != frame)
+        {
+            track->DecodeKeyFrame(nextFrame, decoded[1]);
+            nextKeyFrame = &decoded[1];
+        }
+        else
+            nextKeyFrame = keyFrame;
+    }
+    else
+    {
+        keyFrame = &track->keyFrames_[frame];
+        nextKeyFrame = &track->keyFrames_[nextFrame];
+    }
+    t = 0.0f;
+
+    if (nextFrame != frame)
+    {
+        float timeInterval = nextKeyFrame->time_ - keyFrame->time_;
+        if (timeInterval < 0.0f)
+            timeInterval += animation_->GetLength();
+        t = timeInterval > 0.0f ? (time_ - keyFrame->time_) / timeInterval : 1.0f;
+    }
+
+    return true;
+}
+
+void AnimationState::SampleTrack(AnimationStateTrack& stateTrack, float weight)
+{
+    AnimationKeyFrame decoded[2];
+    const AnimationKeyFrame* keyFrame;
+    const AnimationKeyFrame* nextKeyFrame;
+    float t;
+    if (!GetKeyFrames(stateTrack, decoded, keyFrame, nextKeyFrame, t))
+        return;
+
+    Node* node = stateTrack.node_;
+    unsigned char channelMask = stateTrack.track_->channelMask_;
+    // Full weight replaces the node transform without blending
+    if (Equals(weight, 1.0f))
+        weight = 1.0f;
+
+    if (channelMask & CHANNEL_POSITION)
+        positionSamples_.Add(node, keyFrame->position_, nextKeyFrame->position_, t, weight);
+    if (channelMask & CHANNEL_ROTATION)
+        rotationSamples_.Add(node, keyFrame->rotation_, nextKeyFrame->rotation_, t, weight);
+    if (channelMask & CHANNEL_SCALE)
+        scaleSamples_.Add(node, keyFrame->scale_, nextKeyFrame->scale_, t, weight);
+}
+
+/// Prepare interpolated samples for blending from the current node values. Samples with full weight blend from
+/// themselves, which leaves them unchanged. Return false if no sample needs blending.
+template <class T> static bool PrepareBlend(AnimationChannelSamples<T>& samples, const T& (Node::*getter)() const)
+{
+    const unsigned count = samples.nodes_.Size();
+    unsigned i = 0;
+    while (i < count && samples.weights_[i] == 1.0f)
+        ++i;
+    if (i == count)
+        return false;
+
+    for (i = 0; i < count; ++i)
+    {
+        samples.to_[i] = samples.from_[i];
+        if (samples.weights_[i] != 1.0f)
+            samples.from_[i] = (samples.nodes_[i]->*getter)();
+    }
+    return true;
+}
+
+void AnimationState::ApplySamples()
+{
+    // Interpolate between the key frames. Samples without a next key frame interpolate to themselves
+    if (unsigned count = positionSamples_.nodes_.Size())
+    {
+        Vector3* values = &positionSamples_.from_[0];
+        LerpVectors(values, &positionSamples_.to_[0], &positionSamples_.factors_[0], values, count);
+        if (PrepareBlend(positionSamples_, &Node::GetPosition))
+            LerpVectors(values, &positionSamples_.to_[0], &positionSamples_.weights_[0], values, count);
+        for (unsigned i = 0; i < count; ++i)
+            positionSamples_.nodes_[i]->SetPositionSilent(values[i]);
+    }
+
+    if (unsigned count = rotationSamples_.nodes_.Size())
+    {
+        Quaternion* values = &rotationSamples_.from_[0];
+        SlerpQuaternions(values, &rotationSamples_.to_[0], &rotationSamples_.factors_[0], values, count);
+        if (PrepareBlend(rotationSamples_, &Node::GetRotation))
+            SlerpQuaternions(values, &rotationSamples_.to_[0], &rotationSamples_.weights_[0], values, count);
+        for (unsigned i = 0; i < count; ++i)
+            rotationSamples_.nodes_[i]->SetRotationSilent(values[i]);
+    }
+
+    if (unsigned count = scaleSamples_.nodes_.Size())
+    {
+        Vector3* values = &scaleSamples_.from_[0];
+        LerpVectors(values, &scaleSamples_.to_[0], &scaleSamples_.factors_[0], values, count);
+        if (PrepareBlend(scaleSamples_, &Node::GetScale))
+            LerpVectors(values, &scaleSamples_.to_[0], &scaleSamples_.weights_[0], values, count);
+        for (unsigned i = 0; i < count; ++i)
+            scaleSamples_.nodes_[i]->SetScaleSilent(values[i]);
+    }
+}
+
+// ATOMIC END
+
 }
@@ -24,6 +24,9 @@
 
 #include "../Container/HashMap.h"
 #include "../Container/Ptr.h"
+// ATOMIC BEGIN
+#include "../Math/Quaternion.h"
+// ATOMIC END
 
 namespace Atomic
 {
@@ -31,8 +34,10 @@ namespace Atomic
 class Animation;
 class AnimatedModel;
 class Deserializer;
+class Node;
 class Serializer;
 class Skeleton;
+struct AnimationKeyFrame;
 struct AnimationTrack;
 struct Bone;
 
@@ -65,6 +70,45 @@ struct AnimationStateTrack
     unsigned keyFrame_;
 };
 
+// ATOMIC BEGIN
+
+/// %Animation channel values sampled from all tracks of a state, so that they can be interpolated and blended in batches.
+template <class T> struct AnimationChannelSamples
+{
+    /// Remove all samples.
+    void Clear()
+    {
+        nodes_.Clear();
+        from_.Clear();
+        to_.Clear();
+        factors_.Clear();
+        weights_.Clear();
+    }
+
+    /// Add a sample interpolated between two key frames and blended to the node with a weight.
+    void Add(Node* node, const T& from, const T& to, float factor, float weight)
+    {
+        nodes_.Push(node);
+        from_.Push(from);
+        to_.Push(to);
+        factors_.Push(factor);
+        weights_.Push(weight);
+    }
+
+    /// Target scene nodes.
+    PODVector<Node*> nodes_;
+    /// Key frame values to interpolate from. Receive the results.
+    PODVector<T> from_;
+    /// Key frame values to interpolate to.
+    PODVector<T> to_;
+    /// Interpolation factors between the key frames.
+    PODVector<float> factors_;
+    /// Blending weights toward the sampled values.
+    PODVector<float> weights_;
+};
+
+// ATOMIC END
+
 /// %Animation instance.
 class ATOMIC_API AnimationState : public RefCounted
 {
@@ -144,6 +188,11 @@ public:
     /// Return blending layer.
     unsigned char GetLayer() const { return layer_; }
 
+    // ATOMIC BEGIN
+    /// Return number of tracks applied on the last apply.
+    unsigned GetNumAppliedTracks() const { return numAppliedTracks_; }
+    // ATOMIC END
+
     /// Apply the animation at the current time position.
     void Apply();
 
@@ -154,6 +203,15 @@ private:
     void ApplyToNodes();
     /// Apply track.
     void ApplyTrack(AnimationStateTrack& stateTrack, float weight, bool silent);
+    // ATOMIC BEGIN
+    /// Find the key frames to interpolate between at the current time and the interpolation factor. Compressed key frames are decoded into the two-element scratch array. Return false if the track has no key frames or node.
+    bool GetKeyFrames(AnimationStateTrack& stateTrack, AnimationKeyFrame* decoded, const AnimationKeyFrame*& keyFrame,
+        const AnimationKeyFrame*& nextKeyFrame, float& t);
+    /// Sample a track into the channel samples for batched application to a skeleton.
+    void SampleTrack(AnimationStateTrack& stateTrack, float weight);
+    /// Interpolate the sampled channels, blend them to the current bone transforms and apply silently.
+    void ApplySamples();
+    // ATOMIC END
 
     /// Animated model (model mode.)
     WeakPtr<AnimatedModel> model_;
@@ -175,6 +233,16 @@ private:
     unsigned char layer_;
     /// Blending mode.
     AnimationBlendMode blendingMode_;
+    // ATOMIC BEGIN
+    /// Sampled position channels.
+    AnimationChannelSamples<Vector3> positionSamples_;
+    /// Sampled rotation channels.
+    AnimationChannelSamples<Quaternion> rotationSamples_;
+    /// Sampled scale channels.
+    AnimationChannelSamples<Vector3> scaleSamples_;
+    /// Number of tracks applied on the last apply.
+    unsigned numAppliedTracks_;
+    // ATOMIC END
 };
 
 }
@@ -80,6 +80,199 @@ inline bool CompareBatchGroupOrder(BatchGroup* lhs, BatchGroup* rhs)
     return lhs->renderOrder_ < rhs->renderOrder_;
 }
 
+// ATOMIC BEGIN
+
+/// Minimum number of elements to radix sort. Smaller arrays use a comparison sort.
+static const unsigned RADIX_SORT_THRESHOLD = 64;
+
+/// Batch sort orders.
+enum BatchSortOrder
+{
+    SORT_BATCHES_STATE = 0,
+    SORT_BATCHES_FRONTTOBACK,
+    SORT_BATCHES_BACKTOFRONT
+};
+
+/// Convert a distance to an unsigned key with the same ordering.
+inline unsigned long long GetDistanceSortKey(float distance)
+{
+    unsigned bits;
+    memcpy(&bits, &distance, sizeof bits);
+    return (bits & 0x80000000) ? ~bits : (bits | 0x80000000);
+}
+
+/// Stable radix sort pass on batch or batch group pointers by one key field.
+template <class T, class KeyFunction> void RadixSortBatchPass(PODVector<T*>& batches, PODVector<RadixSortEntry<T*> >* entries,
+    unsigned numKeyBytes, KeyFunction getKey)
+{
+    unsigned count = batches.Size();
+    RadixSortEntry<T*>* dest = entries[0].Buffer();
+    for (unsigned i = 0; i < count; ++i)
+    {
+        dest[i].key_ = getKey(batches[i]);
+        dest[i].value_ = batches[i];
+    }
+
+    RadixSort(dest, entries[1].Buffer(), count, numKeyBytes);
+
+    for (unsigned i = 0; i < count; ++i)
+        batches[i] = dest[i].value_;
+}
+
+/// Sort batch pointers. Large arrays are radix sorted by applying stable passes from the least to the most significant
+/// field, as the render order, 64-bit state key and distance together do not fit one key.
+template <class T> void SortBatches(PODVector<T*>& batches, PODVector<RadixSortEntry<T*> >* entries, BatchSortOrder order)
+{
+    if (batches.Size() < RADIX_SORT_THRESHOLD)
+    {
+        switch (order)
+        {
+        case SORT_BATCHES_STATE:
+            Sort(batches.Begin(), batches.End(), CompareBatchesState);
+            break;
+
+        case SORT_BATCHES_FRONTTOBACK:
+            Sort(batches.Begin(), batches.End(), CompareBatchesFrontToBack);
+            break;
+
+        case SORT_BATCHES_BACKTOFRONT:
+            Sort(batches.Begin(), batches.End(), CompareBatchesBackToFront);
+            break;
+        }
+        return;
+    }
+
+    entries[0].Resize(batches.Size());
+    entries[1].Resize(batches.Size());
+
+    switch (order)
+    {
+    case SORT_BATCHES_STATE:
+        RadixSortBatchPass(batches, entries, 4, [](Batch* batch) { return GetDistanceSortKey(batch->distance_); });
+        RadixSortBatchPass(batches, entries, 8, [](Batch* batch) { return batch->sortKey_; });
+        RadixSortBatchPass(batches, entries, 1, [](Batch* batch) { return (unsigned long long)batch->renderOrder_; });
+        break;
+
+    case SORT_BATCHES_FRONTTOBACK:
+        RadixSortBatchPass(batches, entries, 8, [](Batch* batch) { return batch->sortKey_; });
+        RadixSortBatchPass(batches, entries, 5, [](Batch* batch)
+        {
+            return ((unsigned long long)batch->renderOrder_ << 32) | GetDistanceSortKey(batch->distance_);
+        });
+        break;
+
+    case SORT_BATCHES_BACKTOFRONT:
+        RadixSortBatchPass(batches, entries, 8, [](Batch* batch) { return batch->sortKey_; });
+        RadixSortBatchPass(batches, entries, 5, [](Batch* batch)
+        {
+            return ((unsigned long long)batch->renderOrder_ << 32) | (~GetDistanceSortKey(batch->distance_) & 0xffffffff);
+        });
+        break;
+    }
+}
+
+/// Sort batch groups by render order.
+void SortBatchGroups(PODVector<BatchGroup*>& groups, PODVector<RadixSortEntry<BatchGroup*> >* entries)
+{
+    if (groups.Size() < RADIX_SORT_THRESHOLD)
+    {
+        Sort(groups.Begin(), groups.End(), CompareBatchGroupOrder);
+        return;
+    }
+
+    entries[0].Resize(groups.Size());
+    entries[1].Resize(groups.Size());
+    RadixSortBatchPass(groups, entries, 1, [](Batch* batch) { return (unsigned long long)batch->renderOrder_; });
+}
+
+/// Sort batches or batch groups front to back while also maintaining state sorting.
+template <class T> void SortFrontToBack2Pass(BatchQueue& queue, PODVector<T*>& batches, PODVector<RadixSortEntry<T*> >* entries)
+{
+    // Mobile devices likely use a tiled deferred approach, with which front-to-back sorting is irrelevant. The 2-pass
+    // method is also time consuming, so just sort with state having priority
+#ifdef GL_ES_VERSION_2_0
+    SortBatches(batches, entries, SORT_BATCHES_STATE);
+#else
+    // For desktop, first sort by distance and remap shader/material/geometry IDs in the sort key
+    SortBatches(batches, entries, SORT_BATCHES_FRONTTOBACK);
+
+    unsigned freeShaderID = 0;
+    unsigned short freeMaterialID = 0;
+    unsigned short freeGeometryID = 0;
+
+    for (typename PODVector<T*>::Iterator i = batches.Begin(); i != batches.End(); ++i)
+    {
+        Batch* batch = *i;
+
+        unsigned shaderID = (unsigned)(batch->sortKey_ >> 32);
+        HashMap<unsigned, unsigned>::ConstIterator j = queue.shaderRemapping_.Find(shaderID);
+        if (j != queue.shaderRemapping_.End())
+            shaderID = j->second_;
+        else
+        {
+            shaderID = queue.shaderRemapping_[shaderID] = freeShaderID | (shaderID & 0x80000000);
+            ++freeShaderID;
+        }
+
+        unsigned short materialID = (unsigned short)(batch->sortKey_ & 0xffff0000);
+        HashMap<unsigned short, unsigned short>::ConstIterator k = queue.materialRemapping_.Find(materialID);
+        if (k != queue.materialRemapping_.End())
+            materialID = k->second_;
+        else
+        {
+            materialID = queue.materialRemapping_[materialID] = freeMaterialID;
+            ++freeMaterialID;
+        }
+
+        unsigned short geometryID = (unsigned short)(batch->sortKey_ & 0xffff);
+        HashMap<unsigned short, unsigned short>::ConstIterator l = queue.geometryRemapping_.Find(geometryID);
+        if (l != queue.geometryRemapping_.End())
+            geometryID = l->second_;
+        else
+        {
+            geometryID = queue.geometryRemapping_[geometryID] = freeGeometryID;
+            ++freeGeometryID;
+        }
+
+        batch->sortKey_ = (((unsigned long long)shaderID) << 32) | (((unsigned long long)materialID) << 16) | geometryID;
+    }
+
+    queue.shaderRemapping_.Clear();
+    queue.materialRemapping_.Clear();
+    queue.geometryRemapping_.Clear();
+
+    // Finally sort again with the rewritten ID's
+    SortBatches(batches, entries, SORT_BATCHES_STATE);
+#endif
+}
+
+/// Sort instances front to back.
+void SortInstances(PODVector<InstanceData>& instances, PODVector<RadixSortEntry<InstanceData> >* entries)
+{
+    unsigned count = instances.Size();
+    if (count < RADIX_SORT_THRESHOLD)
+    {
+        Sort(instances.Begin(), instances.End(), CompareInstancesFrontToBack);
+        return;
+    }
+
+    entries[0].Resize(count);
+    entries[1].Resize(count);
+    RadixSortEntry<InstanceData>* dest = entries[0].Buffer();
+    for (unsigned i = 0; i < count; ++i)
+    {
+        dest[i].key_ = GetDistanceSortKey(instances[i].distance_);
+        dest[i].value_ = instances[i];
+    }
+
+    RadixSort(dest, entries[1].Buffer(), count, 4);
+
+    for (unsigned i = 0; i < count; ++i)
+        instances[i] = dest[i].value_;
+}
+
+// ATOMIC END
+
 void CalculateShadowMatrix(Matrix4& dest, LightBatchQueue* queue, unsigned split, Renderer* renderer)
 {
     Camera* shadowCamera = queue->shadowSplits_[split].shadowCamera_;
@@ -642,29 +835,6 @@ void Batch::Draw(View* view, Camera* camera, bool allowDepthWrite) const
     }
 }
 
-void BatchGroup::SetInstancingData(void* lockedData, unsigned stride, unsigned& freeIndex)
-{
-    // Do not use up buffer space if not going to draw as instanced
-    if (geometryType_ != GEOM_INSTANCED)
-        return;
-
-    startIndex_ = freeIndex;
-    unsigned char* buffer = static_cast<unsigned char*>(lockedData) + startIndex_ * stride;
-
-    for (unsigned i = 0; i < instances_.Size(); ++i)
-    {
-        const InstanceData& instance = instances_[i];
-
-        memcpy(buffer, instance.worldTransform_, sizeof(Matrix3x4));
-        if (instance.instancingData_)
-            memcpy(buffer + sizeof(Matrix3x4), instance.instancingData_, stride - sizeof(Matrix3x4));
-
-        buffer += stride;
-    }
-
-    freeIndex += instances_.Size();
-}
-
 void BatchGroup::Draw(View* view, Camera* camera, bool allowDepthWrite) const
 {
     Graphics* graphics = view->GetGraphics();
@@ -732,7 +902,9 @@ void BatchQueue::SortBackToFront()
     for (unsigned i = 0; i < batches_.Size(); ++i)
         sortedBatches_[i] = &batches_[i];
 
-    Sort(sortedBatches_.Begin(), sortedBatches_.End(), CompareBatchesBackToFront);
+    // ATOMIC BEGIN
+    SortBatches(sortedBatches_, batchSortEntries_, SORT_BATCHES_BACKTOFRONT);
+    // ATOMIC END
 
     sortedBatchGroups_.Resize(batchGroups_.Size());
     
@@ -740,7 +912,9 @@ void BatchQueue::SortBackToFront()
     for (HashMap<BatchGroupKey, BatchGroup>::Iterator i = batchGroups_.Begin(); i != batchGroups_.End(); ++i)
         sortedBatchGroups_[index++] = &i->second_;
     
-    Sort(sortedBatchGroups_.Begin(), sortedBatchGroups_.End(), CompareBatchGroupOrder);
+    // ATOMIC BEGIN
+    SortBatchGroups(sortedBatchGroups_, batchGroupSortEntries_);
+    // ATOMIC END
 }
 
 void BatchQueue::SortFrontToBack()
@@ -757,7 +931,9 @@ void BatchQueue::SortFrontToBack()
     {
         if (i->second_.instances_.Size() <= maxSortedInstances_)
         {
-            Sort(i->second_.instances_.Begin(), i->second_.instances_.End(), CompareInstancesFrontToBack);
+            // ATOMIC BEGIN
+            SortInstances(i->second_.instances_, instanceSortEntries_);
+            // ATOMIC END
             if (i->second_.instances_.Size())
                 i->second_.distance_ = i->second_.instances_[0].distance_;
         }
@@ -776,74 +952,24 @@ void BatchQueue::SortFrontToBack()
     for (HashMap<BatchGroupKey, BatchGroup>::Iterator i = batchGroups_.Begin(); i != batchGroups_.End(); ++i)
         sortedBatchGroups_[index++] = &i->second_;
 
-    SortFrontToBack2Pass(reinterpret_cast<PODVector<Batch*>& >(sortedBatchGroups_));
+    // ATOMIC BEGIN
+    SortFrontToBack2Pass(sortedBatchGroups_);
+    // ATOMIC END
 }
 
 void BatchQueue::SortFrontToBack2Pass(PODVector<Batch*>& batches)
 {
-    // Mobile devices likely use a tiled deferred approach, with which front-to-back sorting is irrelevant. The 2-pass
-    // method is also time consuming, so just sort with state having priority
-#ifdef GL_ES_VERSION_2_0
-    Sort(batches.Begin(), batches.End(), CompareBatchesState);
-#else
-    // For desktop, first sort by distance and remap shader/material/geometry IDs in the sort key
-    Sort(batches.Begin(), batches.End(), CompareBatchesFrontToBack);
-
-    unsigned freeShaderID = 0;
-    unsigned short freeMaterialID = 0;
-    unsigned short freeGeometryID = 0;
-
-    for (PODVector<Batch*>::Iterator i = batches.Begin(); i != batches.End(); ++i)
-    {
-        Batch* batch = *i;
-
-        unsigned shaderID = (unsigned)(batch->sortKey_ >> 32);
-        HashMap<unsigned, unsigned>::ConstIterator j = shaderRemapping_.Find(shaderID);
-        if (j != shaderRemapping_.End())
-            shaderID = j->second_;
-        else
-        {
-            shaderID = shaderRemapping_[shaderID] = freeShaderID | (shaderID & 0x80000000);
-            ++freeShaderID;
-        }
-
-        unsigned short materialID = (unsigned short)(batch->sortKey_ & 0xffff0000);
-        HashMap<unsigned short, unsigned short>::ConstIterator k = materialRemapping_.Find(materialID);
-        if (k != materialRemapping_.End())
-            materialID = k->second_;
-        else
-        {
-            materialID = materialRemapping_[materialID] = freeMaterialID;
-            ++freeMaterialID;
-        }
-
-        unsigned short geometryID = (unsigned short)(batch->sortKey_ & 0xffff);
-        HashMap<unsigned short, unsigned short>::ConstIterator l = geometryRemapping_.Find(geometryID);
-        if (l != geometryRemapping_.End())
-            geometryID = l->second_;
-        else
-        {
-            geometryID = geometryRemapping_[geometryID] = freeGeometryID;
-            ++freeGeometryID;
-        }
-
-        batch->sortKey_ = (((unsigned long long)shaderID) << 32) | (((unsigned long long)materialID) << 16) | geometryID;
-    }
-
-    shaderRemapping_.Clear();
-    materialRemapping_.Clear();
-    geometryRemapping_.Clear();
-
-    // Finally sort again with the rewritten ID's
-    Sort(batches.Begin(), batches.End(), CompareBatchesState);
-#endif
+    // ATOMIC BEGIN
+    Atomic::SortFrontToBack2Pass(*this, batches, batchSortEntries_);
+    // ATOMIC END
 }
 
-void BatchQueue::SetInstancingData(void* lockedData, unsigned stride, unsigned& freeIndex)
+// ATOMIC BEGIN
+void BatchQueue::SortFrontToBack2Pass(PODVector<BatchGroup*>& groups)
 {
-    for (HashMap<BatchGroupKey, BatchGroup>::Iterator i = batchGroups_.Begin(); i != batchGroups_.End(); ++i)
-        i->second_.SetInstancingData(lockedData, stride, freeIndex);
+    Atomic::SortFrontToBack2Pass(*this, groups, batchGroupSortEntries_);
 }
+// ATOMIC END
 
 void BatchQueue::Draw(View* view, Camera* camera, bool markToStencil, bool usingLightOptimization, bool allowDepthWrite) const
 {
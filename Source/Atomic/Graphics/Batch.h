@@ -23,6 +23,7 @@
 #pragma once
 
 #include "../Container/Ptr.h"
+#include "../Container/Sort.h"
 #include "../Graphics/Drawable.h"
 #include "../Graphics/Material.h"
 #include "../Math/MathDefs.h"
@@ -171,8 +172,6 @@ struct BatchGroup : public Batch
         }
     }
 
-    /// Pre-set the instance data. Buffer must be big enough to hold all data.
-    void SetInstancingData(void* lockedData, unsigned stride, unsigned& freeIndex);
     /// Prepare and draw.
     void Draw(View* view, Camera* camera, bool allowDepthWrite) const;
 
@@ -244,8 +243,10 @@ public:
     void SortFrontToBack();
     /// Sort batches front to back while also maintaining state sorting.
     void SortFrontToBack2Pass(PODVector<Batch*>& batches);
-    /// Pre-set instance data of all groups. The vertex buffer must be big enough to hold all data.
-    void SetInstancingData(void* lockedData, unsigned stride, unsigned& freeIndex);
+    // ATOMIC BEGIN
+    /// Sort batch groups front to back while also maintaining state sorting.
+    void SortFrontToBack2Pass(PODVector<BatchGroup*>& groups);
+    // ATOMIC END
     /// Draw.
     void Draw(View* view, Camera* camera, bool markToStencil, bool usingLightOptimization, bool allowDepthWrite) const;
     /// Return the combined amount of instances.
@@ -269,6 +270,14 @@ public:
     PODVector<Batch*> sortedBatches_;
     /// Sorted instanced draw calls.
     PODVector<BatchGroup*> sortedBatchGroups_;
+    // ATOMIC BEGIN
+    /// Radix sort work buffers for draw calls.
+    PODVector<RadixSortEntry<Batch*> > batchSortEntries_[2];
+    /// Radix sort work buffers for instanced draw calls.
+    PODVector<RadixSortEntry<BatchGroup*> > batchGroupSortEntries_[2];
+    /// Radix sort work buffers for instances.
+    PODVector<RadixSortEntry<InstanceData> > instanceSortEntries_[2];
+    // ATOMIC END
     /// Maximum sorted instances.
     unsigned maxSortedInstances_;
     /// Whether the pass command contains extra shader defines.
@@ -70,10 +70,15 @@ const char* billboardsStructureElementNames[] =
     0
 };
 
-inline bool CompareBillboards(Billboard* lhs, Billboard* rhs)
+// ATOMIC BEGIN
+/// Convert a sort distance to an unsigned key that orders billboards from back to front.
+inline unsigned long long GetBillboardSortKey(float distance)
 {
-    return lhs->sortDistance_ > rhs->sortDistance_;
+    unsigned bits;
+    memcpy(&bits, &distance, sizeof bits);
+    return (bits & 0x80000000) ? bits : (~bits & 0x7fffffff);
 }
+// ATOMIC END
 
 // ATOMIC BEGIN
 Billboard::Billboard()
@@ -666,7 +671,20 @@ void BillboardSet::UpdateVertexBuffer(const FrameInfo& frame)
 
     if (sorted_)
     {
-        Sort(sortedBillboards_.Begin(), sortedBillboards_.End(), CompareBillboards);
+        // ATOMIC BEGIN
+        // Radix sort on the distance bits, which is linear in the billboard count
+        sortEntries_[0].Resize(enabledBillboards);
+        sortEntries_[1].Resize(enabledBillboards);
+        RadixSortEntry<Billboard*>* entries = sortEntries_[0].Buffer();
+        for (unsigned i = 0; i < enabledBillboards; ++i)
+        {
+            entries[i].key_ = GetBillboardSortKey(sortedBillboards_[i]->sortDistance_);
+            entries[i].value_ = sortedBillboards_[i];
+        }
+        RadixSort(entries, sortEntries_[1].Buffer(), enabledBillboards, 4);
+        for (unsigned i = 0; i < enabledBillboards; ++i)
+            sortedBillboards_[i] = entries[i].value_;
+        // ATOMIC END
         Vector3 worldPos = node_->GetWorldPosition();
         // Store the "last sorted position" now
         previousOffset_ = (worldPos - frame.camera_->GetNode()->GetWorldPosition());
@@ -22,6 +22,9 @@
 
 #pragma once
 
+// ATOMIC BEGIN
+#include "../Container/Sort.h"
+// ATOMIC END
 #include "../Graphics/Drawable.h"
 #include "../IO/VectorBuffer.h"
 #include "../Math/Color.h"
@@ -248,6 +251,10 @@ private:
     Vector3 previousOffset_;
     /// Billboard pointers for sorting.
     Vector<Billboard*> sortedBillboards_;
+    // ATOMIC BEGIN
+    /// Radix sort buffers for the billboard pointers.
+    PODVector<RadixSortEntry<Billboard*> > sortEntries_[2];
+    // ATOMIC END
     /// Attribute buffer for network replication.
     mutable VectorBuffer attrBuffer_;
 };
@@ -30,6 +30,9 @@
 #include "../Graphics/DebugRenderer.h"
 #include "../Graphics/Graphics.h"
 #include "../Graphics/Light.h"
+// ATOMIC BEGIN
+#include "../Graphics/RenderCommandBuffer.h"
+// ATOMIC END
 #include "../Graphics/ShaderVariation.h"
 #include "../Graphics/VertexBuffer.h"
 #include "../Math/Polyhedron.h"
@@ -61,6 +64,9 @@ DebugRenderer::DebugRenderer(Context* context) :
   // ATOMIC END
 {
     vertexBuffer_ = new VertexBuffer(context_);
+    // ATOMIC BEGIN
+    commands_ = new RenderCommandBuffer();
+    // ATOMIC END
 
     SubscribeToEvent(E_ENDFRAME, ATOMIC_HANDLER(DebugRenderer, HandleEndFrame));
 }
@@ -547,56 +553,63 @@ void DebugRenderer::Render()
 
     vertexBuffer_->Unlock();
 
-    graphics->SetBlendMode(lineAntiAlias_ ? BLEND_ALPHA : BLEND_REPLACE);
-    graphics->SetColorWrite(true);
-    graphics->SetCullMode(CULL_NONE);
-    graphics->SetDepthWrite(true);
-    graphics->SetLineAntiAlias(lineAntiAlias_);
-    graphics->SetScissorTest(false);
-    graphics->SetStencilTest(false);
-    graphics->SetShaders(vs, ps);
-    graphics->SetShaderParameter(VSP_MODEL, Matrix3x4::IDENTITY);
-    graphics->SetShaderParameter(VSP_VIEW, view_);
-    graphics->SetShaderParameter(VSP_VIEWINV, view_.Inverse());
-    graphics->SetShaderParameter(VSP_VIEWPROJ, gpuProjection_ * view_);
-    graphics->SetShaderParameter(PSP_MATDIFFCOLOR, Color(1.0f, 1.0f, 1.0f, 1.0f));
-    graphics->SetVertexBuffer(vertexBuffer_);
+    // ATOMIC BEGIN
+    // Record the state and draws, then replay them
+    commands_->Clear();
+
+    commands_->SetBlendMode(lineAntiAlias_ ? BLEND_ALPHA : BLEND_REPLACE);
+    commands_->SetColorWrite(true);
+    commands_->SetCullMode(CULL_NONE);
+    commands_->SetDepthWrite(true);
+    commands_->SetLineAntiAlias(lineAntiAlias_);
+    commands_->SetScissorTest(false);
+    commands_->SetStencilTest(false);
+    commands_->SetShaders(vs, ps);
+    commands_->SetShaderParameter(VSP_MODEL, Matrix3x4::IDENTITY);
+    commands_->SetShaderParameter(VSP_VIEW, view_);
+    commands_->SetShaderParameter(VSP_VIEWINV, view_.Inverse());
+    commands_->SetShaderParameter(VSP_VIEWPROJ, gpuProjection_ * view_);
+    commands_->SetShaderParameter(PSP_MATDIFFCOLOR, Color(1.0f, 1.0f, 1.0f, 1.0f));
+    commands_->SetVertexBuffer(vertexBuffer_);
 
     unsigned start = 0;
     unsigned count = 0;
     if (lines_.Size())
     {
         count = lines_.Size() * 2;
-        graphics->SetDepthTest(CMP_LESSEQUAL);
-        graphics->Draw(LINE_LIST, start, count);
+        commands_->SetDepthTest(CMP_LESSEQUAL);
+        commands_->Draw(LINE_LIST, start, count);
         start += count;
     }
     if (noDepthLines_.Size())
     {
         count = noDepthLines_.Size() * 2;
-        graphics->SetDepthTest(CMP_ALWAYS);
-        graphics->Draw(LINE_LIST, start, count);
+        commands_->SetDepthTest(CMP_ALWAYS);
+        commands_->Draw(LINE_LIST, start, count);
         start += count;
     }
 
-    graphics->SetBlendMode(BLEND_ALPHA);
-    graphics->SetDepthWrite(false);
+    commands_->SetBlendMode(BLEND_ALPHA);
+    commands_->SetDepthWrite(false);
 
     if (triangles_.Size())
     {
         count = triangles_.Size() * 3;
-        graphics->SetDepthTest(CMP_LESSEQUAL);
-        graphics->Draw(TRIANGLE_LIST, start, count);
+        commands_->SetDepthTest(CMP_LESSEQUAL);
+        commands_->Draw(TRIANGLE_LIST, start, count);
         start += count;
     }
     if (noDepthTriangles_.Size())
     {
         count = noDepthTriangles_.Size() * 3;
-        graphics->SetDepthTest(CMP_ALWAYS);
-        graphics->Draw(TRIANGLE_LIST, start, count);
+        commands_->SetDepthTest(CMP_ALWAYS);
+        commands_->Draw(TRIANGLE_LIST, start, count);
     }
 
-    graphics->SetLineAntiAlias(false);
+    commands_->SetLineAntiAlias(false);
+
+    commands_->Execute(graphics);
+    // ATOMIC END
 }
 
 bool DebugRenderer::IsInside(const BoundingBox& box) const
@@ -32,6 +32,9 @@ namespace Atomic
 class BoundingBox;
 class Camera;
 class Polyhedron;
+// ATOMIC BEGIN
+class RenderCommandBuffer;
+// ATOMIC END
 class Drawable;
 class Light;
 class Matrix3x4;
@@ -223,6 +226,9 @@ private:
     /// The amount the scale gets incremented
     int scaleIncrement_;
 
+    /// Render commands for the debug geometry.
+    SharedPtr<RenderCommandBuffer> commands_;
+
     // ATOMIC END
 
 };
@@ -95,6 +95,9 @@ Drawable::Drawable(Context* context, unsigned char drawableFlags) :
     updateQueued_(false),
     zoneDirty_(false),
     octant_(0),
+    // ATOMIC BEGIN
+    bvhProxy_(BVH_NULL_NODE),
+    // ATOMIC END
     zone_(0),
     viewMask_(DEFAULT_VIEWMASK),
     lightMask_(DEFAULT_LIGHTMASK),
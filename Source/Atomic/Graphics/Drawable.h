@@ -113,7 +113,6 @@ class ATOMIC_API Drawable : public Component
 
     friend class Octant;
     friend class Octree;
-    friend void UpdateDrawablesWork(const WorkItem* item, unsigned threadIndex);
 
 public:
     /// Construct.
@@ -349,6 +348,10 @@ protected:
     bool zoneDirty_;
     /// Octree octant.
     Octant* octant_;
+    // ATOMIC BEGIN
+    /// Octree bounding volume hierarchy proxy, or BVH_NULL_NODE if not in one.
+    unsigned bvhProxy_;
+    // ATOMIC END
     /// Current zone.
     Zone* zone_;
     /// View mask.
@@ -0,0 +1,555 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include "../Precompiled.h"
+
+#include "../Graphics/DebugRenderer.h"
+#include "../Graphics/DynamicBVH.h"
+#include "../Graphics/OctreeQuery.h"
+
+#include "../DebugNew.h"
+
+namespace Atomic
+{
+
+/// Leaf bounds enlargement on each side, relative to the drawable's bounding box size.
+static const float BVH_LEAF_MARGIN = 0.1f;
+/// Leaf bounds extension in the direction of movement, relative to the distance moved since the last insertion.
+static const float BVH_DISPLACEMENT_MULTIPLIER = 2.0f;
+/// Traversal stack size. The tree is kept balanced, so its height stays far below this even for millions of leaves.
+static const unsigned BVH_STACK_SIZE = 256;
+/// Number of drawables gathered before passing them to the query in one call.
+static const unsigned BVH_QUERY_BATCH_SIZE = 64;
+
+/// Return surface area of a bounding box, clamped to remain finite for unbounded or undefined boxes.
+static inline float SurfaceArea(const BoundingBox& box)
+{
+    Vector3 size = box.Size();
+    return Clamp(2.0f * (size.x_ * size.y_ + size.y_ * size.z_ + size.z_ * size.x_), 0.0f, M_LARGE_VALUE);
+}
+
+/// Return union of two bounding boxes.
+static inline BoundingBox MergedBox(const BoundingBox& lhs, const BoundingBox& rhs)
+{
+    BoundingBox ret(lhs);
+    ret.Merge(rhs);
+    return ret;
+}
+
+/// Return bounding box enlarged by the leaf margin.
+static inline BoundingBox LooseBox(const BoundingBox& box)
+{
+    Vector3 size = box.Size();
+    Vector3 margin(
+        Clamp(size.x_ * BVH_LEAF_MARGIN, 0.0f, M_LARGE_VALUE),
+        Clamp(size.y_ * BVH_LEAF_MARGIN, 0.0f, M_LARGE_VALUE),
+        Clamp(size.z_ * BVH_LEAF_MARGIN, 0.0f, M_LARGE_VALUE)
+    );
+    return BoundingBox(box.min_ - margin, box.max_ + margin);
+}
+
+/// Drawables gathered for one query call, either fully inside or needing a test of their own.
+class BVHQueryBatch
+{
+public:
+    /// Construct.
+    BVHQueryBatch(OctreeQuery& query, bool inside) :
+        query_(query),
+        inside_(inside),
+        size_(0)
+    {
+    }
+
+    /// Add a drawable and flush when full.
+    void Push(Drawable* drawable)
+    {
+        drawables_[size_++] = drawable;
+        if (size_ == BVH_QUERY_BATCH_SIZE)
+            Flush();
+    }
+
+    /// Pass the gathered drawables to the query.
+    void Flush()
+    {
+        if (size_)
+        {
+            query_.TestDrawables(drawables_, drawables_ + size_, inside_);
+            size_ = 0;
+        }
+    }
+
+private:
+    /// Query.
+    OctreeQuery& query_;
+    /// Inside flag for the query call.
+    bool inside_;
+    /// Number of gathered drawables.
+    unsigned size_;
+    /// Gathered drawables.
+    Drawable* drawables_[BVH_QUERY_BATCH_SIZE];
+};
+
+DynamicBVH::DynamicBVH() :
+    root_(BVH_NULL_NODE),
+    freeList_(BVH_NULL_NODE),
+    numProxies_(0)
+{
+}
+
+unsigned DynamicBVH::CreateProxy(Drawable* drawable, const BoundingBox& box)
+{
+    unsigned proxy = AllocateNode();
+    DynamicBVHNode& node = nodes_[proxy];
+    node.box_ = LooseBox(box);
+    node.drawable_ = drawable;
+    node.height_ = 0;
+
+    InsertLeaf(proxy);
+    ++numProxies_;
+    return proxy;
+}
+
+void DynamicBVH::DestroyProxy(unsigned proxy)
+{
+    assert(proxy < nodes_.Size() && nodes_[proxy].IsLeaf() && nodes_[proxy].height_ == 0);
+
+    RemoveLeaf(proxy);
+    FreeNode(proxy);
+    --numProxies_;
+}
+
+bool DynamicBVH::MoveProxy(unsigned proxy, const BoundingBox& box)
+{
+    assert(proxy < nodes_.Size() && nodes_[proxy].IsLeaf() && nodes_[proxy].height_ == 0);
+
+    // Nothing to do while the drawable stays within the loose bounds
+    if (nodes_[proxy].box_.IsInside(box) == INSIDE)
+        return false;
+
+    // Extend the new loose bounds in the direction of movement, so that steadily moving drawables are reinserted less often
+    BoundingBox looseBox = LooseBox(box);
+    Vector3 displacement = (box.Center() - nodes_[proxy].box_.Center()) * BVH_DISPLACEMENT_MULTIPLIER;
+    if (displacement.Length() < M_LARGE_VALUE)
+    {
+        (displacement.x_ < 0.0f ? looseBox.min_.x_ : looseBox.max_.x_) += displacement.x_;
+        (displacement.y_ < 0.0f ? looseBox.min_.y_ : looseBox.max_.y_) += displacement.y_;
+        (displacement.z_ < 0.0f ? looseBox.min_.z_ : looseBox.max_.z_) += displacement.z_;
+    }
+
+    RemoveLeaf(proxy);
+    nodes_[proxy].box_ = looseBox;
+    InsertLeaf(proxy);
+    return true;
+}
+
+void DynamicBVH::Clear()
+{
+    nodes_.Clear();
+    root_ = BVH_NULL_NODE;
+    freeList_ = BVH_NULL_NODE;
+    numProxies_ = 0;
+}
+
+void DynamicBVH::GetDrawables(OctreeQuery& query) const
+{
+    if (root_ == BVH_NULL_NODE)
+        return;
+
+    BVHQueryBatch insideBatch(query, true);
+    BVHQueryBatch testBatch(query, false);
+
+    // Inside flag is stored in the stack entries' lowest bit
+    unsigned stack[BVH_STACK_SIZE];
+    unsigned stackSize = 0;
+    stack[stackSize++] = root_ << 1;
+
+    while (stackSize)
+    {
+        unsigned entry = stack[--stackSize];
+        const DynamicBVHNode& node = nodes_[entry >> 1];
+        bool inside = (entry & 1) != 0;
+
+        if (node.IsLeaf())
+        {
+            if (inside)
+                insideBatch.Push(node.drawable_);
+            else
+                testBatch.Push(node.drawable_);
+            continue;
+        }
+
+        Intersection res = query.TestOctant(node.box_, inside);
+        if (res == OUTSIDE)
+            continue;
+        if (res == INSIDE)
+            inside = true;
+
+        assert(stackSize + 2 <= BVH_STACK_SIZE);
+        stack[stackSize++] = (node.child2_ << 1) | (inside ? 1 : 0);
+        stack[stackSize++] = (node.child1_ << 1) | (inside ? 1 : 0);
+    }
+
+    insideBatch.Flush();
+    testBatch.Flush();
+}
+
+void DynamicBVH::Raycast(RayOctreeQuery& query) const
+{
+    if (root_ == BVH_NULL_NODE)
+        return;
+
+    unsigned stack[BVH_STACK_SIZE];
+    unsigned stackSize = 0;
+    stack[stackSize++] = root_;
+
+    while (stackSize)
+    {
+        const DynamicBVHNode& node = nodes_[stack[--stackSize]];
+        if (query.ray_.HitDistance(node.box_) >= query.maxDistance_)
+            continue;
+
+        if (node.IsLeaf())
+        {
+            Drawable* drawable = node.drawable_;
+            if ((drawable->GetDrawableFlags() & query.drawableFlags_) && (drawable->GetViewMask() & query.viewMask_))
+                drawable->ProcessRayQuery(query, query.result_);
+            continue;
+        }
+
+        assert(stackSize + 2 <= BVH_STACK_SIZE);
+        stack[stackSize++] = node.child2_;
+        stack[stackSize++] = node.child1_;
+    }
+}
+
+void DynamicBVH::GetDrawablesOnly(RayOctreeQuery& query, PODVector<Drawable*>& drawables) const
+{
+    if (root_ == BVH_NULL_NODE)
+        return;
+
+    unsigned stack[BVH_STACK_SIZE];
+    unsigned stackSize = 0;
+    stack[stackSize++] = root_;
+
+    while (stackSize)
+    {
+        const DynamicBVHNode& node = nodes_[stack[--stackSize]];
+        if (query.ray_.HitDistance(node.box_) >= query.maxDistance_)
+            continue;
+
+        if (node.IsLeaf())
+        {
+            Drawable* drawable = node.drawable_;
+            if ((drawable->GetDrawableFlags() & query.drawableFlags_) && (drawable->GetViewMask() & query.viewMask_))
+                drawables.Push(drawable);
+            continue;
+        }
+
+        assert(stackSize + 2 <= BVH_STACK_SIZE);
+        stack[stackSize++] = node.child2_;
+        stack[stackSize++] = node.child1_;
+    }
+}
+
+void DynamicBVH::GetAllDrawables(PODVector<Drawable*>& drawables) const
+{
+    for (unsigned i = 0; i < nodes_.Size(); ++i)
+    {
+        const DynamicBVHNode& node = nodes_[i];
+        if (node.height_ == 0)
+            drawables.Push(node.drawable_);
+    }
+}
+
+void DynamicBVH::DrawDebugGeometry(DebugRenderer* debug, bool depthTest) const
+{
+    if (!debug)
+        return;
+
+    for (unsigned i = 0; i < nodes_.Size(); ++i)
+    {
+        const DynamicBVHNode& node = nodes_[i];
+        if (node.height_ > 0 && debug->IsInside(node.box_))
+            debug->AddBoundingBox(node.box_, Color(0.25f, 0.25f, 0.25f), depthTest);
+    }
+}
+
+unsigned DynamicBVH::AllocateNode()
+{
+    unsigned index;
+    if (freeList_ != BVH_NULL_NODE)
+    {
+        index = freeList_;
+        freeList_ = nodes_[index].parent_;
+    }
+    else
+    {
+        index = nodes_.Size();
+        nodes_.Resize(index + 1);
+    }
+
+    DynamicBVHNode& node = nodes_[index];
+    node.drawable_ = 0;
+    node.parent_ = BVH_NULL_NODE;
+    node.child1_ = BVH_NULL_NODE;
+    node.child2_ = BVH_NULL_NODE;
+    node.height_ = 0;
+    return index;
+}
+
+void DynamicBVH::FreeNode(unsigned index)
+{
+    DynamicBVHNode& node = nodes_[index];
+    node.drawable_ = 0;
+    node.parent_ = freeList_;
+    node.height_ = -1;
+    freeList_ = index;
+}
+
+void DynamicBVH::InsertLeaf(unsigned leaf)
+{
+    if (root_ == BVH_NULL_NODE)
+    {
+        root_ = leaf;
+        nodes_[leaf].parent_ = BVH_NULL_NODE;
+        return;
+    }
+
+    // Find the best sibling by descending towards the lowest increase of surface area
+    BoundingBox leafBox = nodes_[leaf].box_;
+    unsigned index = root_;
+    while (!nodes_[index].IsLeaf())
+    {
+        const DynamicBVHNode& node = nodes_[index];
+        float area = SurfaceArea(node.box_);
+        float combinedArea = SurfaceArea(MergedBox(node.box_, leafBox));
+
+        // Cost of creating a new parent for this node and the new leaf
+        float cost = 2.0f * combinedArea;
+        // Minimum cost of pushing the leaf further down the tree
+        float inheritanceCost = 2.0f * (combinedArea - area);
+
+        const DynamicBVHNode& child1 = nodes_[node.child1_];
+        float cost1 = SurfaceArea(MergedBox(child1.box_, leafBox)) + inheritanceCost;
+        if (!child1.IsLeaf())
+            cost1 -= SurfaceArea(child1.box_);
+
+        const DynamicBVHNode& child2 = nodes_[node.child2_];
+        float cost2 = SurfaceArea(MergedBox(child2.box_, leafBox)) + inheritanceCost;
+        if (!child2.IsLeaf())
+            cost2 -= SurfaceArea(child2.box_);
+
+        if (cost < cost1 && cost < cost2)
+            break;
+
+        index = cost1 < cost2 ? node.child1_ : node.child2_;
+    }
+
+    unsigned sibling = index;
+
+    // Create a new parent for the sibling and the leaf. Note: allocation may move the node array
+    unsigned newParent = AllocateNode();
+    unsigned oldParent = nodes_[sibling].parent_;
+    DynamicBVHNode& parentNode = nodes_[newParent];
+    parentNode.parent_ = oldParent;
+    parentNode.box_ = MergedBox(leafBox, nodes_[sibling].box_);
+    parentNode.height_ = nodes_[sibling].height_ + 1;
+    parentNode.child1_ = sibling;
+    parentNode.child2_ = leaf;
+
+    if (oldParent != BVH_NULL_NODE)
+    {
+        if (nodes_[oldParent].child1_ == sibling)
+            nodes_[oldParent].child1_ = newParent;
+        else
+            nodes_[oldParent].child2_ = newParent;
+    }
+    else
+        root_ = newParent;
+
+    nodes_[sibling].parent_ = newParent;
+    nodes_[leaf].parent_ = newParent;
+
+    RefitAncestors(nodes_[leaf].parent_);
+}
+
+void DynamicBVH::RemoveLeaf(unsigned leaf)
+{
+    if (leaf == root_)
+    {
+        root_ = BVH_NULL_NODE;
+        return;
+    }
+
+    unsigned parent = nodes_[leaf].parent_;
+    unsigned grandParent = nodes_[parent].parent_;
+    unsigned sibling = nodes_[parent].child1_ == leaf ? nodes_[parent].child2_ : nodes_[parent].child1_;
+
+    // Replace the parent with the sibling
+    if (grandParent != BVH_NULL_NODE)
+    {
+        if (nodes_[grandParent].child1_ == parent)
+            nodes_[grandParent].child1_ = sibling;
+        else
+            nodes_[grandParent].child2_ = sibling;
+        nodes_[sibling].parent_ = grandParent;
+        FreeNode(parent);
+
+        RefitAncestors(grandParent);
+    }
+    else
+    {
+        root_ = sibling;
+        nodes_[sibling].parent_ = BVH_NULL_NODE;
+        FreeNode(parent);
+    }
+
+    nodes_[leaf].parent_ = BVH_NULL_NODE;
+}
+
+void DynamicBVH::RefitAncestors(unsigned index)
+{
+    while (index != BVH_NULL_NODE)
+    {
+        index = Balance(index);
+
+        DynamicBVHNode& node = nodes_[index];
+        const DynamicBVHNode& child1 = nodes_[node.child1_];
+        const DynamicBVHNode& child2 = nodes_[node.child2_];
+        node.height_ = 1 + Max(child1.height_, child2.height_);
+        node.box_ = MergedBox(child1.box_, child2.box_);
+
+        index = node.parent_;
+    }
+}
+
+unsigned DynamicBVH::Balance(unsigned iA)
+{
+    DynamicBVHNode& a = nodes_[iA];
+    if (a.IsLeaf() || a.height_ < 2)
+        return iA;
+
+    unsigned iB = a.child1_;
+    unsigned iC = a.child2_;
+    DynamicBVHNode& b = nodes_[iB];
+    DynamicBVHNode& c = nodes_[iC];
+    int balance = c.height_ - b.height_;
+
+    // Rotate C up
+    if (balance > 1)
+    {
+        unsigned iF = c.child1_;
+        unsigned iG = c.child2_;
+        DynamicBVHNode& f = nodes_[iF];
+        DynamicBVHNode& g = nodes_[iG];
+
+        // Swap A and C
+        c.child1_ = iA;
+        c.parent_ = a.parent_;
+        a.parent_ = iC;
+
+        if (c.parent_ != BVH_NULL_NODE)
+        {
+            if (nodes_[c.parent_].child1_ == iA)
+                nodes_[c.parent_].child1_ = iC;
+            else
+                nodes_[c.parent_].child2_ = iC;
+        }
+        else
+            root_ = iC;
+
+        // Keep the taller of F and G under C
+        if (f.height_ > g.height_)
+        {
+            c.child2_ = iF;
+            a.child2_ = iG;
+            g.parent_ = iA;
+            a.box_ = MergedBox(b.box_, g.box_);
+            c.box_ = MergedBox(a.box_, f.box_);
+            a.height_ = 1 + Max(b.height_, g.height_);
+            c.height_ = 1 + Max(a.height_, f.height_);
+        }
+        else
+        {
+            c.child2_ = iG;
+            a.child2_ = iF;
+            f.parent_ = iA;
+            a.box_ = MergedBox(b.box_, f.box_);
+            c.box_ = MergedBox(a.box_, g.box_);
+            a.height_ = 1 + Max(b.height_, f.height_);
+            c.height_ = 1 + Max(a.height_, g.height_);
+        }
+
+        return iC;
+    }
+
+    // Rotate B up
+    if (balance < -1)
+    {
+        unsigned iD = b.child1_;
+        unsigned iE = b.child2_;
+        DynamicBVHNode& d = nodes_[iD];
+        DynamicBVHNode& e = nodes_[iE];
+
+        // Swap A and B
+        b.child1_ = iA;
+        b.parent_ = a.parent_;
+        a.parent_ = iB;
+
+        if (b.parent_ != BVH_NULL_NODE)
+        {
+            if (nodes_[b.parent_].child1_ == iA)
+                nodes_[b.parent_].child1_ = iB;
+            else
+                nodes_[b.parent_].child2_ = iB;
+        }
+        else
+            root_ = iB;
+
+        // Keep the taller of D and E under B
+        if (d.height_ > e.height_)
+        {
+            b.child2_ = iD;
+            a.child1_ = iE;
+            e.parent_ = iA;
+            a.box_ = MergedBox(c.box_, e.box_);
+            b.box_ = MergedBox(a.box_, d.box_);
+            a.height_ = 1 + Max(c.height_, e.height_);
+            b.height_ = 1 + Max(a.height_, d.height_);
+        }
+        else
+        {
+            b.child2_ = iE;
+            a.child1_ = iD;
+            d.parent_ = iA;
+            a.box_ = MergedBox(c.box_, d.box_);
+            b.box_ = MergedBox(a.box_, e.box_);
+            a.height_ = 1 + Max(c.height_, d.height_);
+            b.height_ = 1 + Max(a.height_, e.height_);
+        }
+
+        return iB;
+    }
+
+    return iA;
+}
+
+}
@@ -0,0 +1,117 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#pragma once
+
+#include "../Container/Vector.h"
+#include "../Math/BoundingBox.h"
+
+namespace Atomic
+{
+
+class DebugRenderer;
+class Drawable;
+class OctreeQuery;
+class RayOctreeQuery;
+
+/// Null node index of the dynamic bounding volume hierarchy.
+static const unsigned BVH_NULL_NODE = M_MAX_UNSIGNED;
+
+/// %Node of the dynamic bounding volume hierarchy. Leaves hold one drawable each.
+struct DynamicBVHNode
+{
+    /// Return whether is a leaf node.
+    bool IsLeaf() const { return child1_ == BVH_NULL_NODE; }
+
+    /// Bounding box. Leaf boxes are enlarged so that small movement does not require reinsertion.
+    BoundingBox box_;
+    /// Drawable for leaf nodes.
+    Drawable* drawable_;
+    /// Parent node, or next free node when on the free list.
+    unsigned parent_;
+    /// First child node.
+    unsigned child1_;
+    /// Second child node.
+    unsigned child2_;
+    /// Height in the tree, leaves are 0 and free nodes -1.
+    int height_;
+};
+
+/// Dynamic bounding volume hierarchy of drawables. Leaves use loose (enlarged) bounds and are only reinserted when the
+/// drawable moves outside them; insertion picks the sibling by surface area and rotations keep the tree balanced.
+class ATOMIC_API DynamicBVH
+{
+public:
+    /// Construct empty.
+    DynamicBVH();
+
+    /// Insert a drawable with its world bounding box and return the proxy (leaf node index).
+    unsigned CreateProxy(Drawable* drawable, const BoundingBox& box);
+    /// Remove a proxy.
+    void DestroyProxy(unsigned proxy);
+    /// Update a proxy's bounding box. Return true if it had to be reinserted, false if the loose bounds still contain it.
+    bool MoveProxy(unsigned proxy, const BoundingBox& box);
+    /// Remove all proxies.
+    void Clear();
+
+    /// Return drawables by a query. Appends to the query result.
+    void GetDrawables(OctreeQuery& query) const;
+    /// Return drawables by a ray query. Appends to the query result.
+    void Raycast(RayOctreeQuery& query) const;
+    /// Return drawables that the ray may hit, without testing them.
+    void GetDrawablesOnly(RayOctreeQuery& query, PODVector<Drawable*>& drawables) const;
+    /// Return all drawables.
+    void GetAllDrawables(PODVector<Drawable*>& drawables) const;
+    /// Draw the internal node bounds to the debug geometry.
+    void DrawDebugGeometry(DebugRenderer* debug, bool depthTest) const;
+
+    /// Return the drawable of a proxy.
+    Drawable* GetDrawable(unsigned proxy) const { return nodes_[proxy].drawable_; }
+    /// Return number of proxies.
+    unsigned GetNumProxies() const { return numProxies_; }
+    /// Return tree height, 0 if empty or a single proxy.
+    unsigned GetHeight() const { return root_ != BVH_NULL_NODE ? (unsigned)nodes_[root_].height_ : 0; }
+
+private:
+    /// Allocate a node from the free list or by growing the node array.
+    unsigned AllocateNode();
+    /// Return a node to the free list.
+    void FreeNode(unsigned index);
+    /// Insert a leaf node.
+    void InsertLeaf(unsigned leaf);
+    /// Remove a leaf node. The node itself is not freed.
+    void RemoveLeaf(unsigned leaf);
+    /// Refit bounds and heights from a node up to the root, rebalancing on the way.
+    void RefitAncestors(unsigned index);
+    /// Rebalance a subtree by rotation if its children's heights differ by more than one. Return the new subtree root.
+    unsigned Balance(unsigned index);
+
+    /// Nodes.
+    PODVector<DynamicBVHNode> nodes_;
+    /// Root node.
+    unsigned root_;
+    /// First free node.
+    unsigned freeList_;
+    /// Number of proxies.
+    unsigned numProxies_;
+};
+
+}
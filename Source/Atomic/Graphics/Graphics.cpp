@@ -44,6 +44,9 @@
 #include "../Graphics/Technique.h"
 #include "../Graphics/Terrain.h"
 #include "../Graphics/TerrainPatch.h"
+// ATOMIC BEGIN
+#include "../Graphics/TerrainStreamer.h"
+// ATOMIC END
 #include "../Graphics/Texture2D.h"
 #include "../Graphics/Texture2DArray.h"
 #include "../Graphics/Texture3D.h"
@@ -268,6 +271,20 @@ void Graphics::PrecacheShaders(Deserializer& source)
     ShaderPrecache::LoadShaders(this, source);
 }
 
+// ATOMIC BEGIN
+
+void Graphics::PrecacheShadersAsync(Deserializer& source, int maxMsPerFrame)
+{
+    shaderPrecompiler_ = new ShaderPrecompiler(context_, source, maxMsPerFrame);
+}
+
+bool Graphics::IsPrecachingShaders() const
+{
+    return shaderPrecompiler_ && !shaderPrecompiler_->IsFinished();
+}
+
+// ATOMIC END
+
 void Graphics::SetShaderCacheDir(const String& path)
 {
     String trimmedPath = path.Trimmed();
@@ -414,6 +431,7 @@ void RegisterGraphicsLibrary(Context* context)
     Text3DFont::RegisterObject(context);
     Text3DText::RegisterObject(context);
     Text3D::RegisterObject(context);
+    TerrainStreamer::RegisterObject(context);
     // ATOMIC END
 }
 
@@ -47,6 +47,9 @@ class GraphicsImpl;
 class RenderSurface;
 class Shader;
 class ShaderPrecache;
+// ATOMIC BEGIN
+class ShaderPrecompiler;
+// ATOMIC END
 class ShaderProgram;
 class ShaderVariation;
 class Texture;
@@ -249,8 +252,12 @@ public:
     void EndDumpShaders();
     /// Precache shader variations from an XML file generated with BeginDumpShaders().
     void PrecacheShaders(Deserializer& source);
-    /// Set shader cache directory, Direct3D only. This can either be an absolute path or a path within the resource system.
+    // ATOMIC BEGIN
+    /// Precache shader variations from an XML file generated with BeginDumpShaders() over several frames, spending at most the given time per frame. The shader source files are loaded in the background.
+    void PrecacheShadersAsync(Deserializer& source, int maxMsPerFrame = 5);
+    /// Set shader cache directory for Direct3D shader bytecode and OpenGL program binaries. This can either be an absolute path or a path within the resource system.
     void SetShaderCacheDir(const String& path);
+    // ATOMIC END
 
     /// Return whether rendering initialized.
     bool IsInitialized() const;
@@ -480,9 +487,18 @@ public:
     /// Return whether a custom clipping plane is in use.
     bool GetUseClipPlane() const { return useClipPlane_; }
 
-    /// Return shader cache directory, Direct3D only.
+    // ATOMIC BEGIN
+    /// Return shader cache directory for Direct3D shader bytecode and OpenGL program binaries.
+    // ATOMIC END
     const String& GetShaderCacheDir() const { return shaderCacheDir_; }
 
+    // ATOMIC BEGIN
+    /// Return whether asynchronous shader precaching is in progress.
+    bool IsPrecachingShaders() const;
+    /// Return the resource name of a shader source file.
+    String GetShaderResourceName(const String& name) const { return shaderPath_ + name + shaderExtension_; }
+    // ATOMIC END
+
     /// Return current rendertarget width and height.
     IntVector2 GetRenderTargetDimensions() const;
 
@@ -803,6 +819,10 @@ private:
     mutable String lastShaderName_;
     /// Shader precache utility.
     SharedPtr<ShaderPrecache> shaderPrecache_;
+    // ATOMIC BEGIN
+    /// Asynchronous shader precompiler.
+    SharedPtr<ShaderPrecompiler> shaderPrecompiler_;
+    // ATOMIC END
     /// Allowed screen orientations.
     String orientations_;
     /// Graphics API name.
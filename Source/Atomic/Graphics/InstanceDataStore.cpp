@@ -0,0 +1,301 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../Precompiled.h"
+
+#include "../Graphics/InstanceDataStore.h"
+#include "../Graphics/Renderer.h"
+#include "../Graphics/VertexBuffer.h"
+#include "../IO/Log.h"
+
+#include "../DebugNew.h"
+
+namespace Atomic
+{
+
+/// Changed slots closer than this to the previous changed range are uploaded together with it.
+static const unsigned DIRTY_MERGE_DISTANCE = 4;
+
+static unsigned GetRangeSizeClass(unsigned capacity)
+{
+    unsigned sizeClass = 0;
+    while (capacity > 1)
+    {
+        capacity >>= 1;
+        ++sizeClass;
+    }
+    return sizeClass;
+}
+
+static inline bool CompareDirtyRanges(const Pair<unsigned, unsigned>& lhs, const Pair<unsigned, unsigned>& rhs)
+{
+    return lhs.first_ < rhs.first_;
+}
+
+InstanceDataStore::InstanceDataStore(Context* context) :
+    Object(context),
+    allocatedSize_(0),
+    frameNumber_(0),
+    numInstances_(0),
+    numUploadedInstances_(0),
+    uploadedBytes_(0),
+    numUploads_(0)
+{
+}
+
+InstanceDataStore::~InstanceDataStore()
+{
+}
+
+bool InstanceDataStore::SetVertexElements(const PODVector<VertexElement>& elements)
+{
+    Clear();
+
+    elements_ = elements;
+    vertexBuffer_ = new VertexBuffer(context_);
+    // The CPU copy is compared against to find the changed instances, and also restores the data on device loss
+    vertexBuffer_->SetShadowed(true);
+    if (!vertexBuffer_->SetSize(INSTANCING_BUFFER_DEFAULT_SIZE, elements_, false))
+    {
+        vertexBuffer_.Reset();
+        return false;
+    }
+
+    memset(vertexBuffer_->GetShadowData(), 0, vertexBuffer_->GetVertexCount() * vertexBuffer_->GetVertexSize());
+    return true;
+}
+
+bool InstanceDataStore::Reserve(unsigned numInstances)
+{
+    if (!vertexBuffer_)
+        return false;
+
+    unsigned oldSize = vertexBuffer_->GetVertexCount();
+    if (numInstances <= oldSize)
+        return true;
+
+    unsigned newSize = INSTANCING_BUFFER_DEFAULT_SIZE;
+    while (newSize < numInstances)
+        newSize <<= 1;
+
+    // Resizing discards the data, so keep a copy of the allocated slots
+    unsigned stride = vertexBuffer_->GetVertexSize();
+    SharedArrayPtr<unsigned char> oldData = vertexBuffer_->GetShadowDataShared();
+
+    if (!vertexBuffer_->SetSize(newSize, elements_, false))
+    {
+        ATOMIC_LOGERROR("Failed to resize instancing buffer to " + String(newSize));
+        // If failed, try to restore the old size and contents
+        vertexBuffer_->SetSize(oldSize, elements_, false);
+        if (vertexBuffer_->GetShadowData())
+        {
+            memcpy(vertexBuffer_->GetShadowData(), oldData.Get(), oldSize * stride);
+            MarkDirty(0, allocatedSize_);
+        }
+        return false;
+    }
+
+    unsigned char* newData = vertexBuffer_->GetShadowData();
+    memcpy(newData, oldData.Get(), allocatedSize_ * stride);
+    memset(newData + allocatedSize_ * stride, 0, (newSize - allocatedSize_) * stride);
+    MarkDirty(0, allocatedSize_);
+
+    ATOMIC_LOGDEBUG("Resized instancing buffer to " + String(newSize));
+    return true;
+}
+
+void InstanceDataStore::BeginFrame(unsigned frameNumber)
+{
+    for (HashMap<InstanceRangeKey, InstanceRange>::Iterator i = ranges_.Begin(); i != ranges_.End();)
+    {
+        if (i->second_.frameNumber_ != frameNumber_)
+        {
+            FreeRange(i->second_);
+            i = ranges_.Erase(i);
+        }
+        else
+            ++i;
+    }
+
+    frameNumber_ = frameNumber;
+    numInstances_ = 0;
+    numUploadedInstances_ = 0;
+    uploadedBytes_ = 0;
+    numUploads_ = 0;
+}
+
+void InstanceDataStore::SetInstancingData(BatchQueue& queue)
+{
+    if (!vertexBuffer_)
+        return;
+
+    for (HashMap<BatchGroupKey, BatchGroup>::Iterator i = queue.batchGroups_.Begin(); i != queue.batchGroups_.End(); ++i)
+    {
+        BatchGroup& group = i->second_;
+
+        // Do not use up buffer space if not going to draw as instanced
+        if (group.geometryType_ != GEOM_INSTANCED)
+            continue;
+
+        unsigned numInstances = group.instances_.Size();
+        InstanceRangeKey key(&queue, i->first_);
+
+        // Reuse the group's range from the previous frames if it is still large enough
+        HashMap<InstanceRangeKey, InstanceRange>::Iterator j = ranges_.Find(key);
+        if (j != ranges_.End() && j->second_.capacity_ < numInstances)
+        {
+            FreeRange(j->second_);
+            ranges_.Erase(j);
+            j = ranges_.End();
+        }
+        if (j == ranges_.End())
+        {
+            InstanceRange range;
+            if (!AllocateRange(numInstances, range))
+                continue;
+            j = ranges_.Insert(MakePair(key, range));
+        }
+
+        InstanceRange& range = j->second_;
+        range.frameNumber_ = frameNumber_;
+        group.startIndex_ = range.start_;
+
+        // Write only the instances that differ from the buffer contents
+        unsigned stride = vertexBuffer_->GetVertexSize();
+        unsigned extraSize = stride - sizeof(Matrix3x4);
+        unsigned char* dest = vertexBuffer_->GetShadowData() + range.start_ * stride;
+
+        for (unsigned k = 0; k < numInstances; ++k)
+        {
+            const InstanceData& instance = group.instances_[k];
+            bool changed = false;
+
+            if (memcmp(dest, instance.worldTransform_, sizeof(Matrix3x4)))
+            {
+                memcpy(dest, instance.worldTransform_, sizeof(Matrix3x4));
+                changed = true;
+            }
+            if (instance.instancingData_ && memcmp(dest + sizeof(Matrix3x4), instance.instancingData_, extraSize))
+            {
+                memcpy(dest + sizeof(Matrix3x4), instance.instancingData_, extraSize);
+                changed = true;
+            }
+
+            if (changed)
+                MarkDirty(range.start_ + k, 1);
+
+            dest += stride;
+        }
+
+        numInstances_ += numInstances;
+    }
+}
+
+void InstanceDataStore::Upload()
+{
+    if (!vertexBuffer_ || dirtyRanges_.Empty())
+        return;
+
+    Sort(dirtyRanges_.Begin(), dirtyRanges_.End(), CompareDirtyRanges);
+
+    unsigned stride = vertexBuffer_->GetVertexSize();
+    unsigned char* data = vertexBuffer_->GetShadowData();
+    unsigned i = 0;
+
+    while (i < dirtyRanges_.Size())
+    {
+        unsigned start = dirtyRanges_[i].first_;
+        unsigned end = dirtyRanges_[i].second_;
+        for (++i; i < dirtyRanges_.Size() && dirtyRanges_[i].first_ <= end + DIRTY_MERGE_DISTANCE; ++i)
+            end = Max(end, dirtyRanges_[i].second_);
+
+        // The data is already in the shadow copy, so this only updates the GPU buffer
+        unsigned count = end - start;
+        vertexBuffer_->SetDataRange(data + start * stride, start, count);
+
+        numUploadedInstances_ += count;
+        uploadedBytes_ += count * stride;
+        ++numUploads_;
+    }
+
+    dirtyRanges_.Clear();
+}
+
+void InstanceDataStore::Clear()
+{
+    ranges_.Clear();
+    freeRanges_.Clear();
+    dirtyRanges_.Clear();
+    allocatedSize_ = 0;
+}
+
+bool InstanceDataStore::AllocateRange(unsigned numInstances, InstanceRange& range)
+{
+    range.capacity_ = NextPowerOfTwo(Max(numInstances, 1U));
+    unsigned sizeClass = GetRangeSizeClass(range.capacity_);
+
+    if (sizeClass < freeRanges_.Size() && freeRanges_[sizeClass].Size())
+    {
+        range.start_ = freeRanges_[sizeClass].Back();
+        freeRanges_[sizeClass].Pop();
+        return true;
+    }
+
+    if (!Reserve(allocatedSize_ + range.capacity_))
+        return false;
+
+    range.start_ = allocatedSize_;
+    allocatedSize_ += range.capacity_;
+    // The GPU buffer contents of never used slots are undefined, while their CPU copy is zero. Upload the whole range once,
+    // as instance data that happens to be zero would otherwise never be detected as changed
+    MarkDirty(range.start_, range.capacity_);
+    return true;
+}
+
+void InstanceDataStore::FreeRange(const InstanceRange& range)
+{
+    unsigned sizeClass = GetRangeSizeClass(range.capacity_);
+    if (freeRanges_.Size() <= sizeClass)
+        freeRanges_.Resize(sizeClass + 1);
+    freeRanges_[sizeClass].Push(range.start_);
+}
+
+void InstanceDataStore::MarkDirty(unsigned start, unsigned count)
+{
+    if (!count)
+        return;
+
+    unsigned end = start + count;
+    if (dirtyRanges_.Size())
+    {
+        Pair<unsigned, unsigned>& last = dirtyRanges_.Back();
+        if (start >= last.first_ && start <= last.second_ + DIRTY_MERGE_DISTANCE)
+        {
+            last.second_ = Max(last.second_, end);
+            return;
+        }
+    }
+
+    dirtyRanges_.Push(MakePair(start, end));
+}
+
+}
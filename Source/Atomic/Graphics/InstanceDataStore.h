@@ -0,0 +1,145 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Container/HashMap.h"
+#include "../Core/Object.h"
+#include "../Graphics/Batch.h"
+#include "../Graphics/GraphicsDefs.h"
+
+namespace Atomic
+{
+
+class VertexBuffer;
+
+/// Identity of a batch group's instance slot range from frame to frame.
+struct InstanceRangeKey
+{
+    /// Construct undefined.
+    InstanceRangeKey()
+    {
+    }
+
+    /// Construct from a batch queue and a batch group key.
+    InstanceRangeKey(const BatchQueue* queue, const BatchGroupKey& group) :
+        queue_(queue),
+        group_(group)
+    {
+    }
+
+    /// Batch queue.
+    const BatchQueue* queue_;
+    /// Batch group key within the queue.
+    BatchGroupKey group_;
+
+    /// Test for equality with another key.
+    bool operator ==(const InstanceRangeKey& rhs) const { return queue_ == rhs.queue_ && group_ == rhs.group_; }
+
+    /// Test for inequality with another key.
+    bool operator !=(const InstanceRangeKey& rhs) const { return queue_ != rhs.queue_ || group_ != rhs.group_; }
+
+    /// Return hash value.
+    unsigned ToHash() const { return (unsigned)((size_t)queue_ / sizeof(BatchQueue)) + group_.ToHash(); }
+};
+
+/// Instance slot range of a batch group.
+struct InstanceRange
+{
+    /// First slot.
+    unsigned start_;
+    /// Number of slots, a power of two.
+    unsigned capacity_;
+    /// Frame number on which the range was last used.
+    unsigned frameNumber_;
+};
+
+/// Persistent instancing vertex buffer. Instanced batch groups keep their slot ranges from frame to frame, the instance data
+/// is compared against a CPU copy of the buffer and only the changed slots are uploaded.
+class ATOMIC_API InstanceDataStore : public Object
+{
+    ATOMIC_OBJECT(InstanceDataStore, Object);
+
+public:
+    /// Construct.
+    InstanceDataStore(Context* context);
+    /// Destruct.
+    virtual ~InstanceDataStore();
+
+    /// Set the instance vertex format and create the vertex buffer. Releases all slot ranges. Return true if successful.
+    bool SetVertexElements(const PODVector<VertexElement>& elements);
+    /// Ensure the buffer holds at least the specified number of instance slots. Return true if successful.
+    bool Reserve(unsigned numInstances);
+    /// Start a new frame. Releases the slot ranges of batch groups that were not drawn on the previous frame and resets the statistics.
+    void BeginFrame(unsigned frameNumber);
+    /// Assign slot ranges to the instanced batch groups of a queue and write their instance data. Groups that do not fit keep
+    /// an undefined start index and are drawn without instancing.
+    void SetInstancingData(BatchQueue& queue);
+    /// Upload the slots changed since the last upload.
+    void Upload();
+    /// Release all slot ranges.
+    void Clear();
+
+    /// Return the vertex buffer.
+    VertexBuffer* GetVertexBuffer() const { return vertexBuffer_; }
+    /// Return number of instances written on this frame.
+    unsigned GetNumInstances() const { return numInstances_; }
+    /// Return number of instances uploaded on this frame.
+    unsigned GetNumUploadedInstances() const { return numUploadedInstances_; }
+    /// Return number of bytes uploaded on this frame.
+    unsigned GetUploadedBytes() const { return uploadedBytes_; }
+    /// Return number of buffer range uploads on this frame.
+    unsigned GetNumUploads() const { return numUploads_; }
+
+private:
+    /// Allocate a slot range. Grows the buffer if necessary. Return true if successful.
+    bool AllocateRange(unsigned numInstances, InstanceRange& range);
+    /// Return a slot range to the free lists.
+    void FreeRange(const InstanceRange& range);
+    /// Mark slots changed.
+    void MarkDirty(unsigned start, unsigned count);
+
+    /// Instance vertex buffer, shadowed in CPU memory.
+    SharedPtr<VertexBuffer> vertexBuffer_;
+    /// Instance vertex elements.
+    PODVector<VertexElement> elements_;
+    /// Slot ranges of batch groups.
+    HashMap<InstanceRangeKey, InstanceRange> ranges_;
+    /// Free range start slots by log2 of the range capacity.
+    Vector<PODVector<unsigned> > freeRanges_;
+    /// Changed slot ranges as begin and end slots.
+    PODVector<Pair<unsigned, unsigned> > dirtyRanges_;
+    /// End of the allocated slots.
+    unsigned allocatedSize_;
+    /// Current frame number.
+    unsigned frameNumber_;
+    /// Instances written on this frame.
+    unsigned numInstances_;
+    /// Instances uploaded on this frame.
+    unsigned numUploadedInstances_;
+    /// Bytes uploaded on this frame.
+    unsigned uploadedBytes_;
+    /// Buffer range uploads on this frame.
+    unsigned numUploads_;
+};
+
+}
@@ -28,6 +28,12 @@
 #include "../Graphics/OcclusionBuffer.h"
 #include "../IO/Log.h"
 
+// ATOMIC BEGIN
+#ifdef ATOMIC_SSE
+#include <emmintrin.h>
+#endif
+// ATOMIC END
+
 #include "../DebugNew.h"
 
 namespace Atomic
@@ -40,12 +46,10 @@ static const unsigned CLIPMASK_Y_NEG = 0x8;
 static const unsigned CLIPMASK_Z_POS = 0x10;
 static const unsigned CLIPMASK_Z_NEG = 0x20;
 
-void DrawOcclusionBatchWork(const WorkItem* item, unsigned threadIndex)
-{
-    OcclusionBuffer* buffer = reinterpret_cast<OcclusionBuffer*>(item->aux_);
-    OcclusionBatch& batch = *reinterpret_cast<OcclusionBatch*>(item->start_);
-    buffer->DrawBatch(batch, threadIndex);
-}
+// ATOMIC BEGIN
+/// Maximum number of depth mip levels built per tile: level N halves the tile rows N + 1 times.
+static const unsigned OCCLUSION_MAX_TILE_MIP_LEVELS = 4;
+// ATOMIC END
 
 OcclusionBuffer::OcclusionBuffer(Context* context) :
     Object(context),
@@ -54,6 +58,10 @@ OcclusionBuffer::OcclusionBuffer(Context* context) :
     numTriangles_(0),
     maxTriangles_(OCCLUSION_DEFAULT_MAX_TRIANGLES),
     cullMode_(CULL_CCW),
+    // ATOMIC BEGIN
+    numTiles_(0),
+    numTileMipLevels_(0),
+    // ATOMIC END
     depthHierarchyDirty_(true),
     reverseCulling_(false),
     nearClip_(0.0f),
@@ -86,18 +94,24 @@ bool OcclusionBuffer::SetSize(int width, int height, bool threaded)
     width_ = width;
     height_ = height;
 
-    // Build work buffers for threading
+    // ATOMIC BEGIN
+    // Build per-thread triangle bins for threading. Tiles are rasterized in parallel directly to the one depth buffer
+    numTiles_ = (unsigned)((height + OCCLUSION_TILE_HEIGHT - 1) / OCCLUSION_TILE_HEIGHT);
     unsigned numThreadBuffers = threaded ? GetSubsystem<WorkQueue>()->GetNumThreads() + 1 : 1;
     buffers_.Resize(numThreadBuffers);
     for (unsigned i = 0; i < numThreadBuffers; ++i)
     {
-        // Reserve extra memory in case 3D clipping is not exact
         OcclusionBufferData& buffer = buffers_[i];
-        buffer.dataWithSafety_ = new int[width * (height + 2) + 2];
-        buffer.data_ = buffer.dataWithSafety_.Get() + width + 1;
-        buffer.used_ = false;
+        buffer.triangles_.Clear();
+        buffer.tileTriangles_.Clear();
+        buffer.tileTriangles_.Resize(numTiles_);
     }
 
+    // Reserve extra memory in case 3D clipping is not exact
+    buffers_[0].dataWithSafety_ = new int[width * (height + 2) + 2];
+    buffers_[0].data_ = buffers_[0].dataWithSafety_.Get() + width + 1;
+    // ATOMIC END
+
     mipBuffers_.Clear();
 
     // Build buffers for mip levels
@@ -112,8 +126,13 @@ bool OcclusionBuffer::SetSize(int width, int height, bool threaded)
             break;
     }
 
+    // ATOMIC BEGIN
+    numTileMipLevels_ = 0;
+
     ATOMIC_LOGDEBUG("Set occlusion buffer size " + String(width_) + "x" + String(height_) + " with " +
-             String(mipBuffers_.Size()) + " mip levels and " + String(numThreadBuffers) + " thread buffers");
+             String(mipBuffers_.Size()) + " mip levels, " + String(numTiles_) + " tiles and " + String(numThreadBuffers) +
+             " thread bins");
+    // ATOMIC END
 
     CalculateViewport();
     return true;
@@ -160,11 +179,12 @@ void OcclusionBuffer::Clear()
 {
     Reset();
 
-    // Only clear the main thread buffer. Rest are cleared on-demand when drawing the first batch
+    // ATOMIC BEGIN
+    // Only the first buffer holds depth values, the rest only bin triangles when threaded
     ClearBuffer(0);
-    for (unsigned i = 1; i < buffers_.Size(); ++i)
-        buffers_[i].used_ = false;
 
+    numTileMipLevels_ = 0;
+    // ATOMIC END
     depthHierarchyDirty_ = true;
 }
 
@@ -212,28 +232,50 @@ void OcclusionBuffer::DrawTriangles()
         for (Vector<OcclusionBatch>::Iterator i = batches_.Begin(); i != batches_.End(); ++i)
             DrawBatch(*i, 0);
 
+        // ATOMIC BEGIN
+        numTileMipLevels_ = 0;
+        // ATOMIC END
         depthHierarchyDirty_ = true;
     }
-    else if (buffers_.Size() > 1)
+    // ATOMIC BEGIN
+    else if (buffers_.Size() > 1 && batches_.Size())
     {
-        // Threaded
+        // Threaded: first transform, clip and bin the triangles to tiles per thread, then rasterize the tiles in
+        // parallel. Tiles do not overlap, so they write to the depth buffer directly without a merge
         WorkQueue* queue = GetSubsystem<WorkQueue>();
 
-        for (Vector<OcclusionBatch>::Iterator i = batches_.Begin(); i != batches_.End(); ++i)
+        for (unsigned i = 0; i < buffers_.Size(); ++i)
         {
-            SharedPtr<WorkItem> item = queue->GetFreeItem();
-            item->priority_ = M_MAX_UNSIGNED;
-            item->workFunction_ = DrawOcclusionBatchWork;
-            item->aux_ = this;
-            item->start_ = &(*i);
-            queue->AddWorkItem(item);
+            OcclusionBufferData& buffer = buffers_[i];
+            buffer.triangles_.Clear();
+            for (unsigned j = 0; j < numTiles_; ++j)
+                buffer.tileTriangles_[j].Clear();
         }
 
-        queue->Complete(M_MAX_UNSIGNED);
+        {
+            ATOMIC_PROFILE(SetupOcclusionTriangles);
+
+            queue->ParallelFor(0, batches_.Size(), 1, [this](unsigned begin, unsigned end, unsigned threadIndex)
+            {
+                for (unsigned i = begin; i < end; ++i)
+                    DrawBatch(batches_[i], threadIndex);
+            });
+        }
+
+        {
+            ATOMIC_PROFILE(RasterizeOcclusionTiles);
+
+            numTileMipLevels_ = Min(OCCLUSION_MAX_TILE_MIP_LEVELS, mipBuffers_.Size());
+            queue->ParallelFor(0, numTiles_, 1, [this](unsigned begin, unsigned end, unsigned threadIndex)
+            {
+                for (unsigned i = begin; i < end; ++i)
+                    DrawTile(i);
+            });
+        }
 
-        MergeBuffers();
         depthHierarchyDirty_ = true;
     }
+    // ATOMIC END
 
     batches_.Clear();
 }
@@ -245,20 +287,44 @@ void OcclusionBuffer::BuildDepthHierarchy()
 
     ATOMIC_PROFILE(BuildDepthHierarchy);
 
-    // Build the first mip level from the pixel-level data
-    int width = (width_ + 1) / 2;
-    int height = (height_ + 1) / 2;
-    if (mipBuffers_.Size())
+    // ATOMIC BEGIN
+    // Levels fully inside the tiles were already built by the tile rasterization, build the rest
+    int height = height_;
+    for (unsigned i = 0; i < mipBuffers_.Size(); ++i)
     {
-        for (int y = 0; y < height; ++y)
+        height = (height + 1) / 2;
+        if (i >= numTileMipLevels_)
+            BuildMipLevel(i, 0, height);
+    }
+    // ATOMIC END
+
+    depthHierarchyDirty_ = false;
+}
+
+// ATOMIC BEGIN
+void OcclusionBuffer::BuildMipLevel(unsigned level, int beginRow, int endRow)
+{
+    int prevWidth = width_;
+    int prevHeight = height_;
+    for (unsigned i = 0; i < level; ++i)
+    {
+        prevWidth = (prevWidth + 1) / 2;
+        prevHeight = (prevHeight + 1) / 2;
+    }
+    int width = (prevWidth + 1) / 2;
+
+    if (!level)
+    {
+        // Build the first mip level from the pixel-level data
+        for (int y = beginRow; y < endRow; ++y)
         {
-            int* src = buffers_[0].data_ + (y * 2) * width_;
+            int* src = buffers_[0].data_ + (y * 2) * prevWidth;
             DepthValue* dest = mipBuffers_[0].Get() + y * width;
             DepthValue* end = dest + width;
 
-            if (y * 2 + 1 < height_)
+            if (y * 2 + 1 < prevHeight)
             {
-                int* src2 = src + width_;
+                int* src2 = src + prevWidth;
                 while (dest < end)
                 {
                     int minUpper = Min(src[0], src[1]);
@@ -286,19 +352,13 @@ void OcclusionBuffer::BuildDepthHierarchy()
             }
         }
     }
-
-    // Build the rest of the mip levels
-    for (unsigned i = 1; i < mipBuffers_.Size(); ++i)
+    else
     {
-        int prevWidth = width;
-        int prevHeight = height;
-        width = (width + 1) / 2;
-        height = (height + 1) / 2;
-
-        for (int y = 0; y < height; ++y)
+        // Build the rest of the mip levels from the previous level
+        for (int y = beginRow; y < endRow; ++y)
         {
-            DepthValue* src = mipBuffers_[i - 1].Get() + (y * 2) * prevWidth;
-            DepthValue* dest = mipBuffers_[i].Get() + y * width;
+            DepthValue* src = mipBuffers_[level - 1].Get() + (y * 2) * prevWidth;
+            DepthValue* dest = mipBuffers_[level].Get() + y * width;
             DepthValue* end = dest + width;
 
             if (y * 2 + 1 < prevHeight)
@@ -331,9 +391,8 @@ void OcclusionBuffer::BuildDepthHierarchy()
             }
         }
     }
-
-    depthHierarchyDirty_ = false;
 }
+// ATOMIC END
 
 void OcclusionBuffer::ResetUseTimer()
 {
@@ -473,13 +532,6 @@ unsigned OcclusionBuffer::GetUseTimer()
 
 void OcclusionBuffer::DrawBatch(const OcclusionBatch& batch, unsigned threadIndex)
 {
-    // If buffer not yet used, clear it
-    if (threadIndex > 0 && !buffers_[threadIndex].used_)
-    {
-        ClearBuffer(threadIndex);
-        buffers_[threadIndex].used_ = true;
-    }
-
     Matrix4 modelViewProj = viewProj_ * batch.model_;
 
     // Theoretical max. amount of vertices if each of the 6 clipping planes doubles the triangle count
@@ -643,7 +695,7 @@ void OcclusionBuffer::DrawTriangle(Vector4* vertices, unsigned threadIndex)
         bool clockwise = SignedArea(projected[0], projected[1], projected[2]) < 0.0f;
         if (cullMode_ == CULL_NONE || (cullMode_ == CULL_CCW && clockwise) || (cullMode_ == CULL_CW && !clockwise))
         {
-            DrawTriangle2D(projected, clockwise, threadIndex);
+            SubmitTriangle2D(projected, clockwise, threadIndex);
             drawOk = true;
         }
     }
@@ -681,7 +733,7 @@ void OcclusionBuffer::DrawTriangle(Vector4* vertices, unsigned threadIndex)
                 bool clockwise = SignedArea(projected[0], projected[1], projected[2]) < 0.0f;
                 if (cullMode_ == CULL_NONE || (cullMode_ == CULL_CCW && clockwise) || (cullMode_ == CULL_CW && !clockwise))
                 {
-                    DrawTriangle2D(projected, clockwise, threadIndex);
+                    SubmitTriangle2D(projected, clockwise, threadIndex);
                     drawOk = true;
                 }
             }
@@ -822,7 +874,123 @@ struct Edge
     int invZStep_;
 };
 
-void OcclusionBuffer::DrawTriangle2D(const Vector3* vertices, bool clockwise, unsigned threadIndex)
+// ATOMIC BEGIN
+static inline void FillSpan(int* dest, int* end, int invZ, int invZStep)
+{
+#ifdef ATOMIC_SSE
+    // Depth test and write four pixels at a time
+    if (end - dest >= 4)
+    {
+        __m128i z = _mm_set_epi32(invZ + 3 * invZStep, invZ + 2 * invZStep, invZ + invZStep, invZ);
+        __m128i zStep = _mm_set1_epi32(4 * invZStep);
+        while (end - dest >= 4)
+        {
+            __m128i depth = _mm_loadu_si128(reinterpret_cast<__m128i*>(dest));
+            __m128i closer = _mm_cmplt_epi32(z, depth);
+            depth = _mm_or_si128(_mm_and_si128(closer, z), _mm_andnot_si128(closer, depth));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), depth);
+            z = _mm_add_epi32(z, zStep);
+            dest += 4;
+        }
+        invZ = _mm_cvtsi128_si32(z);
+    }
+#endif
+
+    while (dest < end)
+    {
+        if (invZ < *dest)
+            *dest = invZ;
+        invZ += invZStep;
+        ++dest;
+    }
+}
+
+static void DrawSpans(int* bufferData, int width, Edge left, int leftStartY, Edge right, int rightStartY, int beginRow,
+    int endRow, int invZStep)
+{
+    if (beginRow >= endRow)
+        return;
+
+    // Advance the edges to the first row to draw
+    int leftSkip = beginRow - leftStartY;
+    left.x_ += leftSkip * left.xStep_;
+    left.invZ_ += leftSkip * left.invZStep_;
+    int rightSkip = beginRow - rightStartY;
+    right.x_ += rightSkip * right.xStep_;
+
+    int* row = bufferData + beginRow * width;
+    int* endRowPtr = bufferData + endRow * width;
+    while (row < endRowPtr)
+    {
+        FillSpan(row + (left.x_ >> 16), row + (right.x_ >> 16), left.invZ_, invZStep);
+
+        left.x_ += left.xStep_;
+        left.invZ_ += left.invZStep_;
+        right.x_ += right.xStep_;
+        row += width;
+    }
+}
+
+void OcclusionBuffer::SubmitTriangle2D(const Vector3* vertices, bool clockwise, unsigned threadIndex)
+{
+    if (buffers_.Size() == 1)
+    {
+        DrawTriangle2D(vertices, clockwise, M_MIN_INT, M_MAX_INT);
+        return;
+    }
+
+    int topY = (int)Min(Min(vertices[0].y_, vertices[1].y_), vertices[2].y_);
+    int bottomY = (int)Max(Max(vertices[0].y_, vertices[1].y_), vertices[2].y_);
+    // Degenerate triangles draw no rows
+    if (topY == bottomY)
+        return;
+
+    OcclusionBufferData& buffer = buffers_[threadIndex];
+    unsigned index = buffer.triangles_.Size();
+    buffer.triangles_.Resize(index + 1);
+    OcclusionTriangle& triangle = buffer.triangles_.Back();
+    triangle.vertices_[0] = vertices[0];
+    triangle.vertices_[1] = vertices[1];
+    triangle.vertices_[2] = vertices[2];
+    triangle.clockwise_ = clockwise;
+
+    int lastTile = (int)numTiles_ - 1;
+    int firstTile = Clamp(topY / OCCLUSION_TILE_HEIGHT, 0, lastTile);
+    int endTile = Clamp((bottomY - 1) / OCCLUSION_TILE_HEIGHT, 0, lastTile);
+    for (int i = firstTile; i <= endTile; ++i)
+        buffer.tileTriangles_[i].Push(index);
+}
+
+void OcclusionBuffer::DrawTile(unsigned tile)
+{
+    // The first and last tiles also cover any rows outside the buffer, like the non-tiled rasterization
+    int minY = tile ? (int)tile * OCCLUSION_TILE_HEIGHT : M_MIN_INT;
+    int maxY = tile < numTiles_ - 1 ? (int)(tile + 1) * OCCLUSION_TILE_HEIGHT : M_MAX_INT;
+
+    for (unsigned i = 0; i < buffers_.Size(); ++i)
+    {
+        const OcclusionBufferData& buffer = buffers_[i];
+        const PODVector<unsigned>& tileTriangles = buffer.tileTriangles_[tile];
+        for (unsigned j = 0; j < tileTriangles.Size(); ++j)
+        {
+            const OcclusionTriangle& triangle = buffer.triangles_[tileTriangles[j]];
+            DrawTriangle2D(triangle.vertices_, triangle.clockwise_, minY, maxY);
+        }
+    }
+
+    // Build the depth mip levels whose rows come only from this tile
+    int beginRow = (int)tile * OCCLUSION_TILE_HEIGHT;
+    int endRow = Min((int)(tile + 1) * OCCLUSION_TILE_HEIGHT, height_);
+    for (unsigned i = 0; i < numTileMipLevels_; ++i)
+    {
+        beginRow >>= 1;
+        endRow = (endRow + 1) >> 1;
+        BuildMipLevel(i, beginRow, endRow);
+    }
+}
+
+void OcclusionBuffer::DrawTriangle2D(const Vector3* vertices, bool clockwise, int minY, int maxY)
+// ATOMIC END
 {
     int top, middle, bottom;
     bool middleIsRight;
@@ -898,124 +1066,29 @@ void OcclusionBuffer::DrawTriangle2D(const Vector3* vertices, bool clockwise, un
     Edge topToBottom(gradients, vertices[top], vertices[bottom], topY);
     Edge middleToBottom(gradients, vertices[middle], vertices[bottom], middleY);
 
-    int* bufferData = buffers_[threadIndex].data_;
+    // ATOMIC BEGIN
+    if (bottomY <= minY || topY >= maxY)
+        return;
+
+    int* bufferData = buffers_[0].data_;
+    int topBegin = Max(topY, minY);
+    int topEnd = Min(middleY, maxY);
+    int bottomBegin = Max(middleY, minY);
+    int bottomEnd = Min(bottomY, maxY);
 
     if (middleIsRight)
     {
-        // Top half
-        int* row = bufferData + topY * width_;
-        int* endRow = bufferData + middleY * width_;
-        while (row < endRow)
-        {
-            int invZ = topToBottom.invZ_;
-            int* dest = row + (topToBottom.x_ >> 16);
-            int* end = row + (topToMiddle.x_ >> 16);
-            while (dest < end)
-            {
-                if (invZ < *dest)
-                    *dest = invZ;
-                invZ += gradients.dInvZdXInt_;
-                ++dest;
-            }
-
-            topToBottom.x_ += topToBottom.xStep_;
-            topToBottom.invZ_ += topToBottom.invZStep_;
-            topToMiddle.x_ += topToMiddle.xStep_;
-            row += width_;
-        }
-
-        // Bottom half
-        row = bufferData + middleY * width_;
-        endRow = bufferData + bottomY * width_;
-        while (row < endRow)
-        {
-            int invZ = topToBottom.invZ_;
-            int* dest = row + (topToBottom.x_ >> 16);
-            int* end = row + (middleToBottom.x_ >> 16);
-            while (dest < end)
-            {
-                if (invZ < *dest)
-                    *dest = invZ;
-                invZ += gradients.dInvZdXInt_;
-                ++dest;
-            }
-
-            topToBottom.x_ += topToBottom.xStep_;
-            topToBottom.invZ_ += topToBottom.invZStep_;
-            middleToBottom.x_ += middleToBottom.xStep_;
-            row += width_;
-        }
+        DrawSpans(bufferData, width_, topToBottom, topY, topToMiddle, topY, topBegin, topEnd, gradients.dInvZdXInt_);
+        DrawSpans(bufferData, width_, topToBottom, topY, middleToBottom, middleY, bottomBegin, bottomEnd,
+            gradients.dInvZdXInt_);
     }
     else
     {
-        // Top half
-        int* row = bufferData + topY * width_;
-        int* endRow = bufferData + middleY * width_;
-        while (row < endRow)
-        {
-            int invZ = topToMiddle.invZ_;
-            int* dest = row + (topToMiddle.x_ >> 16);
-            int* end = row + (topToBottom.x_ >> 16);
-            while (dest < end)
-            {
-                if (invZ < *dest)
-                    *dest = invZ;
-                invZ += gradients.dInvZdXInt_;
-                ++dest;
-            }
-
-            topToMiddle.x_ += topToMiddle.xStep_;
-            topToMiddle.invZ_ += topToMiddle.invZStep_;
-            topToBottom.x_ += topToBottom.xStep_;
-            row += width_;
-        }
-
-        // Bottom half
-        row = bufferData + middleY * width_;
-        endRow = bufferData + bottomY * width_;
-        while (row < endRow)
-        {
-            int invZ = middleToBottom.invZ_;
-            int* dest = row + (middleToBottom.x_ >> 16);
-            int* end = row + (topToBottom.x_ >> 16);
-            while (dest < end)
-            {
-                if (invZ < *dest)
-                    *dest = invZ;
-                invZ += gradients.dInvZdXInt_;
-                ++dest;
-            }
-
-            middleToBottom.x_ += middleToBottom.xStep_;
-            middleToBottom.invZ_ += middleToBottom.invZStep_;
-            topToBottom.x_ += topToBottom.xStep_;
-            row += width_;
-        }
-    }
-}
-
-void OcclusionBuffer::MergeBuffers()
-{
-    ATOMIC_PROFILE(MergeBuffers);
-
-    for (unsigned i = 1; i < buffers_.Size(); ++i)
-    {
-        if (!buffers_[i].used_)
-            continue;
-
-        int* src = buffers_[i].data_;
-        int* dest = buffers_[0].data_;
-        int count = width_ * height_;
-
-        while (count--)
-        {
-            // If thread buffer's depth value is closer, overwrite the original
-            if (*src < *dest)
-                *dest = *src;
-            ++src;
-            ++dest;
-        }
+        DrawSpans(bufferData, width_, topToMiddle, topY, topToBottom, topY, topBegin, topEnd, gradients.dInvZdXInt_);
+        DrawSpans(bufferData, width_, middleToBottom, middleY, topToBottom, topY, bottomBegin, bottomEnd,
+            gradients.dInvZdXInt_);
     }
+    // ATOMIC END
 }
 
 void OcclusionBuffer::ClearBuffer(unsigned threadIndex)
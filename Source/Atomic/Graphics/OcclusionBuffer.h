@@ -48,16 +48,30 @@ struct DepthValue
     int max_;
 };
 
-/// Per-thread occlusion buffer data.
+// ATOMIC BEGIN
+/// Screen-space triangle set up for tiled rasterization.
+struct OcclusionTriangle
+{
+    /// Vertices in viewport coordinates with scaled depth.
+    Vector3 vertices_[3];
+    /// Clockwise winding flag.
+    bool clockwise_;
+};
+
+/// Per-thread occlusion buffer data. Only the first holds depth values; in threaded mode each thread sets up and bins
+/// triangles into its own tile lists, which the tile rasterization then reads.
 struct OcclusionBufferData
 {
     /// Full buffer data with safety padding.
     SharedArrayPtr<int> dataWithSafety_;
     /// Buffer data.
     int* data_;
-    /// Use flag.
-    bool used_;
+    /// Triangles set up by this thread.
+    PODVector<OcclusionTriangle> triangles_;
+    /// Indices of this thread's triangles overlapping each tile.
+    Vector<PODVector<unsigned> > tileTriangles_;
 };
+// ATOMIC END
 
 /// Stored occlusion render job.
 struct OcclusionBatch
@@ -84,6 +98,10 @@ static const float OCCLUSION_RELATIVE_BIAS = 0.00001f;
 static const int OCCLUSION_FIXED_BIAS = 16;
 static const float OCCLUSION_X_SCALE = 65536.0f;
 static const float OCCLUSION_Z_SCALE = 16777216.0f;
+// ATOMIC BEGIN
+/// Height in pixel rows of the tiles rasterized in parallel. Tiles span the full buffer width.
+static const int OCCLUSION_TILE_HEIGHT = 16;
+// ATOMIC END
 
 /// Software renderer for occlusion.
 class ATOMIC_API OcclusionBuffer : public Object
@@ -147,6 +165,11 @@ public:
     /// Return whether is using threads to speed up rendering.
     bool IsThreaded() const { return buffers_.Size() > 1; }
 
+    // ATOMIC BEGIN
+    /// Return number of tiles rasterized in parallel when threaded.
+    unsigned GetNumTiles() const { return numTiles_; }
+    // ATOMIC END
+
     /// Test a bounding box for visibility. For best performance, build depth hierarchy first.
     bool IsVisible(const BoundingBox& worldSpaceBox) const;
     /// Return time since last use in milliseconds.
@@ -154,6 +177,10 @@ public:
 
     /// Draw a batch. Called internally.
     void DrawBatch(const OcclusionBatch& batch, unsigned threadIndex);
+    // ATOMIC BEGIN
+    /// Rasterize the binned triangles of a tile and build the depth mip levels within it. Called internally.
+    void DrawTile(unsigned tile);
+    // ATOMIC END
 
 private:
     /// Apply modelview transform to vertex.
@@ -170,12 +197,16 @@ private:
     void DrawTriangle(Vector4* vertices, unsigned threadIndex);
     /// Clip vertices against a plane.
     void ClipVertices(const Vector4& plane, Vector4* vertices, bool* triangles, unsigned& numTriangles);
-    /// Draw a clipped triangle.
-    void DrawTriangle2D(const Vector3* vertices, bool clockwise, unsigned threadIndex);
+    // ATOMIC BEGIN
+    /// Draw a clipped triangle, or bin it to tiles when threaded.
+    void SubmitTriangle2D(const Vector3* vertices, bool clockwise, unsigned threadIndex);
+    /// Draw a clipped triangle limited to the pixel rows [minY, maxY).
+    void DrawTriangle2D(const Vector3* vertices, bool clockwise, int minY, int maxY);
+    /// Build rows [beginRow, endRow) of a depth mip level from the previous level.
+    void BuildMipLevel(unsigned level, int beginRow, int endRow);
+    // ATOMIC END
     /// Clear a thread work buffer.
     void ClearBuffer(unsigned threadIndex);
-    /// Merge thread work buffers into the first buffer.
-    void MergeBuffers();
 
     /// Highest-level buffer data per thread.
     Vector<OcclusionBufferData> buffers_;
@@ -193,6 +224,12 @@ private:
     unsigned maxTriangles_;
     /// Culling mode.
     CullMode cullMode_;
+    // ATOMIC BEGIN
+    /// Number of tiles.
+    unsigned numTiles_;
+    /// Number of depth mip levels already built by the tile rasterization.
+    unsigned numTileMipLevels_;
+    // ATOMIC END
     /// Depth hierarchy needs update flag.
     bool depthHierarchyDirty_;
     /// Culling reverse flag.
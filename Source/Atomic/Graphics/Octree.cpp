@@ -45,23 +45,18 @@ namespace Atomic
 
 static const float DEFAULT_OCTREE_SIZE = 1000.0f;
 static const int DEFAULT_OCTREE_LEVELS = 8;
+// ATOMIC BEGIN
+static const unsigned DRAWABLES_PER_UPDATE_RANGE = 16;
 
-extern const char* SUBSYSTEM_CATEGORY;
-
-void UpdateDrawablesWork(const WorkItem* item, unsigned threadIndex)
+static const char* spatialIndexNames[] =
 {
-    const FrameInfo& frame = *(reinterpret_cast<FrameInfo*>(item->aux_));
-    Drawable** start = reinterpret_cast<Drawable**>(item->start_);
-    Drawable** end = reinterpret_cast<Drawable**>(item->end_);
+    "Octree",
+    "BVH",
+    0
+};
+// ATOMIC END
 
-    while (start != end)
-    {
-        Drawable* drawable = *start;
-        if (drawable)
-            drawable->Update(frame);
-        ++start;
-    }
-}
+extern const char* SUBSYSTEM_CATEGORY;
 
 inline bool CompareRayQueryResults(const RayQueryResult& lhs, const RayQueryResult& rhs)
 {
@@ -137,6 +132,14 @@ void Octant::DeleteChild(unsigned index)
 
 void Octant::InsertDrawable(Drawable* drawable)
 {
+// ATOMIC BEGIN
+    if (this == root_ && root_->spatialIndex_ == SPATIAL_INDEX_BVH)
+    {
+        root_->InsertDrawableBVH(drawable);
+        return;
+    }
+// ATOMIC END
+
     const BoundingBox& box = drawable->GetWorldBoundingBox();
 
     // If root octant, insert all non-occludees here, so that octant occlusion does not hide the drawable.
@@ -169,6 +172,28 @@ void Octant::InsertDrawable(Drawable* drawable)
     }
 }
 
+// ATOMIC BEGIN
+void Octant::RemoveDrawable(Drawable* drawable, bool resetOctant)
+{
+    // Drawables of a BVH indexed octree live in the hierarchy instead of the root octant's drawable list
+    if (drawable->bvhProxy_ != BVH_NULL_NODE && this == root_)
+    {
+        root_->RemoveDrawableBVH(drawable);
+        if (resetOctant)
+            drawable->SetOctant(0);
+        DecDrawableCount();
+        return;
+    }
+
+    if (drawables_.Remove(drawable))
+    {
+        if (resetOctant)
+            drawable->SetOctant(0);
+        DecDrawableCount();
+    }
+}
+// ATOMIC END
+
 bool Octant::CheckDrawableFit(const BoundingBox& box) const
 {
     Vector3 boxSize = box.Size();
@@ -315,7 +340,10 @@ void Octant::GetDrawablesOnlyInternal(RayOctreeQuery& query, PODVector<Drawable*
 Octree::Octree(Context* context) :
     Component(context),
     Octant(BoundingBox(-DEFAULT_OCTREE_SIZE, DEFAULT_OCTREE_SIZE), 0, 0, this),
-    numLevels_(DEFAULT_OCTREE_LEVELS)
+    numLevels_(DEFAULT_OCTREE_LEVELS),
+    // ATOMIC BEGIN
+    spatialIndex_(SPATIAL_INDEX_OCTREE)
+    // ATOMIC END
 {
     // If the engine is running headless, subscribe to RenderUpdate events for manually updating the octree
     // to allow raycasts and animation update
@@ -327,6 +355,17 @@ Octree::~Octree()
 {
     // Reset root pointer from all child octants now so that they do not move their drawables to root
     drawableUpdates_.Clear();
+// ATOMIC BEGIN
+    // Detach the drawables held by the bounding volume hierarchy
+    PODVector<Drawable*> drawables;
+    bvh_.GetAllDrawables(drawables);
+    for (PODVector<Drawable*>::Iterator i = drawables.Begin(); i != drawables.End(); ++i)
+    {
+        (*i)->SetOctant(0);
+        (*i)->bvhProxy_ = BVH_NULL_NODE;
+    }
+    bvh_.Clear();
+// ATOMIC END
     ResetRoot();
 }
 
@@ -340,6 +379,10 @@ void Octree::RegisterObject(Context* context)
     ATOMIC_ATTRIBUTE("Bounding Box Min", Vector3, worldBoundingBox_.min_, defaultBoundsMin, AM_DEFAULT);
     ATOMIC_ATTRIBUTE("Bounding Box Max", Vector3, worldBoundingBox_.max_, defaultBoundsMax, AM_DEFAULT);
     ATOMIC_ATTRIBUTE("Number of Levels", int, numLevels_, DEFAULT_OCTREE_LEVELS, AM_DEFAULT);
+    // ATOMIC BEGIN
+    ATOMIC_ENUM_ACCESSOR_ATTRIBUTE("Spatial Index", GetSpatialIndex, SetSpatialIndex, OctreeSpatialIndex, spatialIndexNames,
+        SPATIAL_INDEX_OCTREE, AM_DEFAULT);
+    // ATOMIC END
 }
 
 void Octree::OnSetAttribute(const AttributeInfo& attr, const Variant& src)
@@ -356,6 +399,9 @@ void Octree::DrawDebugGeometry(DebugRenderer* debug, bool depthTest)
         ATOMIC_PROFILE(OctreeDrawDebug);
 
         Octant::DrawDebugGeometry(debug, depthTest);
+        // ATOMIC BEGIN
+        bvh_.DrawDebugGeometry(debug, depthTest);
+        // ATOMIC END
     }
 }
 
@@ -368,10 +414,55 @@ void Octree::SetSize(const BoundingBox& box, unsigned numLevels)
         DeleteChild(i);
 
     Initialize(box);
-    numDrawables_ = drawables_.Size();
+    // ATOMIC BEGIN
+    numDrawables_ = drawables_.Size() + bvh_.GetNumProxies();
+    // ATOMIC END
     numLevels_ = Max(numLevels, 1U);
 }
 
+// ATOMIC BEGIN
+void Octree::SetSpatialIndex(OctreeSpatialIndex index)
+{
+    if (index == spatialIndex_)
+        return;
+
+    ATOMIC_PROFILE(ChangeSpatialIndex);
+
+    if (index == SPATIAL_INDEX_BVH)
+    {
+        // Deleting the octants moves their drawables to the root, from where they are inserted to the hierarchy
+        for (unsigned i = 0; i < NUM_OCTANTS; ++i)
+            DeleteChild(i);
+
+        spatialIndex_ = index;
+        PODVector<Drawable*> nonOccludees;
+        for (PODVector<Drawable*>::Iterator i = drawables_.Begin(); i != drawables_.End(); ++i)
+        {
+            if ((*i)->IsOccludee())
+                (*i)->bvhProxy_ = bvh_.CreateProxy(*i, (*i)->GetWorldBoundingBox());
+            else
+                nonOccludees.Push(*i);
+        }
+        drawables_ = nonOccludees;
+    }
+    else
+    {
+        // Move the drawables to the root and queue them for reinsertion to the octants on the next update
+        bvh_.GetAllDrawables(drawables_);
+        bvh_.Clear();
+
+        spatialIndex_ = index;
+        for (PODVector<Drawable*>::Iterator i = drawables_.Begin(); i != drawables_.End(); ++i)
+        {
+            Drawable* drawable = *i;
+            drawable->bvhProxy_ = BVH_NULL_NODE;
+            if (!drawable->updateQueued_)
+                QueueUpdate(drawable);
+        }
+    }
+}
+// ATOMIC END
+
 void Octree::Update(const FrameInfo& frame)
 {
     if (!Thread::IsMainThread())
@@ -380,6 +471,13 @@ void Octree::Update(const FrameInfo& frame)
         return;
     }
 
+// ATOMIC BEGIN
+    // Resolve dirty node transforms in one batched pass, so that drawables read them without lazy recursive updates
+    // from the worker threads
+    if (GetScene())
+        GetScene()->UpdateWorldTransforms();
+// ATOMIC END
+
     // Let drawables update themselves before reinsertion. This can be used for animation
     if (!drawableUpdates_.Empty())
     {
@@ -391,31 +489,25 @@ void Octree::Update(const FrameInfo& frame)
         WorkQueue* queue = GetSubsystem<WorkQueue>();
         scene->BeginThreadedUpdate();
 
-        int numWorkItems = queue->GetNumThreads() + 1; // Worker threads + main thread
-        int drawablesPerItem = Max((int)(drawableUpdates_.Size() / numWorkItems), 1);
-
-        PODVector<Drawable*>::Iterator start = drawableUpdates_.Begin();
-        // Create a work item for each thread
-        for (int i = 0; i < numWorkItems; ++i)
+        // ATOMIC BEGIN
+        PODVector<Drawable*>& drawables = drawableUpdates_;
+        queue->ParallelFor(0, drawables.Size(), DRAWABLES_PER_UPDATE_RANGE, [&drawables, &frame](unsigned begin, unsigned end, unsigned threadIndex)
         {
-            SharedPtr<WorkItem> item = queue->GetFreeItem();
-            item->priority_ = M_MAX_UNSIGNED;
-            item->workFunction_ = UpdateDrawablesWork;
-            item->aux_ = const_cast<FrameInfo*>(&frame);
-
-            PODVector<Drawable*>::Iterator end = drawableUpdates_.End();
-            if (i < numWorkItems - 1 && end - start > drawablesPerItem)
-                end = start + drawablesPerItem;
-
-            item->start_ = &(*start);
-            item->end_ = &(*end);
-            queue->AddWorkItem(item);
-
-            start = end;
-        }
+            for (unsigned i = begin; i < end; ++i)
+            {
+                if (drawables[i])
+                    drawables[i]->Update(frame);
+            }
+        });
+        // ATOMIC END
 
         queue->Complete(M_MAX_UNSIGNED);
         scene->EndThreadedUpdate();
+
+// ATOMIC BEGIN
+        // Drawable updates such as animation may have moved nodes, eg. skeleton bones
+        scene->UpdateWorldTransforms();
+// ATOMIC END
     }
 
     // If any drawables were inserted during threaded update, update them now from the main thread
@@ -464,6 +556,14 @@ void Octree::Update(const FrameInfo& frame)
             // Skip if no octant or does not belong to this octree anymore
             if (!octant || octant->GetRoot() != this)
                 continue;
+// ATOMIC BEGIN
+            // Refit in the bounding volume hierarchy, which reinserts only if the drawable left its loose bounds
+            if (spatialIndex_ == SPATIAL_INDEX_BVH)
+            {
+                InsertDrawableBVH(drawable);
+                continue;
+            }
+// ATOMIC END
             // Skip if still fits the current octant
             if (drawable->IsOccludee() && octant->GetCullingBox().IsInside(box) == INSIDE && octant->CheckDrawableFit(box))
                 continue;
@@ -490,6 +590,14 @@ void Octree::AddManualDrawable(Drawable* drawable)
     if (!drawable || drawable->GetOctant())
         return;
 
+// ATOMIC BEGIN
+    if (spatialIndex_ == SPATIAL_INDEX_BVH)
+    {
+        InsertDrawableBVH(drawable);
+        return;
+    }
+// ATOMIC END
+
     AddDrawable(drawable);
 }
 
@@ -507,6 +615,10 @@ void Octree::GetDrawables(OctreeQuery& query) const
 {
     query.result_.Clear();
     GetDrawablesInternal(query, false);
+// ATOMIC BEGIN
+    if (spatialIndex_ == SPATIAL_INDEX_BVH)
+        bvh_.GetDrawables(query);
+// ATOMIC END
 }
 
 void Octree::Raycast(RayOctreeQuery& query) const
@@ -515,6 +627,10 @@ void Octree::Raycast(RayOctreeQuery& query) const
 
     query.result_.Clear();
     GetDrawablesInternal(query);
+// ATOMIC BEGIN
+    if (spatialIndex_ == SPATIAL_INDEX_BVH)
+        bvh_.Raycast(query);
+// ATOMIC END
     Sort(query.result_.Begin(), query.result_.End(), CompareRayQueryResults);
 }
 
@@ -525,6 +641,10 @@ void Octree::RaycastSingle(RayOctreeQuery& query) const
     query.result_.Clear();
     rayQueryDrawables_.Clear();
     GetDrawablesOnlyInternal(query, rayQueryDrawables_);
+// ATOMIC BEGIN
+    if (spatialIndex_ == SPATIAL_INDEX_BVH)
+        bvh_.GetDrawablesOnly(query, rayQueryDrawables_);
+// ATOMIC END
 
     // Sort by increasing hit distance to AABB
     for (PODVector<Drawable*>::Iterator i = rayQueryDrawables_.Begin(); i != rayQueryDrawables_.End(); ++i)
@@ -603,4 +723,47 @@ void Octree::HandleRenderUpdate(StringHash eventType, VariantMap& eventData)
     Update(frame);
 }
 
+// ATOMIC BEGIN
+void Octree::InsertDrawableBVH(Drawable* drawable)
+{
+    Octant* oldOctant = drawable->octant_;
+    if (oldOctant != this)
+    {
+        // Remove first, as the old octree may hold the drawable's hierarchy proxy
+        if (oldOctant)
+            oldOctant->RemoveDrawable(drawable, false);
+        drawable->SetOctant(this);
+        IncDrawableCount();
+    }
+
+    // Keep non-occludees in the root drawable list, as in octree mode, so that occlusion of hierarchy nodes does not hide them.
+    // The occludee flag can change, so move the drawable between the list and the hierarchy as needed
+    if (!drawable->IsOccludee())
+    {
+        if (drawable->bvhProxy_ != BVH_NULL_NODE)
+        {
+            RemoveDrawableBVH(drawable);
+            drawables_.Push(drawable);
+        }
+        else if (oldOctant != this)
+            drawables_.Push(drawable);
+        return;
+    }
+    if (oldOctant == this && drawable->bvhProxy_ == BVH_NULL_NODE)
+        drawables_.Remove(drawable);
+
+    const BoundingBox& box = drawable->GetWorldBoundingBox();
+    if (drawable->bvhProxy_ == BVH_NULL_NODE)
+        drawable->bvhProxy_ = bvh_.CreateProxy(drawable, box);
+    else
+        bvh_.MoveProxy(drawable->bvhProxy_, box);
+}
+
+void Octree::RemoveDrawableBVH(Drawable* drawable)
+{
+    bvh_.DestroyProxy(drawable->bvhProxy_);
+    drawable->bvhProxy_ = BVH_NULL_NODE;
+}
+// ATOMIC END
+
 }
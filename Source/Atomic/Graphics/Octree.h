@@ -25,6 +25,9 @@
 #include "../Container/List.h"
 #include "../Core/Mutex.h"
 #include "../Graphics/Drawable.h"
+// ATOMIC BEGIN
+#include "../Graphics/DynamicBVH.h"
+// ATOMIC END
 #include "../Graphics/OctreeQuery.h"
 
 namespace Atomic
@@ -35,6 +38,17 @@ class Octree;
 static const int NUM_OCTANTS = 8;
 static const unsigned ROOT_INDEX = M_MAX_UNSIGNED;
 
+// ATOMIC BEGIN
+/// %Octree spatial index backend.
+enum OctreeSpatialIndex
+{
+    /// Octants of fixed subdivision levels. Drawables are reinserted to the octant they fit in whenever they move.
+    SPATIAL_INDEX_OCTREE = 0,
+    /// Dynamic bounding volume hierarchy with loose leaf bounds. Moving drawables are only reinserted when they leave them.
+    SPATIAL_INDEX_BVH
+};
+// ATOMIC END
+
 /// %Octree octant
 class ATOMIC_API Octant
 {
@@ -62,15 +76,9 @@ public:
     }
 
     /// Remove a drawable object from this octant.
-    void RemoveDrawable(Drawable* drawable, bool resetOctant = true)
-    {
-        if (drawables_.Remove(drawable))
-        {
-            if (resetOctant)
-                drawable->SetOctant(0);
-            DecDrawableCount();
-        }
-    }
+    // ATOMIC BEGIN
+    void RemoveDrawable(Drawable* drawable, bool resetOctant = true);
+    // ATOMIC END
 
     /// Return world-space bounding box.
     const BoundingBox& GetWorldBoundingBox() const { return worldBoundingBox_; }
@@ -160,6 +168,9 @@ protected:
 class ATOMIC_API Octree : public Component, public Octant
 {
     friend void RaycastDrawablesWork(const WorkItem* item, unsigned threadIndex);
+    // ATOMIC BEGIN
+    friend class Octant;
+    // ATOMIC END
 
     ATOMIC_OBJECT(Octree, Component);
 
@@ -195,6 +206,13 @@ public:
     /// Return subdivision levels.
     unsigned GetNumLevels() const { return numLevels_; }
 
+    // ATOMIC BEGIN
+    /// Set the spatial index backend. Drawables are moved to the new index.
+    void SetSpatialIndex(OctreeSpatialIndex index);
+    /// Return the spatial index backend.
+    OctreeSpatialIndex GetSpatialIndex() const { return spatialIndex_; }
+    // ATOMIC END
+
     /// Mark drawable object as requiring an update and a reinsertion.
     void QueueUpdate(Drawable* drawable);
     /// Cancel drawable object's update.
@@ -206,6 +224,13 @@ private:
     /// Handle render update in case of headless execution.
     void HandleRenderUpdate(StringHash eventType, VariantMap& eventData);
 
+    // ATOMIC BEGIN
+    /// Insert or update a drawable in the bounding volume hierarchy. Non-occludees go to the root drawable list instead.
+    void InsertDrawableBVH(Drawable* drawable);
+    /// Remove a drawable's bounding volume hierarchy proxy.
+    void RemoveDrawableBVH(Drawable* drawable);
+    // ATOMIC END
+
     /// Drawable objects that require update.
     PODVector<Drawable*> drawableUpdates_;
     /// Drawable objects that were inserted during threaded update phase.
@@ -216,6 +241,12 @@ private:
     mutable PODVector<Drawable*> rayQueryDrawables_;
     /// Subdivision level.
     unsigned numLevels_;
+    // ATOMIC BEGIN
+    /// Spatial index backend.
+    OctreeSpatialIndex spatialIndex_;
+    /// Bounding volume hierarchy of the drawables when using the BVH backend.
+    DynamicBVH bvh_;
+    // ATOMIC END
 };
 
 }
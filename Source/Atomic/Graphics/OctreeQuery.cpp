@@ -100,7 +100,7 @@ Intersection FrustumOctreeQuery::TestOctant(const BoundingBox& box, bool inside)
     if (inside)
         return INSIDE;
     else
-        return frustum_.IsInside(box);
+        return packedFrustum_.IsInside(box);
 }
 
 void FrustumOctreeQuery::TestDrawables(Drawable** start, Drawable** end, bool inside)
@@ -111,7 +111,7 @@ void FrustumOctreeQuery::TestDrawables(Drawable** start, Drawable** end, bool in
 
         if ((drawable->GetDrawableFlags() & drawableFlags_) && (drawable->GetViewMask() & viewMask_))
         {
-            if (inside || frustum_.IsInsideFast(drawable->GetWorldBoundingBox()))
+            if (inside || packedFrustum_.IsInsideFast(drawable->GetWorldBoundingBox()))
                 result_.Push(drawable);
         }
     }
@@ -25,6 +25,9 @@
 #include "../Graphics/Drawable.h"
 #include "../Math/BoundingBox.h"
 #include "../Math/Frustum.h"
+// ATOMIC BEGIN
+#include "../Math/MathSIMD.h"
+// ATOMIC END
 #include "../Math/Ray.h"
 #include "../Math/Sphere.h"
 
@@ -141,7 +144,10 @@ public:
     FrustumOctreeQuery(PODVector<Drawable*>& result, const Frustum& frustum, unsigned char drawableFlags = DRAWABLE_ANY,
         unsigned viewMask = DEFAULT_VIEWMASK) :
         OctreeQuery(result, drawableFlags, viewMask),
-        frustum_(frustum)
+        frustum_(frustum),
+        // ATOMIC BEGIN
+        packedFrustum_(frustum)
+        // ATOMIC END
     {
     }
 
@@ -150,8 +156,12 @@ public:
     /// Intersection test for drawables.
     virtual void TestDrawables(Drawable** start, Drawable** end, bool inside);
 
-    /// Frustum.
-    Frustum frustum_;
+    // ATOMIC BEGIN
+    /// Frustum. Read-only, as the tests use the packed copy made on construction.
+    const Frustum frustum_;
+    /// Frustum planes packed for the octant and drawable tests.
+    const PackedFrustum packedFrustum_;
+    // ATOMIC END
 };
 
 /// General octree query result. Used for Lua bindings only.
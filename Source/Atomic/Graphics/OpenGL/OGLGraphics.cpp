@@ -2824,6 +2824,13 @@ void Graphics::CheckFeatureSupport()
         glGetIntegerv(GL_MAX_COLOR_ATTACHMENTS_EXT, &numSupportedRTs);
     }
 
+    // ATOMIC BEGIN
+    // Check the function pointers, as GLEW may fail to check the extension from a GL3 context
+    impl_->programBinarySupport_ = glGetProgramBinary != 0 && glProgramBinary != 0 && glProgramParameteri != 0;
+    impl_->driverName_ = String((const char*)glGetString(GL_VENDOR)) + " " + String((const char*)glGetString(GL_RENDERER)) + " " +
+        String((const char*)glGetString(GL_VERSION));
+    // ATOMIC END
+
     // Must support 2 rendertargets for light pre-pass, and 4 for deferred
     if (numSupportedRTs >= 2)
         lightPrepassSupport_ = true;
@@ -46,7 +46,10 @@ GraphicsImpl::GraphicsImpl() :
     pixelFormat_(0),
     fboDirty_(false),
     vertexBuffersDirty_(false),
-    shaderProgram_(0)
+    shaderProgram_(0),
+    // ATOMIC BEGIN
+    programBinarySupport_(false)
+    // ATOMIC END
 {
 }
 
@@ -111,6 +111,13 @@ public:
     /// Return the GL Context.
     const SDL_GLContext& GetGLContext() { return context_; }
 
+    // ATOMIC BEGIN
+    /// Return whether linked program binaries can be retrieved and loaded.
+    bool GetProgramBinarySupport() const { return programBinarySupport_; }
+    /// Return the driver identification string used to key the program binary cache.
+    const String& GetDriverName() const { return driverName_; }
+    // ATOMIC END
+
 private:
     /// SDL OpenGL context.
     SDL_GLContext context_;
@@ -162,6 +169,12 @@ private:
     bool vertexBuffersDirty_;
     /// sRGB write mode flag.
     bool sRGBWrite_;
+    // ATOMIC BEGIN
+    /// Program binary support flag.
+    bool programBinarySupport_;
+    /// Driver vendor, renderer and version.
+    String driverName_;
+    // ATOMIC END
 };
 
 }
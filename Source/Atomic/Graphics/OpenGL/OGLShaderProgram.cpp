@@ -25,9 +25,20 @@
 #include "../../Graphics/ConstantBuffer.h"
 #include "../../Graphics/Graphics.h"
 #include "../../Graphics/GraphicsImpl.h"
+// ATOMIC BEGIN
+#include "../../Graphics/Shader.h"
+#include "../../Graphics/ShaderPrecache.h"
+// ATOMIC END
 #include "../../Graphics/ShaderProgram.h"
 #include "../../Graphics/ShaderVariation.h"
+// ATOMIC BEGIN
+#include "../../IO/File.h"
+#include "../../IO/FileSystem.h"
+// ATOMIC END
 #include "../../IO/Log.h"
+// ATOMIC BEGIN
+#include "../../Resource/ResourceCache.h"
+// ATOMIC END
 
 #include "../../DebugNew.h"
 
@@ -128,9 +139,21 @@ bool ShaderProgram::Link()
         return false;
     }
 
-    glAttachShader(object_.name_, vertexShader_->GetGPUObjectName());
-    glAttachShader(object_.name_, pixelShader_->GetGPUObjectName());
-    glLinkProgram(object_.name_);
+    // ATOMIC BEGIN
+    // Use a cached program binary if available to skip linking. Else link and cache the result
+    String binaryFileName = GetBinaryFileName();
+    bool fromBinary = !binaryFileName.Empty() && LoadBinary(binaryFileName);
+    if (!fromBinary)
+    {
+#ifndef GL_ES_VERSION_2_0
+        if (!binaryFileName.Empty())
+            glProgramParameteri(object_.name_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+        glAttachShader(object_.name_, vertexShader_->GetGPUObjectName());
+        glAttachShader(object_.name_, pixelShader_->GetGPUObjectName());
+        glLinkProgram(object_.name_);
+    }
+    // ATOMIC END
 
     int linked, length;
     glGetProgramiv(object_.name_, GL_LINK_STATUS, &linked);
@@ -149,6 +172,11 @@ bool ShaderProgram::Link()
     if (!object_.name_)
         return false;
 
+    // ATOMIC BEGIN
+    if (!fromBinary && !binaryFileName.Empty())
+        SaveBinary(binaryFileName);
+    // ATOMIC END
+
     const int MAX_NAME_LENGTH = 256;
     char nameBuffer[MAX_NAME_LENGTH];
     int attributeCount, uniformCount, elementCount, nameLength;
@@ -324,6 +352,104 @@ bool ShaderProgram::Link()
     return true;
 }
 
+// ATOMIC BEGIN
+
+String ShaderProgram::GetBinaryFileName() const
+{
+#ifndef GL_ES_VERSION_2_0
+    GraphicsImpl* impl = graphics_->GetImpl();
+    const String& cacheDir = graphics_->GetShaderCacheDir();
+    unsigned long long vsSourceHash = vertexShader_->GetSourceHash();
+    unsigned long long psSourceHash = pixelShader_->GetSourceHash();
+    if (!impl->GetProgramBinarySupport() || cacheDir.Empty() || !vsSourceHash || !psSourceHash)
+        return String::EMPTY;
+
+    // The key covers the source code and defines of both shaders, and the driver the binary was produced with
+    return cacheDir + GetShaderProgramCacheKey(vsSourceHash, psSourceHash, impl->GetDriverName()) + ".glp";
+#else
+    return String::EMPTY;
+#endif
+}
+
+bool ShaderProgram::LoadBinary(const String& fileName)
+{
+#ifndef GL_ES_VERSION_2_0
+    ResourceCache* cache = graphics_->GetSubsystem<ResourceCache>();
+    if (!cache->Exists(fileName))
+        return false;
+
+    // A binary of another cache version or key is stale. It is not used, and is overwritten after linking normally
+    SharedPtr<File> file = cache->GetFile(fileName, false);
+    unsigned format;
+    PODVector<unsigned char> data;
+    if (!file || !ReadShaderProgramBinary(*file, GetFileName(fileName), format, data))
+    {
+        ATOMIC_LOGDEBUG("Discarded outdated or invalid program binary " + fileName);
+        return false;
+    }
+
+    // The driver may reject a binary produced by another driver version. In that case the program is linked normally
+    glProgramBinary(object_.name_, format, &data[0], (GLsizei)data.Size());
+    int linked;
+    glGetProgramiv(object_.name_, GL_LINK_STATUS, &linked);
+    if (!linked)
+    {
+        ATOMIC_LOGDEBUG("Discarded outdated program binary " + fileName);
+        return false;
+    }
+
+    ATOMIC_LOGDEBUG("Loaded program binary " + fileName);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ShaderProgram::SaveBinary(const String& fileName)
+{
+#ifndef GL_ES_VERSION_2_0
+    ResourceCache* cache = graphics_->GetSubsystem<ResourceCache>();
+    FileSystem* fileSystem = graphics_->GetSubsystem<FileSystem>();
+
+    // Filename may or may not be inside the resource system
+    String fullName = fileName;
+    if (!IsAbsolutePath(fullName))
+    {
+        // If not absolute, use the resource dir of the vertex shader
+        Shader* owner = vertexShader_->GetOwner();
+        if (!owner)
+            return;
+        String shaderFileName = cache->GetResourceFileName(owner->GetName());
+        if (shaderFileName.Empty())
+            return;
+        fullName = shaderFileName.Substring(0, shaderFileName.Find(owner->GetName())) + fileName;
+    }
+    String path = GetPath(fullName);
+    if (!fileSystem->DirExists(path))
+        fileSystem->CreateDir(path);
+
+    int length = 0;
+    glGetProgramiv(object_.name_, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    SharedArrayPtr<unsigned char> data(new unsigned char[length]);
+    GLsizei written = 0;
+    GLenum format = 0;
+    glGetProgramBinary(object_.name_, length, &written, &format, data.Get());
+    if (written <= 0)
+        return;
+
+    File file(graphics_->GetContext(), fullName, FILE_WRITE);
+    if (!file.IsOpen())
+        return;
+
+    WriteShaderProgramBinary(file, GetFileName(fullName), format, data.Get(), (unsigned)written);
+#endif
+}
+
+// ATOMIC END
+
 ShaderVariation* ShaderProgram::GetVertexShader() const
 {
     return vertexShader_;
@@ -110,6 +110,15 @@ private:
     /// Shader parameter source framenumber.
     unsigned frameNumber_;
 
+    // ATOMIC BEGIN
+    /// Return the program binary cache file name, or empty if the cache is not in use.
+    String GetBinaryFileName() const;
+    /// Load the linked program from a program binary cache file. Return true if successful.
+    bool LoadBinary(const String& fileName);
+    /// Save the linked program to a program binary cache file.
+    void SaveBinary(const String& fileName);
+    // ATOMIC END
+
     /// Global shader parameter source framenumber.
     static unsigned globalFrameNumber;
     /// Remembered global shader parameter sources for constant buffer mode.
@@ -166,6 +166,10 @@ bool ShaderVariation::Create()
     else
         shaderCode += originalShaderCode;
 
+    // ATOMIC BEGIN
+    sourceHash_ = FNV1aHash64(shaderCode.CString(), shaderCode.Length());
+    // ATOMIC END
+
     const char* shaderCStr = shaderCode.CString();
     glShaderSource(object_.name_, 1, &shaderCStr, 0);
     glCompileShader(object_.name_);
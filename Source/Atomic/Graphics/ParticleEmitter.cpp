@@ -32,6 +32,12 @@
 #include "../Scene/Scene.h"
 #include "../Scene/SceneEvents.h"
 
+// ATOMIC BEGIN
+#ifdef ATOMIC_SSE
+#include <emmintrin.h>
+#endif
+// ATOMIC END
+
 #include "../DebugNew.h"
 
 namespace Atomic
@@ -43,6 +49,134 @@ static const unsigned MAX_PARTICLES_IN_FRAME = 100;
 
 extern const char* autoRemoveModeNames[];
 
+// ATOMIC BEGIN
+
+/// Resize a particle array, zero-initializing new elements.
+template <class T> static void ResizeParticleArray(PODVector<T>& values, unsigned num)
+{
+    unsigned oldSize = values.Size();
+    values.Resize(num);
+    for (unsigned i = oldSize; i < num; ++i)
+        values[i] = T();
+}
+
+void ParticleBuffer::Resize(unsigned num)
+{
+    // Pad the integrated arrays so that they can always be processed in groups of four
+    unsigned padded = (num + 3) & ~3U;
+    ResizeParticleArray(velocityX_, padded);
+    ResizeParticleArray(velocityY_, padded);
+    ResizeParticleArray(velocityZ_, padded);
+    ResizeParticleArray(timer_, padded);
+    ResizeParticleArray(timeToLive_, padded);
+    ResizeParticleArray(scale_, padded);
+    ResizeParticleArray(rotationSpeed_, padded);
+    ResizeParticleArray(billboardSize_, num);
+    ResizeParticleArray(colorIndex_, num);
+    ResizeParticleArray(texIndex_, num);
+    ResizeParticleArray(expired_, padded >> 2);
+    size_ = num;
+}
+
+Particle ParticleBuffer::GetParticle(unsigned index) const
+{
+    Particle particle;
+    particle.velocity_ = Vector3(velocityX_[index], velocityY_[index], velocityZ_[index]);
+    particle.size_ = billboardSize_[index];
+    particle.timer_ = timer_[index];
+    particle.timeToLive_ = timeToLive_[index];
+    particle.scale_ = scale_[index];
+    particle.rotationSpeed_ = rotationSpeed_[index];
+    particle.colorIndex_ = colorIndex_[index];
+    particle.texIndex_ = texIndex_[index];
+    return particle;
+}
+
+void ParticleBuffer::SetParticle(unsigned index, const Particle& particle)
+{
+    velocityX_[index] = particle.velocity_.x_;
+    velocityY_[index] = particle.velocity_.y_;
+    velocityZ_[index] = particle.velocity_.z_;
+    billboardSize_[index] = particle.size_;
+    timer_[index] = particle.timer_;
+    timeToLive_[index] = particle.timeToLive_;
+    scale_[index] = particle.scale_;
+    rotationSpeed_[index] = particle.rotationSpeed_;
+    colorIndex_[index] = particle.colorIndex_;
+    texIndex_[index] = particle.texIndex_;
+}
+
+/// Integrate all particles for one time step. Flags the particles whose lifetime had already ended, then advances the
+/// timers, applies the constant and damping forces to the velocities, and optionally updates the size scales.
+static void IntegrateParticles(ParticleBuffer& particles, float timeStep, const Vector3& constantForce, float dampingForce,
+    bool updateScale, float sizeAdd, float sizeMul)
+{
+    const unsigned count = particles.timer_.Size();
+    if (!count)
+        return;
+
+    float* velocityX = &particles.velocityX_[0];
+    float* velocityY = &particles.velocityY_[0];
+    float* velocityZ = &particles.velocityZ_[0];
+    float* timer = &particles.timer_[0];
+    const float* timeToLive = &particles.timeToLive_[0];
+    float* scale = &particles.scale_[0];
+    unsigned char* expired = &particles.expired_[0];
+    const float scaleMul = (timeStep * (sizeMul - 1.0f)) + 1.0f;
+
+#ifdef ATOMIC_SSE
+    const __m128 dt = _mm_set1_ps(timeStep);
+    const __m128 forceX = _mm_set1_ps(constantForce.x_);
+    const __m128 forceY = _mm_set1_ps(constantForce.y_);
+    const __m128 forceZ = _mm_set1_ps(constantForce.z_);
+    const __m128 damping = _mm_set1_ps(-dampingForce);
+    const __m128 add = _mm_set1_ps(timeStep * sizeAdd);
+    const __m128 mul = _mm_set1_ps(scaleMul);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (unsigned i = 0; i < count; i += 4)
+    {
+        __m128 t = _mm_loadu_ps(timer + i);
+        expired[i >> 2] = (unsigned char)_mm_movemask_ps(_mm_cmpge_ps(t, _mm_loadu_ps(timeToLive + i)));
+        _mm_storeu_ps(timer + i, _mm_add_ps(t, dt));
+
+        __m128 vx = _mm_add_ps(_mm_loadu_ps(velocityX + i), _mm_mul_ps(dt, forceX));
+        __m128 vy = _mm_add_ps(_mm_loadu_ps(velocityY + i), _mm_mul_ps(dt, forceY));
+        __m128 vz = _mm_add_ps(_mm_loadu_ps(velocityZ + i), _mm_mul_ps(dt, forceZ));
+        _mm_storeu_ps(velocityX + i, _mm_add_ps(vx, _mm_mul_ps(dt, _mm_mul_ps(damping, vx))));
+        _mm_storeu_ps(velocityY + i, _mm_add_ps(vy, _mm_mul_ps(dt, _mm_mul_ps(damping, vy))));
+        _mm_storeu_ps(velocityZ + i, _mm_add_ps(vz, _mm_mul_ps(dt, _mm_mul_ps(damping, vz))));
+
+        if (updateScale)
+            _mm_storeu_ps(scale + i, _mm_mul_ps(_mm_max_ps(_mm_add_ps(_mm_loadu_ps(scale + i), add), zero), mul));
+    }
+#else
+    for (unsigned i = 0; i < count; i += 4)
+    {
+        unsigned char mask = 0;
+        for (unsigned j = i; j < i + 4; ++j)
+        {
+            if (timer[j] >= timeToLive[j])
+                mask |= 1 << (j - i);
+            timer[j] += timeStep;
+
+            velocityX[j] += timeStep * constantForce.x_;
+            velocityY[j] += timeStep * constantForce.y_;
+            velocityZ[j] += timeStep * constantForce.z_;
+            velocityX[j] += timeStep * (-dampingForce * velocityX[j]);
+            velocityY[j] += timeStep * (-dampingForce * velocityY[j]);
+            velocityZ[j] += timeStep * (-dampingForce * velocityZ[j]);
+
+            if (updateScale)
+                scale[j] = Max(scale[j] + timeStep * sizeAdd, 0.0f) * scaleMul;
+        }
+        expired[i >> 2] = mask;
+    }
+#endif
+}
+
+// ATOMIC END
+
 ParticleEmitter::ParticleEmitter(Context* context) :
     BillboardSet(context),
     periodTimer_(0.0f),
@@ -174,9 +308,19 @@ void ParticleEmitter::Update(const FrameInfo& frame)
     if (scaled_ && !relative_)
         scaleVector = node_->GetWorldScale();
 
+    // ATOMIC BEGIN
+    // Integrate the particle state for all particles at once, then write the results to the enabled billboards
+    float sizeAdd = effect_->GetSizeAdd();
+    float sizeMul = effect_->GetSizeMul();
+    bool updateScale = sizeAdd != 0.0f || sizeMul != 1.0f;
+    IntegrateParticles(particles_, lastTimeStep_, relative_ ? relativeConstantForce : effect_->GetConstantForce(),
+        effect_->GetDampingForce(), updateScale, sizeAdd, sizeMul);
+
+    const Vector<ColorFrame>& colorFrames_ = effect_->GetColorFrames();
+    const Vector<TextureFrame>& textureFrames_ = effect_->GetTextureFrames();
+
     for (unsigned i = 0; i < particles_.Size(); ++i)
     {
-        Particle& particle = particles_[i];
         Billboard& billboard = *billboards_[i];
 
         if (billboard.enabled_)
@@ -184,70 +328,45 @@ void ParticleEmitter::Update(const FrameInfo& frame)
             needCommit = true;
 
             // Time to live
-            if (particle.timer_ >= particle.timeToLive_)
+            if (particles_.expired_[i >> 2] & (1 << (i & 3)))
             {
                 billboard.enabled_ = false;
                 continue;
             }
-            particle.timer_ += lastTimeStep_;
+            float timer = particles_.timer_[i];
 
-            // Velocity & position
-            const Vector3& constantForce = effect_->GetConstantForce();
-            if (constantForce != Vector3::ZERO)
-            {
-                if (relative_)
-                    particle.velocity_ += lastTimeStep_ * relativeConstantForce;
-                else
-                    particle.velocity_ += lastTimeStep_ * constantForce;
-            }
-
-            float dampingForce = effect_->GetDampingForce();
-            if (dampingForce != 0.0f)
-            {
-                Vector3 force = -dampingForce * particle.velocity_;
-                particle.velocity_ += lastTimeStep_ * force;
-            }
-            billboard.position_ += lastTimeStep_ * particle.velocity_ * scaleVector;
-            billboard.direction_ = particle.velocity_.Normalized();
+            // Position
+            Vector3 velocity(particles_.velocityX_[i], particles_.velocityY_[i], particles_.velocityZ_[i]);
+            billboard.position_ += lastTimeStep_ * velocity * scaleVector;
+            billboard.direction_ = velocity.Normalized();
 
             // Rotation
-            billboard.rotation_ += lastTimeStep_ * particle.rotationSpeed_;
+            billboard.rotation_ += lastTimeStep_ * particles_.rotationSpeed_[i];
 
             // Scaling
-            float sizeAdd = effect_->GetSizeAdd();
-            float sizeMul = effect_->GetSizeMul();
-            if (sizeAdd != 0.0f || sizeMul != 1.0f)
-            {
-                particle.scale_ += lastTimeStep_ * sizeAdd;
-                if (particle.scale_ < 0.0f)
-                    particle.scale_ = 0.0f;
-                if (sizeMul != 1.0f)
-                    particle.scale_ *= (lastTimeStep_ * (sizeMul - 1.0f)) + 1.0f;
-                billboard.size_ = particle.size_ * particle.scale_;
-            }
+            if (updateScale)
+                billboard.size_ = particles_.billboardSize_[i] * particles_.scale_[i];
 
             // Color interpolation
-            unsigned& index = particle.colorIndex_;
-            const Vector<ColorFrame>& colorFrames_ = effect_->GetColorFrames();
+            unsigned& index = particles_.colorIndex_[i];
             if (index < colorFrames_.Size())
             {
                 if (index < colorFrames_.Size() - 1)
                 {
-                    if (particle.timer_ >= colorFrames_[index + 1].time_)
+                    if (timer >= colorFrames_[index + 1].time_)
                         ++index;
                 }
                 if (index < colorFrames_.Size() - 1)
-                    billboard.color_ = colorFrames_[index].Interpolate(colorFrames_[index + 1], particle.timer_);
+                    billboard.color_ = colorFrames_[index].Interpolate(colorFrames_[index + 1], timer);
                 else
                     billboard.color_ = colorFrames_[index].color_;
             }
 
             // Texture animation
-            unsigned& texIndex = particle.texIndex_;
-            const Vector<TextureFrame>& textureFrames_ = effect_->GetTextureFrames();
+            unsigned& texIndex = particles_.texIndex_[i];
             if (textureFrames_.Size() && texIndex < textureFrames_.Size() - 1)
             {
-                if (particle.timer_ >= textureFrames_[texIndex + 1].time_)
+                if (timer >= textureFrames_[texIndex + 1].time_)
                 {
                     billboard.uv_ = textureFrames_[texIndex + 1].uv_;
                     ++texIndex;
@@ -255,6 +374,7 @@ void ParticleEmitter::Update(const FrameInfo& frame)
             }
         }
     }
+    // ATOMIC END
 
     if (needCommit)
         Commit();
@@ -373,17 +493,21 @@ void ParticleEmitter::SetParticlesAttr(const VariantVector& value)
     unsigned index = 0;
     SetNumParticles(index < value.Size() ? value[index++].GetUInt() : 0);
 
-    for (PODVector<Particle>::Iterator i = particles_.Begin(); i != particles_.End() && index < value.Size(); ++i)
+    // ATOMIC BEGIN
+    for (unsigned i = 0; i < particles_.Size() && index < value.Size(); ++i)
     {
-        i->velocity_ = value[index++].GetVector3();
-        i->size_ = value[index++].GetVector2();
-        i->timer_ = value[index++].GetFloat();
-        i->timeToLive_ = value[index++].GetFloat();
-        i->scale_ = value[index++].GetFloat();
-        i->rotationSpeed_ = value[index++].GetFloat();
-        i->colorIndex_ = (unsigned)value[index++].GetInt();
-        i->texIndex_ = (unsigned)value[index++].GetInt();
+        Particle particle;
+        particle.velocity_ = value[index++].GetVector3();
+        particle.size_ = value[index++].GetVector2();
+        particle.timer_ = value[index++].GetFloat();
+        particle.timeToLive_ = value[index++].GetFloat();
+        particle.scale_ = value[index++].GetFloat();
+        particle.rotationSpeed_ = value[index++].GetFloat();
+        particle.colorIndex_ = (unsigned)value[index++].GetInt();
+        particle.texIndex_ = (unsigned)value[index++].GetInt();
+        particles_.SetParticle(i, particle);
     }
+    // ATOMIC END
 }
 
 VariantVector ParticleEmitter::GetParticlesAttr() const
@@ -397,17 +521,20 @@ VariantVector ParticleEmitter::GetParticlesAttr() const
 
     ret.Reserve(particles_.Size() * 8 + 1);
     ret.Push(particles_.Size());
-    for (PODVector<Particle>::ConstIterator i = particles_.Begin(); i != particles_.End(); ++i)
+    // ATOMIC BEGIN
+    for (unsigned i = 0; i < particles_.Size(); ++i)
     {
-        ret.Push(i->velocity_);
-        ret.Push(i->size_);
-        ret.Push(i->timer_);
-        ret.Push(i->timeToLive_);
-        ret.Push(i->scale_);
-        ret.Push(i->rotationSpeed_);
-        ret.Push(i->colorIndex_);
-        ret.Push(i->texIndex_);
+        Particle particle = particles_.GetParticle(i);
+        ret.Push(particle.velocity_);
+        ret.Push(particle.size_);
+        ret.Push(particle.timer_);
+        ret.Push(particle.timeToLive_);
+        ret.Push(particle.scale_);
+        ret.Push(particle.rotationSpeed_);
+        ret.Push(particle.colorIndex_);
+        ret.Push(particle.texIndex_);
     }
+    // ATOMIC END
     return ret;
 }
 
@@ -453,7 +580,9 @@ bool ParticleEmitter::EmitNewParticle()
     if (index == M_MAX_UNSIGNED)
         return false;
     assert(index < particles_.Size());
-    Particle& particle = particles_[index];
+    // ATOMIC BEGIN
+    Particle particle;
+    // ATOMIC END
     Billboard* billboard = billboards_[index];
 
     Vector3 startDir;
@@ -508,9 +637,12 @@ bool ParticleEmitter::EmitNewParticle()
     };
 
     particle.velocity_ = effect_->GetRandomVelocity() * startDir;
+    // ATOMIC BEGIN
+    particles_.SetParticle(index, particle);
+    // ATOMIC END
 
     billboard->position_ = startPos;
-    billboard->size_ = particles_[index].size_;
+    billboard->size_ = particle.size_;
     const Vector<TextureFrame>& textureFrames_ = effect_->GetTextureFrames();
     billboard->uv_ = textureFrames_.Size() ? textureFrames_[0].uv_ : Rect::POSITIVE;
     billboard->rotation_ = effect_->GetRandomRotation();
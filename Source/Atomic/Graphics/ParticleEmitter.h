@@ -50,6 +50,55 @@ struct Particle
     unsigned texIndex_;
 };
 
+// ATOMIC BEGIN
+
+/// %Particle state stored in structure-of-arrays form, so that the per-frame integration can process four particles at
+/// once. The float arrays are padded to a multiple of four.
+struct ATOMIC_API ParticleBuffer
+{
+    /// Construct empty.
+    ParticleBuffer() :
+        size_(0)
+    {
+    }
+
+    /// Set number of particles. New particles are zero-initialized.
+    void Resize(unsigned num);
+    /// Return particle at index.
+    Particle GetParticle(unsigned index) const;
+    /// Set particle at index.
+    void SetParticle(unsigned index, const Particle& particle);
+    /// Return number of particles.
+    unsigned Size() const { return size_; }
+
+    /// Velocity X components.
+    PODVector<float> velocityX_;
+    /// Velocity Y components.
+    PODVector<float> velocityY_;
+    /// Velocity Z components.
+    PODVector<float> velocityZ_;
+    /// Times elapsed from creation.
+    PODVector<float> timer_;
+    /// Lifetimes.
+    PODVector<float> timeToLive_;
+    /// Size scaling values.
+    PODVector<float> scale_;
+    /// Rotation speeds.
+    PODVector<float> rotationSpeed_;
+    /// Original billboard sizes.
+    PODVector<Vector2> billboardSize_;
+    /// Current color animation indices.
+    PODVector<unsigned> colorIndex_;
+    /// Current texture animation indices.
+    PODVector<unsigned> texIndex_;
+    /// Expiry flags of the last integration, one bit per particle and one byte per group of four.
+    PODVector<unsigned char> expired_;
+    /// Number of particles.
+    unsigned size_;
+};
+
+// ATOMIC END
+
 /// %Particle emitter component.
 class ATOMIC_API ParticleEmitter : public BillboardSet
 {
@@ -132,8 +181,10 @@ private:
 
     /// Particle effect.
     SharedPtr<ParticleEffect> effect_;
+    // ATOMIC BEGIN
     /// Particles.
-    PODVector<Particle> particles_;
+    ParticleBuffer particles_;
+    // ATOMIC END
     /// Active/inactive period timer.
     float periodTimer_;
     /// New particle emission timer.
@@ -0,0 +1,592 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../Precompiled.h"
+
+#include "../Graphics/Graphics.h"
+#include "../Graphics/RenderCommandBuffer.h"
+
+#include "../DebugNew.h"
+
+namespace Atomic
+{
+
+/// Return number of primitives drawn from an element count.
+static unsigned GetPrimitiveCount(PrimitiveType type, unsigned elementCount)
+{
+    switch (type)
+    {
+    case TRIANGLE_LIST:
+        return elementCount / 3;
+
+    case LINE_LIST:
+        return elementCount / 2;
+
+    case TRIANGLE_STRIP:
+    case TRIANGLE_FAN:
+        return elementCount > 2 ? elementCount - 2 : 0;
+
+    case LINE_STRIP:
+        return elementCount > 1 ? elementCount - 1 : 0;
+
+    default:
+        return elementCount;
+    }
+}
+
+/// Reinterpret a float as unsigned for storing in the command arguments.
+static unsigned FloatBits(float value)
+{
+    unsigned bits;
+    memcpy(&bits, &value, sizeof bits);
+    return bits;
+}
+
+/// Reinterpret a command argument as float.
+static float BitsToFloat(unsigned value)
+{
+    float result;
+    memcpy(&result, &value, sizeof result);
+    return result;
+}
+
+RenderCommandBuffer::RenderCommandBuffer() :
+    numRedundantCommands_(0)
+{
+    ResetState();
+}
+
+RenderCommandBuffer::~RenderCommandBuffer()
+{
+}
+
+void RenderCommandBuffer::Clear()
+{
+    commands_.Clear();
+    parameterData_.Clear();
+    vertexBufferLists_.Clear();
+    numRedundantCommands_ = 0;
+    ResetState();
+}
+
+void RenderCommandBuffer::ResetState()
+{
+    for (unsigned i = 0; i < MAX_RENDER_COMMAND_TYPES; ++i)
+        stateValid_[i] = false;
+    for (unsigned i = 0; i < MAX_TEXTURE_UNITS; ++i)
+    {
+        textures_[i] = 0;
+        texturesValid_[i] = false;
+    }
+    vertexShader_ = 0;
+    pixelShader_ = 0;
+    vertexBuffer_ = 0;
+    indexBuffer_ = 0;
+    parameters_.Clear();
+}
+
+void RenderCommandBuffer::SetShaders(ShaderVariation* vs, ShaderVariation* ps)
+{
+    if (stateValid_[RCMD_SHADERS] && vs == vertexShader_ && ps == pixelShader_)
+    {
+        ++numRedundantCommands_;
+        return;
+    }
+
+    stateValid_[RCMD_SHADERS] = true;
+    vertexShader_ = vs;
+    pixelShader_ = ps;
+    // Parameters are set to the shader program in use, so they must be recorded again after a shader change
+    parameters_.Clear();
+
+    RenderCommand& command = AddCommand(RCMD_SHADERS);
+    command.shaders_[0] = vs;
+    command.shaders_[1] = ps;
+}
+
+void RenderCommandBuffer::SetBlendMode(BlendMode mode, bool alphaToCoverage)
+{
+    unsigned args[] = { (unsigned)mode, alphaToCoverage ? 1U : 0U };
+    AddStateCommand(RCMD_BLENDMODE, args, 2);
+}
+
+void RenderCommandBuffer::SetColorWrite(bool enable)
+{
+    unsigned args[] = { enable ? 1U : 0U };
+    AddStateCommand(RCMD_COLORWRITE, args, 1);
+}
+
+void RenderCommandBuffer::SetCullMode(CullMode mode)
+{
+    unsigned args[] = { (unsigned)mode };
+    AddStateCommand(RCMD_CULLMODE, args, 1);
+}
+
+void RenderCommandBuffer::SetDepthBias(float constantBias, float slopeScaledBias)
+{
+    unsigned args[] = { FloatBits(constantBias), FloatBits(slopeScaledBias) };
+    AddStateCommand(RCMD_DEPTHBIAS, args, 2);
+}
+
+void RenderCommandBuffer::SetDepthTest(CompareMode mode)
+{
+    unsigned args[] = { (unsigned)mode };
+    AddStateCommand(RCMD_DEPTHTEST, args, 1);
+}
+
+void RenderCommandBuffer::SetDepthWrite(bool enable)
+{
+    unsigned args[] = { enable ? 1U : 0U };
+    AddStateCommand(RCMD_DEPTHWRITE, args, 1);
+}
+
+void RenderCommandBuffer::SetFillMode(FillMode mode)
+{
+    unsigned args[] = { (unsigned)mode };
+    AddStateCommand(RCMD_FILLMODE, args, 1);
+}
+
+void RenderCommandBuffer::SetLineAntiAlias(bool enable)
+{
+    unsigned args[] = { enable ? 1U : 0U };
+    AddStateCommand(RCMD_LINEANTIALIAS, args, 1);
+}
+
+void RenderCommandBuffer::SetScissorTest(bool enable, const IntRect& rect)
+{
+    // The rectangle does not matter when the test is disabled
+    IntRect scissorRect = enable ? rect : IntRect::ZERO;
+    unsigned args[] = { enable ? 1U : 0U, (unsigned)scissorRect.left_, (unsigned)scissorRect.top_, (unsigned)scissorRect.right_,
+        (unsigned)scissorRect.bottom_ };
+    AddStateCommand(RCMD_SCISSORTEST, args, 5);
+}
+
+void RenderCommandBuffer::SetStencilTest(bool enable, CompareMode mode, StencilOp pass, StencilOp fail, StencilOp zFail,
+    unsigned stencilRef, unsigned compareMask, unsigned writeMask)
+{
+    unsigned args[] = { enable ? 1U : 0U, (unsigned)mode, (unsigned)pass, (unsigned)fail, (unsigned)zFail, stencilRef, compareMask,
+        writeMask };
+    AddStateCommand(RCMD_STENCILTEST, args, 8);
+}
+
+void RenderCommandBuffer::SetTexture(unsigned index, Texture* texture)
+{
+    if (index >= MAX_TEXTURE_UNITS)
+        return;
+
+    if (texturesValid_[index] && textures_[index] == texture)
+    {
+        ++numRedundantCommands_;
+        return;
+    }
+
+    texturesValid_[index] = true;
+    textures_[index] = texture;
+
+    RenderCommand& command = AddCommand(RCMD_TEXTURE);
+    command.texture_ = texture;
+    command.args_[0] = index;
+}
+
+void RenderCommandBuffer::SetVertexBuffer(VertexBuffer* buffer)
+{
+    RenderCommand* command = AddBindCommand(RCMD_VERTEXBUFFER, vertexBuffer_, buffer);
+    if (command)
+        command->vertexBuffer_ = buffer;
+}
+
+void RenderCommandBuffer::SetVertexBuffers(const PODVector<VertexBuffer*>& buffers, unsigned instanceOffset)
+{
+    // The single vertex buffer state is unknown after binding a list
+    stateValid_[RCMD_VERTEXBUFFER] = false;
+
+    RenderCommand& command = AddCommand(RCMD_VERTEXBUFFERS);
+    command.args_[0] = vertexBufferLists_.Size();
+    command.args_[1] = buffers.Size();
+    command.args_[2] = instanceOffset;
+    vertexBufferLists_.Push(buffers);
+}
+
+void RenderCommandBuffer::SetIndexBuffer(IndexBuffer* buffer)
+{
+    RenderCommand* command = AddBindCommand(RCMD_INDEXBUFFER, indexBuffer_, buffer);
+    if (command)
+        command->indexBuffer_ = buffer;
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, const float* data, unsigned count)
+{
+    AddParameter(param, VAR_BUFFER, data, count);
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, float value)
+{
+    AddParameter(param, VAR_FLOAT, &value, 1);
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, int value)
+{
+    AddParameter(param, VAR_INT, (const float*)&value, 1);
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, bool value)
+{
+    int intValue = value ? 1 : 0;
+    AddParameter(param, VAR_BOOL, (const float*)&intValue, 1);
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, const Color& color)
+{
+    AddParameter(param, VAR_COLOR, color.Data(), 4);
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, const Vector2& vector)
+{
+    AddParameter(param, VAR_VECTOR2, vector.Data(), 2);
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, const Matrix3& matrix)
+{
+    AddParameter(param, VAR_MATRIX3, matrix.Data(), 9);
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, const Vector3& vector)
+{
+    AddParameter(param, VAR_VECTOR3, vector.Data(), 3);
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, const Matrix4& matrix)
+{
+    AddParameter(param, VAR_MATRIX4, matrix.Data(), 16);
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, const Vector4& vector)
+{
+    AddParameter(param, VAR_VECTOR4, vector.Data(), 4);
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, const Matrix3x4& matrix)
+{
+    AddParameter(param, VAR_MATRIX3X4, matrix.Data(), 12);
+}
+
+void RenderCommandBuffer::Draw(PrimitiveType type, unsigned vertexStart, unsigned vertexCount)
+{
+    if (!vertexCount)
+        return;
+
+    RenderCommand& command = AddCommand(RCMD_DRAW);
+    command.args_[0] = type;
+    command.args_[1] = vertexStart;
+    command.args_[2] = vertexCount;
+}
+
+void RenderCommandBuffer::Draw(PrimitiveType type, unsigned indexStart, unsigned indexCount, unsigned minVertex, unsigned vertexCount)
+{
+    if (!indexCount)
+        return;
+
+    RenderCommand& command = AddCommand(RCMD_DRAWINDEXED);
+    command.args_[0] = type;
+    command.args_[1] = indexStart;
+    command.args_[2] = indexCount;
+    command.args_[3] = minVertex;
+    command.args_[4] = vertexCount;
+}
+
+void RenderCommandBuffer::DrawInstanced(PrimitiveType type, unsigned indexStart, unsigned indexCount, unsigned minVertex,
+    unsigned vertexCount, unsigned instanceCount)
+{
+    if (!indexCount || !instanceCount)
+        return;
+
+    RenderCommand& command = AddCommand(RCMD_DRAWINSTANCED);
+    command.args_[0] = type;
+    command.args_[1] = indexStart;
+    command.args_[2] = indexCount;
+    command.args_[3] = minVertex;
+    command.args_[4] = vertexCount;
+    command.args_[5] = instanceCount;
+}
+
+RenderCommandStats RenderCommandBuffer::Execute(Graphics* graphics) const
+{
+    RenderCommandStats stats;
+    PODVector<VertexBuffer*> vertexBuffers;
+
+    for (PODVector<RenderCommand>::ConstIterator i = commands_.Begin(); i != commands_.End(); ++i)
+    {
+        const RenderCommand& command = *i;
+        const unsigned* args = command.args_;
+
+        switch (command.type_)
+        {
+        case RCMD_SHADERPARAMETER:
+            ++stats.numParameterCommands_;
+            break;
+
+        case RCMD_DRAW:
+        case RCMD_DRAWINDEXED:
+            ++stats.numDrawCommands_;
+            stats.numPrimitives_ += GetPrimitiveCount((PrimitiveType)args[0], args[2]);
+            break;
+
+        case RCMD_DRAWINSTANCED:
+            ++stats.numDrawCommands_;
+            stats.numPrimitives_ += GetPrimitiveCount((PrimitiveType)args[0], args[2]) * args[5];
+            break;
+
+        default:
+            ++stats.numStateCommands_;
+            break;
+        }
+
+        // Without graphics, only gather the statistics
+        if (!graphics)
+            continue;
+
+        switch (command.type_)
+        {
+        case RCMD_SHADERS:
+            graphics->SetShaders(command.shaders_[0], command.shaders_[1]);
+            break;
+
+        case RCMD_BLENDMODE:
+            graphics->SetBlendMode((BlendMode)args[0], args[1] != 0);
+            break;
+
+        case RCMD_COLORWRITE:
+            graphics->SetColorWrite(args[0] != 0);
+            break;
+
+        case RCMD_CULLMODE:
+            graphics->SetCullMode((CullMode)args[0]);
+            break;
+
+        case RCMD_DEPTHBIAS:
+            graphics->SetDepthBias(BitsToFloat(args[0]), BitsToFloat(args[1]));
+            break;
+
+        case RCMD_DEPTHTEST:
+            graphics->SetDepthTest((CompareMode)args[0]);
+            break;
+
+        case RCMD_DEPTHWRITE:
+            graphics->SetDepthWrite(args[0] != 0);
+            break;
+
+        case RCMD_FILLMODE:
+            graphics->SetFillMode((FillMode)args[0]);
+            break;
+
+        case RCMD_LINEANTIALIAS:
+            graphics->SetLineAntiAlias(args[0] != 0);
+            break;
+
+        case RCMD_SCISSORTEST:
+            graphics->SetScissorTest(args[0] != 0, IntRect((int)args[1], (int)args[2], (int)args[3], (int)args[4]));
+            break;
+
+        case RCMD_STENCILTEST:
+            graphics->SetStencilTest(args[0] != 0, (CompareMode)args[1], (StencilOp)args[2], (StencilOp)args[3], (StencilOp)args[4],
+                args[5], args[6], args[7]);
+            break;
+
+        case RCMD_TEXTURE:
+            graphics->SetTexture(args[0], command.texture_);
+            break;
+
+        case RCMD_VERTEXBUFFER:
+            graphics->SetVertexBuffer(command.vertexBuffer_);
+            break;
+
+        case RCMD_VERTEXBUFFERS:
+            vertexBuffers.Resize(args[1]);
+            for (unsigned j = 0; j < args[1]; ++j)
+                vertexBuffers[j] = vertexBufferLists_[args[0] + j];
+            graphics->SetVertexBuffers(vertexBuffers, args[2]);
+            break;
+
+        case RCMD_INDEXBUFFER:
+            graphics->SetIndexBuffer(command.indexBuffer_);
+            break;
+
+        case RCMD_SHADERPARAMETER:
+            {
+                StringHash param(args[0]);
+                const float* data = &parameterData_[args[2]];
+
+                switch (args[1])
+                {
+                case VAR_FLOAT:
+                    graphics->SetShaderParameter(param, data[0]);
+                    break;
+
+                case VAR_INT:
+                    graphics->SetShaderParameter(param, *((const int*)data));
+                    break;
+
+                case VAR_BOOL:
+                    graphics->SetShaderParameter(param, *((const int*)data) != 0);
+                    break;
+
+                case VAR_COLOR:
+                    graphics->SetShaderParameter(param, *((const Color*)data));
+                    break;
+
+                case VAR_VECTOR2:
+                    graphics->SetShaderParameter(param, *((const Vector2*)data));
+                    break;
+
+                case VAR_VECTOR3:
+                    graphics->SetShaderParameter(param, *((const Vector3*)data));
+                    break;
+
+                case VAR_VECTOR4:
+                    graphics->SetShaderParameter(param, *((const Vector4*)data));
+                    break;
+
+                case VAR_MATRIX3:
+                    graphics->SetShaderParameter(param, *((const Matrix3*)data));
+                    break;
+
+                case VAR_MATRIX3X4:
+                    graphics->SetShaderParameter(param, *((const Matrix3x4*)data));
+                    break;
+
+                case VAR_MATRIX4:
+                    graphics->SetShaderParameter(param, *((const Matrix4*)data));
+                    break;
+
+                default:
+                    graphics->SetShaderParameter(param, data, args[3]);
+                    break;
+                }
+            }
+            break;
+
+        case RCMD_DRAW:
+            graphics->Draw((PrimitiveType)args[0], args[1], args[2]);
+            break;
+
+        case RCMD_DRAWINDEXED:
+            graphics->Draw((PrimitiveType)args[0], args[1], args[2], args[3], args[4]);
+            break;
+
+        case RCMD_DRAWINSTANCED:
+            graphics->DrawInstanced((PrimitiveType)args[0], args[1], args[2], args[3], args[4], args[5]);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return stats;
+}
+
+RenderCommand& RenderCommandBuffer::AddCommand(RenderCommandType type)
+{
+    commands_.Resize(commands_.Size() + 1);
+    RenderCommand& command = commands_.Back();
+    command.type_ = type;
+    return command;
+}
+
+RenderCommand* RenderCommandBuffer::AddStateCommand(RenderCommandType type, const unsigned* args, unsigned numArgs)
+{
+    unsigned* state = stateArgs_[type];
+
+    if (stateValid_[type])
+    {
+        bool changed = false;
+        for (unsigned i = 0; i < numArgs; ++i)
+        {
+            if (state[i] != args[i])
+            {
+                changed = true;
+                break;
+            }
+        }
+
+        if (!changed)
+        {
+            ++numRedundantCommands_;
+            return 0;
+        }
+    }
+
+    stateValid_[type] = true;
+    for (unsigned i = 0; i < numArgs; ++i)
+        state[i] = args[i];
+
+    RenderCommand& command = AddCommand(type);
+    for (unsigned i = 0; i < numArgs; ++i)
+        command.args_[i] = args[i];
+    return &command;
+}
+
+RenderCommand* RenderCommandBuffer::AddBindCommand(RenderCommandType type, void*& boundObject, void* object)
+{
+    if (stateValid_[type] && boundObject == object)
+    {
+        ++numRedundantCommands_;
+        return 0;
+    }
+
+    stateValid_[type] = true;
+    boundObject = object;
+
+    RenderCommand& command = AddCommand(type);
+    return &command;
+}
+
+void RenderCommandBuffer::AddParameter(StringHash param, VariantType type, const float* data, unsigned count)
+{
+    if (!count)
+        return;
+
+    HashMap<StringHash, RecordedParameter>::Iterator i = parameters_.Find(param);
+    if (i != parameters_.End() && i->second_.type_ == type && i->second_.count_ == count &&
+        !memcmp(&parameterData_[i->second_.offset_], data, count * sizeof(float)))
+    {
+        ++numRedundantCommands_;
+        return;
+    }
+
+    unsigned offset = parameterData_.Size();
+    parameterData_.Resize(offset + count);
+    memcpy(&parameterData_[offset], data, count * sizeof(float));
+
+    RecordedParameter& recorded = parameters_[param];
+    recorded.type_ = type;
+    recorded.offset_ = offset;
+    recorded.count_ = count;
+
+    RenderCommand& command = AddCommand(RCMD_SHADERPARAMETER);
+    command.args_[0] = param.Value();
+    command.args_[1] = type;
+    command.args_[2] = offset;
+    command.args_[3] = count;
+}
+
+}
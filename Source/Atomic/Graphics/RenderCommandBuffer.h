@@ -0,0 +1,248 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Container/HashMap.h"
+#include "../Container/RefCounted.h"
+#include "../Core/Variant.h"
+#include "../Graphics/GraphicsDefs.h"
+#include "../Math/Rect.h"
+
+namespace Atomic
+{
+
+class Graphics;
+class IndexBuffer;
+class ShaderVariation;
+class Texture;
+class VertexBuffer;
+
+/// Render command types.
+enum RenderCommandType
+{
+    RCMD_SHADERS = 0,
+    RCMD_BLENDMODE,
+    RCMD_COLORWRITE,
+    RCMD_CULLMODE,
+    RCMD_DEPTHBIAS,
+    RCMD_DEPTHTEST,
+    RCMD_DEPTHWRITE,
+    RCMD_FILLMODE,
+    RCMD_LINEANTIALIAS,
+    RCMD_SCISSORTEST,
+    RCMD_STENCILTEST,
+    RCMD_TEXTURE,
+    RCMD_VERTEXBUFFER,
+    RCMD_VERTEXBUFFERS,
+    RCMD_INDEXBUFFER,
+    RCMD_SHADERPARAMETER,
+    RCMD_DRAW,
+    RCMD_DRAWINDEXED,
+    RCMD_DRAWINSTANCED,
+    MAX_RENDER_COMMAND_TYPES
+};
+
+/// Recorded render command.
+struct RenderCommand
+{
+    /// Command type.
+    RenderCommandType type_;
+
+    union
+    {
+        /// Vertex and pixel shader.
+        ShaderVariation* shaders_[2];
+        /// Texture.
+        Texture* texture_;
+        /// Vertex buffer.
+        VertexBuffer* vertexBuffer_;
+        /// Index buffer.
+        IndexBuffer* indexBuffer_;
+    };
+
+    /// Integer arguments: state values, texture unit, draw ranges, or shader parameter name, type and data offset.
+    unsigned args_[8];
+};
+
+/// Render command statistics.
+struct RenderCommandStats
+{
+    /// Construct with zero counts.
+    RenderCommandStats() :
+        numStateCommands_(0),
+        numParameterCommands_(0),
+        numDrawCommands_(0),
+        numPrimitives_(0)
+    {
+    }
+
+    /// Render state and resource binding commands.
+    unsigned numStateCommands_;
+    /// Shader parameter commands.
+    unsigned numParameterCommands_;
+    /// Draw commands.
+    unsigned numDrawCommands_;
+    /// Primitives drawn.
+    unsigned numPrimitives_;
+};
+
+/// Buffer of render state changes and draw calls. Recording does not access the Graphics subsystem, so buffers can be
+/// recorded on worker threads (one buffer per thread) and replayed on the main thread. State commands that would not
+/// change the recorded state are dropped while recording. The referenced shaders, textures and buffers must stay alive
+/// until the buffer is replayed.
+class ATOMIC_API RenderCommandBuffer : public RefCounted
+{
+    ATOMIC_REFCOUNTED(RenderCommandBuffer)
+
+public:
+    /// Construct.
+    RenderCommandBuffer();
+    /// Destruct.
+    ~RenderCommandBuffer();
+
+    /// Remove all commands and forget the recorded state.
+    void Clear();
+    /// Forget the recorded state, so that the next state commands are recorded even if they repeat earlier ones. Call when something other than the buffer may have changed the state in between.
+    void ResetState();
+
+    /// Record vertex and pixel shaders.
+    void SetShaders(ShaderVariation* vs, ShaderVariation* ps);
+    /// Record blending mode.
+    void SetBlendMode(BlendMode mode, bool alphaToCoverage = false);
+    /// Record color write on/off.
+    void SetColorWrite(bool enable);
+    /// Record hardware culling mode.
+    void SetCullMode(CullMode mode);
+    /// Record depth bias.
+    void SetDepthBias(float constantBias, float slopeScaledBias);
+    /// Record depth compare.
+    void SetDepthTest(CompareMode mode);
+    /// Record depth write on/off.
+    void SetDepthWrite(bool enable);
+    /// Record polygon fill mode.
+    void SetFillMode(FillMode mode);
+    /// Record line antialiasing on/off.
+    void SetLineAntiAlias(bool enable);
+    /// Record scissor test.
+    void SetScissorTest(bool enable, const IntRect& rect = IntRect::ZERO);
+    /// Record stencil test.
+    void SetStencilTest(bool enable, CompareMode mode = CMP_ALWAYS, StencilOp pass = OP_KEEP, StencilOp fail = OP_KEEP,
+        StencilOp zFail = OP_KEEP, unsigned stencilRef = 0, unsigned compareMask = M_MAX_UNSIGNED, unsigned writeMask = M_MAX_UNSIGNED);
+    /// Record texture binding.
+    void SetTexture(unsigned index, Texture* texture);
+    /// Record vertex buffer binding.
+    void SetVertexBuffer(VertexBuffer* buffer);
+    /// Record multiple vertex buffers binding, for example with an instancing buffer.
+    void SetVertexBuffers(const PODVector<VertexBuffer*>& buffers, unsigned instanceOffset = 0);
+    /// Record index buffer binding.
+    void SetIndexBuffer(IndexBuffer* buffer);
+    /// Record shader float constants.
+    void SetShaderParameter(StringHash param, const float* data, unsigned count);
+    /// Record shader float constant.
+    void SetShaderParameter(StringHash param, float value);
+    /// Record shader integer constant.
+    void SetShaderParameter(StringHash param, int value);
+    /// Record shader boolean constant.
+    void SetShaderParameter(StringHash param, bool value);
+    /// Record shader color constant.
+    void SetShaderParameter(StringHash param, const Color& color);
+    /// Record shader 2D vector constant.
+    void SetShaderParameter(StringHash param, const Vector2& vector);
+    /// Record shader 3x3 matrix constant.
+    void SetShaderParameter(StringHash param, const Matrix3& matrix);
+    /// Record shader 3D vector constant.
+    void SetShaderParameter(StringHash param, const Vector3& vector);
+    /// Record shader 4x4 matrix constant.
+    void SetShaderParameter(StringHash param, const Matrix4& matrix);
+    /// Record shader 4D vector constant.
+    void SetShaderParameter(StringHash param, const Vector4& vector);
+    /// Record shader 3x4 matrix constant.
+    void SetShaderParameter(StringHash param, const Matrix3x4& matrix);
+    /// Record non-indexed geometry draw.
+    void Draw(PrimitiveType type, unsigned vertexStart, unsigned vertexCount);
+    /// Record indexed geometry draw.
+    void Draw(PrimitiveType type, unsigned indexStart, unsigned indexCount, unsigned minVertex, unsigned vertexCount);
+    /// Record indexed, instanced geometry draw. An instancing vertex buffer must be set.
+    void DrawInstanced(PrimitiveType type, unsigned indexStart, unsigned indexCount, unsigned minVertex, unsigned vertexCount,
+        unsigned instanceCount);
+
+    /// Replay the commands in recording order. With a null graphics subsystem the commands are only walked and counted, which allows recording and replay to be measured without a GPU. Return the command statistics.
+    RenderCommandStats Execute(Graphics* graphics) const;
+
+    /// Return number of recorded commands.
+    unsigned GetNumCommands() const { return commands_.Size(); }
+    /// Return number of state commands dropped as redundant.
+    unsigned GetNumRedundantCommands() const { return numRedundantCommands_; }
+    /// Return the recorded commands.
+    const PODVector<RenderCommand>& GetCommands() const { return commands_; }
+
+private:
+    /// Recorded shader parameter.
+    struct RecordedParameter
+    {
+        /// Value type.
+        VariantType type_;
+        /// Offset of the value in the parameter data.
+        unsigned offset_;
+        /// Number of floats.
+        unsigned count_;
+    };
+
+    /// Add a command to the end of the buffer.
+    RenderCommand& AddCommand(RenderCommandType type);
+    /// Record a state command unless its arguments repeat the recorded state. Return the command, or null if dropped.
+    RenderCommand* AddStateCommand(RenderCommandType type, const unsigned* args, unsigned numArgs);
+    /// Record a resource binding command unless the object is already bound. Return the command, or null if dropped.
+    RenderCommand* AddBindCommand(RenderCommandType type, void*& boundObject, void* object);
+    /// Record a shader parameter unless it repeats the value already recorded since the last shader change.
+    void AddParameter(StringHash param, VariantType type, const float* data, unsigned count);
+
+    /// Recorded commands.
+    PODVector<RenderCommand> commands_;
+    /// Shader parameter values.
+    PODVector<float> parameterData_;
+    /// Vertex buffer lists of the multiple vertex buffers commands.
+    PODVector<VertexBuffer*> vertexBufferLists_;
+    /// Last recorded state command arguments by command type.
+    unsigned stateArgs_[MAX_RENDER_COMMAND_TYPES][8];
+    /// Whether the state of a command type has been recorded.
+    bool stateValid_[MAX_RENDER_COMMAND_TYPES];
+    /// Last recorded vertex shader.
+    void* vertexShader_;
+    /// Last recorded pixel shader.
+    void* pixelShader_;
+    /// Last recorded vertex buffer.
+    void* vertexBuffer_;
+    /// Last recorded index buffer.
+    void* indexBuffer_;
+    /// Last recorded textures by unit.
+    void* textures_[MAX_TEXTURE_UNITS];
+    /// Whether the texture of a unit has been recorded.
+    bool texturesValid_[MAX_TEXTURE_UNITS];
+    /// Shader parameters recorded since the last shader change.
+    HashMap<StringHash, RecordedParameter> parameters_;
+    /// Number of dropped redundant commands.
+    unsigned numRedundantCommands_;
+};
+
+}
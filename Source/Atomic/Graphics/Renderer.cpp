@@ -31,6 +31,7 @@
 #include "../Graphics/GraphicsEvents.h"
 #include "../Graphics/GraphicsImpl.h"
 #include "../Graphics/IndexBuffer.h"
+#include "../Graphics/InstanceDataStore.h"
 #include "../Graphics/Material.h"
 #include "../Graphics/OcclusionBuffer.h"
 #include "../Graphics/Octree.h"
@@ -288,6 +289,11 @@ Renderer::Renderer(Context* context) :
     mobileShadowBiasMul_(1.0f),
     mobileShadowBiasAdd_(0.0f),
     mobileNormalOffsetMul_(1.0f),
+    // ATOMIC BEGIN
+    animationLodBias_(1.0f),
+    boneLodDistance_(0.0f),
+    maxBoneLodLevel_(2),
+    // ATOMIC END
     numOcclusionBuffers_(0),
     numShadowCameras_(0),
     shadersChangedFrameNumber_(M_MAX_UNSIGNED),
@@ -493,7 +499,7 @@ void Renderer::SetMaxShadowMaps(int shadowMaps)
 
 void Renderer::SetDynamicInstancing(bool enable)
 {
-    if (!instancingBuffer_)
+    if (!instanceDataStore_)
         enable = false;
 
     dynamicInstancing_ = enable;
@@ -544,6 +550,25 @@ void Renderer::SetMobileNormalOffsetMul(float mul)
     mobileNormalOffsetMul_ = mul;
 }
 
+// ATOMIC BEGIN
+
+void Renderer::SetAnimationLodBias(float bias)
+{
+    animationLodBias_ = Max(bias, 0.0f);
+}
+
+void Renderer::SetBoneLodDistance(float distance)
+{
+    boneLodDistance_ = Max(distance, 0.0f);
+}
+
+void Renderer::SetMaxBoneLodLevel(int level)
+{
+    maxBoneLodLevel_ = Max(level, 0);
+}
+
+// ATOMIC END
+
 void Renderer::SetOccluderSizeThreshold(float screenSize)
 {
     occluderSizeThreshold_ = Max(screenSize, 0.0f);
@@ -721,6 +746,12 @@ void Renderer::Render()
     graphics_->SetDefaultTextureFilterMode(textureFilterMode_);
     graphics_->SetDefaultTextureAnisotropy((unsigned)textureAnisotropy_);
 
+    // ATOMIC BEGIN
+    // Release the instance ranges of batch groups that were not drawn on the previous frame
+    if (instanceDataStore_)
+        instanceDataStore_->BeginFrame(frame_.frameNumber_);
+    // ATOMIC END
+
     // If no views that render to the backbuffer, clear the screen so that e.g. the UI is not rendered on top of previous frame
     bool hasBackbufferViews = false;
     for (unsigned i = 0; i < views_.Size(); ++i)
@@ -1362,29 +1393,20 @@ void Renderer::SetCullMode(CullMode mode, Camera* camera)
 
 bool Renderer::ResizeInstancingBuffer(unsigned numInstances)
 {
-    if (!instancingBuffer_ || !dynamicInstancing_)
+    // ATOMIC BEGIN
+    if (!instanceDataStore_ || !dynamicInstancing_)
         return false;
 
-    unsigned oldSize = instancingBuffer_->GetVertexCount();
-    if (numInstances <= oldSize)
-        return true;
-
-    unsigned newSize = INSTANCING_BUFFER_DEFAULT_SIZE;
-    while (newSize < numInstances)
-        newSize <<= 1;
-
-    const PODVector<VertexElement> instancingBufferElements = CreateInstancingBufferElements(numExtraInstancingBufferElements_);
-    if (!instancingBuffer_->SetSize(newSize, instancingBufferElements, true))
-    {
-        ATOMIC_LOGERROR("Failed to resize instancing buffer to " + String(newSize));
-        // If failed, try to restore the old size
-        instancingBuffer_->SetSize(oldSize, instancingBufferElements, true);
-        return false;
-    }
+    return instanceDataStore_->Reserve(numInstances);
+    // ATOMIC END
+}
 
-    ATOMIC_LOGDEBUG("Resized instancing buffer to " + String(newSize));
-    return true;
+// ATOMIC BEGIN
+VertexBuffer* Renderer::GetInstancingBuffer() const
+{
+    return dynamicInstancing_ && instanceDataStore_ ? instanceDataStore_->GetVertexBuffer() : (VertexBuffer*)0;
 }
+// ATOMIC END
 
 void Renderer::SaveScreenBufferAllocations()
 {
@@ -1910,18 +1932,22 @@ void Renderer::CreateInstancingBuffer()
     // Do not create buffer if instancing not supported
     if (!graphics_->GetInstancingSupport())
     {
-        instancingBuffer_.Reset();
+        // ATOMIC BEGIN
+        instanceDataStore_.Reset();
+        // ATOMIC END
         dynamicInstancing_ = false;
         return;
     }
 
-    instancingBuffer_ = new VertexBuffer(context_);
+    // ATOMIC BEGIN
+    instanceDataStore_ = new InstanceDataStore(context_);
     const PODVector<VertexElement> instancingBufferElements = CreateInstancingBufferElements(numExtraInstancingBufferElements_);
-    if (!instancingBuffer_->SetSize(INSTANCING_BUFFER_DEFAULT_SIZE, instancingBufferElements, true))
+    if (!instanceDataStore_->SetVertexElements(instancingBufferElements))
     {
-        instancingBuffer_.Reset();
+        instanceDataStore_.Reset();
         dynamicInstancing_ = false;
     }
+    // ATOMIC END
 }
 
 void Renderer::ResetShadowMaps()
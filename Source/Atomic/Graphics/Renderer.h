@@ -40,6 +40,7 @@ class Pass;
 class Technique;
 class Octree;
 class Graphics;
+class InstanceDataStore;
 class RenderPath;
 class RenderSurface;
 class ResourceCache;
@@ -243,6 +244,14 @@ public:
     void SetMobileShadowBiasAdd(float add);
     /// Set shadow normal offset multiplier for mobile platforms to counteract possible worse shadow map precision. Default 1.0 (no effect.)
     void SetMobileNormalOffsetMul(float mul);
+    // ATOMIC BEGIN
+    /// Set global animation LOD bias, multiplied with the bias of each animated model. Zero disables animation update rate throttling. Default 1.0.
+    void SetAnimationLodBias(float bias);
+    /// Set LOD distance per bone LOD level for animated models that do not define their own. Each level stops evaluating one more level of leaf bones. Default 0.0 (disabled.)
+    void SetBoneLodDistance(float distance);
+    /// Set maximum bone LOD level. Default 2.
+    void SetMaxBoneLodLevel(int level);
+    // ATOMIC END
     /// Force reload of shaders.
     void ReloadShaders();
 
@@ -334,6 +343,17 @@ public:
     /// Return shadow normal offset multiplier for mobile platforms.
     float GetMobileNormalOffsetMul() const { return mobileNormalOffsetMul_; }
 
+    // ATOMIC BEGIN
+    /// Return global animation LOD bias.
+    float GetAnimationLodBias() const { return animationLodBias_; }
+
+    /// Return LOD distance per bone LOD level.
+    float GetBoneLodDistance() const { return boneLodDistance_; }
+
+    /// Return maximum bone LOD level.
+    int GetMaxBoneLodLevel() const { return maxBoneLodLevel_; }
+    // ATOMIC END
+
     /// Return number of views rendered.
     unsigned GetNumViews() const { return views_.Size(); }
 
@@ -371,7 +391,11 @@ public:
     TextureCube* GetIndirectionCubeMap() const { return indirectionCubeMap_; }
 
     /// Return the instancing vertex buffer
-    VertexBuffer* GetInstancingBuffer() const { return dynamicInstancing_ ? instancingBuffer_ : (VertexBuffer*)0; }
+    VertexBuffer* GetInstancingBuffer() const;
+    // ATOMIC BEGIN
+    /// Return the persistent instance data store, which owns the instancing vertex buffer.
+    InstanceDataStore* GetInstanceDataStore() const { return dynamicInstancing_ ? instanceDataStore_ : (InstanceDataStore*)0; }
+    // ATOMIC END
 
     /// Return the frame update parameters.
     const FrameInfo& GetFrameInfo() const { return frame_; }
@@ -486,8 +510,10 @@ private:
     SharedPtr<Geometry> spotLightGeometry_;
     /// Point light volume geometry.
     SharedPtr<Geometry> pointLightGeometry_;
-    /// Instance stream vertex buffer.
-    SharedPtr<VertexBuffer> instancingBuffer_;
+    // ATOMIC BEGIN
+    /// Persistent instance data store with the instance stream vertex buffer.
+    SharedPtr<InstanceDataStore> instanceDataStore_;
+    // ATOMIC END
     /// Default material.
     SharedPtr<Material> defaultMaterial_;
     /// Default range attenuation texture.
@@ -574,6 +600,14 @@ private:
     float mobileShadowBiasAdd_;
     /// Mobile platform shadow normal offset multiplier.
     float mobileNormalOffsetMul_;
+    // ATOMIC BEGIN
+    /// Global animation LOD bias.
+    float animationLodBias_;
+    /// LOD distance per bone LOD level.
+    float boneLodDistance_;
+    /// Maximum bone LOD level.
+    int maxBoneLodLevel_;
+    // ATOMIC END
     /// Number of occlusion buffers in use.
     unsigned numOcclusionBuffers_;
     /// Number of temporary shadow cameras in use.
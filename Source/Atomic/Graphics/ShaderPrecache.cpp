@@ -22,19 +22,84 @@
 
 #include "../Precompiled.h"
 
+#include "../Core/CoreEvents.h"
+#include "../Core/Profiler.h"
+#include "../Core/Timer.h"
 #include "../Graphics/Graphics.h"
 #include "../Graphics/GraphicsImpl.h"
+#include "../Graphics/Shader.h"
 #include "../Graphics/ShaderPrecache.h"
 #include "../Graphics/ShaderVariation.h"
 #include "../IO/File.h"
 #include "../IO/FileSystem.h"
 #include "../IO/Log.h"
+#include "../Resource/ResourceCache.h"
 
 #include "../DebugNew.h"
 
 namespace Atomic
 {
 
+// ATOMIC BEGIN
+
+/// Return whether a shader combination can be compiled on the current platform.
+static bool IsSupportedCombination(const String& vsDefines, const String& psDefines)
+{
+    // Check for illegal variations on OpenGL ES
+#ifdef GL_ES_VERSION_2_0
+    if (
+#ifndef __EMSCRIPTEN__
+        vsDefines.Contains("INSTANCED") ||
+#endif
+        (psDefines.Contains("POINTLIGHT") && psDefines.Contains("SHADOW")))
+        return false;
+#endif
+
+    return true;
+}
+
+String GetShaderProgramCacheKey(unsigned long long vsSourceHash, unsigned long long psSourceHash, const String& driverName,
+    unsigned version)
+{
+    unsigned long long hash = FNV1aHash64(&vsSourceHash, sizeof vsSourceHash);
+    hash = FNV1aHash64(&psSourceHash, sizeof psSourceHash, hash);
+    hash = FNV1aHash64(driverName.CString(), driverName.Length(), hash);
+    hash = FNV1aHash64(&version, sizeof version, hash);
+    return ToStringHex((unsigned)(hash >> 32)) + ToStringHex((unsigned)hash);
+}
+
+bool WriteShaderProgramBinary(Serializer& dest, const String& key, unsigned format, const unsigned char* data, unsigned size)
+{
+    bool success = true;
+    success &= dest.WriteFileID("UGLP");
+    success &= dest.WriteUInt(SHADER_PROGRAM_CACHE_VERSION);
+    success &= dest.WriteString(key);
+    success &= dest.WriteUInt(format);
+    success &= dest.WriteUInt(size);
+    success &= dest.Write(data, size) == size;
+    return success;
+}
+
+bool ReadShaderProgramBinary(Deserializer& source, const String& key, unsigned& format, PODVector<unsigned char>& data)
+{
+    if (source.ReadFileID() != "UGLP")
+        return false;
+
+    // The key is stored as well, so that a binary renamed or colliding with another key is not used either
+    if (source.ReadUInt() != SHADER_PROGRAM_CACHE_VERSION || source.ReadString() != key)
+        return false;
+
+    format = source.ReadUInt();
+    unsigned size = source.ReadUInt();
+    if (!size || size > source.GetSize() - source.GetPosition())
+        return false;
+
+    data.Resize(size);
+    return source.Read(&data[0], size) == size;
+}
+
+// ATOMIC END
+
 ShaderPrecache::ShaderPrecache(Context* context, const String& fileName) :
     Object(context),
     fileName_(fileName),
@@ -117,18 +182,14 @@ void ShaderPrecache::LoadShaders(Graphics* graphics, Deserializer& source)
         String vsDefines = shader.GetAttribute("vsdefines");
         String psDefines = shader.GetAttribute("psdefines");
 
-        // Check for illegal variations on OpenGL ES and skip them
-#ifdef GL_ES_VERSION_2_0
-        if (
-#ifndef __EMSCRIPTEN__
-            vsDefines.Contains("INSTANCED") ||
-#endif
-            (psDefines.Contains("POINTLIGHT") && psDefines.Contains("SHADOW")))
+        // Check for illegal variations and skip them
+        // ATOMIC BEGIN
+        if (!IsSupportedCombination(vsDefines, psDefines))
+        // ATOMIC END
         {
             shader = shader.GetNext("shader");
             continue;
         }
-#endif
 
         ShaderVariation* vs = graphics->GetShader(VS, shader.GetAttribute("vs"), vsDefines);
         ShaderVariation* ps = graphics->GetShader(PS, shader.GetAttribute("ps"), psDefines);
@@ -141,4 +202,97 @@ void ShaderPrecache::LoadShaders(Graphics* graphics, Deserializer& source)
     ATOMIC_LOGDEBUG("End precaching shaders");
 }
 
+// ATOMIC BEGIN
+
+ShaderPrecompiler::ShaderPrecompiler(Context* context, Deserializer& source, int maxMsPerFrame) :
+    Object(context),
+    nextCombination_(0),
+    maxMsPerFrame_(Max(maxMsPerFrame, 1))
+{
+    XMLFile xmlFile(context_);
+    xmlFile.Load(source);
+
+    Graphics* graphics = GetSubsystem<Graphics>();
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    HashSet<String> shaderNames;
+
+    XMLElement shader = xmlFile.GetRoot().GetChild("shader");
+    while (shader)
+    {
+        Combination combination;
+        combination.vs_ = shader.GetAttribute("vs");
+        combination.vsDefines_ = shader.GetAttribute("vsdefines");
+        combination.ps_ = shader.GetAttribute("ps");
+        combination.psDefines_ = shader.GetAttribute("psdefines");
+
+        if (IsSupportedCombination(combination.vsDefines_, combination.psDefines_))
+        {
+            combinations_.Push(combination);
+            shaderNames.Insert(combination.vs_);
+            shaderNames.Insert(combination.ps_);
+        }
+
+        shader = shader.GetNext("shader");
+    }
+
+    // Read and preprocess the shader source files on the background loading thread, so that only the GPU compile
+    // remains to be done on the main thread
+    for (HashSet<String>::ConstIterator i = shaderNames.Begin(); i != shaderNames.End(); ++i)
+        cache->BackgroundLoadResource<Shader>(graphics->GetShaderResourceName(*i));
+
+    ATOMIC_LOGDEBUG("Begin precaching " + String(combinations_.Size()) + " shader combinations");
+
+    if (!IsFinished())
+        SubscribeToEvent(E_BEGINFRAME, ATOMIC_HANDLER(ShaderPrecompiler, HandleBeginFrame));
+}
+
+ShaderPrecompiler::~ShaderPrecompiler()
+{
+}
+
+bool ShaderPrecompiler::Update()
+{
+    ATOMIC_PROFILE(PrecompileShaders);
+
+    Graphics* graphics = GetSubsystem<Graphics>();
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    HiresTimer timer;
+    long long maxUSec = maxMsPerFrame_ * 1000LL;
+
+    while (!IsFinished() && timer.GetUSec(false) < maxUSec)
+    {
+        const Combination& combination = combinations_[nextCombination_];
+
+        // Wait for the background loading of the source files instead of stalling on them, unless loading has finished
+        // or failed, in which case the shaders are requested normally
+        if (cache->GetNumBackgroundLoadResources() &&
+            (!cache->GetExistingResource<Shader>(graphics->GetShaderResourceName(combination.vs_)) ||
+            !cache->GetExistingResource<Shader>(graphics->GetShaderResourceName(combination.ps_))))
+            break;
+
+        ShaderVariation* vs = graphics->GetShader(VS, combination.vs_, combination.vsDefines_);
+        ShaderVariation* ps = graphics->GetShader(PS, combination.ps_, combination.psDefines_);
+        // Set the shaders active to actually compile them
+        graphics->SetShaders(vs, ps);
+
+        ++nextCombination_;
+    }
+
+    if (IsFinished())
+    {
+        ATOMIC_LOGDEBUG("End precaching shaders");
+        UnsubscribeFromEvent(E_BEGINFRAME);
+        return true;
+    }
+    else
+        return false;
+}
+
+void ShaderPrecompiler::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+    Update();
+}
+
+// ATOMIC END
+
 }
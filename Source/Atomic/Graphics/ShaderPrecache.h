@@ -32,6 +32,19 @@ namespace Atomic
 class Graphics;
 class ShaderVariation;
 
+// ATOMIC BEGIN
+/// Program binary cache format version. Increment to invalidate all cached program binaries.
+static const unsigned SHADER_PROGRAM_CACHE_VERSION = 1;
+
+/// Return the program binary cache key for a vertex and pixel shader source hash, a graphics driver identification string and a cache version.
+ATOMIC_API String GetShaderProgramCacheKey(unsigned long long vsSourceHash, unsigned long long psSourceHash, const String& driverName,
+    unsigned version = SHADER_PROGRAM_CACHE_VERSION);
+/// Write a program binary cache file with its key. Return true if successful.
+ATOMIC_API bool WriteShaderProgramBinary(Serializer& dest, const String& key, unsigned format, const unsigned char* data, unsigned size);
+/// Read a program binary cache file. Return false if it is not valid, or was written with another cache version or key and is stale.
+ATOMIC_API bool ReadShaderProgramBinary(Deserializer& source, const String& key, unsigned& format, PODVector<unsigned char>& data);
+// ATOMIC END
+
 /// Utility class for collecting used shader combinations during runtime for precaching.
 class ATOMIC_API ShaderPrecache : public Object
 {
@@ -60,4 +73,52 @@ private:
     HashSet<String> usedCombinations_;
 };
 
+// ATOMIC BEGIN
+
+/// Utility class for compiling shader combinations from a precache XML file over several frames.
+class ATOMIC_API ShaderPrecompiler : public Object
+{
+    ATOMIC_OBJECT(ShaderPrecompiler, Object);
+
+public:
+    /// Construct, read the combinations from XML and begin loading the shader source files in the background.
+    ShaderPrecompiler(Context* context, Deserializer& source, int maxMsPerFrame);
+    /// Destruct.
+    ~ShaderPrecompiler();
+
+    /// Compile shader combinations until the time budget for one frame is used. Return true when all have been compiled.
+    bool Update();
+
+    /// Return number of combinations not yet compiled.
+    unsigned GetNumRemaining() const { return combinations_.Size() - nextCombination_; }
+    /// Return whether all combinations have been compiled.
+    bool IsFinished() const { return nextCombination_ >= combinations_.Size(); }
+
+private:
+    /// Shader combination from the precache file.
+    struct Combination
+    {
+        /// Vertex shader name.
+        String vs_;
+        /// Vertex shader defines.
+        String vsDefines_;
+        /// Pixel shader name.
+        String ps_;
+        /// Pixel shader defines.
+        String psDefines_;
+    };
+
+    /// Handle frame begin event.
+    void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+
+    /// Combinations to compile.
+    Vector<Combination> combinations_;
+    /// Index of the next combination to compile.
+    unsigned nextCombination_;
+    /// Maximum time to spend compiling per frame.
+    int maxMsPerFrame_;
+};
+
+// ATOMIC END
+
 }
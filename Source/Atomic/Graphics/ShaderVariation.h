@@ -136,6 +136,11 @@ public:
     /// Return defines with the CLIPPLANE define appended. Used internally on Direct3D11 only, will be empty on other APIs.
     const String& GetDefinesClipPlane() { return definesClipPlane_; }
 
+    // ATOMIC BEGIN
+    /// Return hash of the final source code including defines. Used on OpenGL to key the program binary cache, zero on other APIs.
+    unsigned long long GetSourceHash() const { return sourceHash_; }
+    // ATOMIC END
+
     /// D3D11 vertex semantic names. Used internally.
     static const char* elementSemanticNames[];
 
@@ -173,6 +178,10 @@ private:
     String definesClipPlane_;
     /// Shader compile error string.
     String compilerOutput_;
+    // ATOMIC BEGIN
+    /// Hash of the final source code including defines. Used only on OpenGL.
+    unsigned long long sourceHash_;
+    // ATOMIC END
 };
 
 }
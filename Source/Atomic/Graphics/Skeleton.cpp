@@ -73,6 +73,10 @@ bool Skeleton::Load(Deserializer& source)
         bones_.Push(newBone);
     }
 
+    // ATOMIC BEGIN
+    UpdateLodHeights();
+    // ATOMIC END
+
     return true;
 }
 
@@ -112,6 +116,10 @@ void Skeleton::Define(const Skeleton& src)
     for (Vector<Bone>::Iterator i = bones_.Begin(); i != bones_.End(); ++i)
         i->node_.Reset();
     rootBoneIndex_ = src.rootBoneIndex_;
+
+    // ATOMIC BEGIN
+    UpdateLodHeights();
+    // ATOMIC END
 }
 
 void Skeleton::SetRootBoneIndex(unsigned index)
@@ -178,4 +186,30 @@ Bone* Skeleton::GetBone(StringHash nameHash)
     return 0;
 }
 
+// ATOMIC BEGIN
+
+void Skeleton::UpdateLodHeights()
+{
+    for (unsigned i = 0; i < bones_.Size(); ++i)
+        bones_[i].lodHeight_ = 0;
+
+    // Propagate the height of each bone up its parent chain
+    for (unsigned i = 0; i < bones_.Size(); ++i)
+    {
+        unsigned height = 1;
+        unsigned index = i;
+        while (bones_[index].parentIndex_ != index && bones_[index].parentIndex_ < bones_.Size() && height <= bones_.Size())
+        {
+            Bone& parent = bones_[bones_[index].parentIndex_];
+            if (parent.lodHeight_ >= height)
+                break;
+            parent.lodHeight_ = (unsigned char)Min(height, 255U);
+            index = bones_[index].parentIndex_;
+            ++height;
+        }
+    }
+}
+
+// ATOMIC END
+
 }
@@ -46,6 +46,9 @@ struct Bone
         initialRotation_(Quaternion::IDENTITY),
         initialScale_(Vector3::ONE),
         animated_(true),
+        // ATOMIC BEGIN
+        lodHeight_(0),
+        // ATOMIC END
         collisionMask_(0),
         radius_(0.0f)
     {
@@ -67,6 +70,10 @@ struct Bone
     Matrix3x4 offsetMatrix_;
     /// Animation enable flag.
     bool animated_;
+    // ATOMIC BEGIN
+    /// Number of bone levels below this bone, zero for leaf bones. Bone LOD stops evaluating the lowest levels first.
+    unsigned char lodHeight_;
+    // ATOMIC END
     /// Supported collision types.
     unsigned char collisionMask_;
     /// Radius.
@@ -122,6 +129,11 @@ public:
     /// Reset all animating bones to initial positions without marking the nodes dirty. Requires the node dirtying to be performed later.
     void ResetSilent();
 
+    // ATOMIC BEGIN
+    /// Recalculate the bone LOD heights from the hierarchy. Called on load and define; call after modifying the bone hierarchy.
+    void UpdateLodHeights();
+    // ATOMIC END
+
 private:
     /// Bones.
     Vector<Bone> bones_;
@@ -24,6 +24,7 @@
 
 #include "../Core/Context.h"
 #include "../Core/Profiler.h"
+#include "../Core/WorkQueue.h"
 #include "../Graphics/DrawableEvents.h"
 #include "../Graphics/Geometry.h"
 #include "../Graphics/IndexBuffer.h"
@@ -48,10 +49,31 @@ extern const char* GEOMETRY_CATEGORY;
 
 static const Vector3 DEFAULT_SPACING(1.0f, 0.25f, 1.0f);
 static const unsigned MIN_LOD_LEVELS = 1;
-static const unsigned MAX_LOD_LEVELS = 4;
+// ATOMIC BEGIN
+// There is no fixed maximum: each LOD level halves the patch resolution until MIN_PATCH_SIZE, so the patch size bounds
+// the number of levels created
+static const unsigned DEFAULT_MAX_LOD_LEVELS = 4;
+// ATOMIC END
 static const int DEFAULT_PATCH_SIZE = 32;
 static const int MIN_PATCH_SIZE = 4;
 static const int MAX_PATCH_SIZE = 128;
+// ATOMIC BEGIN
+static const unsigned PATCH_VERTEX_FLOATS = 12;
+static const unsigned PATCHES_PER_GEOMETRY_BATCH = 32;
+
+/// Intermediate patch geometry generated on the CPU before upload.
+struct TerrainPatchData
+{
+    /// Interleaved vertex data for the vertex buffer.
+    SharedArrayPtr<float> vertexData_;
+    /// Positions for raycasts.
+    SharedArrayPtr<unsigned char> cpuVertexData_;
+    /// Positions with neighborhood minimum heights for occlusion rendering.
+    SharedArrayPtr<unsigned char> occlusionCpuVertexData_;
+    /// Local space bounding box.
+    BoundingBox boundingBox_;
+};
+// ATOMIC END
 static const unsigned STITCH_NORTH = 1;
 static const unsigned STITCH_SOUTH = 2;
 static const unsigned STITCH_WEST = 4;
@@ -90,7 +112,7 @@ Terrain::Terrain(Context* context) :
     patchSize_(DEFAULT_PATCH_SIZE),
     lastPatchSize_(0),
     numLodLevels_(1),
-    maxLodLevels_(MAX_LOD_LEVELS),
+    maxLodLevels_(DEFAULT_MAX_LOD_LEVELS),
     occlusionLodLevel_(M_MAX_UNSIGNED),
     smoothing_(false),
     visible_(true),
@@ -109,6 +131,8 @@ Terrain::Terrain(Context* context) :
     southID_(0),
     westID_(0),
     eastID_(0),
+    coarseEdges_(0),
+    fineEdges_(0),
     recreateTerrain_(false),
     neighborsDirty_(false)
 {
@@ -134,7 +158,7 @@ void Terrain::RegisterObject(Context* context)
     ATOMIC_ATTRIBUTE("East Neighbor NodeID", unsigned, eastID_, 0, AM_DEFAULT | AM_NODEID);
     ATOMIC_ATTRIBUTE("Vertex Spacing", Vector3, spacing_, DEFAULT_SPACING, AM_DEFAULT);
     ATOMIC_ACCESSOR_ATTRIBUTE("Patch Size", GetPatchSize, SetPatchSizeAttr, int, DEFAULT_PATCH_SIZE, AM_DEFAULT);
-    ATOMIC_ACCESSOR_ATTRIBUTE("Max LOD Levels", GetMaxLodLevels, SetMaxLodLevelsAttr, unsigned, MAX_LOD_LEVELS, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Max LOD Levels", GetMaxLodLevels, SetMaxLodLevelsAttr, unsigned, DEFAULT_MAX_LOD_LEVELS, AM_DEFAULT);
     ATOMIC_ATTRIBUTE("Smooth Height Map", bool, smoothing_, false, AM_DEFAULT);
     ATOMIC_ACCESSOR_ATTRIBUTE("Is Occluder", IsOccluder, SetOccluder, bool, false, AM_DEFAULT);
     ATOMIC_ACCESSOR_ATTRIBUTE("Can Be Occluded", IsOccludee, SetOccludee, bool, true, AM_DEFAULT);
@@ -223,7 +247,9 @@ void Terrain::SetSpacing(const Vector3& spacing)
 
 void Terrain::SetMaxLodLevels(unsigned levels)
 {
-    levels = Clamp(levels, MIN_LOD_LEVELS, MAX_LOD_LEVELS);
+    // ATOMIC BEGIN
+    levels = Max(levels, MIN_LOD_LEVELS);
+    // ATOMIC END
     if (levels != maxLodLevels_)
     {
         maxLodLevels_ = levels;
@@ -393,6 +419,28 @@ void Terrain::SetNeighbors(Terrain* north, Terrain* south, Terrain* west, Terrai
     MarkNetworkUpdate();
 }
 
+// ATOMIC BEGIN
+
+void Terrain::SetCoarseEdges(unsigned edges)
+{
+    if (edges != coarseEdges_)
+    {
+        coarseEdges_ = edges;
+        UpdateEdgePatchNeighbors();
+    }
+}
+
+void Terrain::SetFineEdges(unsigned edges)
+{
+    if (edges != fineEdges_)
+    {
+        fineEdges_ = edges;
+        UpdateEdgePatchNeighbors();
+    }
+}
+
+// ATOMIC END
+
 void Terrain::SetDrawDistance(float distance)
 {
     drawDistance_ = distance;
@@ -653,114 +701,145 @@ void Terrain::CreatePatchGeometry(TerrainPatch* patch)
 {
     ATOMIC_PROFILE(CreatePatchGeometry);
 
-    unsigned row = (unsigned)(patchSize_ + 1);
-    VertexBuffer* vertexBuffer = patch->GetVertexBuffer();
-    Geometry* geometry = patch->GetGeometry();
-    Geometry* maxLodGeometry = patch->GetMaxLodGeometry();
-    Geometry* occlusionGeometry = patch->GetOcclusionGeometry();
+    // ATOMIC BEGIN
+    TerrainPatchData data;
+    GeneratePatchData(patch, data);
+    UploadPatchData(patch, data);
+    // ATOMIC END
+}
 
-    if (vertexBuffer->GetVertexCount() != row * row)
-        vertexBuffer->SetSize(row * row, MASK_POSITION | MASK_NORMAL | MASK_TEXCOORD1 | MASK_TANGENT);
+// ATOMIC BEGIN
+void Terrain::GeneratePatchData(TerrainPatch* patch, TerrainPatchData& data) const
+{
+    unsigned row = (unsigned)(patchSize_ + 1);
 
-    SharedArrayPtr<unsigned char> cpuVertexData(new unsigned char[row * row * sizeof(Vector3)]);
-    SharedArrayPtr<unsigned char> occlusionCpuVertexData(new unsigned char[row * row * sizeof(Vector3)]);
+    data.vertexData_ = new float[row * row * PATCH_VERTEX_FLOATS];
+    data.cpuVertexData_ = new unsigned char[row * row * sizeof(Vector3)];
+    data.occlusionCpuVertexData_ = new unsigned char[row * row * sizeof(Vector3)];
+    data.boundingBox_.Clear();
 
-    float* vertexData = (float*)vertexBuffer->Lock(0, vertexBuffer->GetVertexCount());
-    float* positionData = (float*)cpuVertexData.Get();
-    float* occlusionData = (float*)occlusionCpuVertexData.Get();
-    BoundingBox box;
+    float* vertexData = data.vertexData_.Get();
+    float* positionData = (float*)data.cpuVertexData_.Get();
+    float* occlusionData = (float*)data.occlusionCpuVertexData_.Get();
+    BoundingBox& box = data.boundingBox_;
 
-    unsigned occlusionLevel = occlusionLodLevel_;
-    if (occlusionLevel > numLodLevels_ - 1)
-        occlusionLevel = numLodLevels_ - 1;
+    unsigned occlusionLevel = GetPatchOcclusionLevel();
+    const IntVector2& coords = patch->GetCoordinates();
+    int lodExpand = (1 << (occlusionLevel)) - 1;
+    int halfLodExpand = (1 << (occlusionLevel)) / 2;
 
-    if (vertexData)
+    for (int z = 0; z <= patchSize_; ++z)
     {
-        const IntVector2& coords = patch->GetCoordinates();
-        int lodExpand = (1 << (occlusionLevel)) - 1;
-        int halfLodExpand = (1 << (occlusionLevel)) / 2;
-
-        for (int z = 0; z <= patchSize_; ++z)
+        for (int x = 0; x <= patchSize_; ++x)
         {
-            for (int x = 0; x <= patchSize_; ++x)
+            int xPos = coords.x_ * patchSize_ + x;
+            int zPos = coords.y_ * patchSize_ + z;
+
+            // Position
+            Vector3 position((float)x * spacing_.x_, GetRawHeight(xPos, zPos), (float)z * spacing_.z_);
+            *vertexData++ = position.x_;
+            *vertexData++ = position.y_;
+            *vertexData++ = position.z_;
+            *positionData++ = position.x_;
+            *positionData++ = position.y_;
+            *positionData++ = position.z_;
+
+            box.Merge(position);
+
+            // For vertices that are part of the occlusion LOD, calculate the minimum height in the neighborhood
+            // to prevent false positive occlusion due to inaccuracy between occlusion LOD & visible LOD
+            float minHeight = position.y_;
+            if (halfLodExpand > 0 && (x & lodExpand) == 0 && (z & lodExpand) == 0)
             {
-                int xPos = coords.x_ * patchSize_ + x;
-                int zPos = coords.y_ * patchSize_ + z;
-
-                // Position
-                Vector3 position((float)x * spacing_.x_, GetRawHeight(xPos, zPos), (float)z * spacing_.z_);
-                *vertexData++ = position.x_;
-                *vertexData++ = position.y_;
-                *vertexData++ = position.z_;
-                *positionData++ = position.x_;
-                *positionData++ = position.y_;
-                *positionData++ = position.z_;
-
-                box.Merge(position);
-
-                // For vertices that are part of the occlusion LOD, calculate the minimum height in the neighborhood
-                // to prevent false positive occlusion due to inaccuracy between occlusion LOD & visible LOD
-                float minHeight = position.y_;
-                if (halfLodExpand > 0 && (x & lodExpand) == 0 && (z & lodExpand) == 0)
+                int minX = Max(xPos - halfLodExpand, 0);
+                int maxX = Min(xPos + halfLodExpand, numVertices_.x_ - 1);
+                int minZ = Max(zPos - halfLodExpand, 0);
+                int maxZ = Min(zPos + halfLodExpand, numVertices_.y_ - 1);
+                for (int nZ = minZ; nZ <= maxZ; ++nZ)
                 {
-                    int minX = Max(xPos - halfLodExpand, 0);
-                    int maxX = Min(xPos + halfLodExpand, numVertices_.x_ - 1);
-                    int minZ = Max(zPos - halfLodExpand, 0);
-                    int maxZ = Min(zPos + halfLodExpand, numVertices_.y_ - 1);
-                    for (int nZ = minZ; nZ <= maxZ; ++nZ)
-                    {
-                        for (int nX = minX; nX <= maxX; ++nX)
-                            minHeight = Min(minHeight, GetRawHeight(nX, nZ));
-                    }
+                    for (int nX = minX; nX <= maxX; ++nX)
+                        minHeight = Min(minHeight, GetRawHeight(nX, nZ));
                 }
-                *occlusionData++ = position.x_;
-                *occlusionData++ = minHeight;
-                *occlusionData++ = position.z_;
-
-                // Normal
-                Vector3 normal = GetRawNormal(xPos, zPos);
-                *vertexData++ = normal.x_;
-                *vertexData++ = normal.y_;
-                *vertexData++ = normal.z_;
-
-                // Texture coordinate
-                Vector2 texCoord((float)xPos / (float)(numVertices_.x_ - 1), 1.0f - (float)zPos / (float)(numVertices_.y_ - 1));
-                *vertexData++ = texCoord.x_;
-                *vertexData++ = texCoord.y_;
-
-                // Tangent
-                Vector3 xyz = (Vector3::RIGHT - normal * normal.DotProduct(Vector3::RIGHT)).Normalized();
-                *vertexData++ = xyz.x_;
-                *vertexData++ = xyz.y_;
-                *vertexData++ = xyz.z_;
-                *vertexData++ = 1.0f;
             }
+            *occlusionData++ = position.x_;
+            *occlusionData++ = minHeight;
+            *occlusionData++ = position.z_;
+
+            // Normal
+            Vector3 normal = GetRawNormal(xPos, zPos);
+            *vertexData++ = normal.x_;
+            *vertexData++ = normal.y_;
+            *vertexData++ = normal.z_;
+
+            // Texture coordinate
+            Vector2 texCoord((float)xPos / (float)(numVertices_.x_ - 1), 1.0f - (float)zPos / (float)(numVertices_.y_ - 1));
+            *vertexData++ = texCoord.x_;
+            *vertexData++ = texCoord.y_;
+
+            // Tangent
+            Vector3 xyz = (Vector3::RIGHT - normal * normal.DotProduct(Vector3::RIGHT)).Normalized();
+            *vertexData++ = xyz.x_;
+            *vertexData++ = xyz.y_;
+            *vertexData++ = xyz.z_;
+            *vertexData++ = 1.0f;
         }
+    }
+}
+
+void Terrain::UploadPatchData(TerrainPatch* patch, const TerrainPatchData& data)
+{
+    unsigned row = (unsigned)(patchSize_ + 1);
+    VertexBuffer* vertexBuffer = patch->GetVertexBuffer();
+    Geometry* geometry = patch->GetGeometry();
+    Geometry* maxLodGeometry = patch->GetMaxLodGeometry();
+    Geometry* occlusionGeometry = patch->GetOcclusionGeometry();
+
+    if (vertexBuffer->GetVertexCount() != row * row)
+        vertexBuffer->SetSize(row * row, MASK_POSITION | MASK_NORMAL | MASK_TEXCOORD1 | MASK_TANGENT);
 
-        vertexBuffer->Unlock();
+    if (vertexBuffer->SetData(data.vertexData_.Get()))
         vertexBuffer->ClearDataLost();
-    }
 
-    patch->SetBoundingBox(box);
+    patch->SetBoundingBox(data.boundingBox_);
 
     if (drawRanges_.Size())
     {
-        unsigned occlusionDrawRange = occlusionLevel << 4;
+        unsigned occlusionDrawRange = GetPatchOcclusionLevel() << 4;
 
         geometry->SetIndexBuffer(indexBuffer_);
         geometry->SetDrawRange(TRIANGLE_LIST, drawRanges_[0].first_, drawRanges_[0].second_, false);
-        geometry->SetRawVertexData(cpuVertexData, MASK_POSITION);
+        geometry->SetRawVertexData(data.cpuVertexData_, MASK_POSITION);
         maxLodGeometry->SetIndexBuffer(indexBuffer_);
         maxLodGeometry->SetDrawRange(TRIANGLE_LIST, drawRanges_[0].first_, drawRanges_[0].second_, false);
-        maxLodGeometry->SetRawVertexData(cpuVertexData, MASK_POSITION);
+        maxLodGeometry->SetRawVertexData(data.cpuVertexData_, MASK_POSITION);
         occlusionGeometry->SetIndexBuffer(indexBuffer_);
         occlusionGeometry->SetDrawRange(TRIANGLE_LIST, drawRanges_[occlusionDrawRange].first_, drawRanges_[occlusionDrawRange].second_, false);
-        occlusionGeometry->SetRawVertexData(occlusionCpuVertexData, MASK_POSITION);
+        occlusionGeometry->SetRawVertexData(data.occlusionCpuVertexData_, MASK_POSITION);
     }
 
     patch->ResetLod();
 }
 
+unsigned Terrain::GetPatchOcclusionLevel() const
+{
+    return Min(occlusionLodLevel_, numLodLevels_ - 1);
+}
+
+unsigned Terrain::GetPatchEdges(const IntVector2& coords) const
+{
+    unsigned edges = 0;
+    if (coords.y_ == numPatches_.y_ - 1)
+        edges |= TERRAIN_EDGE_NORTH;
+    if (coords.y_ == 0)
+        edges |= TERRAIN_EDGE_SOUTH;
+    if (coords.x_ == 0)
+        edges |= TERRAIN_EDGE_WEST;
+    if (coords.x_ == numPatches_.x_ - 1)
+        edges |= TERRAIN_EDGE_EAST;
+    return edges;
+}
+// ATOMIC END
+
 void Terrain::UpdatePatchLod(TerrainPatch* patch)
 {
     Geometry* geometry = patch->GetGeometry();
@@ -783,6 +862,13 @@ void Terrain::UpdatePatchLod(TerrainPatch* patch)
             drawRangeIndex |= STITCH_WEST;
         if (east && east->GetLodLevel() > lodLevel)
             drawRangeIndex |= STITCH_EAST;
+
+        // ATOMIC BEGIN
+        // Patches along a coarser terrain are locked to LOD 0 and always stitch towards it. The stitch flags equal the
+        // TERRAIN_EDGE_* flags
+        if (coarseEdges_)
+            drawRangeIndex |= GetPatchEdges(patch->GetCoordinates()) & coarseEdges_;
+        // ATOMIC END
     }
 
     if (drawRangeIndex < drawRanges_.Size())
@@ -816,7 +902,9 @@ void Terrain::SetPatchSizeAttr(int value)
 
 void Terrain::SetMaxLodLevelsAttr(unsigned value)
 {
-    value = Clamp(value, MIN_LOD_LEVELS, MAX_LOD_LEVELS);
+    // ATOMIC BEGIN
+    value = Max(value, MIN_LOD_LEVELS);
+    // ATOMIC END
 
     if (value != maxLodLevels_)
     {
@@ -857,7 +945,7 @@ void Terrain::CreateGeometry()
 
     unsigned prevNumPatches = patches_.Size();
 
-    // Determine number of LOD levels
+    // Determine number of LOD levels. The patch size bounds the LOD count, as each level halves the resolution
     unsigned lodSize = (unsigned)patchSize_;
     numLodLevels_ = 1;
     while (lodSize > MIN_PATCH_SIZE && numLodLevels_ < maxLodLevels_)
@@ -1110,18 +1198,45 @@ void Terrain::CreateGeometry()
             }
         }
 
+        // ATOMIC BEGIN
+        // Generate vertex data and LOD errors for the dirty patches in worker threads, then upload the results to the GPU
+        // in the main thread. Work in batches to bound the amount of intermediate vertex data held at once
+        PODVector<TerrainPatch*> dirtyPatchList;
         for (unsigned i = 0; i < patches_.Size(); ++i)
         {
-            TerrainPatch* patch = patches_[i];
-
             if (dirtyPatches[i])
+                dirtyPatchList.Push(patches_[i]);
+        }
+
+        if (dirtyPatchList.Size())
+        {
+            ATOMIC_PROFILE(CreatePatchGeometries);
+
+            WorkQueue* queue = GetSubsystem<WorkQueue>();
+            Vector<TerrainPatchData> patchData(Min(dirtyPatchList.Size(), PATCHES_PER_GEOMETRY_BATCH));
+
+            for (unsigned start = 0; start < dirtyPatchList.Size(); start += PATCHES_PER_GEOMETRY_BATCH)
             {
-                CreatePatchGeometry(patch);
-                CalculateLodErrors(patch);
-            }
+                unsigned count = Min(dirtyPatchList.Size() - start, PATCHES_PER_GEOMETRY_BATCH);
+                TerrainPatch** batchPatches = &dirtyPatchList[start];
 
-            SetPatchNeighbors(patch);
+                queue->ParallelFor(0, count, 1, [this, batchPatches, &patchData](unsigned begin, unsigned end, unsigned threadIndex)
+                {
+                    for (unsigned i = begin; i < end; ++i)
+                    {
+                        GeneratePatchData(batchPatches[i], patchData[i]);
+                        CalculateLodErrors(batchPatches[i]);
+                    }
+                });
+
+                for (unsigned i = 0; i < count; ++i)
+                    UploadPatchData(batchPatches[i], patchData[i]);
+            }
         }
+
+        for (unsigned i = 0; i < patches_.Size(); ++i)
+            SetPatchNeighbors(patches_[i]);
+        // ATOMIC END
     }
 
     // Send event only if new geometry was generated, or the old was cleared
@@ -1364,7 +1479,7 @@ Vector3 Terrain::GetRawNormal(int x, int z) const
             Vector3(nwSlope, up, nwSlope)).Normalized();
 }
 
-void Terrain::CalculateLodErrors(TerrainPatch* patch)
+void Terrain::CalculateLodErrors(TerrainPatch* patch) const
 {
     ATOMIC_PROFILE(CalculateLodErrors);
 
@@ -1413,6 +1528,9 @@ void Terrain::SetPatchNeighbors(TerrainPatch* patch)
     const IntVector2& coords = patch->GetCoordinates();
     patch->SetNeighbors(GetNeighborPatch(coords.x_, coords.y_ + 1), GetNeighborPatch(coords.x_, coords.y_ - 1),
         GetNeighborPatch(coords.x_ - 1, coords.y_), GetNeighborPatch(coords.x_ + 1, coords.y_));
+    // ATOMIC BEGIN
+    patch->SetLodLocked((GetPatchEdges(coords) & (coarseEdges_ | fineEdges_)) != 0);
+    // ATOMIC END
 }
 
 bool Terrain::SetHeightMapInternal(Image* image, bool recreateNow)
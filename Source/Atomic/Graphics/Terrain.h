@@ -33,6 +33,15 @@ class IndexBuffer;
 class Material;
 class Node;
 class TerrainPatch;
+// ATOMIC BEGIN
+struct TerrainPatchData;
+
+/// Terrain edge flags.
+static const unsigned TERRAIN_EDGE_NORTH = 1;
+static const unsigned TERRAIN_EDGE_SOUTH = 2;
+static const unsigned TERRAIN_EDGE_WEST = 4;
+static const unsigned TERRAIN_EDGE_EAST = 8;
+// ATOMIC END
 
 /// Heightmap terrain component.
 class ATOMIC_API Terrain : public Component
@@ -58,7 +67,7 @@ public:
     void SetPatchSize(int size);
     /// Set vertex (XZ) and height (Y) spacing.
     void SetSpacing(const Vector3& spacing);
-    /// Set maximum number of LOD levels for terrain patches. This can be between 1-4.
+    /// Set maximum number of LOD levels for terrain patches. This is limited by the patch size as the coarsest level is 4 quads per side.
     void SetMaxLodLevels(unsigned levels);
     /// Set LOD level used for terrain patch occlusion. By default (M_MAX_UNSIGNED) the coarsest. Since the LOD level used needs to be fixed, using finer LOD levels may result in false positive occlusion in cases where the actual rendered geometry is coarser, so use with caution.
     void SetOcclusionLodLevel(unsigned level);
@@ -78,6 +87,12 @@ public:
     void SetEastNeighbor(Terrain* east);
     /// Set all neighbor terrains at once.
     void SetNeighbors(Terrain* north, Terrain* south, Terrain* west, Terrain* east);
+    // ATOMIC BEGIN
+    /// Set edges (TERRAIN_EDGE_* flags) that border a terrain with twice the vertex spacing. Patches along them stay at the finest LOD and skip every other edge vertex to meet the coarser terrain without cracks. Requires at least two LOD levels.
+    void SetCoarseEdges(unsigned edges);
+    /// Set edges (TERRAIN_EDGE_* flags) that border a terrain with half the vertex spacing. Patches along them stay at the finest LOD so that the finer terrain can stitch to them.
+    void SetFineEdges(unsigned edges);
+    // ATOMIC END
     /// Set draw distance for patches.
     void SetDrawDistance(float distance);
     /// Set shadow draw distance for patches.
@@ -115,7 +130,7 @@ public:
     /// Return heightmap size in patches.
     const IntVector2& GetNumPatches() const { return numPatches_; }
 
-    /// Return maximum number of LOD levels for terrain patches. This can be between 1-4.
+    /// Return maximum number of LOD levels for terrain patches.
     unsigned GetMaxLodLevels() const { return maxLodLevels_; }
     
     /// Return LOD level used for occlusion.
@@ -124,6 +139,14 @@ public:
     /// Return whether smoothing is in use.
     bool GetSmoothing() const { return smoothing_; }
 
+    // ATOMIC BEGIN
+    /// Return edges that border a coarser terrain.
+    unsigned GetCoarseEdges() const { return coarseEdges_; }
+
+    /// Return edges that border a finer terrain.
+    unsigned GetFineEdges() const { return fineEdges_; }
+    // ATOMIC END
+
     /// Return heightmap image.
     Image* GetHeightMap() const;
     /// Return material.
@@ -224,8 +247,18 @@ private:
     float GetLodHeight(int x, int z, unsigned lodLevel) const;
     /// Get slope-based terrain normal at position.
     Vector3 GetRawNormal(int x, int z) const;
-    /// Calculate LOD errors for a patch.
-    void CalculateLodErrors(TerrainPatch* patch);
+    /// Calculate LOD errors for a patch. Safe to call from worker threads.
+    void CalculateLodErrors(TerrainPatch* patch) const;
+    // ATOMIC BEGIN
+    /// Generate CPU-side vertex data and bounding box for a patch. Does not access GPU resources, so is safe to call from worker threads.
+    void GeneratePatchData(TerrainPatch* patch, TerrainPatchData& data) const;
+    /// Upload generated patch data to the patch vertex buffer and geometries. Must be called from the main thread.
+    void UploadPatchData(TerrainPatch* patch, const TerrainPatchData& data);
+    /// Return LOD level used for occlusion, clamped to the available levels.
+    unsigned GetPatchOcclusionLevel() const;
+    /// Return the terrain edges (TERRAIN_EDGE_* flags) that a patch lies on.
+    unsigned GetPatchEdges(const IntVector2& coords) const;
+    // ATOMIC END
     /// Set neighbors for a patch.
     void SetPatchNeighbors(TerrainPatch* patch);
     /// Set heightmap image and optionally recreate the geometry immediately. Return true if successful.
@@ -317,6 +350,12 @@ private:
     unsigned westID_;
     /// Node ID of east neighbor.
     unsigned eastID_;
+    // ATOMIC BEGIN
+    /// Edges bordering a coarser terrain.
+    unsigned coarseEdges_;
+    /// Edges bordering a finer terrain.
+    unsigned fineEdges_;
+    // ATOMIC END
     /// Terrain needs regeneration flag.
     bool recreateTerrain_;
     /// Terrain neighbor attributes dirty flag.
@@ -52,7 +52,10 @@ TerrainPatch::TerrainPatch(Context* context) :
     occlusionGeometry_(new Geometry(context)),
     vertexBuffer_(new VertexBuffer(context)),
     coordinates_(IntVector2::ZERO),
-    lodLevel_(0)
+    lodLevel_(0),
+    // ATOMIC BEGIN
+    lodLocked_(false)
+    // ATOMIC END
 {
     geometry_->SetVertexBuffer(0, vertexBuffer_);
     maxLodGeometry_->SetVertexBuffer(0, vertexBuffer_);
@@ -137,7 +140,9 @@ void TerrainPatch::UpdateBatches(const FrameInfo& frame)
             newLodLevel = i;
     }
 
-    lodLevel_ = GetCorrectedLodLevel(newLodLevel);
+    // ATOMIC BEGIN
+    lodLevel_ = lodLocked_ ? 0 : GetCorrectedLodLevel(newLodLevel);
+    // ATOMIC END
 }
 
 void TerrainPatch::UpdateGeometry(const FrameInfo& frame)
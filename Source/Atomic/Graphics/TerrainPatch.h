@@ -73,6 +73,10 @@ public:
     void SetCoordinates(const IntVector2& coordinates);
     /// Reset to LOD level 0.
     void ResetLod();
+    // ATOMIC BEGIN
+    /// Set whether the patch is locked to LOD level 0, for example along the border to a terrain of different vertex spacing.
+    void SetLodLocked(bool enable) { lodLocked_ = enable; }
+    // ATOMIC END
 
     /// Return visible geometry.
     Geometry* GetGeometry() const;
@@ -106,6 +110,11 @@ public:
     /// Return current LOD level.
     unsigned GetLodLevel() const { return lodLevel_; }
 
+    // ATOMIC BEGIN
+    /// Return whether the patch is locked to LOD level 0.
+    bool IsLodLocked() const { return lodLocked_; }
+    // ATOMIC END
+
 protected:
     /// Recalculate the world-space bounding box.
     virtual void OnWorldBoundingBoxUpdate();
@@ -138,6 +147,10 @@ private:
     IntVector2 coordinates_;
     /// Current LOD level.
     unsigned lodLevel_;
+    // ATOMIC BEGIN
+    /// LOD level 0 lock flag.
+    bool lodLocked_;
+    // ATOMIC END
 };
 
 }
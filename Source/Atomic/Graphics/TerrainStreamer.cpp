@@ -0,0 +1,675 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../Precompiled.h"
+
+#include "../Container/Sort.h"
+#include "../Core/Context.h"
+#include "../Core/Profiler.h"
+#include "../Graphics/Material.h"
+#include "../Graphics/Terrain.h"
+#include "../Graphics/TerrainStreamer.h"
+#include "../IO/Log.h"
+#include "../Resource/Image.h"
+#include "../Resource/ResourceCache.h"
+#include "../Resource/ResourceEvents.h"
+#include "../Scene/Node.h"
+#include "../Scene/Scene.h"
+#include "../Scene/SceneEvents.h"
+
+#include "../DebugNew.h"
+
+namespace Atomic
+{
+
+extern const char* GEOMETRY_CATEGORY;
+
+static const Vector3 DEFAULT_SPACING(1.0f, 0.25f, 1.0f);
+static const int DEFAULT_TILE_SIZE = 256;
+static const int DEFAULT_PATCH_SIZE = 32;
+static const unsigned DEFAULT_MAX_LOD_LEVELS = 4;
+static const unsigned DEFAULT_NUM_TILE_LEVELS = 1;
+static const int DEFAULT_LOAD_DISTANCE = 2;
+static const unsigned DEFAULT_MAX_TILES_PER_FRAME = 1;
+
+TerrainStreamer::TerrainStreamer(Context* context) :
+    Component(context),
+    numTiles_(IntVector2::ZERO),
+    spacing_(DEFAULT_SPACING),
+    tileSize_(DEFAULT_TILE_SIZE),
+    patchSize_(DEFAULT_PATCH_SIZE),
+    numTileLevels_(DEFAULT_NUM_TILE_LEVELS),
+    maxLodLevels_(DEFAULT_MAX_LOD_LEVELS),
+    loadDistance_(DEFAULT_LOAD_DISTANCE),
+    maxTilesPerFrame_(DEFAULT_MAX_TILES_PER_FRAME),
+    numCreatedTiles_(0),
+    smoothing_(false),
+    neighborsDirty_(false)
+{
+    tiles_.Resize(numTileLevels_);
+
+    SubscribeToEvent(E_RESOURCEBACKGROUNDLOADED, ATOMIC_HANDLER(TerrainStreamer, HandleResourceBackgroundLoaded));
+}
+
+TerrainStreamer::~TerrainStreamer()
+{
+    UnloadAllTiles();
+}
+
+void TerrainStreamer::RegisterObject(Context* context)
+{
+    context->RegisterFactory<TerrainStreamer>(GEOMETRY_CATEGORY);
+
+    ATOMIC_ACCESSOR_ATTRIBUTE("Is Enabled", IsEnabled, SetEnabled, bool, true, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Tile Name", GetTileName, SetTileName, String, String::EMPTY, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Number of Tiles", GetNumTiles, SetNumTiles, IntVector2, IntVector2::ZERO, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Tile Size", GetTileSize, SetTileSize, int, DEFAULT_TILE_SIZE, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Tile LOD Levels", GetNumTileLevels, SetNumTileLevels, unsigned, DEFAULT_NUM_TILE_LEVELS, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Vertex Spacing", GetSpacing, SetSpacing, Vector3, DEFAULT_SPACING, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Patch Size", GetPatchSize, SetPatchSize, int, DEFAULT_PATCH_SIZE, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Max LOD Levels", GetMaxLodLevels, SetMaxLodLevels, unsigned, DEFAULT_MAX_LOD_LEVELS, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Smooth Height Map", GetSmoothing, SetSmoothing, bool, false, AM_DEFAULT);
+    ATOMIC_MIXED_ACCESSOR_ATTRIBUTE("Material", GetMaterialAttr, SetMaterialAttr, ResourceRef, ResourceRef(Material::GetTypeStatic()),
+        AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Load Distance", GetLoadDistance, SetLoadDistance, int, DEFAULT_LOAD_DISTANCE, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Max Tiles Per Frame", GetMaxTilesPerFrame, SetMaxTilesPerFrame, unsigned, DEFAULT_MAX_TILES_PER_FRAME,
+        AM_DEFAULT);
+}
+
+void TerrainStreamer::OnSetEnabled()
+{
+    OnSceneSet(GetScene());
+}
+
+void TerrainStreamer::SetTileName(const String& name)
+{
+    if (name != tileName_)
+    {
+        tileName_ = name;
+        UnloadAllTiles();
+        MarkNetworkUpdate();
+    }
+}
+
+void TerrainStreamer::SetNumTiles(const IntVector2& numTiles)
+{
+    IntVector2 newNumTiles(Max(numTiles.x_, 0), Max(numTiles.y_, 0));
+    if (newNumTiles != numTiles_)
+    {
+        numTiles_ = newNumTiles;
+        UnloadAllTiles();
+        MarkNetworkUpdate();
+    }
+}
+
+void TerrainStreamer::SetTileSize(int size)
+{
+    if (size > 0 && size != tileSize_)
+    {
+        tileSize_ = size;
+        UnloadAllTiles();
+        MarkNetworkUpdate();
+    }
+}
+
+void TerrainStreamer::SetNumTileLevels(unsigned levels)
+{
+    levels = Max(levels, 1U);
+    if (levels != numTileLevels_)
+    {
+        UnloadAllTiles();
+        numTileLevels_ = levels;
+        tiles_.Resize(numTileLevels_);
+        MarkNetworkUpdate();
+    }
+}
+
+void TerrainStreamer::SetSpacing(const Vector3& spacing)
+{
+    if (spacing != spacing_)
+    {
+        spacing_ = spacing;
+        UnloadAllTiles();
+        MarkNetworkUpdate();
+    }
+}
+
+void TerrainStreamer::SetPatchSize(int size)
+{
+    if (size != patchSize_)
+    {
+        patchSize_ = size;
+        UnloadAllTiles();
+        MarkNetworkUpdate();
+    }
+}
+
+void TerrainStreamer::SetMaxLodLevels(unsigned levels)
+{
+    if (levels != maxLodLevels_)
+    {
+        maxLodLevels_ = levels;
+        for (unsigned i = 0; i < tiles_.Size(); ++i)
+        {
+            for (HashMap<IntVector2, Tile>::Iterator j = tiles_[i].Begin(); j != tiles_[i].End(); ++j)
+            {
+                if (j->second_.terrain_)
+                    j->second_.terrain_->SetMaxLodLevels(levels);
+            }
+        }
+        MarkNetworkUpdate();
+    }
+}
+
+void TerrainStreamer::SetSmoothing(bool enable)
+{
+    if (enable != smoothing_)
+    {
+        smoothing_ = enable;
+        for (unsigned i = 0; i < tiles_.Size(); ++i)
+        {
+            for (HashMap<IntVector2, Tile>::Iterator j = tiles_[i].Begin(); j != tiles_[i].End(); ++j)
+            {
+                if (j->second_.terrain_)
+                    j->second_.terrain_->SetSmoothing(enable);
+            }
+        }
+        MarkNetworkUpdate();
+    }
+}
+
+void TerrainStreamer::SetMaterial(Material* material)
+{
+    material_ = material;
+    for (unsigned i = 0; i < tiles_.Size(); ++i)
+    {
+        for (HashMap<IntVector2, Tile>::Iterator j = tiles_[i].Begin(); j != tiles_[i].End(); ++j)
+        {
+            if (j->second_.terrain_)
+                j->second_.terrain_->SetMaterial(material);
+        }
+    }
+    MarkNetworkUpdate();
+}
+
+void TerrainStreamer::SetLoadDistance(int distance)
+{
+    loadDistance_ = Max(distance, 0);
+    MarkNetworkUpdate();
+}
+
+void TerrainStreamer::SetMaxTilesPerFrame(unsigned num)
+{
+    maxTilesPerFrame_ = Max(num, 1U);
+    MarkNetworkUpdate();
+}
+
+void TerrainStreamer::SetFocusNode(Node* node)
+{
+    focusNode_ = node;
+}
+
+Material* TerrainStreamer::GetMaterial() const
+{
+    return material_;
+}
+
+IntVector2 TerrainStreamer::WorldToTile(const Vector3& worldPosition, unsigned level) const
+{
+    if (!node_)
+        return IntVector2::ZERO;
+
+    Vector3 position = node_->GetWorldTransform().Inverse() * worldPosition;
+    float levelTileSize = (float)(tileSize_ << level);
+    return IntVector2(FloorToInt(position.x_ / (spacing_.x_ * levelTileSize)), FloorToInt(position.z_ / (spacing_.z_ * levelTileSize)));
+}
+
+Terrain* TerrainStreamer::GetTileTerrain(const IntVector2& coords, unsigned level) const
+{
+    if (level >= tiles_.Size())
+        return 0;
+
+    HashMap<IntVector2, Tile>::ConstIterator i = tiles_[level].Find(coords);
+    return i != tiles_[level].End() ? i->second_.terrain_.Get() : (Terrain*)0;
+}
+
+float TerrainStreamer::GetHeight(const Vector3& worldPosition) const
+{
+    for (unsigned i = 0; i < tiles_.Size(); ++i)
+    {
+        Terrain* terrain = GetVisibleTerrain(i, WorldToTile(worldPosition, i));
+        if (terrain)
+            return terrain->GetHeight(worldPosition);
+    }
+
+    return 0.0f;
+}
+
+unsigned TerrainStreamer::GetNumLoadedTiles() const
+{
+    unsigned num = 0;
+    for (unsigned i = 0; i < tiles_.Size(); ++i)
+    {
+        for (HashMap<IntVector2, Tile>::ConstIterator j = tiles_[i].Begin(); j != tiles_[i].End(); ++j)
+        {
+            if (j->second_.state_ == TILE_LOADED)
+                ++num;
+        }
+    }
+    return num;
+}
+
+unsigned TerrainStreamer::GetNumVisibleTiles() const
+{
+    unsigned num = 0;
+    for (unsigned i = 0; i < tiles_.Size(); ++i)
+    {
+        for (HashMap<IntVector2, Tile>::ConstIterator j = tiles_[i].Begin(); j != tiles_[i].End(); ++j)
+        {
+            if (j->second_.visible_ && j->second_.terrain_)
+                ++num;
+        }
+    }
+    return num;
+}
+
+unsigned TerrainStreamer::GetNumPendingTiles() const
+{
+    unsigned num = 0;
+    for (unsigned i = 0; i < tiles_.Size(); ++i)
+    {
+        for (HashMap<IntVector2, Tile>::ConstIterator j = tiles_[i].Begin(); j != tiles_[i].End(); ++j)
+        {
+            if (j->second_.state_ == TILE_LOADING)
+                ++num;
+        }
+    }
+    return num;
+}
+
+void TerrainStreamer::SetMaterialAttr(const ResourceRef& value)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    SetMaterial(cache->GetResource<Material>(value.name_));
+}
+
+ResourceRef TerrainStreamer::GetMaterialAttr() const
+{
+    return GetResourceRef(material_, Material::GetTypeStatic());
+}
+
+void TerrainStreamer::OnSceneSet(Scene* scene)
+{
+    if (scene && IsEnabledEffective())
+        SubscribeToEvent(scene, E_SCENEUPDATE, ATOMIC_HANDLER(TerrainStreamer, HandleSceneUpdate));
+    else
+        UnsubscribeFromEvent(E_SCENEUPDATE);
+
+    if (!scene)
+        UnloadAllTiles();
+}
+
+void TerrainStreamer::HandleSceneUpdate(StringHash eventType, VariantMap& eventData)
+{
+    UpdateTiles();
+}
+
+void TerrainStreamer::HandleResourceBackgroundLoaded(StringHash eventType, VariantMap& eventData)
+{
+    using namespace ResourceBackgroundLoaded;
+
+    if (eventData[P_SUCCESS].GetBool() && eventData[P_RESOURCE].GetPtr())
+        return;
+
+    // A tile whose heightmap failed to load would otherwise wait for it forever
+    const String& name = eventData[P_RESOURCENAME].GetString();
+    for (unsigned i = 0; i < tiles_.Size(); ++i)
+    {
+        for (HashMap<IntVector2, Tile>::Iterator j = tiles_[i].Begin(); j != tiles_[i].End(); ++j)
+        {
+            Tile& tile = j->second_;
+            if (tile.state_ == TILE_LOADING && tile.imageName_ == name)
+            {
+                ATOMIC_LOGWARNING("Terrain tile heightmap " + name + " failed to load");
+                tile.state_ = TILE_MISSING;
+                return;
+            }
+        }
+    }
+}
+
+void TerrainStreamer::UpdateTiles()
+{
+    if (!node_ || tileName_.Empty() || !numTiles_.x_ || !numTiles_.y_)
+        return;
+
+    ATOMIC_PROFILE(UpdateTerrainTiles);
+
+    Vector3 focusPosition = focusNode_ ? focusNode_->GetWorldPosition() : node_->GetWorldPosition();
+    numCreatedTiles_ = 0;
+
+    for (unsigned i = 0; i < tiles_.Size(); ++i)
+    {
+        for (HashMap<IntVector2, Tile>::Iterator j = tiles_[i].Begin(); j != tiles_[i].End(); ++j)
+        {
+            j->second_.requested_ = false;
+            j->second_.visible_ = false;
+        }
+    }
+
+    // Select the visible tiles from the roots of the quadtree, which are the coarsest level tiles within the load distance.
+    // Nearest first, so that they also load first
+    unsigned topLevel = numTileLevels_ - 1;
+    IntVector2 focus = WorldToTile(focusPosition, topLevel);
+    IntVector2 numTopTiles = GetNumLevelTiles(topLevel);
+    PODVector<IntVector2> roots;
+    for (int z = Max(focus.y_ - loadDistance_, 0); z <= Min(focus.y_ + loadDistance_, numTopTiles.y_ - 1); ++z)
+    {
+        for (int x = Max(focus.x_ - loadDistance_, 0); x <= Min(focus.x_ + loadDistance_, numTopTiles.x_ - 1); ++x)
+            roots.Push(IntVector2(x, z));
+    }
+
+    Sort(roots.Begin(), roots.End(), [&focus](const IntVector2& lhs, const IntVector2& rhs)
+    {
+        return Max(Abs(lhs.x_ - focus.x_), Abs(lhs.y_ - focus.y_)) < Max(Abs(rhs.x_ - focus.x_), Abs(rhs.y_ - focus.y_));
+    });
+
+    for (unsigned i = 0; i < roots.Size(); ++i)
+        SelectTile(topLevel, roots[i], focusPosition);
+
+    // Unload tiles that were not requested and are beyond the load distance. Keep one extra ring to avoid reloading when
+    // the focus moves back and forth across a tile border
+    bool tilesChanged = numCreatedTiles_ > 0;
+    for (unsigned i = 0; i < tiles_.Size(); ++i)
+    {
+        IntVector2 levelFocus = WorldToTile(focusPosition, i);
+        PODVector<IntVector2> farTiles;
+        for (HashMap<IntVector2, Tile>::Iterator j = tiles_[i].Begin(); j != tiles_[i].End(); ++j)
+        {
+            const IntVector2& coords = j->first_;
+            if (!j->second_.requested_ && Max(Abs(coords.x_ - levelFocus.x_), Abs(coords.y_ - levelFocus.y_)) > loadDistance_ + 1)
+                farTiles.Push(coords);
+        }
+        for (unsigned j = 0; j < farTiles.Size(); ++j)
+        {
+            HashMap<IntVector2, Tile>::Iterator k = tiles_[i].Find(farTiles[j]);
+            UnloadTile(k->second_);
+            tiles_[i].Erase(k);
+        }
+        if (farTiles.Size())
+            tilesChanged = true;
+    }
+
+    // Show the selected tiles and hide the rest
+    for (unsigned i = 0; i < tiles_.Size(); ++i)
+    {
+        for (HashMap<IntVector2, Tile>::Iterator j = tiles_[i].Begin(); j != tiles_[i].End(); ++j)
+        {
+            Tile& tile = j->second_;
+            if (tile.node_ && tile.node_->IsEnabled() != tile.visible_)
+            {
+                tile.node_->SetEnabled(tile.visible_);
+                tilesChanged = true;
+            }
+        }
+    }
+
+    if (tilesChanged)
+        neighborsDirty_ = true;
+
+    if (neighborsDirty_)
+        UpdateTileNeighbors();
+}
+
+void TerrainStreamer::SelectTile(unsigned level, const IntVector2& coords, const Vector3& focusPosition)
+{
+    Tile& tile = RequestTile(level, coords, focusPosition);
+
+    if (level > 0)
+    {
+        // Split when the focus is closer to the tile than the load distance plus one, measured in tiles of the child level.
+        // Splitting within at least two child tiles keeps adjacent visible tiles within one level of each other, which
+        // stitching requires
+        Vector3 position = node_->GetWorldTransform().Inverse() * focusPosition;
+        float childTileSize = (float)(tileSize_ << (level - 1));
+        float focusX = position.x_ / (spacing_.x_ * childTileSize);
+        float focusZ = position.z_ / (spacing_.z_ * childTileSize);
+        IntVector2 firstChild(coords.x_ * 2, coords.y_ * 2);
+        float dx = Max(Max((float)firstChild.x_ - focusX, focusX - (float)(firstChild.x_ + 2)), 0.0f);
+        float dz = Max(Max((float)firstChild.y_ - focusZ, focusZ - (float)(firstChild.y_ + 2)), 0.0f);
+
+        if (Max(dx, dz) < (float)(Max(loadDistance_, 1) + 1))
+        {
+            IntVector2 numChildTiles = GetNumLevelTiles(level - 1);
+            PODVector<IntVector2> children;
+            bool childrenReady = true;
+            for (int z = firstChild.y_; z <= firstChild.y_ + 1 && z < numChildTiles.y_; ++z)
+            {
+                for (int x = firstChild.x_; x <= firstChild.x_ + 1 && x < numChildTiles.x_; ++x)
+                {
+                    IntVector2 childCoords(x, z);
+                    if (RequestTile(level - 1, childCoords, focusPosition).state_ != TILE_LOADED)
+                        childrenReady = false;
+                    children.Push(childCoords);
+                }
+            }
+
+            // Keep showing this tile until all the children can replace it. A missing child would leave a hole, so a tile
+            // with missing children is never split
+            if (childrenReady)
+            {
+                for (unsigned i = 0; i < children.Size(); ++i)
+                    SelectTile(level - 1, children[i], focusPosition);
+                return;
+            }
+        }
+    }
+
+    tile.visible_ = true;
+}
+
+TerrainStreamer::Tile& TerrainStreamer::RequestTile(unsigned level, const IntVector2& coords, const Vector3& focusPosition)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+
+    HashMap<IntVector2, Tile>::Iterator i = tiles_[level].Find(coords);
+    if (i == tiles_[level].End())
+    {
+        i = tiles_[level].Insert(MakePair(coords, Tile()));
+        Tile& tile = i->second_;
+        tile.imageName_ = GetTileImageName(level, coords);
+        tile.state_ = TILE_LOADING;
+        tile.requested_ = false;
+        tile.visible_ = false;
+
+        if (!cache->Exists(tile.imageName_))
+        {
+            ATOMIC_LOGWARNING("Terrain tile heightmap " + tile.imageName_ + " not found");
+            tile.state_ = TILE_MISSING;
+        }
+        else
+        {
+            // The focus tile and its immediate neighbors of each level are needed now, the rest are prefetched
+            IntVector2 focus = WorldToTile(focusPosition, level);
+            int distance = Max(Abs(coords.x_ - focus.x_), Abs(coords.y_ - focus.y_));
+            cache->BackgroundLoadResource<Image>(tile.imageName_, true, 0,
+                distance <= 1 ? BACKGROUND_LOAD_PRIORITY_HIGH : BACKGROUND_LOAD_PRIORITY_PREFETCH - distance);
+        }
+    }
+
+    Tile& tile = i->second_;
+    tile.requested_ = true;
+
+    // Create the terrain once the heightmap has finished loading
+    if (tile.state_ == TILE_LOADING && numCreatedTiles_ < maxTilesPerFrame_)
+    {
+        Image* image = cache->GetExistingResource<Image>(tile.imageName_);
+        if (image)
+        {
+            CreateTileTerrain(level, coords, tile, image);
+            ++numCreatedTiles_;
+        }
+    }
+
+    return tile;
+}
+
+void TerrainStreamer::CreateTileTerrain(unsigned level, const IntVector2& coords, Tile& tile, Image* image)
+{
+    if (image->GetWidth() != tileSize_ + 1 || image->GetHeight() != tileSize_ + 1)
+    {
+        ATOMIC_LOGWARNING("Terrain tile heightmap " + tile.imageName_ + " is not " + String(tileSize_ + 1) + " pixels per side");
+    }
+
+    // Each tile level doubles the horizontal vertex spacing, as the tile images have the same size on all levels
+    float levelScale = (float)(1 << level);
+    Vector3 levelSpacing(spacing_.x_ * levelScale, spacing_.y_, spacing_.z_ * levelScale);
+    Vector2 tileWorldSize(levelSpacing.x_ * (float)tileSize_, levelSpacing.z_ * (float)tileSize_);
+
+    // Create the tile node as local and temporary, as the tiles are recreated by streaming. It stays disabled until selected
+    tile.node_ = node_->CreateTemporaryChild("Tile_" + String(level) + "_" + String(coords.x_) + "_" + String(coords.y_), LOCAL);
+    tile.node_->SetPosition(Vector3(((float)coords.x_ + 0.5f) * tileWorldSize.x_, 0.0f, ((float)coords.y_ + 0.5f) * tileWorldSize.y_));
+    tile.node_->SetEnabled(false);
+
+    Terrain* terrain = tile.node_->CreateComponent<Terrain>();
+    terrain->SetPatchSize(patchSize_);
+    terrain->SetSpacing(levelSpacing);
+    terrain->SetMaxLodLevels(maxLodLevels_);
+    terrain->SetSmoothing(smoothing_);
+    terrain->SetMaterial(material_);
+    terrain->SetHeightMap(image);
+
+    tile.terrain_ = terrain;
+    tile.state_ = TILE_LOADED;
+}
+
+void TerrainStreamer::UnloadTile(Tile& tile)
+{
+    if (tile.node_)
+    {
+        tile.node_->Remove();
+        tile.node_.Reset();
+    }
+    tile.terrain_.Reset();
+
+    // Cancel a heightmap still loading in the background, or release it from the cache once no terrain uses it
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    if (tile.state_ == TILE_LOADING && cache->CancelBackgroundLoadResource<Image>(tile.imageName_))
+        return;
+    if (tile.state_ != TILE_MISSING)
+        cache->ReleaseResource<Image>(tile.imageName_);
+}
+
+void TerrainStreamer::UnloadAllTiles()
+{
+    for (unsigned i = 0; i < tiles_.Size(); ++i)
+    {
+        for (HashMap<IntVector2, Tile>::Iterator j = tiles_[i].Begin(); j != tiles_[i].End(); ++j)
+            UnloadTile(j->second_);
+        tiles_[i].Clear();
+    }
+
+    neighborsDirty_ = false;
+}
+
+void TerrainStreamer::UpdateTileNeighbors()
+{
+    for (unsigned i = 0; i < tiles_.Size(); ++i)
+    {
+        for (HashMap<IntVector2, Tile>::Iterator j = tiles_[i].Begin(); j != tiles_[i].End(); ++j)
+        {
+            Terrain* terrain = j->second_.terrain_;
+            if (!terrain)
+                continue;
+
+            const IntVector2& coords = j->first_;
+            if (!j->second_.visible_)
+            {
+                terrain->SetNeighbors(0, 0, 0, 0);
+                terrain->SetCoarseEdges(0);
+                terrain->SetFineEdges(0);
+                continue;
+            }
+
+            terrain->SetNeighbors(GetVisibleTerrain(i, IntVector2(coords.x_, coords.y_ + 1)),
+                GetVisibleTerrain(i, IntVector2(coords.x_, coords.y_ - 1)), GetVisibleTerrain(i, IntVector2(coords.x_ - 1, coords.y_)),
+                GetVisibleTerrain(i, IntVector2(coords.x_ + 1, coords.y_)));
+            terrain->SetCoarseEdges(GetLevelEdges(i, coords, (int)i + 1));
+            terrain->SetFineEdges(GetLevelEdges(i, coords, (int)i - 1));
+        }
+    }
+
+    neighborsDirty_ = false;
+}
+
+Terrain* TerrainStreamer::GetVisibleTerrain(unsigned level, const IntVector2& coords) const
+{
+    if (level >= tiles_.Size())
+        return 0;
+
+    HashMap<IntVector2, Tile>::ConstIterator i = tiles_[level].Find(coords);
+    return i != tiles_[level].End() && i->second_.visible_ ? i->second_.terrain_.Get() : (Terrain*)0;
+}
+
+unsigned TerrainStreamer::GetLevelEdges(unsigned level, const IntVector2& coords, int otherLevel) const
+{
+    if (otherLevel < 0 || otherLevel >= (int)tiles_.Size())
+        return 0;
+
+    static const unsigned edgeFlags[] = { TERRAIN_EDGE_NORTH, TERRAIN_EDGE_SOUTH, TERRAIN_EDGE_WEST, TERRAIN_EDGE_EAST };
+    static const IntVector2 edgeOffsets[] = { IntVector2(0, 1), IntVector2(0, -1), IntVector2(-1, 0), IntVector2(1, 0) };
+
+    IntVector2 numLevelTiles = GetNumLevelTiles(level);
+    unsigned edges = 0;
+
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        IntVector2 neighbor = coords + edgeOffsets[i];
+        if (neighbor.x_ < 0 || neighbor.y_ < 0 || neighbor.x_ >= numLevelTiles.x_ || neighbor.y_ >= numLevelTiles.y_)
+            continue;
+
+        // A coarser neighbor is the parent of the neighbor cell. A finer neighbor is any child of the neighbor cell touching
+        // this tile; checking the one at the start of the shared edge is enough, as the quadtree splits all children at once
+        IntVector2 otherCoords;
+        if (otherLevel > (int)level)
+            otherCoords = IntVector2(neighbor.x_ >> 1, neighbor.y_ >> 1);
+        else
+            otherCoords = IntVector2(neighbor.x_ * 2 + (edgeOffsets[i].x_ < 0 ? 1 : 0), neighbor.y_ * 2 + (edgeOffsets[i].y_ < 0 ? 1 : 0));
+
+        if (GetVisibleTerrain((unsigned)otherLevel, otherCoords))
+            edges |= edgeFlags[i];
+    }
+
+    return edges;
+}
+
+IntVector2 TerrainStreamer::GetNumLevelTiles(unsigned level) const
+{
+    return IntVector2(((numTiles_.x_ - 1) >> level) + 1, ((numTiles_.y_ - 1) >> level) + 1);
+}
+
+String TerrainStreamer::GetTileImageName(unsigned level, const IntVector2& coords) const
+{
+    return tileName_.Replaced("{x}", String(coords.x_)).Replaced("{z}", String(coords.y_)).Replaced("{lod}", String(level));
+}
+
+}
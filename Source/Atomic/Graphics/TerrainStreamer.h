@@ -0,0 +1,209 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Container/HashMap.h"
+#include "../Scene/Component.h"
+
+namespace Atomic
+{
+
+class Image;
+class Material;
+class Terrain;
+
+/// Streams a grid of heightmap tiles around a focus node, creating a Terrain child node for each loaded tile. Tile heightmaps are loaded in the background and tiles beyond the load distance are released again, so that large worlds do not need to be resident at once. Neighboring tiles must duplicate their shared edge pixels, so a tile image is (tile size + 1) pixels per side.
+///
+/// With more than one tile LOD level the tiles form a quadtree: a level N tile covers 2x2 tiles of level N - 1 with the same image size, so its vertex spacing doubles. Tiles of the coarsest level are streamed within the load distance, and each tile is replaced by its four children once the focus is within the load distance of them, measured in tiles of the child level. Tiles are only split after all their children have loaded, so the terrain never has holes while refining. Where tiles of adjacent levels meet, the finer tile stitches to the coarser one, which requires the coarser level image pixels along tile edges to equal every other pixel of the finer level.
+class ATOMIC_API TerrainStreamer : public Component
+{
+    ATOMIC_OBJECT(TerrainStreamer, Component);
+
+public:
+    /// Construct.
+    TerrainStreamer(Context* context);
+    /// Destruct.
+    ~TerrainStreamer();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Handle enabled/disabled state change.
+    virtual void OnSetEnabled();
+
+    /// Set heightmap tile resource name. "{x}" and "{z}" are replaced with the tile coordinates, and "{lod}" with the tile LOD level.
+    void SetTileName(const String& name);
+    /// Set number of tiles on the X and Z axes.
+    void SetNumTiles(const IntVector2& numTiles);
+    /// Set tile size in quads per side. Must be a multiple of the patch size.
+    void SetTileSize(int size);
+    /// Set vertex (XZ) and height (Y) spacing of the tile terrains.
+    void SetSpacing(const Vector3& spacing);
+    /// Set patch quads per side of the tile terrains. Must be a power of two.
+    void SetPatchSize(int size);
+    /// Set number of tile quadtree levels. Level 0 is the finest. There is no maximum, but levels beyond the one where a single tile covers the grid are not useful.
+    void SetNumTileLevels(unsigned levels);
+    /// Set maximum number of LOD levels of the tile terrains. Must be at least 2 to stitch tiles of different levels.
+    void SetMaxLodLevels(unsigned levels);
+    /// Set heightmap smoothing of the tile terrains.
+    void SetSmoothing(bool enable);
+    /// Set material of the tile terrains.
+    void SetMaterial(Material* material);
+    /// Set load distance in tiles from the focus tile. Tiles are unloaded once they are more than one tile further away.
+    void SetLoadDistance(int distance);
+    /// Set maximum number of tile terrains to create per frame.
+    void SetMaxTilesPerFrame(unsigned num);
+    /// Set the node around which tiles are streamed. If null, the grid origin is used.
+    void SetFocusNode(Node* node);
+
+    /// Return heightmap tile resource name.
+    const String& GetTileName() const { return tileName_; }
+    /// Return number of tiles on the X and Z axes.
+    const IntVector2& GetNumTiles() const { return numTiles_; }
+    /// Return tile size in quads per side.
+    int GetTileSize() const { return tileSize_; }
+    /// Return vertex and height spacing.
+    const Vector3& GetSpacing() const { return spacing_; }
+    /// Return patch quads per side.
+    int GetPatchSize() const { return patchSize_; }
+    /// Return number of tile quadtree levels.
+    unsigned GetNumTileLevels() const { return numTileLevels_; }
+    /// Return maximum number of LOD levels.
+    unsigned GetMaxLodLevels() const { return maxLodLevels_; }
+    /// Return heightmap smoothing.
+    bool GetSmoothing() const { return smoothing_; }
+    /// Return material.
+    Material* GetMaterial() const;
+    /// Return load distance in tiles.
+    int GetLoadDistance() const { return loadDistance_; }
+    /// Return maximum number of tile terrains to create per frame.
+    unsigned GetMaxTilesPerFrame() const { return maxTilesPerFrame_; }
+    /// Return focus node.
+    Node* GetFocusNode() const { return focusNode_; }
+    /// Return tile coordinates of a tile LOD level containing a world position. May be outside the grid.
+    IntVector2 WorldToTile(const Vector3& worldPosition, unsigned level = 0) const;
+    /// Return the terrain of a tile, or null if not loaded.
+    Terrain* GetTileTerrain(const IntVector2& coords, unsigned level = 0) const;
+    /// Return terrain height at world coordinates from the finest visible tile, or zero if no tile is visible there.
+    float GetHeight(const Vector3& worldPosition) const;
+    /// Return number of tiles with a terrain created.
+    unsigned GetNumLoadedTiles() const;
+    /// Return number of tiles currently shown.
+    unsigned GetNumVisibleTiles() const;
+    /// Return number of tiles waiting for their heightmap.
+    unsigned GetNumPendingTiles() const;
+
+    /// Set material attribute.
+    void SetMaterialAttr(const ResourceRef& value);
+    /// Return material attribute.
+    ResourceRef GetMaterialAttr() const;
+
+protected:
+    /// Handle scene being assigned.
+    virtual void OnSceneSet(Scene* scene);
+
+private:
+    /// Tile streaming state.
+    enum TileState
+    {
+        TILE_LOADING = 0,
+        TILE_LOADED,
+        TILE_MISSING
+    };
+
+    /// Streamed tile.
+    struct Tile
+    {
+        /// Heightmap resource name.
+        String imageName_;
+        /// Tile node, created once the heightmap has loaded.
+        SharedPtr<Node> node_;
+        /// Tile terrain.
+        WeakPtr<Terrain> terrain_;
+        /// Streaming state.
+        TileState state_;
+        /// Whether the tile was requested during the last update.
+        bool requested_;
+        /// Whether the tile is shown.
+        bool visible_;
+    };
+
+    /// Handle scene update.
+    void HandleSceneUpdate(StringHash eventType, VariantMap& eventData);
+    /// Handle a background loaded resource. Marks tiles whose heightmap failed to load as missing.
+    void HandleResourceBackgroundLoaded(StringHash eventType, VariantMap& eventData);
+    /// Request tiles within the load distance, create terrains for loaded tiles and unload far tiles.
+    void UpdateTiles();
+    /// Request a tile and either show it or split it into its children, depending on the focus distance.
+    void SelectTile(unsigned level, const IntVector2& coords, const Vector3& focusPosition);
+    /// Return a tile, starting to load its heightmap if not requested before, and mark it requested.
+    Tile& RequestTile(unsigned level, const IntVector2& coords, const Vector3& focusPosition);
+    /// Create the terrain for a tile whose heightmap has loaded.
+    void CreateTileTerrain(unsigned level, const IntVector2& coords, Tile& tile, Image* image);
+    /// Remove a tile's node and release its heightmap.
+    void UnloadTile(Tile& tile);
+    /// Remove all tiles, so that they are streamed in again with the current settings.
+    void UnloadAllTiles();
+    /// Link visible tile terrains to their visible neighbors of the same level and mark the edges towards other levels for seamless LOD stitching.
+    void UpdateTileNeighbors();
+    /// Return the terrain of a tile if it is shown.
+    Terrain* GetVisibleTerrain(unsigned level, const IntVector2& coords) const;
+    /// Return the edges of a visible tile that border a visible tile of another level.
+    unsigned GetLevelEdges(unsigned level, const IntVector2& coords, int otherLevel) const;
+    /// Return number of tiles on the X and Z axes at a tile LOD level.
+    IntVector2 GetNumLevelTiles(unsigned level) const;
+    /// Return heightmap resource name for tile coordinates.
+    String GetTileImageName(unsigned level, const IntVector2& coords) const;
+
+    /// Streamed tiles by coordinates for each tile LOD level.
+    Vector<HashMap<IntVector2, Tile> > tiles_;
+    /// Focus node.
+    WeakPtr<Node> focusNode_;
+    /// Material.
+    SharedPtr<Material> material_;
+    /// Heightmap tile resource name.
+    String tileName_;
+    /// Number of tiles on the X and Z axes.
+    IntVector2 numTiles_;
+    /// Vertex and height spacing.
+    Vector3 spacing_;
+    /// Tile size in quads per side.
+    int tileSize_;
+    /// Patch size of the tile terrains.
+    int patchSize_;
+    /// Number of tile quadtree levels.
+    unsigned numTileLevels_;
+    /// Maximum number of LOD levels of the tile terrains.
+    unsigned maxLodLevels_;
+    /// Load distance in tiles.
+    int loadDistance_;
+    /// Maximum number of tile terrains to create per frame.
+    unsigned maxTilesPerFrame_;
+    /// Number of tile terrains created during the current update.
+    unsigned numCreatedTiles_;
+    /// Heightmap smoothing flag.
+    bool smoothing_;
+    /// Tile neighbors need relinking flag.
+    bool neighborsDirty_;
+};
+
+}
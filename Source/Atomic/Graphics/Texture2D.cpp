@@ -40,7 +40,11 @@ namespace Atomic
 {
 
 Texture2D::Texture2D(Context* context) :
-    Texture(context)
+    Texture(context),
+    // ATOMIC BEGIN
+    reducedMips_(0),
+    minQualityReached_(false)
+    // ATOMIC END
 {
 #ifdef ATOMIC_OPENGL
     target_ = GL_TEXTURE_2D;
@@ -109,6 +113,93 @@ bool Texture2D::EndLoad()
     return success;
 }
 
+// ATOMIC BEGIN
+bool Texture2D::ReduceQuality()
+{
+    // Only textures loaded from a file, and not used as rendertargets, can be reloaded at a lower quality
+    if (minQualityReached_ || !graphics_ || graphics_->IsDeviceLost() || usage_ >= TEXTURE_RENDERTARGET || GetName().Empty() ||
+        levels_ <= 1)
+        return false;
+
+    // Check from the current size whether SetData() can skip one more mip level before reloading: compressed mips are
+    // kept at least 4 texels wide and high, and uncompressed images can not be halved below 1x1
+    if (IsCompressed() ? (width_ / 2 < 4 || height_ / 2 < 4) : (width_ <= 1 && height_ <= 1))
+    {
+        minQualityReached_ = true;
+        return false;
+    }
+
+    SharedPtr<File> file = GetSubsystem<ResourceCache>()->GetFile(GetName(), false);
+    if (!file)
+    {
+        minQualityReached_ = true;
+        return false;
+    }
+
+    Renderer* renderer = GetSubsystem<Renderer>();
+    int quality = renderer ? renderer->GetTextureQuality() : QUALITY_HIGH;
+    unsigned oldMipsToSkip[MAX_TEXTURE_QUALITY_LEVELS];
+    for (int i = 0; i < MAX_TEXTURE_QUALITY_LEVELS; ++i)
+        oldMipsToSkip[i] = mipsToSkip_[i];
+    unsigned oldMemoryUse = GetMemoryUse();
+
+    // Lower quality levels must skip at least as many mips, as SetMipsToSkip() would clamp the current level otherwise
+    unsigned newMipsToSkip = mipsToSkip_[quality] + 1;
+    for (int i = quality; i >= QUALITY_LOW; --i)
+        mipsToSkip_[i] = Max(mipsToSkip_[i], newMipsToSkip);
+
+    bool loaded = Load(*file);
+    if (loaded && GetMemoryUse() < oldMemoryUse)
+    {
+        if (!reducedMips_)
+        {
+            for (int i = 0; i < MAX_TEXTURE_QUALITY_LEVELS; ++i)
+                baseMipsToSkip_[i] = oldMipsToSkip[i];
+        }
+        ++reducedMips_;
+        ATOMIC_LOGDEBUG("Reduced quality of texture " + GetName() + " to skip " + String(newMipsToSkip) + " mip levels");
+        return true;
+    }
+
+    // Could not reduce, for example as the file format decompresses to a different size than expected. Restore the
+    // previous quality, and the texture data if the reload failed. Do not try again until the quality is restored
+    for (int i = 0; i < MAX_TEXTURE_QUALITY_LEVELS; ++i)
+        mipsToSkip_[i] = oldMipsToSkip[i];
+    if (!loaded)
+    {
+        file->Seek(0);
+        Load(*file);
+    }
+    minQualityReached_ = true;
+    return false;
+}
+
+bool Texture2D::RestoreQuality()
+{
+    if (!reducedMips_ || !graphics_ || graphics_->IsDeviceLost())
+        return false;
+
+    SharedPtr<File> file = GetSubsystem<ResourceCache>()->GetFile(GetName(), false);
+    if (!file)
+        return false;
+
+    for (int i = 0; i < MAX_TEXTURE_QUALITY_LEVELS; ++i)
+        mipsToSkip_[i] = baseMipsToSkip_[i];
+    reducedMips_ = 0;
+    minQualityReached_ = false;
+
+    ATOMIC_LOGDEBUG("Restored quality of texture " + GetName());
+    return Load(*file);
+}
+
+unsigned Texture2D::GetRestoredMemoryUse() const
+{
+    // Each dropped mip level quartered the memory use of the remaining mip chain
+    unsigned long long restored = (unsigned long long)GetMemoryUse() << (2 * Min(reducedMips_, 15U));
+    return (unsigned)Min(restored, (unsigned long long)M_MAX_UNSIGNED);
+}
+// ATOMIC END
+
 bool Texture2D::SetSize(int width, int height, unsigned format, TextureUsage usage, int multiSample, bool autoResolve)
 {
     if (width <= 0 || height <= 0)
@@ -49,6 +49,14 @@ public:
     virtual bool BeginLoad(Deserializer& source);
     /// Finish resource loading. Always called from the main thread. Return true if successful.
     virtual bool EndLoad();
+    // ATOMIC BEGIN
+    /// Reduce memory use by reloading from the resource file with one more mip level skipped at the current texture quality. Return true if memory use was reduced.
+    virtual bool ReduceQuality();
+    /// Reload from the resource file with the mip levels skipped before the first ReduceQuality() call. Return true if restored.
+    virtual bool RestoreQuality();
+    /// Return the estimated memory use with the mip levels dropped by ReduceQuality() restored.
+    virtual unsigned GetRestoredMemoryUse() const;
+    // ATOMIC END
     /// Mark the GPU resource destroyed on context destruction.
     virtual void OnDeviceLost();
     /// Recreate the GPU resource and restore data if applicable.
@@ -88,6 +96,14 @@ private:
     SharedPtr<Image> loadImage_;
     /// Parameter file acquired during BeginLoad.
     SharedPtr<XMLFile> loadParameters_;
+    // ATOMIC BEGIN
+    /// Mip levels to skip per quality level before the first ReduceQuality() call.
+    unsigned baseMipsToSkip_[MAX_TEXTURE_QUALITY_LEVELS];
+    /// Number of mip levels dropped by ReduceQuality().
+    unsigned reducedMips_;
+    /// Set when ReduceQuality() failed to lower memory use, so that it is not attempted again until the quality is restored.
+    bool minQualityReached_;
+    // ATOMIC END
 };
 
 }
@@ -30,6 +30,7 @@
 #include "../Graphics/Graphics.h"
 #include "../Graphics/GraphicsEvents.h"
 #include "../Graphics/GraphicsImpl.h"
+#include "../Graphics/InstanceDataStore.h"
 #include "../Graphics/Material.h"
 #include "../Graphics/OcclusionBuffer.h"
 #include "../Graphics/Octree.h"
@@ -86,7 +87,7 @@ public:
             if (drawable->GetCastShadows() && (drawable->GetDrawableFlags() & drawableFlags_) &&
                 (drawable->GetViewMask() & viewMask_))
             {
-                if (inside || frustum_.IsInsideFast(drawable->GetWorldBoundingBox()))
+                if (inside || packedFrustum_.IsInsideFast(drawable->GetWorldBoundingBox()))
                     result_.Push(drawable);
             }
         }
@@ -115,7 +116,7 @@ public:
             if ((flags == DRAWABLE_ZONE || (flags == DRAWABLE_GEOMETRY && drawable->IsOccluder())) &&
                 (drawable->GetViewMask() & viewMask_))
             {
-                if (inside || frustum_.IsInsideFast(drawable->GetWorldBoundingBox()))
+                if (inside || packedFrustum_.IsInsideFast(drawable->GetWorldBoundingBox()))
                     result_.Push(drawable);
             }
         }
@@ -141,7 +142,7 @@ public:
             return buffer_->IsVisible(box) ? INSIDE : OUTSIDE;
         else
         {
-            Intersection result = frustum_.IsInside(box);
+            Intersection result = packedFrustum_.IsInside(box);
             if (result != OUTSIDE && !buffer_->IsVisible(box))
                 result = OUTSIDE;
             return result;
@@ -157,7 +158,7 @@ public:
 
             if ((drawable->GetDrawableFlags() & drawableFlags_) && (drawable->GetViewMask() & viewMask_))
             {
-                if (inside || frustum_.IsInsideFast(drawable->GetWorldBoundingBox()))
+                if (inside || packedFrustum_.IsInsideFast(drawable->GetWorldBoundingBox()))
                     result_.Push(drawable);
             }
         }
@@ -167,11 +168,10 @@ public:
     OcclusionBuffer* buffer_;
 };
 
-void CheckVisibilityWork(const WorkItem* item, unsigned threadIndex)
+// ATOMIC BEGIN
+void CheckVisibilityWork(View* view, Drawable** start, Drawable** end, unsigned threadIndex)
 {
-    View* view = reinterpret_cast<View*>(item->aux_);
-    Drawable** start = reinterpret_cast<Drawable**>(item->start_);
-    Drawable** end = reinterpret_cast<Drawable**>(item->end_);
+    // ATOMIC END
     OcclusionBuffer* buffer = view->occlusionBuffer_;
     const Matrix3x4& viewMatrix = view->cullCamera_->GetView();
     Vector3 viewZ = Vector3(viewMatrix.m20_, viewMatrix.m21_, viewMatrix.m22_);
@@ -236,20 +236,9 @@ void CheckVisibilityWork(const WorkItem* item, unsigned threadIndex)
     }
 }
 
-void ProcessLightWork(const WorkItem* item, unsigned threadIndex)
-{
-    View* view = reinterpret_cast<View*>(item->aux_);
-    LightQueryResult* query = reinterpret_cast<LightQueryResult*>(item->start_);
-
-    view->ProcessLight(*query, threadIndex);
-}
-
-void UpdateDrawableGeometriesWork(const WorkItem* item, unsigned threadIndex)
+// ATOMIC BEGIN
+void UpdateDrawableGeometriesWork(const FrameInfo& frame, Drawable** start, Drawable** end)
 {
-    const FrameInfo& frame = *(reinterpret_cast<FrameInfo*>(item->aux_));
-    Drawable** start = reinterpret_cast<Drawable**>(item->start_);
-    Drawable** end = reinterpret_cast<Drawable**>(item->end_);
-
     while (start != end)
     {
         Drawable* drawable = *start++;
@@ -259,36 +248,26 @@ void UpdateDrawableGeometriesWork(const WorkItem* item, unsigned threadIndex)
     }
 }
 
-void SortBatchQueueFrontToBackWork(const WorkItem* item, unsigned threadIndex)
-{
-    BatchQueue* queue = reinterpret_cast<BatchQueue*>(item->start_);
-
-    queue->SortFrontToBack();
-}
-
-void SortBatchQueueBackToFrontWork(const WorkItem* item, unsigned threadIndex)
-{
-    BatchQueue* queue = reinterpret_cast<BatchQueue*>(item->start_);
-
-    queue->SortBackToFront();
-}
-
-void SortLightQueueWork(const WorkItem* item, unsigned threadIndex)
-{
-    LightBatchQueue* start = reinterpret_cast<LightBatchQueue*>(item->start_);
-    start->litBaseBatches_.SortFrontToBack();
-    start->litBatches_.SortFrontToBack();
-}
-
-void SortShadowQueueWork(const WorkItem* item, unsigned threadIndex)
+void SortLightQueueWork(LightBatchQueue& queue)
 {
-    LightBatchQueue* start = reinterpret_cast<LightBatchQueue*>(item->start_);
-    for (unsigned i = 0; i < start->shadowSplits_.Size(); ++i)
-        start->shadowSplits_[i].shadowBatches_.SortFrontToBack();
+    queue.litBaseBatches_.SortFrontToBack();
+    queue.litBatches_.SortFrontToBack();
+    for (unsigned i = 0; i < queue.shadowSplits_.Size(); ++i)
+        queue.shadowSplits_[i].shadowBatches_.SortFrontToBack();
 }
+// ATOMIC END
 
 StringHash ParseTextureTypeXml(ResourceCache* cache, String filename);
 
+// ATOMIC BEGIN
+/// Minimum number of geometries per base batch collection range.
+static const unsigned BASE_BATCH_RANGE_SIZE = 64;
+/// Minimum number of drawables per visibility check subrange.
+static const unsigned VISIBILITY_GRAIN_SIZE = 32;
+/// Minimum number of drawables per threaded geometry update subrange.
+static const unsigned GEOMETRY_UPDATE_GRAIN_SIZE = 8;
+// ATOMIC END
+
 View::View(Context* context) :
     Object(context),
     graphics_(GetSubsystem<Graphics>()),
@@ -907,30 +886,13 @@ void View::GetDrawables()
             result.maxZ_ = 0.0f;
         }
 
-        int numWorkItems = queue->GetNumThreads() + 1; // Worker threads + main thread
-        int drawablesPerItem = tempDrawables.Size() / numWorkItems;
-
-        PODVector<Drawable*>::Iterator start = tempDrawables.Begin();
-        // Create a work item for each thread
-        for (int i = 0; i < numWorkItems; ++i)
+        // ATOMIC BEGIN
+        queue->ParallelFor(0, tempDrawables.Size(), VISIBILITY_GRAIN_SIZE, [this, &tempDrawables](unsigned begin, unsigned end,
+            unsigned threadIndex)
         {
-            SharedPtr<WorkItem> item = queue->GetFreeItem();
-            item->priority_ = M_MAX_UNSIGNED;
-            item->workFunction_ = CheckVisibilityWork;
-            item->aux_ = this;
-
-            PODVector<Drawable*>::Iterator end = tempDrawables.End();
-            if (i < numWorkItems - 1 && end - start > drawablesPerItem)
-                end = start + drawablesPerItem;
-
-            item->start_ = &(*start);
-            item->end_ = &(*end);
-            queue->AddWorkItem(item);
-
-            start = end;
-        }
-
-        queue->Complete(M_MAX_UNSIGNED);
+            CheckVisibilityWork(this, tempDrawables.Buffer() + begin, tempDrawables.Buffer() + end, threadIndex);
+        });
+        // ATOMIC END
     }
 
     // Combine lights, geometries & scene Z range from the threads
@@ -995,22 +957,17 @@ void View::ProcessLights()
     WorkQueue* queue = GetSubsystem<WorkQueue>();
     lightQueryResults_.Resize(lights_.Size());
 
+    // ATOMIC BEGIN
     for (unsigned i = 0; i < lightQueryResults_.Size(); ++i)
-    {
-        SharedPtr<WorkItem> item = queue->GetFreeItem();
-        item->priority_ = M_MAX_UNSIGNED;
-        item->workFunction_ = ProcessLightWork;
-        item->aux_ = this;
+        lightQueryResults_[i].light_ = lights_[i];
 
-        LightQueryResult& query = lightQueryResults_[i];
-        query.light_ = lights_[i];
-
-        item->start_ = &query;
-        queue->AddWorkItem(item);
-    }
-
-    // Ensure all lights have been processed before proceeding
-    queue->Complete(M_MAX_UNSIGNED);
+    // Returns once all lights have been processed
+    queue->ParallelFor(0, lightQueryResults_.Size(), 1, [this](unsigned begin, unsigned end, unsigned threadIndex)
+    {
+        for (unsigned i = begin; i < end; ++i)
+            ProcessLight(lightQueryResults_[i], threadIndex);
+    });
+    // ATOMIC END
 }
 
 void View::GetLightBatches()
@@ -1206,14 +1163,98 @@ void View::GetBaseBatches()
 {
     ATOMIC_PROFILE(GetBaseBatches);
 
-    for (PODVector<Drawable*>::ConstIterator i = geometries_.Begin(); i != geometries_.End(); ++i)
+    // ATOMIC BEGIN
+    // Collect batches from fixed geometry ranges in worker threads, then merge the ranges in order in the main thread so
+    // that the result does not depend on thread scheduling. Vertex light queues, aux view checks and adding to the batch
+    // queues (which may load shaders) remain in the main thread
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    unsigned numGeometries = geometries_.Size();
+    unsigned numRanges = Clamp((numGeometries + BASE_BATCH_RANGE_SIZE - 1) / BASE_BATCH_RANGE_SIZE, 1U,
+        (queue->GetNumThreads() + 1) * 4);
+    if (baseBatchResults_.Size() < numRanges)
+        baseBatchResults_.Resize(numRanges);
+
     {
-        Drawable* drawable = *i;
+        ATOMIC_PROFILE(CollectBaseBatches);
+
+        queue->ParallelFor(0, numRanges, 1, [this, numGeometries, numRanges](unsigned begin, unsigned end, unsigned threadIndex)
+        {
+            for (unsigned i = begin; i < end; ++i)
+            {
+                CollectBaseBatches((unsigned)((unsigned long long)numGeometries * i / numRanges),
+                    (unsigned)((unsigned long long)numGeometries * (i + 1) / numRanges), baseBatchResults_[i]);
+            }
+        });
+    }
+
+    for (unsigned i = 0; i < numRanges; ++i)
+    {
+        BaseBatchResult& result = baseBatchResults_[i];
+
+        nonThreadedGeometries_.Push(result.nonThreadedGeometries_);
+        threadedGeometries_.Push(result.threadedGeometries_);
+
+        // Check here if the material refers to a rendertarget texture with camera(s) attached. The same material may
+        // have been collected from several ranges
+        for (PODVector<Material*>::ConstIterator j = result.auxViewMaterials_.Begin(); j != result.auxViewMaterials_.End(); ++j)
+        {
+            if ((*j)->GetAuxViewFrameNumber() != frame_.frameNumber_)
+                CheckMaterialForAuxView(*j);
+        }
+
+        for (PODVector<PendingBaseBatch>::Iterator j = result.batches_.Begin(); j != result.batches_.End(); ++j)
+        {
+            Batch& destBatch = j->batch_;
+
+            if (j->vertexLitDrawable_)
+            {
+                Drawable* drawable = j->vertexLitDrawable_;
+                // Limit vertex lights. If this is a deferred opaque batch, remove converted per-pixel lights,
+                // as they will be rendered as light volumes in any case, and drawing them also as vertex lights
+                // would result in double lighting
+                if (j->limitVertexLights_)
+                    drawable->LimitVertexLights(j->removeConvertedLights_);
+
+                const PODVector<Light*>& drawableVertexLights = drawable->GetVertexLights();
+                if (drawableVertexLights.Size())
+                {
+                    // Find a vertex light queue. If not found, create new
+                    unsigned long long hash = GetVertexLightQueueHash(drawableVertexLights);
+                    HashMap<unsigned long long, LightBatchQueue>::Iterator k = vertexLightQueues_.Find(hash);
+                    if (k == vertexLightQueues_.End())
+                    {
+                        k = vertexLightQueues_.Insert(MakePair(hash, LightBatchQueue()));
+                        k->second_.light_ = 0;
+                        k->second_.shadowMap_ = 0;
+                        k->second_.vertexLights_ = drawableVertexLights;
+                    }
+
+                    destBatch.lightQueue_ = &(k->second_);
+                }
+            }
+
+            AddBatchToQueue(*scenePasses_[j->scenePassIndex_].batchQueue_, destBatch, j->tech_, j->allowInstancing_);
+        }
+    }
+    // ATOMIC END
+}
+
+// ATOMIC BEGIN
+void View::CollectBaseBatches(unsigned begin, unsigned end, BaseBatchResult& result)
+{
+    result.nonThreadedGeometries_.Clear();
+    result.threadedGeometries_.Clear();
+    result.auxViewMaterials_.Clear();
+    result.batches_.Clear();
+
+    for (unsigned i = begin; i < end; ++i)
+    {
+        Drawable* drawable = geometries_[i];
         UpdateGeometryType type = drawable->GetUpdateGeometryType();
         if (type == UPDATE_MAIN_THREAD)
-            nonThreadedGeometries_.Push(drawable);
+            result.nonThreadedGeometries_.Push(drawable);
         else if (type == UPDATE_WORKER_THREAD)
-            threadedGeometries_.Push(drawable);
+            result.threadedGeometries_.Push(drawable);
 
         const Vector<SourceBatch>& batches = drawable->GetBatches();
         bool vertexLightsProcessed = false;
@@ -1222,10 +1263,9 @@ void View::GetBaseBatches()
         {
             const SourceBatch& srcBatch = batches[j];
 
-            // Check here if the material refers to a rendertarget texture with camera(s) attached
             // Only check this for backbuffer views (null rendertarget)
             if (srcBatch.material_ && srcBatch.material_->GetAuxViewFrameNumber() != frame_.frameNumber_ && !renderTarget_)
-                CheckMaterialForAuxView(srcBatch.material_);
+                result.auxViewMaterials_.Push(srcBatch.material_);
 
             Technique* tech = GetTechnique(drawable, srcBatch.material_);
             if (!srcBatch.geometry_ || !srcBatch.numWorldTransforms_ || !tech)
@@ -1243,52 +1283,43 @@ void View::GetBaseBatches()
                 if (!pass)
                     continue;
 
-                Batch destBatch(srcBatch);
+                result.batches_.Resize(result.batches_.Size() + 1);
+                PendingBaseBatch& pending = result.batches_.Back();
+                Batch& destBatch = pending.batch_;
+                destBatch = Batch(srcBatch);
                 destBatch.pass_ = pass;
                 destBatch.zone_ = GetZone(drawable);
                 destBatch.isBase_ = true;
                 destBatch.lightMask_ = (unsigned char)GetLightMask(drawable);
+                destBatch.lightQueue_ = 0;
+
+                pending.tech_ = tech;
+                pending.vertexLitDrawable_ = 0;
+                pending.scenePassIndex_ = k;
+                pending.limitVertexLights_ = false;
+                pending.removeConvertedLights_ = false;
 
-                if (info.vertexLights_)
+                // The vertex light queue is found in the main thread, as limiting the vertex lights modifies the lights
+                if (info.vertexLights_ && drawable->GetVertexLights().Size())
                 {
-                    const PODVector<Light*>& drawableVertexLights = drawable->GetVertexLights();
-                    if (drawableVertexLights.Size() && !vertexLightsProcessed)
+                    pending.vertexLitDrawable_ = drawable;
+                    if (!vertexLightsProcessed)
                     {
-                        // Limit vertex lights. If this is a deferred opaque batch, remove converted per-pixel lights,
-                        // as they will be rendered as light volumes in any case, and drawing them also as vertex lights
-                        // would result in double lighting
-                        drawable->LimitVertexLights(deferred_ && destBatch.pass_->GetBlendMode() == BLEND_REPLACE);
+                        pending.limitVertexLights_ = true;
+                        pending.removeConvertedLights_ = deferred_ && pass->GetBlendMode() == BLEND_REPLACE;
                         vertexLightsProcessed = true;
                     }
-
-                    if (drawableVertexLights.Size())
-                    {
-                        // Find a vertex light queue. If not found, create new
-                        unsigned long long hash = GetVertexLightQueueHash(drawableVertexLights);
-                        HashMap<unsigned long long, LightBatchQueue>::Iterator i = vertexLightQueues_.Find(hash);
-                        if (i == vertexLightQueues_.End())
-                        {
-                            i = vertexLightQueues_.Insert(MakePair(hash, LightBatchQueue()));
-                            i->second_.light_ = 0;
-                            i->second_.shadowMap_ = 0;
-                            i->second_.vertexLights_ = drawableVertexLights;
-                        }
-
-                        destBatch.lightQueue_ = &(i->second_);
-                    }
                 }
-                else
-                    destBatch.lightQueue_ = 0;
 
                 bool allowInstancing = info.allowInstancing_;
                 if (allowInstancing && info.markToStencil_ && destBatch.lightMask_ != (destBatch.zone_->GetLightMask() & 0xff))
                     allowInstancing = false;
-
-                AddBatchToQueue(*info.batchQueue_, destBatch, tech, allowInstancing);
+                pending.allowInstancing_ = allowInstancing;
             }
         }
     }
 }
+// ATOMIC END
 
 void View::UpdateGeometries()
 {
@@ -1303,8 +1334,12 @@ void View::UpdateGeometries()
 
     WorkQueue* queue = GetSubsystem<WorkQueue>();
 
-    // Sort batches
+    // ATOMIC BEGIN
+    // Sort batches. Resolve the scene pass queues in the main thread, as looking them up may insert into the map
     {
+        PODVector<BatchQueue*> sortQueues;
+        PODVector<bool> sortFrontToBack;
+
         for (unsigned i = 0; i < renderPath_->commands_.Size(); ++i)
         {
             const RenderPathCommand& command = renderPath_->commands_[i];
@@ -1313,33 +1348,27 @@ void View::UpdateGeometries()
 
             if (command.type_ == CMD_SCENEPASS)
             {
-                SharedPtr<WorkItem> item = queue->GetFreeItem();
-                item->priority_ = M_MAX_UNSIGNED;
-                item->workFunction_ =
-                    command.sortMode_ == SORT_FRONTTOBACK ? SortBatchQueueFrontToBackWork : SortBatchQueueBackToFrontWork;
-                item->start_ = &batchQueues_[command.passIndex_];
-                queue->AddWorkItem(item);
+                sortQueues.Push(&batchQueues_[command.passIndex_]);
+                sortFrontToBack.Push(command.sortMode_ == SORT_FRONTTOBACK);
             }
         }
 
-        for (Vector<LightBatchQueue>::Iterator i = lightQueues_.Begin(); i != lightQueues_.End(); ++i)
+        unsigned numSceneQueues = sortQueues.Size();
+        queue->ParallelFor(0, numSceneQueues + lightQueues_.Size(), 1, [this, &sortQueues, &sortFrontToBack,
+            numSceneQueues](unsigned begin, unsigned end, unsigned threadIndex)
         {
-            SharedPtr<WorkItem> lightItem = queue->GetFreeItem();
-            lightItem->priority_ = M_MAX_UNSIGNED;
-            lightItem->workFunction_ = SortLightQueueWork;
-            lightItem->start_ = &(*i);
-            queue->AddWorkItem(lightItem);
-
-            if (i->shadowSplits_.Size())
+            for (unsigned i = begin; i < end; ++i)
             {
-                SharedPtr<WorkItem> shadowItem = queue->GetFreeItem();
-                shadowItem->priority_ = M_MAX_UNSIGNED;
-                shadowItem->workFunction_ = SortShadowQueueWork;
-                shadowItem->start_ = &(*i);
-                queue->AddWorkItem(shadowItem);
+                if (i >= numSceneQueues)
+                    SortLightQueueWork(lightQueues_[i - numSceneQueues]);
+                else if (sortFrontToBack[i])
+                    sortQueues[i]->SortFrontToBack();
+                else
+                    sortQueues[i]->SortBackToFront();
             }
-        }
+        });
     }
+    // ATOMIC END
 
     // Update geometries. Split into threaded and non-threaded updates.
     {
@@ -1357,35 +1386,23 @@ void View::UpdateGeometries()
                 }
             }
 
-            int numWorkItems = queue->GetNumThreads() + 1; // Worker threads + main thread
-            int drawablesPerItem = threadedGeometries_.Size() / numWorkItems;
-
-            PODVector<Drawable*>::Iterator start = threadedGeometries_.Begin();
-            for (int i = 0; i < numWorkItems; ++i)
+            // ATOMIC BEGIN
+            // ParallelFor returns once all threaded updates have completed
+            queue->ParallelFor(0, threadedGeometries_.Size(), GEOMETRY_UPDATE_GRAIN_SIZE, [this](unsigned begin, unsigned end,
+                unsigned threadIndex)
             {
-                PODVector<Drawable*>::Iterator end = threadedGeometries_.End();
-                if (i < numWorkItems - 1 && end - start > drawablesPerItem)
-                    end = start + drawablesPerItem;
-
-                SharedPtr<WorkItem> item = queue->GetFreeItem();
-                item->priority_ = M_MAX_UNSIGNED;
-                item->workFunction_ = UpdateDrawableGeometriesWork;
-                item->aux_ = const_cast<FrameInfo*>(&frame_);
-                item->start_ = &(*start);
-                item->end_ = &(*end);
-                queue->AddWorkItem(item);
-
-                start = end;
-            }
+                UpdateDrawableGeometriesWork(frame_, threadedGeometries_.Buffer() + begin, threadedGeometries_.Buffer() + end);
+            });
+            // ATOMIC END
         }
 
-        // While the work queue is processed, update non-threaded geometries
+        // ATOMIC BEGIN
+        // Update non-threaded geometries in the main thread
+        // ATOMIC END
         for (PODVector<Drawable*>::ConstIterator i = nonThreadedGeometries_.Begin(); i != nonThreadedGeometries_.End(); ++i)
             (*i)->UpdateGeometry(frame_);
     }
 
-    // Finally ensure all threaded work has completed
-    queue->Complete(M_MAX_UNSIGNED);
     geometriesUpdated_ = true;
 }
 
@@ -2972,41 +2989,25 @@ void View::PrepareInstancingBuffer()
 
     ATOMIC_PROFILE(PrepareInstancingBuffer);
 
-    unsigned totalInstances = 0;
-
-    for (HashMap<unsigned, BatchQueue>::Iterator i = batchQueues_.Begin(); i != batchQueues_.End(); ++i)
-        totalInstances += i->second_.GetNumInstances();
-
-    for (Vector<LightBatchQueue>::Iterator i = lightQueues_.Begin(); i != lightQueues_.End(); ++i)
-    {
-        for (unsigned j = 0; j < i->shadowSplits_.Size(); ++j)
-            totalInstances += i->shadowSplits_[j].shadowBatches_.GetNumInstances();
-        totalInstances += i->litBaseBatches_.GetNumInstances();
-        totalInstances += i->litBatches_.GetNumInstances();
-    }
-
-    if (!totalInstances || !renderer_->ResizeInstancingBuffer(totalInstances))
-        return;
-
-    VertexBuffer* instancingBuffer = renderer_->GetInstancingBuffer();
-    unsigned freeIndex = 0;
-    void* dest = instancingBuffer->Lock(0, totalInstances, true);
-    if (!dest)
+    // ATOMIC BEGIN
+    // Batch groups keep their instance slots from the previous frames, and only changed instances are uploaded
+    InstanceDataStore* store = renderer_->GetInstanceDataStore();
+    if (!store)
         return;
 
-    const unsigned stride = instancingBuffer->GetVertexSize();
     for (HashMap<unsigned, BatchQueue>::Iterator i = batchQueues_.Begin(); i != batchQueues_.End(); ++i)
-        i->second_.SetInstancingData(dest, stride, freeIndex);
+        store->SetInstancingData(i->second_);
 
     for (Vector<LightBatchQueue>::Iterator i = lightQueues_.Begin(); i != lightQueues_.End(); ++i)
     {
         for (unsigned j = 0; j < i->shadowSplits_.Size(); ++j)
-            i->shadowSplits_[j].shadowBatches_.SetInstancingData(dest, stride, freeIndex);
-        i->litBaseBatches_.SetInstancingData(dest, stride, freeIndex);
-        i->litBatches_.SetInstancingData(dest, stride, freeIndex);
+            store->SetInstancingData(i->shadowSplits_[j].shadowBatches_);
+        store->SetInstancingData(i->litBaseBatches_);
+        store->SetInstancingData(i->litBatches_);
     }
 
-    instancingBuffer->Unlock();
+    store->Upload();
+    // ATOMIC END
 }
 
 void View::SetupLightVolumeBatch(Batch& batch)
@@ -104,13 +104,48 @@ struct PerThreadSceneResult
     float maxZ_;
 };
 
+// ATOMIC BEGIN
+/// Base pass batch collected in a worker thread, to be added to its batch queue in the main thread.
+struct PendingBaseBatch
+{
+    /// Batch with pass, zone and light mask set.
+    Batch batch_;
+    /// Technique.
+    Technique* tech_;
+    /// Drawable when the batch needs a vertex light queue, null otherwise.
+    Drawable* vertexLitDrawable_;
+    /// Index of the scene pass.
+    unsigned scenePassIndex_;
+    /// Allow instancing flag.
+    bool allowInstancing_;
+    /// Limit the drawable's vertex lights before finding the vertex light queue. Set for the first vertex lit batch of a drawable.
+    bool limitVertexLights_;
+    /// Remove converted per-pixel lights when limiting vertex lights.
+    bool removeConvertedLights_;
+};
+
+/// Base pass batch collection result for a range of geometries.
+struct BaseBatchResult
+{
+    /// Geometry objects that will be updated in the main thread.
+    PODVector<Drawable*> nonThreadedGeometries_;
+    /// Geometry objects that will be updated in worker threads.
+    PODVector<Drawable*> threadedGeometries_;
+    /// Materials that may refer to rendertarget textures with cameras attached.
+    PODVector<Material*> auxViewMaterials_;
+    /// Collected batches.
+    PODVector<PendingBaseBatch> batches_;
+};
+// ATOMIC END
+
 static const unsigned MAX_VIEWPORT_TEXTURES = 2;
 
 /// Internal structure for 3D rendering work. Created for each backbuffer and texture viewport, but not for shadow cameras.
 class ATOMIC_API View : public Object
 {
-    friend void CheckVisibilityWork(const WorkItem* item, unsigned threadIndex);
-    friend void ProcessLightWork(const WorkItem* item, unsigned threadIndex);
+    // ATOMIC BEGIN
+    friend void CheckVisibilityWork(View* view, Drawable** start, Drawable** end, unsigned threadIndex);
+    // ATOMIC END
 
     ATOMIC_OBJECT(View, Object);
 
@@ -206,6 +241,10 @@ private:
     void GetLightBatches();
     /// Get unlit batches.
     void GetBaseBatches();
+    // ATOMIC BEGIN
+    /// Collect unlit batches from a range of geometries. Called in worker threads.
+    void CollectBaseBatches(unsigned begin, unsigned end, BaseBatchResult& result);
+    // ATOMIC END
     /// Update geometries and sort batches.
     void UpdateGeometries();
     /// Get pixel lit batches for a certain light and drawable.
@@ -386,6 +425,10 @@ private:
     Vector<PODVector<Drawable*> > tempDrawables_;
     /// Per-thread geometries, lights and Z range collection results.
     Vector<PerThreadSceneResult> sceneResults_;
+    // ATOMIC BEGIN
+    /// Base pass batch collection results per geometry range.
+    Vector<BaseBatchResult> baseBatchResults_;
+    // ATOMIC END
     /// Visible zones.
     PODVector<Zone*> zones_;
     /// Visible geometry objects.
@@ -50,6 +50,10 @@ public:
     virtual unsigned GetChecksum();
     /// Return whether the end of stream has been reached.
     virtual bool IsEof() const { return position_ >= size_; }
+    // ATOMIC BEGIN
+    /// Return the whole stream contents if they reside contiguously in memory, allowing zero-copy access. Return null otherwise.
+    virtual const unsigned char* GetDirectData() const { return 0; }
+    // ATOMIC END
 
     /// Return current position.
     unsigned GetPosition() const { return position_; }
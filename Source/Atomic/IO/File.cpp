@@ -23,6 +23,10 @@
 #include "../Precompiled.h"
 
 #include "../Core/Profiler.h"
+// ATOMIC BEGIN
+#include "../Core/Thread.h"
+#include "../Core/WorkQueue.h"
+// ATOMIC END
 #include "../IO/File.h"
 #include "../IO/FileSystem.h"
 #include "../IO/Log.h"
@@ -86,7 +90,13 @@ File::File(Context* context) :
     checksum_(0),
     compressed_(false),
     readSyncNeeded_(false),
-    writeSyncNeeded_(false)
+    writeSyncNeeded_(false),
+    // ATOMIC BEGIN
+    mapping_(0),
+    mappedData_(0),
+    mappedPosition_(0),
+    blockCapacity_(0)
+    // ATOMIC END
 {
 }
 
@@ -105,7 +115,11 @@ File::File(Context* context, const String& fileName, FileMode mode) :
     readSyncNeeded_(false),
     writeSyncNeeded_(false),
     // ATOMIC BEGIN
-    fullPath_(fileName)
+    fullPath_(fileName),
+    mapping_(0),
+    mappedData_(0),
+    mappedPosition_(0),
+    blockCapacity_(0)
     // ATOMIC END
 {
     Open(fileName, mode);
@@ -124,7 +138,13 @@ File::File(Context* context, PackageFile* package, const String& fileName) :
     checksum_(0),
     compressed_(false),
     readSyncNeeded_(false),
-    writeSyncNeeded_(false)
+    writeSyncNeeded_(false),
+    // ATOMIC BEGIN
+    mapping_(0),
+    mappedData_(0),
+    mappedPosition_(0),
+    blockCapacity_(0)
+    // ATOMIC END
 {
     Open(package, fileName);
 }
@@ -148,7 +168,9 @@ bool File::Open(PackageFile* package, const String& fileName)
     if (!entry)
         return false;
 
-    bool success = OpenInternal(package->GetName(), FILE_READ, true);
+    // ATOMIC BEGIN
+    bool success = package->IsMemoryMapped() ? OpenMapped(package) : OpenInternal(package->GetName(), FILE_READ, true);
+    // ATOMIC END
     if (!success)
     {
         ATOMIC_LOGERROR("Could not open package file " + fileName);
@@ -159,7 +181,9 @@ bool File::Open(PackageFile* package, const String& fileName)
     offset_ = entry->offset_;
     checksum_ = entry->checksum_;
     size_ = entry->size_;
-    compressed_ = package->IsCompressed();
+    // ATOMIC BEGIN
+    compressed_ = entry->codec_ != PACKAGE_CODEC_NONE;
+    // ATOMIC END
 
     // Seek to beginning of package entry's file data
     SeekInternal(offset_);
@@ -225,6 +249,21 @@ unsigned File::Read(void* dest, unsigned size)
         unsigned sizeLeft = size;
         unsigned char* destPtr = (unsigned char*)dest;
 
+        // ATOMIC BEGIN
+        // Whole blocks of a memory mapped package can be decompressed straight to the destination
+        if (mappedData_ && (!readBuffer_ || readBufferOffset_ >= readBufferSize_))
+        {
+            unsigned blockBytes;
+            if (!ReadCompressedBlocks(destPtr, sizeLeft, blockBytes))
+            {
+                ATOMIC_LOGERROR("Error while decompressing file " + GetName());
+                return 0;
+            }
+            destPtr += blockBytes;
+            sizeLeft -= blockBytes;
+        }
+        // ATOMIC END
+
         while (sizeLeft)
         {
             if (!readBuffer_ || readBufferOffset_ >= readBufferSize_)
@@ -240,11 +279,22 @@ unsigned File::Read(void* dest, unsigned size)
                 {
                     readBuffer_ = new unsigned char[unpackedSize];
                     inputBuffer_ = new unsigned char[LZ4_compressBound(unpackedSize)];
+                    // ATOMIC BEGIN
+                    blockCapacity_ = unpackedSize;
+                    // ATOMIC END
                 }
 
-                /// \todo Handle errors
-                ReadInternal(inputBuffer_.Get(), packedSize);
-                LZ4_decompress_fast((const char*)inputBuffer_.Get(), (char*)readBuffer_.Get(), unpackedSize);
+                // ATOMIC BEGIN
+                // The buffers are sized by the first block, so reject later blocks that would not fit them
+                if (unpackedSize > blockCapacity_ || packedSize > (unsigned)LZ4_compressBound(blockCapacity_) ||
+                    !ReadInternal(inputBuffer_.Get(), packedSize) || LZ4_decompress_safe((const char*)inputBuffer_.Get(),
+                    (char*)readBuffer_.Get(), packedSize, unpackedSize) != (int)unpackedSize)
+                {
+                    readBufferSize_ = readBufferOffset_ = 0;
+                    ATOMIC_LOGERROR("Error while decompressing file " + GetName());
+                    return 0;
+                }
+                // ATOMIC END
 
                 readBufferSize_ = unpackedSize;
                 readBufferOffset_ = 0;
@@ -414,6 +464,20 @@ void File::Close()
         offset_ = 0;
         checksum_ = 0;
     }
+
+    // ATOMIC BEGIN
+    if (mappedData_)
+    {
+        mappedData_ = 0;
+        mapping_->ReleaseRef();
+        mapping_ = 0;
+        mappedPosition_ = 0;
+        position_ = 0;
+        size_ = 0;
+        offset_ = 0;
+        checksum_ = 0;
+    }
+    // ATOMIC END
 }
 
 void File::Flush()
@@ -429,11 +493,13 @@ void File::SetName(const String& name)
 
 bool File::IsOpen() const
 {
+// ATOMIC BEGIN
 #ifdef __ANDROID__
-    return handle_ != 0 || assetHandle_ != 0;
+    return handle_ != 0 || assetHandle_ != 0 || mappedData_ != 0;
 #else
-    return handle_ != 0;
+    return handle_ != 0 || mappedData_ != 0;
 #endif
+// ATOMIC END
 }
 
 bool File::OpenInternal(const String& fileName, FileMode mode, bool fromPackage)
@@ -536,6 +602,17 @@ bool File::OpenInternal(const String& fileName, FileMode mode, bool fromPackage)
 
 bool File::ReadInternal(void* dest, unsigned size)
 {
+    // ATOMIC BEGIN
+    if (mappedData_)
+    {
+        if (mappedPosition_ + size > mapping_->GetSize())
+            return false;
+        memcpy(dest, mappedData_ + mappedPosition_, size);
+        mappedPosition_ += size;
+        return true;
+    }
+    // ATOMIC END
+
 #ifdef __ANDROID__
     if (assetHandle_)
     {
@@ -548,6 +625,14 @@ bool File::ReadInternal(void* dest, unsigned size)
 
 void File::SeekInternal(unsigned newPosition)
 {
+    // ATOMIC BEGIN
+    if (mappedData_)
+    {
+        mappedPosition_ = newPosition;
+        return;
+    }
+    // ATOMIC END
+
 #ifdef __ANDROID__
     if (assetHandle_)
     {
@@ -592,6 +677,119 @@ bool File::Copy(File* srcFile)
 
 }
 
+const unsigned char* File::GetDirectData() const
+{
+    return mappedData_ && !compressed_ ? mappedData_ + offset_ : 0;
+}
+
+bool File::OpenMapped(PackageFile* package)
+{
+    Close();
+
+    FileSystem* fileSystem = GetSubsystem<FileSystem>();
+    if (fileSystem && !fileSystem->CheckAccess(GetPath(package->GetName())))
+    {
+        ATOMIC_LOGERRORF("Access denied to %s", package->GetName().CString());
+        return false;
+    }
+
+    mapping_ = package->GetMapping();
+    mapping_->AddRef();
+    mappedData_ = mapping_->GetData();
+    mappedPosition_ = 0;
+    mode_ = FILE_READ;
+    position_ = 0;
+    checksum_ = 0;
+    compressed_ = false;
+    readSyncNeeded_ = false;
+    writeSyncNeeded_ = false;
+    return true;
+}
+
+bool File::ReadCompressedBlocks(unsigned char* dest, unsigned size, unsigned& readSize)
+{
+    struct CompressedBlock
+    {
+        unsigned packedOffset_;
+        unsigned packedSize_;
+        unsigned unpackedOffset_;
+        unsigned unpackedSize_;
+        bool failed_;
+    };
+
+    readSize = 0;
+
+    unsigned totalSize = mapping_->GetSize();
+    unsigned scanPosition = mappedPosition_;
+    unsigned unpackedTotal = 0;
+    PODVector<CompressedBlock> blocks;
+
+    // Collect the blocks that fit whole into the requested size
+    while (scanPosition + 4 <= totalSize)
+    {
+        MemoryBuffer blockHeader(mappedData_ + scanPosition, 4);
+        unsigned unpackedSize = blockHeader.ReadUShort();
+        unsigned packedSize = blockHeader.ReadUShort();
+
+        // The first block of the entry determines the buffer size for partial block reads, as in Read()
+        if (!readBuffer_)
+        {
+            readBuffer_ = new unsigned char[unpackedSize];
+            inputBuffer_ = new unsigned char[LZ4_compressBound(unpackedSize)];
+            blockCapacity_ = unpackedSize;
+        }
+
+        if (!unpackedSize || unpackedTotal + unpackedSize > size || scanPosition + 4 + packedSize > totalSize)
+            break;
+
+        CompressedBlock block;
+        block.packedOffset_ = scanPosition + 4;
+        block.packedSize_ = packedSize;
+        block.failed_ = false;
+        block.unpackedOffset_ = unpackedTotal;
+        block.unpackedSize_ = unpackedSize;
+        blocks.Push(block);
+
+        scanPosition += 4 + packedSize;
+        unpackedTotal += unpackedSize;
+    }
+
+    if (blocks.Empty())
+        return true;
+
+    // The packed sizes are known, so use the bounds checked decompressor to not read or write past the block on
+    // corrupt data
+    const unsigned char* mappedData = mappedData_;
+    CompressedBlock* blockData = &blocks[0];
+    auto decompressBlocks = [mappedData, blockData, dest](unsigned begin, unsigned end, unsigned threadIndex)
+    {
+        for (unsigned i = begin; i < end; ++i)
+        {
+            CompressedBlock& block = blockData[i];
+            block.failed_ = LZ4_decompress_safe((const char*)mappedData + block.packedOffset_, (char*)dest + block.unpackedOffset_,
+                block.packedSize_, block.unpackedSize_) != (int)block.unpackedSize_;
+        }
+    };
+
+    // Blocks are independent, so decompress them in parallel when called from the main thread
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    if (blocks.Size() > 1 && queue && queue->GetNumThreads() && Thread::IsMainThread())
+        queue->ParallelFor(0, blocks.Size(), 1, decompressBlocks);
+    else
+        decompressBlocks(0, blocks.Size(), 0);
+
+    for (unsigned i = 0; i < blocks.Size(); ++i)
+    {
+        if (blocks[i].failed_)
+            return false;
+    }
+
+    mappedPosition_ = scanPosition;
+    position_ += unpackedTotal;
+    readSize = unpackedTotal;
+    return true;
+}
+
 // ATOMIC END
 
 }
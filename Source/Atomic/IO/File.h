@@ -58,6 +58,9 @@ enum FileMode
 };
 
 class PackageFile;
+// ATOMIC BEGIN
+class PackageFileMapping;
+// ATOMIC END
 
 /// %File opened either through the filesystem or from within a package file.
 class ATOMIC_API File : public Object, public AbstractFile
@@ -125,6 +128,12 @@ public:
     /// Unlike FileSystem.Copy this copy works when the source file is in a package file
     bool Copy(File* srcFile);
 
+    /// Return whether reads are served from a memory mapped package file.
+    bool IsMemoryMapped() const { return mappedData_ != 0; }
+
+    /// Return the file contents for zero-copy access if opened uncompressed from a memory mapped package file, null otherwise.
+    virtual const unsigned char* GetDirectData() const;
+
     // ATOMIC END
 
 private:
@@ -134,6 +143,12 @@ private:
     bool ReadInternal(void* dest, unsigned size);
     /// Seek in file internally using either C standard IO functions or SDL RWops for Android asset files.
     void SeekInternal(unsigned newPosition);
+    // ATOMIC BEGIN
+    /// Set up reading from a memory mapped package file. Return true if successful.
+    bool OpenMapped(PackageFile* package);
+    /// Decompress whole blocks of a memory mapped compressed package entry directly to the destination, in parallel when possible. Store the number of bytes read. Return false if a block is corrupt.
+    bool ReadCompressedBlocks(unsigned char* dest, unsigned size, unsigned& readSize);
+    // ATOMIC END
 
     /// File name.
     String fileName_;
@@ -168,6 +183,14 @@ private:
 
     /// Full path to file
     String fullPath_;
+    /// Memory mapping of the package file the file is read from. Holds a reference to keep the mapping alive.
+    PackageFileMapping* mapping_;
+    /// Start of the memory mapped package file, null if not mapped.
+    const unsigned char* mappedData_;
+    /// Read position within the memory mapped package file.
+    unsigned mappedPosition_;
+    /// Unpacked size the compressed read buffers were allocated for.
+    unsigned blockCapacity_;
 
     // ATOMIC END
 };
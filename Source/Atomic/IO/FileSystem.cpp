@@ -1170,9 +1170,9 @@ bool FileSystem::RemoveDir(const String& directoryIn, bool recursive)
 
 #ifdef WIN32
         return RemoveDirectoryW(GetWideNativePath(directory).CString()) != 0;
-#endif
-
-#ifdef __APPLE__
+#else
+        // remove() deletes empty directories on all POSIX platforms. Without a return here Linux fell through to the
+        // recursive path and recursed on the same directory forever
         return remove(GetNativePath(directory).CString()) == 0;
 #endif
     }
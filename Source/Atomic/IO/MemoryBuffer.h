@@ -49,6 +49,10 @@ public:
 
     /// Return memory area.
     unsigned char* GetData() { return buffer_; }
+    // ATOMIC BEGIN
+    /// Return the memory area for zero-copy access.
+    virtual const unsigned char* GetDirectData() const { return buffer_; }
+    // ATOMIC END
 
     /// Return whether buffer is read-only.
     bool IsReadOnly() { return readOnly_; }
@@ -22,11 +22,28 @@
 
 #include "../Precompiled.h"
 
+// ATOMIC BEGIN
+#include "../Container/ArrayPtr.h"
+#include "../Container/Sort.h"
+// ATOMIC END
 #include "../IO/File.h"
 #include "../IO/Log.h"
 #include "../IO/PackageFile.h"
 // ATOMIC BEGIN
 #include "../IO/FileSystem.h"
+#include "../IO/Serializer.h"
+#include "../IO/VectorBuffer.h"
+
+#include <LZ4/lz4.h>
+#include <LZ4/lz4hc.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 // ATOMIC END
 
 namespace Atomic
@@ -37,7 +54,10 @@ PackageFile::PackageFile(Context* context) :
     totalSize_(0),
     totalDataSize_(0),
     checksum_(0),
-    compressed_(false)
+    compressed_(false),
+    // ATOMIC BEGIN
+    mapping_(0)
+    // ATOMIC END
 {
 }
 
@@ -46,17 +66,31 @@ PackageFile::PackageFile(Context* context, const String& fileName, unsigned star
     totalSize_(0),
     totalDataSize_(0),
     checksum_(0),
-    compressed_(false)
+    compressed_(false),
+    // ATOMIC BEGIN
+    mapping_(0)
+    // ATOMIC END
 {
     Open(fileName, startOffset);
 }
 
 PackageFile::~PackageFile()
 {
+    // ATOMIC BEGIN
+    UnmapFile();
+    // ATOMIC END
 }
 
-bool PackageFile::Open(const String& fileName, unsigned startOffset)
+bool PackageFile::Open(const String& fileName, unsigned startOffset, bool memoryMap)
 {
+    // ATOMIC BEGIN
+    UnmapFile();
+    indexDisplacements_.Clear();
+    indexRecords_.Clear();
+    indexEntries_.Clear();
+    indexNames_.Clear();
+    // ATOMIC END
+
     SharedPtr<File> file(new File(context_, fileName));
     if (!file->IsOpen())
         return false;
@@ -64,7 +98,7 @@ bool PackageFile::Open(const String& fileName, unsigned startOffset)
     // Check ID, then read the directory
     file->Seek(startOffset);
     String id = file->ReadFileID();
-    if (id != "UPAK" && id != "ULZ4")
+    if (id != "UPAK" && id != "ULZ4" && id != "UPK2")
     {
         // If start offset has not been explicitly specified, also try to read package size from the end of file
         // to know how much we must rewind to find the package start
@@ -81,7 +115,7 @@ bool PackageFile::Open(const String& fileName, unsigned startOffset)
             }
         }
 
-        if (id != "UPAK" && id != "ULZ4")
+        if (id != "UPAK" && id != "ULZ4" && id != "UPK2")
         {
             ATOMIC_LOGERROR(fileName + " is not a valid package file");
             return false;
@@ -93,30 +127,57 @@ bool PackageFile::Open(const String& fileName, unsigned startOffset)
     totalSize_ = file->GetSize();
     compressed_ = id == "ULZ4";
 
-    unsigned numFiles = file->ReadUInt();
-    checksum_ = file->ReadUInt();
-
-    for (unsigned i = 0; i < numFiles; ++i)
+    // ATOMIC BEGIN
+    if (id == "UPK2")
     {
-        String entryName = file->ReadString();
-        PackageEntry newEntry;
-        newEntry.offset_ = file->ReadUInt() + startOffset;
-        totalDataSize_ += (newEntry.size_ = file->ReadUInt());
-        newEntry.checksum_ = file->ReadUInt();
-        if (!compressed_ && newEntry.offset_ + newEntry.size_ > totalSize_)
-        {
-            ATOMIC_LOGERROR("File entry " + entryName + " outside package file");
+        if (!ReadDirectoryIndex(*file, startOffset))
             return false;
+    }
+    else
+    {
+        unsigned numFiles = file->ReadUInt();
+        checksum_ = file->ReadUInt();
+
+        for (unsigned i = 0; i < numFiles; ++i)
+        {
+            String entryName = file->ReadString();
+            PackageEntry newEntry;
+            newEntry.offset_ = file->ReadUInt() + startOffset;
+            totalDataSize_ += (newEntry.size_ = file->ReadUInt());
+            newEntry.checksum_ = file->ReadUInt();
+            newEntry.packedSize_ = compressed_ ? 0 : newEntry.size_;
+            newEntry.codec_ = compressed_ ? PACKAGE_CODEC_LZ4 : PACKAGE_CODEC_NONE;
+            if (!compressed_ && newEntry.offset_ + newEntry.size_ > totalSize_)
+            {
+                ATOMIC_LOGERROR("File entry " + entryName + " outside package file");
+                return false;
+            }
+            else
+                entries_[entryName] = newEntry;
         }
-        else
-            entries_[entryName] = newEntry;
     }
+    // ATOMIC END
+
+    // ATOMIC BEGIN
+    if (memoryMap)
+    {
+        // Fall back to regular file reads if the mapping fails
+        file->Close();
+        if (!MapFile())
+            ATOMIC_LOGWARNING("Could not memory map package file " + fileName_ + ", using regular file reads");
+    }
+    // ATOMIC END
 
     return true;
 }
 
 bool PackageFile::Exists(const String& fileName) const
 {
+    // ATOMIC BEGIN
+    if (!indexRecords_.Empty())
+        return GetEntry(fileName) != 0;
+    // ATOMIC END
+
     bool found = entries_.Find(fileName) != entries_.End();
 
 #ifdef _WIN32
@@ -139,6 +200,27 @@ bool PackageFile::Exists(const String& fileName) const
 
 const PackageEntry* PackageFile::GetEntry(const String& fileName) const
 {
+    // ATOMIC BEGIN
+    if (!indexRecords_.Empty())
+    {
+        unsigned index = FindIndexEntry(fileName);
+        if (index < indexEntries_.Size())
+            return &indexEntries_[index];
+
+#ifdef _WIN32
+        // On Windows perform a fallback case-insensitive search
+        for (unsigned i = 0; i < indexRecords_.Size(); ++i)
+        {
+            const PackageIndexEntry& record = indexRecords_[i];
+            if (!String(&indexNames_[record.nameOffset_], record.nameLength_).Compare(fileName, false))
+                return &indexEntries_[i];
+        }
+#endif
+
+        return 0;
+    }
+    // ATOMIC END
+
     HashMap<String, PackageEntry>::ConstIterator i = entries_.Find(fileName);
     if (i != entries_.End())
         return &i->second_;
@@ -159,6 +241,343 @@ const PackageEntry* PackageFile::GetEntry(const String& fileName) const
 }
 
 // ATOMIC BEGIN
+
+/// Uncompressed size of a compressed entry block.
+static const unsigned COMPRESSED_BLOCK_SIZE = 32768;
+/// Entries that compress by less than 1/16th of their size are stored uncompressed.
+static const unsigned MIN_COMPRESSION_SAVING_DIVISOR = 16;
+
+/// Return the index hash of an entry name hash for a displacement. Displacement 0 selects the bucket.
+static inline unsigned long long GetIndexHash(unsigned long long nameHash, int displacement)
+{
+    // SplitMix64 finalizer
+    unsigned long long hash = nameHash + (unsigned long long)(displacement + 1) * 0x9e3779b97f4a7c15ULL;
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+/// Return the directory slot of an entry name hash.
+static inline unsigned GetIndexSlot(unsigned long long nameHash, const int* displacements, unsigned numFiles)
+{
+    int displacement = displacements[GetIndexHash(nameHash, 0) % numFiles];
+    // Negative displacements store the slot of a single entry bucket directly
+    if (displacement < 0)
+        return (unsigned)(-displacement - 1);
+    return (unsigned)(GetIndexHash(nameHash, displacement) % numFiles);
+}
+
+/// Build a minimal perfect hash index with the hash and displace method. Return false if the name hashes are not unique.
+static bool BuildDirectoryIndex(const PODVector<unsigned long long>& nameHashes, PODVector<int>& displacements, PODVector<unsigned>& slots)
+{
+    unsigned numFiles = nameHashes.Size();
+    displacements.Resize(numFiles);
+    slots.Resize(numFiles);
+    if (!numFiles)
+        return true;
+
+    PODVector<unsigned long long> sortedHashes = nameHashes;
+    Sort(sortedHashes.Begin(), sortedHashes.End());
+    for (unsigned i = 1; i < numFiles; ++i)
+    {
+        if (sortedHashes[i] == sortedHashes[i - 1])
+            return false;
+    }
+
+    // Group the entries into buckets, then place the largest buckets first while most slots are free
+    Vector<PODVector<unsigned> > buckets(numFiles);
+    for (unsigned i = 0; i < numFiles; ++i)
+        buckets[GetIndexHash(nameHashes[i], 0) % numFiles].Push(i);
+
+    PODVector<unsigned> order(numFiles);
+    for (unsigned i = 0; i < numFiles; ++i)
+    {
+        order[i] = i;
+        displacements[i] = 0;
+    }
+    Sort(order.Begin(), order.End(), [&buckets](unsigned lhs, unsigned rhs)
+    {
+        return buckets[lhs].Size() > buckets[rhs].Size();
+    });
+
+    PODVector<bool> used(numFiles);
+    for (unsigned i = 0; i < numFiles; ++i)
+        used[i] = false;
+
+    PODVector<unsigned> bucketSlots;
+    unsigned i = 0;
+
+    // Search a displacement that moves all entries of a multi-entry bucket to free slots
+    for (; i < numFiles && buckets[order[i]].Size() > 1; ++i)
+    {
+        const PODVector<unsigned>& bucket = buckets[order[i]];
+        for (int displacement = 1; ; ++displacement)
+        {
+            if (displacement == M_MAX_INT)
+                return false;
+
+            bucketSlots.Clear();
+            for (unsigned j = 0; j < bucket.Size(); ++j)
+            {
+                unsigned slot = (unsigned)(GetIndexHash(nameHashes[bucket[j]], displacement) % numFiles);
+                if (used[slot] || bucketSlots.Contains(slot))
+                    break;
+                bucketSlots.Push(slot);
+            }
+
+            if (bucketSlots.Size() == bucket.Size())
+            {
+                displacements[order[i]] = displacement;
+                for (unsigned j = 0; j < bucket.Size(); ++j)
+                {
+                    used[bucketSlots[j]] = true;
+                    slots[bucket[j]] = bucketSlots[j];
+                }
+                break;
+            }
+        }
+    }
+
+    // Single entry buckets take the remaining free slots directly
+    unsigned freeSlot = 0;
+    for (; i < numFiles && buckets[order[i]].Size() == 1; ++i)
+    {
+        while (used[freeSlot])
+            ++freeSlot;
+        used[freeSlot] = true;
+        displacements[order[i]] = -(int)freeSlot - 1;
+        slots[buckets[order[i]][0]] = freeSlot;
+    }
+
+    return true;
+}
+
+const HashMap<String, PackageEntry>& PackageFile::GetEntries() const
+{
+    // Resources may be requested from several threads, so build the map under the mutex. It is not modified afterward
+    MutexLock lock(entriesMutex_);
+
+    if (entries_.Empty() && !indexRecords_.Empty())
+    {
+        for (unsigned i = 0; i < indexRecords_.Size(); ++i)
+        {
+            const PackageIndexEntry& record = indexRecords_[i];
+            entries_[String(&indexNames_[record.nameOffset_], record.nameLength_)] = indexEntries_[i];
+        }
+    }
+
+    return entries_;
+}
+
+unsigned long long PackageFile::GetEntryNameHash(const String& name)
+{
+    return FNV1aHash64(name.CString(), name.Length());
+}
+
+bool PackageFile::WriteDirectory(Serializer& dest, const Vector<String>& names, const PODVector<PackageEntry>& entries, unsigned checksum)
+{
+    unsigned numFiles = names.Size();
+    if (entries.Size() != numFiles)
+        return false;
+
+    PODVector<unsigned long long> nameHashes(numFiles);
+    for (unsigned i = 0; i < numFiles; ++i)
+        nameHashes[i] = GetEntryNameHash(names[i]);
+
+    PODVector<int> displacements;
+    PODVector<unsigned> slots;
+    if (!BuildDirectoryIndex(nameHashes, displacements, slots))
+    {
+        ATOMIC_LOGERROR("Could not build package directory index, entry names are not unique");
+        return false;
+    }
+
+    PODVector<PackageIndexEntry> records(numFiles);
+    String nameTable;
+    for (unsigned i = 0; i < numFiles; ++i)
+    {
+        const PackageEntry& entry = entries[i];
+        PackageIndexEntry& record = records[slots[i]];
+        record.nameHash_ = nameHashes[i];
+        record.offset_ = entry.offset_;
+        record.size_ = entry.size_;
+        record.packedSize_ = entry.packedSize_;
+        record.checksum_ = entry.checksum_;
+        record.nameOffset_ = nameTable.Length();
+        record.nameLength_ = names[i].Length();
+        record.codec_ = entry.codec_;
+        nameTable += names[i];
+    }
+
+    bool success = dest.WriteFileID("UPK2");
+    success &= dest.WriteUInt(numFiles);
+    success &= dest.WriteUInt(checksum);
+    success &= dest.WriteUInt(nameTable.Length());
+    if (numFiles)
+    {
+        success &= dest.Write(&displacements[0], numFiles * sizeof(int)) == numFiles * sizeof(int);
+        success &= dest.Write(&records[0], numFiles * sizeof(PackageIndexEntry)) == numFiles * sizeof(PackageIndexEntry);
+    }
+    if (nameTable.Length())
+        success &= dest.Write(nameTable.CString(), nameTable.Length()) == nameTable.Length();
+
+    return success;
+}
+
+bool PackageFile::CompressEntry(const unsigned char* data, unsigned size, PackageCodec& codec, VectorBuffer& dest)
+{
+    if (codec == PACKAGE_CODEC_NONE)
+        return true;
+
+    int compressBound = LZ4_compressBound(COMPRESSED_BLOCK_SIZE);
+    SharedArrayPtr<unsigned char> compressBuffer(new unsigned char[compressBound]);
+
+    for (unsigned pos = 0; pos < size; pos += COMPRESSED_BLOCK_SIZE)
+    {
+        unsigned unpackedSize = Min(size - pos, COMPRESSED_BLOCK_SIZE);
+
+        int packedSize;
+        if (codec == PACKAGE_CODEC_LZ4HC)
+            packedSize = LZ4_compressHC((const char*)&data[pos], (char*)compressBuffer.Get(), unpackedSize);
+        else
+            packedSize = LZ4_compress_default((const char*)&data[pos], (char*)compressBuffer.Get(), unpackedSize, compressBound);
+        if (packedSize <= 0)
+            return false;
+
+        dest.WriteUShort((unsigned short)unpackedSize);
+        dest.WriteUShort((unsigned short)packedSize);
+        dest.Write(compressBuffer.Get(), (unsigned)packedSize);
+    }
+
+    // Store as is if compression does not pay off, eg. for already compressed images and sounds
+    if (dest.GetSize() + size / MIN_COMPRESSION_SAVING_DIVISOR >= size)
+        codec = PACKAGE_CODEC_NONE;
+
+    return true;
+}
+
+unsigned PackageFile::FindDuplicateEntry(PODVector<PackageEntry>& entries, unsigned index, const unsigned char* data,
+    HashMap<unsigned long long, unsigned>& contentEntries)
+{
+    PackageEntry& entry = entries[index];
+    unsigned long long contentHash = FNV1aHash64(data, entry.size_);
+
+    // The hash may collide, so also compare size and checksum
+    HashMap<unsigned long long, unsigned>::ConstIterator i = contentEntries.Find(contentHash);
+    if (i != contentEntries.End())
+    {
+        const PackageEntry& original = entries[i->second_];
+        if (original.size_ == entry.size_ && original.checksum_ == entry.checksum_)
+        {
+            entry.offset_ = original.offset_;
+            entry.packedSize_ = original.packedSize_;
+            entry.codec_ = original.codec_;
+            return i->second_;
+        }
+    }
+
+    contentEntries[contentHash] = index;
+    return M_MAX_UNSIGNED;
+}
+
+bool PackageFile::ReadDirectoryIndex(File& file, unsigned startOffset)
+{
+    MutexLock lock(entriesMutex_);
+    entries_.Clear();
+    totalDataSize_ = 0;
+    compressed_ = false;
+
+    unsigned numFiles = file.ReadUInt();
+    checksum_ = file.ReadUInt();
+    unsigned nameTableSize = file.ReadUInt();
+
+    unsigned long long directorySize = (unsigned long long)numFiles * (sizeof(int) + sizeof(PackageIndexEntry)) + nameTableSize;
+    if (file.GetPosition() + directorySize > totalSize_)
+    {
+        ATOMIC_LOGERROR(fileName_ + " has a truncated package directory");
+        return false;
+    }
+
+    indexDisplacements_.Resize(numFiles);
+    indexRecords_.Resize(numFiles);
+    indexEntries_.Resize(numFiles);
+    indexNames_.Resize(nameTableSize);
+
+    // The directory is stored in its in-memory layout, so it is read as is without per-entry parsing
+    if (numFiles)
+    {
+        file.Read(&indexDisplacements_[0], numFiles * sizeof(int));
+        file.Read(&indexRecords_[0], numFiles * sizeof(PackageIndexEntry));
+    }
+    if (nameTableSize)
+        file.Read(&indexNames_[0], nameTableSize);
+
+    // Lookups index the records with the displacements unchecked, so reject direct slots outside the directory, and
+    // the one displacement that can not be negated
+    for (unsigned i = 0; i < numFiles; ++i)
+    {
+        int displacement = indexDisplacements_[i];
+        if (displacement == M_MIN_INT || (displacement < 0 && (unsigned)(-displacement - 1) >= numFiles))
+        {
+            ATOMIC_LOGERROR(fileName_ + " has a corrupt package directory index");
+            return false;
+        }
+    }
+
+    for (unsigned i = 0; i < numFiles; ++i)
+    {
+        const PackageIndexEntry& record = indexRecords_[i];
+        unsigned long long offset = record.offset_ + startOffset;
+
+        if (record.codec_ >= MAX_PACKAGE_CODECS)
+        {
+            ATOMIC_LOGERROR(fileName_ + " uses an unsupported compression codec");
+            return false;
+        }
+        if (!record.nameLength_ || (unsigned long long)record.nameOffset_ + record.nameLength_ > nameTableSize)
+        {
+            ATOMIC_LOGERROR(fileName_ + " has a corrupt package directory");
+            return false;
+        }
+        // The package is limited to 4 GB, as the file class addresses files with 32-bit positions
+        if (offset + record.packedSize_ > totalSize_)
+        {
+            ATOMIC_LOGERROR("File entry " + String(&indexNames_[record.nameOffset_], record.nameLength_) + " outside package file");
+            return false;
+        }
+
+        PackageEntry& entry = indexEntries_[i];
+        entry.offset_ = (unsigned)offset;
+        entry.size_ = record.size_;
+        entry.checksum_ = record.checksum_;
+        entry.packedSize_ = record.packedSize_;
+        entry.codec_ = (PackageCodec)record.codec_;
+
+        totalDataSize_ += entry.size_;
+        if (entry.codec_ != PACKAGE_CODEC_NONE)
+            compressed_ = true;
+    }
+
+    return true;
+}
+
+unsigned PackageFile::FindIndexEntry(const String& fileName) const
+{
+    if (indexRecords_.Empty())
+        return M_MAX_UNSIGNED;
+
+    unsigned long long nameHash = GetEntryNameHash(fileName);
+    unsigned slot = GetIndexSlot(nameHash, &indexDisplacements_[0], indexRecords_.Size());
+    const PackageIndexEntry& record = indexRecords_[slot];
+
+    // Names not in the package also map to some slot, so verify the name
+    if (record.nameHash_ == nameHash && record.nameLength_ == fileName.Length() &&
+        !memcmp(&indexNames_[record.nameOffset_], fileName.CString(), record.nameLength_))
+        return slot;
+
+    return M_MAX_UNSIGNED;
+}
+
 void PackageFile::Scan(Vector<String>& result, const String& pathName, const String& filter, bool recursive) const
 {
     result.Clear();
@@ -191,5 +610,96 @@ void PackageFile::Scan(Vector<String>& result, const String& pathName, const Str
         }
     }
 }
+
+const unsigned char* PackageFile::GetEntryData(const String& fileName, unsigned& size) const
+{
+    size = 0;
+    if (!mapping_)
+        return 0;
+
+    const PackageEntry* entry = GetEntry(fileName);
+    if (!entry || entry->codec_ != PACKAGE_CODEC_NONE)
+        return 0;
+
+    size = entry->size_;
+    return mapping_->GetData() + entry->offset_;
+}
+
+bool PackageFile::MapFile()
+{
+    if (!totalSize_)
+        return false;
+
+#if defined(__ANDROID__)
+    // Files inside the APK can not be mapped
+    if (ATOMIC_IS_ASSET(fileName_))
+        return false;
+#endif
+
+#if defined(_WIN32)
+    HANDLE fileHandle = CreateFileW(GetWideNativePath(fileName_).CString(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, 0);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    void* data = 0;
+    HANDLE mappingHandle = CreateFileMappingW(fileHandle, 0, PAGE_READONLY, 0, 0, 0);
+    if (mappingHandle)
+    {
+        data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, totalSize_);
+        // The view keeps the mapping alive
+        CloseHandle(mappingHandle);
+    }
+    CloseHandle(fileHandle);
+    if (data)
+    {
+        mapping_ = new PackageFileMapping(data, totalSize_);
+        mapping_->AddRef();
+    }
+#elif !defined(__EMSCRIPTEN__)
+    int fd = open(GetNativePath(fileName_).CString(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    // Shared read-only mapping, so that all processes opening the package share the same page cache
+    void* data = mmap(0, totalSize_, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    if (data != MAP_FAILED)
+    {
+        mapping_ = new PackageFileMapping(data, totalSize_);
+        mapping_->AddRef();
+    }
+#endif
+
+    return mapping_ != 0;
+}
+
+void PackageFile::UnmapFile()
+{
+    // Files still reading from the mapping keep it alive
+    if (mapping_)
+    {
+        mapping_->ReleaseRef();
+        mapping_ = 0;
+    }
+}
+
+PackageFileMapping::PackageFileMapping(void* data, unsigned size) :
+    data_(data),
+    size_(size),
+    refs_(0)
+{
+}
+
+PackageFileMapping::~PackageFileMapping()
+{
+#if defined(_WIN32)
+    UnmapViewOfFile(data_);
+#elif !defined(__EMSCRIPTEN__)
+    munmap(data_, size_);
+#endif
+}
+
 // ATOMIC END
 }
@@ -23,10 +23,35 @@
 #pragma once
 
 #include "../Core/Object.h"
+// ATOMIC BEGIN
+#include "../Core/Mutex.h"
+
+#include <atomic>
+// ATOMIC END
 
 namespace Atomic
 {
 
+// ATOMIC BEGIN
+
+class File;
+class Serializer;
+class VectorBuffer;
+
+/// Compression codec of a package file entry.
+enum PackageCodec
+{
+    /// Stored as is.
+    PACKAGE_CODEC_NONE = 0,
+    /// LZ4 compressed blocks.
+    PACKAGE_CODEC_LZ4,
+    /// LZ4 high compression blocks. Decompressed the same way as LZ4.
+    PACKAGE_CODEC_LZ4HC,
+    MAX_PACKAGE_CODECS
+};
+
+// ATOMIC END
+
 /// %File entry within the package file.
 struct PackageEntry
 {
@@ -36,9 +61,77 @@ struct PackageEntry
     unsigned size_;
     /// File checksum.
     unsigned checksum_;
+    // ATOMIC BEGIN
+    /// Stored size including compressed block headers, or 0 if not known.
+    unsigned packedSize_;
+    /// Compression codec.
+    PackageCodec codec_;
+    // ATOMIC END
+};
+
+// ATOMIC BEGIN
+
+/// Directory record of a version 2 package file. The directory is stored as an array of these, ordered by a minimal perfect hash of the entry names, so that it loads with a single read and is looked up without building a name map.
+struct PackageIndexEntry
+{
+    /// Hash of the entry name.
+    unsigned long long nameHash_;
+    /// Offset from the beginning of the package. Stored as 64-bit for future use, but File and PackageFile address packages with 32-bit positions, so packages are limited to 4 GB.
+    unsigned long long offset_;
+    /// File size.
+    unsigned size_;
+    /// Stored size including compressed block headers.
+    unsigned packedSize_;
+    /// File checksum.
+    unsigned checksum_;
+    /// Offset of the entry name in the name table.
+    unsigned nameOffset_;
+    /// Length of the entry name.
+    unsigned nameLength_;
+    /// Compression codec.
+    unsigned codec_;
+};
+
+/// Memory mapping of a package file. Not an Object, so that files reading from it on worker threads can hold a reference: the reference count is atomic and the mapping is released by whichever thread drops the last one.
+class ATOMIC_API PackageFileMapping
+{
+public:
+    /// Construct from a mapped view and its size. Takes ownership of the view.
+    PackageFileMapping(void* data, unsigned size);
+    /// Destruct. Unmap the view.
+    ~PackageFileMapping();
+
+    /// Increment the reference count.
+    void AddRef() { ++refs_; }
+    /// Decrement the reference count and delete the mapping when it reaches zero.
+    void ReleaseRef()
+    {
+        if (--refs_ == 0)
+            delete this;
+    }
+
+    /// Return the start of the mapped package file.
+    const unsigned char* GetData() const { return (const unsigned char*)data_; }
+    /// Return the mapped size.
+    unsigned GetSize() const { return size_; }
+
+private:
+    /// Prevent copy construction.
+    PackageFileMapping(const PackageFileMapping& rhs);
+    /// Prevent assignment.
+    PackageFileMapping& operator =(const PackageFileMapping& rhs);
+
+    /// Mapped view.
+    void* data_;
+    /// Mapped size.
+    unsigned size_;
+    /// Reference count.
+    std::atomic<int> refs_;
 };
 
-/// Stores files of a directory tree sequentially for convenient access.
+// ATOMIC END
+
+/// Stores files of a directory tree sequentially for convenient access. Package files are limited to 4 GB, as file positions and sizes are 32-bit.
 class ATOMIC_API PackageFile : public Object
 {
     ATOMIC_OBJECT(PackageFile, Object);
@@ -51,15 +144,17 @@ public:
     /// Destruct.
     virtual ~PackageFile();
 
-    /// Open the package file. Return true if successful.
-    bool Open(const String& fileName, unsigned startOffset = 0);
+    /// Open the package file. Optionally map the whole file into memory for zero-copy access of uncompressed entries. Return true if successful.
+    bool Open(const String& fileName, unsigned startOffset = 0, bool memoryMap = false);
     /// Check if a file exists within the package file. This will be case-insensitive on Windows and case-sensitive on other platforms.
     bool Exists(const String& fileName) const;
     /// Return the file entry corresponding to the name, or null if not found. This will be case-insensitive on Windows and case-sensitive on other platforms.
     const PackageEntry* GetEntry(const String& fileName) const;
 
-    /// Return all file entries.
-    const HashMap<String, PackageEntry>& GetEntries() const { return entries_; }
+    // ATOMIC BEGIN
+    /// Return all file entries. For version 2 packages the name map is built on first call. Safe to call from several threads.
+    const HashMap<String, PackageEntry>& GetEntries() const;
+    // ATOMIC END
 
     /// Return the package file name.
     const String& GetName() const { return fileName_; }
@@ -68,7 +163,7 @@ public:
     StringHash GetNameHash() const { return nameHash_; }
 
     /// Return number of files.
-    unsigned GetNumFiles() const { return entries_.Size(); }
+    unsigned GetNumFiles() const { return indexEntries_.Empty() ? entries_.Size() : indexEntries_.Size(); }
 
     /// Return total size of the package file.
     unsigned GetTotalSize() const { return totalSize_; }
@@ -79,11 +174,11 @@ public:
     /// Return checksum of the package file contents.
     unsigned GetChecksum() const { return checksum_; }
 
-    /// Return whether the files are compressed.
+    /// Return whether the files are compressed. For version 2 packages, whether any file is compressed.
     bool IsCompressed() const { return compressed_; }
 
     /// Return list of file names in the package.
-    const Vector<String> GetEntryNames() const { return entries_.Keys(); }
+    const Vector<String> GetEntryNames() const { return GetEntries().Keys(); }
 
     // ATOMIC BEGIN
 
@@ -91,7 +186,8 @@ public:
     const String& GetEntryName(unsigned index) const 
     {
         unsigned nn = 0;
-        for (HashMap<String, PackageEntry>::ConstIterator j = entries_.Begin(); j != entries_.End(); ++j)
+        const HashMap<String, PackageEntry>& entries = GetEntries();
+        for (HashMap<String, PackageEntry>::ConstIterator j = entries.Begin(); j != entries.End(); ++j)
         {
             if (nn == index) return j->first_;
             nn++;
@@ -102,11 +198,50 @@ public:
 
     /// Scan package for specified files.
     void Scan(Vector<String>& result, const String& pathName, const String& filter, bool recursive) const;
-    
+
+    /// Return whether the package file is mapped into memory.
+    bool IsMemoryMapped() const { return mapping_ != 0; }
+
+    /// Return the memory mapping of the package file, or null if not mapped. Readers that may outlive the package file hold a reference to it.
+    PackageFileMapping* GetMapping() const { return mapping_; }
+
+    /// Return a read-only view of an entry's data within the mapped package file, or null if not mapped or compressed. The view is valid for the lifetime of the package file.
+    const unsigned char* GetEntryData(const String& fileName, unsigned& size) const;
+
+    /// Return whether the package uses the version 2 format with a hashed directory index.
+    bool HasDirectoryIndex() const { return !indexRecords_.Empty(); }
+
+    /// Return the hash of an entry name used by the version 2 directory index.
+    static unsigned long long GetEntryNameHash(const String& name);
+
+    /// Write a version 2 package directory. Entry offsets are relative to the package start. The directory size does not depend on offsets, sizes or checksums, so it can be written first as a placeholder and rewritten when the file data is in place. Return true if successful.
+    static bool WriteDirectory(Serializer& dest, const Vector<String>& names, const PODVector<PackageEntry>& entries, unsigned checksum);
+    /// Compress entry data into LZ4 blocks for writing into a package. Set the codec to PACKAGE_CODEC_NONE if it is a compressing codec but compression does not pay off, in which case the data should be stored as is. Return false if compression fails.
+    static bool CompressEntry(const unsigned char* data, unsigned size, PackageCodec& codec, VectorBuffer& dest);
+    /// Find an earlier entry with the same contents as an entry being written, so that identical contents are stored once. The entry's size and checksum must be set. If found, copy its offset, packed size and codec to the entry and return its index. Otherwise remember the contents and return M_MAX_UNSIGNED.
+    static unsigned FindDuplicateEntry(PODVector<PackageEntry>& entries, unsigned index, const unsigned char* data, HashMap<unsigned long long, unsigned>& contentEntries);
+
     // ATOMIC END
 private:
-    /// File entries.
-    HashMap<String, PackageEntry> entries_;
+    // ATOMIC BEGIN
+
+    /// Map the whole package file into memory. Return true if successful.
+    bool MapFile();
+    /// Release the memory mapping.
+    void UnmapFile();
+    /// Read the version 2 directory following the package ID. Return true if successful.
+    bool ReadDirectoryIndex(File& file, unsigned startOffset);
+    /// Return the version 2 directory index of an entry by exact name, or M_MAX_UNSIGNED if not found.
+    unsigned FindIndexEntry(const String& fileName) const;
+
+    // ATOMIC END
+
+    // ATOMIC BEGIN
+    /// File entries. Built on demand for version 2 packages.
+    mutable HashMap<String, PackageEntry> entries_;
+    /// Mutex for building the version 2 package file entries on demand.
+    mutable Mutex entriesMutex_;
+    // ATOMIC END
     /// File name.
     String fileName_;
     /// Package file name hash.
@@ -119,6 +254,18 @@ private:
     unsigned checksum_;
     /// Compressed flag.
     bool compressed_;
+    // ATOMIC BEGIN
+    /// Memory mapping of the package file, null if not mapped.
+    PackageFileMapping* mapping_;
+    /// Perfect hash displacements of the version 2 directory index.
+    PODVector<int> indexDisplacements_;
+    /// Version 2 directory records, ordered by name hash slot.
+    PODVector<PackageIndexEntry> indexRecords_;
+    /// File entries converted from the version 2 directory records.
+    PODVector<PackageEntry> indexEntries_;
+    /// Entry name table of the version 2 directory.
+    PODVector<char> indexNames_;
+    // ATOMIC END
 };
 
 }
@@ -211,6 +211,20 @@ inline unsigned CountSetBits(unsigned value)
 /// Update a hash with the given 8-bit value using the SDBM algorithm.
 inline unsigned SDBMHash(unsigned hash, unsigned char c) { return c + (hash << 6) + (hash << 16) - hash; }
 
+// ATOMIC BEGIN
+/// Initial value for a 64-bit FNV-1a hash.
+static const unsigned long long FNV1A_64_INIT = 0xcbf29ce484222325ULL;
+
+/// Update a 64-bit hash with a block of data using the FNV-1a algorithm.
+inline unsigned long long FNV1aHash64(const void* data, unsigned size, unsigned long long hash = FNV1A_64_INIT)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (unsigned i = 0; i < size; ++i)
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    return hash;
+}
+// ATOMIC END
+
 /// Return a random float between 0.0 (inclusive) and 1.0 (exclusive.)
 inline float Random() { return Rand() / 32768.0f; }
 
@@ -0,0 +1,398 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include "../Precompiled.h"
+
+#include "../Math/MathSIMD.h"
+
+#ifdef ATOMIC_SSE
+#include <emmintrin.h>
+#endif
+
+#include "../DebugNew.h"
+
+namespace Atomic
+{
+
+static const unsigned NUM_PACKED_PLANES = 8;
+
+#ifdef ATOMIC_SSE
+/// Sum the four lanes of a vector into all lanes.
+static inline __m128 HorizontalSum(__m128 v)
+{
+    v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3)));
+}
+
+/// Normalize a quaternion held in a vector, using the same refined reciprocal square root as Quaternion::Normalize().
+static inline __m128 NormalizeQuaternion(__m128 q)
+{
+    __m128 n = HorizontalSum(_mm_mul_ps(q, q));
+    __m128 e = _mm_rsqrt_ps(n);
+    __m128 e3 = _mm_mul_ps(_mm_mul_ps(e, e), e);
+    n = _mm_add_ps(e, _mm_mul_ps(_mm_set1_ps(0.5f), _mm_sub_ps(e, _mm_mul_ps(n, e3))));
+    return _mm_mul_ps(q, n);
+}
+
+/// Spherical linear interpolation of quaternions held in vectors, matching Quaternion::Slerp().
+static inline __m128 SlerpQuaternion(__m128 a, __m128 b, float t)
+{
+    float cosAngle = _mm_cvtss_f32(HorizontalSum(_mm_mul_ps(a, b)));
+    // Enable shortest path rotation
+    if (cosAngle < 0.0f)
+    {
+        cosAngle = -cosAngle;
+        b = _mm_sub_ps(_mm_setzero_ps(), b);
+    }
+
+    float angle = acosf(cosAngle);
+    float sinAngle = sinf(angle);
+    float t1, t2;
+
+    if (sinAngle > 0.001f)
+    {
+        float invSinAngle = 1.0f / sinAngle;
+        t1 = sinf((1.0f - t) * angle) * invSinAngle;
+        t2 = sinf(t * angle) * invSinAngle;
+    }
+    else
+    {
+        t1 = 1.0f - t;
+        t2 = t;
+    }
+
+    return _mm_add_ps(_mm_mul_ps(a, _mm_set1_ps(t1)), _mm_mul_ps(b, _mm_set1_ps(t2)));
+}
+
+/// Store the XYZ lanes of a vector to a Vector3.
+static inline void StoreVector3(Vector3& dest, __m128 v)
+{
+    _mm_storel_pi((__m64*)&dest.x_, v);
+    _mm_store_ss(&dest.z_, _mm_movehl_ps(v, v));
+}
+#endif
+
+PackedFrustum::PackedFrustum()
+{
+    for (unsigned i = 0; i < NUM_PACKED_PLANES; ++i)
+    {
+        normalX_[i] = normalY_[i] = normalZ_[i] = 0.0f;
+        absNormalX_[i] = absNormalY_[i] = absNormalZ_[i] = 0.0f;
+        d_[i] = M_INFINITY;
+    }
+}
+
+PackedFrustum::PackedFrustum(const Frustum& frustum)
+{
+    Define(frustum);
+}
+
+void PackedFrustum::Define(const Frustum& frustum)
+{
+    for (unsigned i = 0; i < NUM_PACKED_PLANES; ++i)
+    {
+        if (i < NUM_FRUSTUM_PLANES)
+        {
+            const Plane& plane = frustum.planes_[i];
+            normalX_[i] = plane.normal_.x_;
+            normalY_[i] = plane.normal_.y_;
+            normalZ_[i] = plane.normal_.z_;
+            d_[i] = plane.d_;
+            absNormalX_[i] = plane.absNormal_.x_;
+            absNormalY_[i] = plane.absNormal_.y_;
+            absNormalZ_[i] = plane.absNormal_.z_;
+        }
+        else
+        {
+            // Padding planes: zero normal and infinite distance, so nothing is ever outside of them
+            normalX_[i] = normalY_[i] = normalZ_[i] = 0.0f;
+            absNormalX_[i] = absNormalY_[i] = absNormalZ_[i] = 0.0f;
+            d_[i] = M_INFINITY;
+        }
+    }
+}
+
+Intersection PackedFrustum::TestVolume(float cx, float cy, float cz, float ex, float ey, float ez, float radius, bool fast) const
+{
+#ifdef ATOMIC_SSE
+    const __m128 centerX = _mm_set1_ps(cx);
+    const __m128 centerY = _mm_set1_ps(cy);
+    const __m128 centerZ = _mm_set1_ps(cz);
+    const __m128 edgeX = _mm_set1_ps(ex);
+    const __m128 edgeY = _mm_set1_ps(ey);
+    const __m128 edgeZ = _mm_set1_ps(ez);
+    const __m128 rad = _mm_set1_ps(radius);
+    const __m128 zero = _mm_setzero_ps();
+    int intersects = 0;
+
+    for (unsigned i = 0; i < NUM_PACKED_PLANES; i += 4)
+    {
+        __m128 dist = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(_mm_loadu_ps(&normalX_[i]), centerX),
+            _mm_mul_ps(_mm_loadu_ps(&normalY_[i]), centerY)),
+            _mm_mul_ps(_mm_loadu_ps(&normalZ_[i]), centerZ)),
+            _mm_loadu_ps(&d_[i]));
+        __m128 absDist = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(_mm_loadu_ps(&absNormalX_[i]), edgeX),
+            _mm_mul_ps(_mm_loadu_ps(&absNormalY_[i]), edgeY)),
+            _mm_mul_ps(_mm_loadu_ps(&absNormalZ_[i]), edgeZ)),
+            rad);
+
+        if (_mm_movemask_ps(_mm_cmplt_ps(dist, _mm_sub_ps(zero, absDist))))
+            return OUTSIDE;
+        if (!fast)
+            intersects |= _mm_movemask_ps(_mm_cmplt_ps(dist, absDist));
+    }
+
+    return intersects ? INTERSECTS : INSIDE;
+#else
+    bool allInside = true;
+
+    for (unsigned i = 0; i < NUM_FRUSTUM_PLANES; ++i)
+    {
+        float dist = normalX_[i] * cx + normalY_[i] * cy + normalZ_[i] * cz + d_[i];
+        float absDist = absNormalX_[i] * ex + absNormalY_[i] * ey + absNormalZ_[i] * ez + radius;
+
+        if (dist < -absDist)
+            return OUTSIDE;
+        else if (dist < absDist)
+            allInside = false;
+    }
+
+    return (allInside || fast) ? INSIDE : INTERSECTS;
+#endif
+}
+
+Intersection PackedFrustum::IsInside(const BoundingBox& box) const
+{
+    Vector3 center = box.Center();
+    Vector3 edge = center - box.min_;
+    return TestVolume(center.x_, center.y_, center.z_, edge.x_, edge.y_, edge.z_, 0.0f, false);
+}
+
+Intersection PackedFrustum::IsInsideFast(const BoundingBox& box) const
+{
+    Vector3 center = box.Center();
+    Vector3 edge = center - box.min_;
+    return TestVolume(center.x_, center.y_, center.z_, edge.x_, edge.y_, edge.z_, 0.0f, true);
+}
+
+Intersection PackedFrustum::IsInside(const Sphere& sphere) const
+{
+    const Vector3& center = sphere.center_;
+    return TestVolume(center.x_, center.y_, center.z_, 0.0f, 0.0f, 0.0f, sphere.radius_, false);
+}
+
+Intersection PackedFrustum::IsInsideFast(const Sphere& sphere) const
+{
+    const Vector3& center = sphere.center_;
+    return TestVolume(center.x_, center.y_, center.z_, 0.0f, 0.0f, 0.0f, sphere.radius_, true);
+}
+
+void PackedFrustum::IsInside(const BoundingBox* boxes, unsigned count, Intersection* results) const
+{
+    for (unsigned i = 0; i < count; ++i)
+        results[i] = IsInside(boxes[i]);
+}
+
+void PackedFrustum::IsInsideFast(const BoundingBox* boxes, unsigned count, Intersection* results) const
+{
+    for (unsigned i = 0; i < count; ++i)
+        results[i] = IsInsideFast(boxes[i]);
+}
+
+void PackedFrustum::IsInside(const Sphere* spheres, unsigned count, Intersection* results) const
+{
+    for (unsigned i = 0; i < count; ++i)
+        results[i] = IsInside(spheres[i]);
+}
+
+void TransformPoints(const Matrix3x4& transform, const Vector3* src, Vector3* dest, unsigned count)
+{
+#ifdef ATOMIC_SSE
+    // Transpose the rows into columns once, then each point is three broadcasts and multiply-adds
+    __m128 c0 = _mm_loadu_ps(&transform.m00_);
+    __m128 c1 = _mm_loadu_ps(&transform.m10_);
+    __m128 c2 = _mm_loadu_ps(&transform.m20_);
+    __m128 c3 = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        const Vector3& point = src[i];
+        __m128 r = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(c0, _mm_set1_ps(point.x_)),
+            _mm_mul_ps(c1, _mm_set1_ps(point.y_))),
+            _mm_mul_ps(c2, _mm_set1_ps(point.z_))),
+            c3);
+        StoreVector3(dest[i], r);
+    }
+#else
+    for (unsigned i = 0; i < count; ++i)
+        dest[i] = transform * src[i];
+#endif
+}
+
+void TransformPoints(const Matrix4& transform, const Vector3* src, Vector3* dest, unsigned count)
+{
+#ifdef ATOMIC_SSE
+    __m128 c0 = _mm_loadu_ps(&transform.m00_);
+    __m128 c1 = _mm_loadu_ps(&transform.m10_);
+    __m128 c2 = _mm_loadu_ps(&transform.m20_);
+    __m128 c3 = _mm_loadu_ps(&transform.m30_);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        const Vector3& point = src[i];
+        __m128 r = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(c0, _mm_set1_ps(point.x_)),
+            _mm_mul_ps(c1, _mm_set1_ps(point.y_))),
+            _mm_mul_ps(c2, _mm_set1_ps(point.z_))),
+            c3);
+        __m128 invW = _mm_div_ps(one, _mm_shuffle_ps(r, r, _MM_SHUFFLE(3, 3, 3, 3)));
+        StoreVector3(dest[i], _mm_mul_ps(r, invW));
+    }
+#else
+    for (unsigned i = 0; i < count; ++i)
+        dest[i] = transform * src[i];
+#endif
+}
+
+void MultiplyMatrices(const Matrix3x4* lhs, const Matrix3x4* rhs, Matrix3x4* dest, unsigned count)
+{
+    for (unsigned i = 0; i < count; ++i)
+        dest[i] = lhs[i] * rhs[i];
+}
+
+void MultiplyMatrices(const Matrix3x4& lhs, const Matrix3x4* rhs, Matrix3x4* dest, unsigned count)
+{
+#ifdef ATOMIC_SSE
+    // Broadcast the constant left hand side elements once for the whole array
+    __m128 l[3][4];
+    const float* lhsRows[3] = { &lhs.m00_, &lhs.m10_, &lhs.m20_ };
+    for (unsigned row = 0; row < 3; ++row)
+    {
+        for (unsigned col = 0; col < 4; ++col)
+            l[row][col] = _mm_set1_ps(lhsRows[row][col]);
+    }
+    const __m128 translationMask = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        __m128 r0 = _mm_loadu_ps(&rhs[i].m00_);
+        __m128 r1 = _mm_loadu_ps(&rhs[i].m10_);
+        __m128 r2 = _mm_loadu_ps(&rhs[i].m20_);
+        float* out = &dest[i].m00_;
+
+        for (unsigned row = 0; row < 3; ++row)
+        {
+            __m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(l[row][0], r0), _mm_mul_ps(l[row][1], r1)),
+                _mm_mul_ps(l[row][2], r2));
+            _mm_storeu_ps(out + row * 4, _mm_add_ps(t, _mm_and_ps(l[row][3], translationMask)));
+        }
+    }
+#else
+    for (unsigned i = 0; i < count; ++i)
+        dest[i] = lhs * rhs[i];
+#endif
+}
+
+void NlerpQuaternions(const Quaternion* from, const Quaternion* to, float t, Quaternion* dest, unsigned count, bool shortestPath)
+{
+#ifdef ATOMIC_SSE
+    const __m128 weight = _mm_set1_ps(t);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        __m128 a = _mm_loadu_ps(&from[i].w_);
+        __m128 b = _mm_loadu_ps(&to[i].w_);
+        if (shortestPath && _mm_cvtss_f32(HorizontalSum(_mm_mul_ps(a, b))) < 0.0f)
+            b = _mm_sub_ps(zero, b);
+        _mm_storeu_ps(&dest[i].w_, NormalizeQuaternion(_mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), weight))));
+    }
+#else
+    for (unsigned i = 0; i < count; ++i)
+        dest[i] = from[i].Nlerp(to[i], t, shortestPath);
+#endif
+}
+
+void SlerpQuaternions(const Quaternion* from, const Quaternion* to, float t, Quaternion* dest, unsigned count)
+{
+#if defined(ATOMIC_SSE) && !defined(__EMSCRIPTEN__)
+    for (unsigned i = 0; i < count; ++i)
+        _mm_storeu_ps(&dest[i].w_, SlerpQuaternion(_mm_loadu_ps(&from[i].w_), _mm_loadu_ps(&to[i].w_), t));
+#else
+    for (unsigned i = 0; i < count; ++i)
+        dest[i] = from[i].Slerp(to[i], t);
+#endif
+}
+
+void SlerpQuaternions(const Quaternion* from, const Quaternion* to, const float* t, Quaternion* dest, unsigned count)
+{
+#if defined(ATOMIC_SSE) && !defined(__EMSCRIPTEN__)
+    for (unsigned i = 0; i < count; ++i)
+        _mm_storeu_ps(&dest[i].w_, SlerpQuaternion(_mm_loadu_ps(&from[i].w_), _mm_loadu_ps(&to[i].w_), t[i]));
+#else
+    for (unsigned i = 0; i < count; ++i)
+        dest[i] = from[i].Slerp(to[i], t[i]);
+#endif
+}
+
+void LerpVectors(const Vector3* from, const Vector3* to, const float* t, Vector3* dest, unsigned count)
+{
+    unsigned i = 0;
+
+#ifdef ATOMIC_SSE
+    // Four vectors occupy three registers; spread the four weights to match the XYZ lanes
+    const __m128 one = _mm_set1_ps(1.0f);
+    const float* src0 = &from[0].x_;
+    const float* src1 = &to[0].x_;
+    float* dst = &dest[0].x_;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 w = _mm_loadu_ps(t + i);
+        __m128 w0 = _mm_shuffle_ps(w, w, _MM_SHUFFLE(1, 0, 0, 0));
+        __m128 w1 = _mm_shuffle_ps(w, w, _MM_SHUFFLE(2, 2, 1, 1));
+        __m128 w2 = _mm_shuffle_ps(w, w, _MM_SHUFFLE(3, 3, 3, 2));
+        const unsigned base = i * 3;
+
+        __m128 a0 = _mm_loadu_ps(src0 + base);
+        __m128 a1 = _mm_loadu_ps(src0 + base + 4);
+        __m128 a2 = _mm_loadu_ps(src0 + base + 8);
+        __m128 b0 = _mm_loadu_ps(src1 + base);
+        __m128 b1 = _mm_loadu_ps(src1 + base + 4);
+        __m128 b2 = _mm_loadu_ps(src1 + base + 8);
+
+        _mm_storeu_ps(dst + base, _mm_add_ps(_mm_mul_ps(a0, _mm_sub_ps(one, w0)), _mm_mul_ps(b0, w0)));
+        _mm_storeu_ps(dst + base + 4, _mm_add_ps(_mm_mul_ps(a1, _mm_sub_ps(one, w1)), _mm_mul_ps(b1, w1)));
+        _mm_storeu_ps(dst + base + 8, _mm_add_ps(_mm_mul_ps(a2, _mm_sub_ps(one, w2)), _mm_mul_ps(b2, w2)));
+    }
+#endif
+
+    for (; i < count; ++i)
+        dest[i] = from[i].Lerp(to[i], t[i]);
+}
+
+}
@@ -0,0 +1,97 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#pragma once
+
+#include "../Math/Frustum.h"
+#include "../Math/Quaternion.h"
+
+namespace Atomic
+{
+
+/// %Frustum planes packed in structure-of-arrays form, so that one volume can be tested against four planes per
+/// instruction. Define once per query and reuse for every test; results match the corresponding Frustum tests.
+class ATOMIC_API PackedFrustum
+{
+public:
+    /// Construct undefined. Every volume tests as inside until defined.
+    PackedFrustum();
+    /// Construct from a frustum.
+    explicit PackedFrustum(const Frustum& frustum);
+
+    /// Define from a frustum.
+    void Define(const Frustum& frustum);
+
+    /// Test if a bounding box is inside, outside or intersects.
+    Intersection IsInside(const BoundingBox& box) const;
+    /// Test if a bounding box is (partially) inside or outside.
+    Intersection IsInsideFast(const BoundingBox& box) const;
+    /// Test if a sphere is inside, outside or intersects.
+    Intersection IsInside(const Sphere& sphere) const;
+    /// Test if a sphere is (partially) inside or outside.
+    Intersection IsInsideFast(const Sphere& sphere) const;
+
+    /// Test an array of bounding boxes, writing one result per box.
+    void IsInside(const BoundingBox* boxes, unsigned count, Intersection* results) const;
+    /// Test an array of bounding boxes for being (partially) inside, writing one result per box.
+    void IsInsideFast(const BoundingBox* boxes, unsigned count, Intersection* results) const;
+    /// Test an array of spheres, writing one result per sphere.
+    void IsInside(const Sphere* spheres, unsigned count, Intersection* results) const;
+
+private:
+    /// Test a volume given by its center and either a box half size or a sphere radius against the planes.
+    Intersection TestVolume(float cx, float cy, float cz, float ex, float ey, float ez, float radius, bool fast) const;
+
+    /// Plane normal X components. The six planes are padded to eight with planes that accept everything.
+    float normalX_[8];
+    /// Plane normal Y components.
+    float normalY_[8];
+    /// Plane normal Z components.
+    float normalZ_[8];
+    /// Plane constants.
+    float d_[8];
+    /// Absolute plane normal X components.
+    float absNormalX_[8];
+    /// Absolute plane normal Y components.
+    float absNormalY_[8];
+    /// Absolute plane normal Z components.
+    float absNormalZ_[8];
+};
+
+/// Transform an array of points by a 3x4 matrix. Source and destination may be the same array.
+ATOMIC_API void TransformPoints(const Matrix3x4& transform, const Vector3* src, Vector3* dest, unsigned count);
+/// Transform an array of points by a 4x4 matrix, including the perspective divide. Source and destination may be the same array.
+ATOMIC_API void TransformPoints(const Matrix4& transform, const Vector3* src, Vector3* dest, unsigned count);
+/// Multiply arrays of 3x4 matrices pairwise, dest[i] = lhs[i] * rhs[i]. Destination may alias either source.
+ATOMIC_API void MultiplyMatrices(const Matrix3x4* lhs, const Matrix3x4* rhs, Matrix3x4* dest, unsigned count);
+/// Multiply an array of 3x4 matrices by one matrix, dest[i] = lhs * rhs[i]. Destination may alias the source.
+ATOMIC_API void MultiplyMatrices(const Matrix3x4& lhs, const Matrix3x4* rhs, Matrix3x4* dest, unsigned count);
+/// Normalized linear interpolation of quaternion arrays pairwise with the same weight.
+ATOMIC_API void NlerpQuaternions
+    (const Quaternion* from, const Quaternion* to, float t, Quaternion* dest, unsigned count, bool shortestPath = false);
+/// Spherical linear interpolation of quaternion arrays pairwise with the same weight.
+ATOMIC_API void SlerpQuaternions(const Quaternion* from, const Quaternion* to, float t, Quaternion* dest, unsigned count);
+/// Spherical linear interpolation of quaternion arrays pairwise with a weight per element. Destination may alias either source.
+ATOMIC_API void SlerpQuaternions(const Quaternion* from, const Quaternion* to, const float* t, Quaternion* dest, unsigned count);
+/// Linear interpolation of vector arrays pairwise with a weight per element. Destination may alias either source.
+ATOMIC_API void LerpVectors(const Vector3* from, const Vector3* to, const float* t, Vector3* dest, unsigned count);
+
+}
@@ -32,6 +32,7 @@
 // ATOMIC BEGIN
 
 #include "../Container/HashMap.h"
+#include "../Core/Mutex.h"
 
 // ATOMIC END
 
@@ -77,13 +78,18 @@ String StringHash::ToString() const
 
 // ATOMIC BEGIN
 
-// Lookup for significant strings, not a member of StringHash so don't need to drag hashmap into header
+// Lookup for significant strings, not a member of StringHash so don't need to drag hashmap into header.
+// Strings are never removed and hash map nodes do not move on rehash, so references to them stay valid
 static HashMap<StringHash, String> gSignificantLookup;
+// Significant strings may be registered from worker threads, eg. during background resource loading
+static Mutex gSignificantLookupMutex;
 
 StringHash StringHash::RegisterSignificantString(const char* str)
 {
     StringHash hash(str);
 
+    MutexLock lock(gSignificantLookupMutex);
+
     if (gSignificantLookup.Contains(hash))
         return StringHash(hash);
 
@@ -100,6 +106,8 @@ StringHash StringHash::RegisterSignificantString(const String& str)
 
 bool StringHash::GetSignificantString(StringHash hash, String& strOut)
 {
+    MutexLock lock(gSignificantLookupMutex);
+
     if (!gSignificantLookup.TryGetValue(hash, strOut))
     {
         strOut.Clear();
@@ -110,6 +118,14 @@ bool StringHash::GetSignificantString(StringHash hash, String& strOut)
 
 }
 
+const String& StringHash::GetSignificantString(StringHash hash)
+{
+    MutexLock lock(gSignificantLookupMutex);
+
+    HashMap<StringHash, String>::ConstIterator i = gSignificantLookup.Find(hash);
+    return i != gSignificantLookup.End() ? i->second_ : String::EMPTY;
+}
+
 // ATOMIC END
 
 
@@ -117,6 +117,9 @@ public:
     /// Get a significant string from a case insensitive hash value
     static bool GetSignificantString(StringHash hash, String& strOut);
 
+    /// Return the single shared copy of a significant string from a case insensitive hash value, or empty if not registered. The reference stays valid for the lifetime of the program. Is thread-safe.
+    static const String& GetSignificantString(StringHash hash);
+
     // ATOMIC END
 
 private:
@@ -20,8 +20,13 @@
 // THE SOFTWARE.
 //
 
+#include "../Core/CoreEvents.h"
 #include "../IO/Log.h"
 
+#include "../Graphics/Graphics.h"
+#include "../Graphics/InstanceDataStore.h"
+#include "../Graphics/Renderer.h"
+#include "../Resource/ResourceCache.h"
 #include "../Scene/Node.h"
 #include "../Script/ScriptComponent.h"
 #include "../Metrics/Metrics.h"
@@ -35,9 +40,53 @@
 namespace Atomic
 {
 
+const char* METRIC_FRAME_TIME = "FrameTime";
+const char* METRIC_DRAW_CALLS = "DrawCalls";
+const char* METRIC_BATCHES = "Batches";
+const char* METRIC_PRIMITIVES = "Primitives";
+const char* METRIC_RESOURCE_LOADS = "ResourceLoads";
+const char* METRIC_NETWORK_BYTES_IN = "NetworkBytesIn";
+const char* METRIC_NETWORK_BYTES_OUT = "NetworkBytesOut";
+const char* METRIC_INSTANCE_BYTES_UPLOADED = "InstanceBytesUploaded";
+const char* METRIC_INSTANCES = "Instances";
+const char* METRIC_BONES_EVALUATED = "BonesEvaluated";
+const char* METRIC_RESOURCE_CACHE_HITS = "ResourceCacheHits";
+const char* METRIC_RESOURCE_CACHE_MISSES = "ResourceCacheMisses";
+const char* METRIC_RESOURCE_EVICTIONS = "ResourceEvictions";
+const char* METRIC_RESOURCE_EVICTED_BYTES = "ResourceEvictedBytes";
+const char* METRIC_RESOURCE_DEMOTIONS = "ResourceDemotions";
+const char* METRIC_RESOURCE_MEMORY = "ResourceMemory";
+
 Metrics* Metrics::metrics_ = 0;
 bool Metrics::everEnabled_ = false;
 
+static unsigned GetHistogramBucket(unsigned value)
+{
+    if (value < 32)
+        return value;
+
+    unsigned exponent = 5;
+    while (value >> (exponent + 1))
+        ++exponent;
+
+    return 32 + (exponent - 5) * 16 + ((value >> (exponent - 4)) & 15);
+}
+
+static double GetHistogramBucketStart(unsigned bucket)
+{
+    if (bucket < 32)
+        return (double)bucket;
+
+    unsigned exponent = (bucket - 32) / 16 + 5;
+    unsigned mantissa = (bucket - 32) % 16;
+    return (double)(1ULL << exponent) + (double)mantissa * (double)(1ULL << (exponent - 4));
+}
+
+static double GetHistogramBucketWidth(unsigned bucket)
+{
+    return bucket < 32 ? 1.0 : (double)(1ULL << ((bucket - 32) / 16 + 1));
+}
+
 bool MetricsSnapshot::CompareInstanceMetrics(const MetricsSnapshot::InstanceMetric& lhs, const MetricsSnapshot::InstanceMetric& rhs)
 {
     // TODO: Introduce various sorting modes, for now alphabetical is best "only" option
@@ -57,6 +106,82 @@ void MetricsSnapshot::Clear()
     instanceMetrics_.Clear();
     nodeMetrics_.Clear();
     resourceMetrics_.Clear();
+    valueMetrics_.Clear();
+    histogramMetrics_.Clear();
+}
+
+double MetricsSnapshot::GetValue(const String& name) const
+{
+    HashMap<StringHash, ValueMetric>::ConstIterator itr = valueMetrics_.Find(name);
+    return itr != valueMetrics_.End() ? itr->second_.value : 0.0;
+}
+
+float MetricsSnapshot::GetPercentile(const String& name, float percentile) const
+{
+    HashMap<StringHash, HistogramMetric>::ConstIterator itr = histogramMetrics_.Find(name);
+    if (itr == histogramMetrics_.End() || !itr->second_.count)
+        return 0.0f;
+
+    const HistogramMetric& metric = itr->second_;
+    double rank = Clamp(percentile, 0.0f, 100.0f) / 100.0 * metric.count;
+    unsigned cumulative = 0;
+
+    for (unsigned i = 0; i < metric.buckets.Size(); ++i)
+    {
+        unsigned count = metric.buckets[i];
+        if (!count)
+            continue;
+
+        if (cumulative + count >= rank)
+        {
+            // Interpolate linearly within the bucket
+            double fraction = (rank - cumulative) / count;
+            return (float)(GetHistogramBucketStart(i) + fraction * GetHistogramBucketWidth(i));
+        }
+
+        cumulative += count;
+    }
+
+    return 0.0f;
+}
+
+float MetricsSnapshot::GetMean(const String& name) const
+{
+    HashMap<StringHash, HistogramMetric>::ConstIterator itr = histogramMetrics_.Find(name);
+    if (itr == histogramMetrics_.End() || !itr->second_.count)
+        return 0.0f;
+
+    return (float)(itr->second_.sum / itr->second_.count);
+}
+
+unsigned MetricsSnapshot::GetCount(const String& name) const
+{
+    HashMap<StringHash, HistogramMetric>::ConstIterator itr = histogramMetrics_.Find(name);
+    return itr != histogramMetrics_.End() ? itr->second_.count : 0;
+}
+
+String MetricsSnapshot::PrintMetrics() const
+{
+    String output;
+
+    for (HashMap<StringHash, ValueMetric>::ConstIterator itr = valueMetrics_.Begin(); itr != valueMetrics_.End(); itr++)
+    {
+        const ValueMetric& metric = itr->second_;
+        output.AppendWithFormat("%-24s %s %14.2f\n", metric.name.CString(), metric.type == METRIC_GAUGE ? "gauge  " : "counter",
+            metric.value);
+    }
+
+    if (histogramMetrics_.Size())
+        output += "\nHistogram                   Count       Mean        p50        p90        p99\n\n";
+
+    for (HashMap<StringHash, HistogramMetric>::ConstIterator itr = histogramMetrics_.Begin(); itr != histogramMetrics_.End(); itr++)
+    {
+        const String& name = itr->second_.name;
+        output.AppendWithFormat("%-24s %8u %10.2f %10.2f %10.2f %10.2f\n", name.CString(), GetCount(name), GetMean(name),
+            GetPercentile(name, 50.0f), GetPercentile(name, 90.0f), GetPercentile(name, 99.0f));
+    }
+
+    return output;
 }
 
 void MetricsSnapshot::RegisterInstance(const String& classname, InstantiationType instantiationType, int count)
@@ -152,17 +277,250 @@ String MetricsSnapshot::PrintData(unsigned columns, unsigned minCount)
 
 }
 
+Metrics::ThreadData::ThreadData(ThreadID id) :
+    threadID(id)
+{
+    for (unsigned i = 0; i < MAX_METRICS; i++)
+        counters[i] = 0;
+
+    for (unsigned i = 0; i < MAX_HISTOGRAM_METRICS; i++)
+    {
+        for (unsigned j = 0; j < NUM_HISTOGRAM_BUCKETS; j++)
+            buckets[i][j] = 0;
+
+        sums[i] = 0;
+    }
+}
+
 Metrics::Metrics(Context* context) :
     Object(context),
-    enabled_(false)
+    enabled_(false),
+    numValueSlots_(0),
+    numHistogramSlots_(0),
+    numThreadData_(0)
 {    
     Metrics::metrics_ = this;
+
+    for (unsigned i = 0; i < MAX_METRICS; i++)
+        gauges_[i] = 0.0f;
+
+    // Built-in metrics are always available, their cost is a few atomic adds per frame
+    RegisterMetric(METRIC_FRAME_TIME, METRIC_HISTOGRAM);
+    RegisterMetric(METRIC_DRAW_CALLS, METRIC_GAUGE);
+    RegisterMetric(METRIC_BATCHES, METRIC_GAUGE);
+    RegisterMetric(METRIC_PRIMITIVES, METRIC_GAUGE);
+    RegisterMetric(METRIC_RESOURCE_LOADS, METRIC_COUNTER);
+    RegisterMetric(METRIC_NETWORK_BYTES_IN, METRIC_COUNTER);
+    RegisterMetric(METRIC_NETWORK_BYTES_OUT, METRIC_COUNTER);
+    RegisterMetric(METRIC_INSTANCE_BYTES_UPLOADED, METRIC_GAUGE);
+    RegisterMetric(METRIC_INSTANCES, METRIC_GAUGE);
+    RegisterMetric(METRIC_BONES_EVALUATED, METRIC_COUNTER);
+    RegisterMetric(METRIC_RESOURCE_CACHE_HITS, METRIC_COUNTER);
+    RegisterMetric(METRIC_RESOURCE_CACHE_MISSES, METRIC_COUNTER);
+    RegisterMetric(METRIC_RESOURCE_EVICTIONS, METRIC_COUNTER);
+    RegisterMetric(METRIC_RESOURCE_EVICTED_BYTES, METRIC_COUNTER);
+    RegisterMetric(METRIC_RESOURCE_DEMOTIONS, METRIC_COUNTER);
+    RegisterMetric(METRIC_RESOURCE_MEMORY, METRIC_GAUGE);
+
+    SubscribeToEvent(E_ENDFRAME, ATOMIC_HANDLER(Metrics, HandleEndFrame));
 }
 
 Metrics::~Metrics()
 {
     Disable();
     Metrics::metrics_ = 0;
+
+    for (unsigned i = 0; i < numThreadData_; i++)
+        delete threadData_[i];
+}
+
+unsigned Metrics::RegisterMetric(const String& name, MetricType type)
+{
+    HashMap<StringHash, unsigned>::ConstIterator itr = metricIDs_.Find(name);
+    if (itr != metricIDs_.End())
+    {
+        if (metricInfos_[itr->second_].type != type)
+        {
+            ATOMIC_LOGERRORF("Metrics::RegisterMetric - %s is already registered with another type", name.CString());
+            return M_MAX_UNSIGNED;
+        }
+
+        return itr->second_;
+    }
+
+    MetricInfo info;
+    info.name = name;
+    info.type = type;
+
+    if (type == METRIC_HISTOGRAM)
+    {
+        if (numHistogramSlots_ >= MAX_HISTOGRAM_METRICS)
+        {
+            ATOMIC_LOGERROR("Metrics::RegisterMetric - Out of histogram metric slots");
+            return M_MAX_UNSIGNED;
+        }
+
+        info.slot = numHistogramSlots_++;
+    }
+    else
+    {
+        if (numValueSlots_ >= MAX_METRICS)
+        {
+            ATOMIC_LOGERROR("Metrics::RegisterMetric - Out of metric slots");
+            return M_MAX_UNSIGNED;
+        }
+
+        info.slot = numValueSlots_++;
+    }
+
+    metricIDs_[name] = metricInfos_.Size();
+    metricInfos_.Push(info);
+
+    return metricInfos_.Size() - 1;
+}
+
+unsigned Metrics::GetMetricID(const String& name) const
+{
+    HashMap<StringHash, unsigned>::ConstIterator itr = metricIDs_.Find(name);
+    return itr != metricIDs_.End() ? itr->second_ : M_MAX_UNSIGNED;
+}
+
+void Metrics::AddToCounter(unsigned metric, unsigned value)
+{
+    if (metric >= metricInfos_.Size() || metricInfos_[metric].type != METRIC_COUNTER)
+        return;
+
+    ThreadData* data = GetThreadData();
+    if (data)
+        data->counters[metricInfos_[metric].slot].fetch_add(value, std::memory_order_relaxed);
+}
+
+void Metrics::SetGauge(unsigned metric, float value)
+{
+    if (metric >= metricInfos_.Size() || metricInfos_[metric].type != METRIC_GAUGE)
+        return;
+
+    gauges_[metricInfos_[metric].slot].store(value, std::memory_order_relaxed);
+}
+
+void Metrics::RecordValue(unsigned metric, unsigned value)
+{
+    if (metric >= metricInfos_.Size() || metricInfos_[metric].type != METRIC_HISTOGRAM)
+        return;
+
+    ThreadData* data = GetThreadData();
+    if (data)
+    {
+        unsigned slot = metricInfos_[metric].slot;
+        data->buckets[slot][GetHistogramBucket(value)].fetch_add(1, std::memory_order_relaxed);
+        data->sums[slot].fetch_add(value, std::memory_order_relaxed);
+    }
+}
+
+Metrics::ThreadData* Metrics::GetThreadData()
+{
+    ThreadID threadID = Thread::GetCurrentThreadID();
+
+    // Each thread accumulates into its own data so that threads do not contend on the same cache lines
+    unsigned numThreadData = numThreadData_.load(std::memory_order_acquire);
+    for (unsigned i = 0; i < numThreadData; i++)
+    {
+        if (threadData_[i]->threadID == threadID)
+            return threadData_[i];
+    }
+
+    MutexLock lock(threadDataMutex_);
+
+    numThreadData = numThreadData_.load(std::memory_order_relaxed);
+    if (numThreadData >= MAX_THREADS_METRICS)
+        return 0;
+
+    threadData_[numThreadData] = new ThreadData(threadID);
+    numThreadData_.store(numThreadData + 1, std::memory_order_release);
+
+    return threadData_[numThreadData];
+}
+
+void Metrics::CaptureMetrics(MetricsSnapshot* snapshot, bool resetHistograms)
+{
+    unsigned numThreadData = numThreadData_.load(std::memory_order_acquire);
+
+    for (unsigned i = 0; i < metricInfos_.Size(); i++)
+    {
+        const MetricInfo& info = metricInfos_[i];
+
+        if (info.type == METRIC_HISTOGRAM)
+        {
+            MetricsSnapshot::HistogramMetric& metric = snapshot->histogramMetrics_[info.name];
+            metric.name = info.name;
+            metric.buckets.Resize(NUM_HISTOGRAM_BUCKETS);
+            for (unsigned j = 0; j < NUM_HISTOGRAM_BUCKETS; j++)
+                metric.buckets[j] = 0;
+
+            for (unsigned t = 0; t < numThreadData; t++)
+            {
+                ThreadData* data = threadData_[t];
+
+                for (unsigned j = 0; j < NUM_HISTOGRAM_BUCKETS; j++)
+                {
+                    unsigned count = resetHistograms ? data->buckets[info.slot][j].exchange(0, std::memory_order_relaxed) :
+                        data->buckets[info.slot][j].load(std::memory_order_relaxed);
+                    metric.buckets[j] += count;
+                    metric.count += count;
+                }
+
+                metric.sum += (double)(resetHistograms ? data->sums[info.slot].exchange(0, std::memory_order_relaxed) :
+                    data->sums[info.slot].load(std::memory_order_relaxed));
+            }
+        }
+        else
+        {
+            MetricsSnapshot::ValueMetric& metric = snapshot->valueMetrics_[info.name];
+            metric.name = info.name;
+            metric.type = info.type;
+
+            if (info.type == METRIC_GAUGE)
+                metric.value = gauges_[info.slot].load(std::memory_order_relaxed);
+            else
+            {
+                long long total = 0;
+                for (unsigned t = 0; t < numThreadData; t++)
+                    total += threadData_[t]->counters[info.slot].load(std::memory_order_relaxed);
+
+                metric.value = (double)total;
+            }
+        }
+    }
+}
+
+void Metrics::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+    // Frame to frame time, including any frame limiter sleep, so that it reflects the actual frame rate
+    RecordValue(METRICID_FRAME_TIME, (unsigned)frameTimer_.GetUSec(true));
+
+    Graphics* graphics = GetSubsystem<Graphics>();
+    if (graphics)
+    {
+        SetGauge(METRICID_DRAW_CALLS, (float)graphics->GetNumBatches());
+        SetGauge(METRICID_PRIMITIVES, (float)graphics->GetNumPrimitives());
+    }
+
+    Renderer* renderer = GetSubsystem<Renderer>();
+    if (renderer)
+    {
+        SetGauge(METRICID_BATCHES, (float)renderer->GetNumBatches());
+
+        InstanceDataStore* instanceDataStore = renderer->GetInstanceDataStore();
+        if (instanceDataStore)
+        {
+            SetGauge(METRICID_INSTANCE_BYTES_UPLOADED, (float)instanceDataStore->GetUploadedBytes());
+            SetGauge(METRICID_INSTANCES, (float)instanceDataStore->GetNumInstances());
+        }
+    }
+
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    if (cache)
+        SetGauge(METRICID_RESOURCE_MEMORY, (float)cache->GetTotalMemoryUse());
 }
 
 void Metrics::ProcessInstances()
@@ -292,20 +650,18 @@ void Metrics::CaptureInstances(MetricsSnapshot* snapshot)
     }
 }
 
-void Metrics::Capture(MetricsSnapshot* snapshot)
+void Metrics::Capture(MetricsSnapshot* snapshot, bool resetHistograms)
 {
-    if (!enabled_)
-    {
-        ATOMIC_LOGERROR("Metrics::Capture - Metrics subsystem is not enabled");
-        return;
-    }
-
     if (!snapshot)
         return;
 
     snapshot->Clear();
 
-    CaptureInstances(snapshot);
+    CaptureMetrics(snapshot, resetHistograms);
+
+    // Instance data is only collected while enabled
+    if (enabled_)
+        CaptureInstances(snapshot);
 
 }
 
@@ -22,12 +22,92 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "../Core/Object.h"
+#include "../Core/Mutex.h"
+#include "../Core/Thread.h"
+#include "../Core/Timer.h"
 #include "../Container/List.h"
 
 namespace Atomic
 {
 
+/// Metric kind
+enum MetricType
+{
+    /// Accumulated total, e.g. bytes sent
+    METRIC_COUNTER = 0,
+    /// Last set value, e.g. draw calls on the last frame
+    METRIC_GAUGE,
+    /// Distribution of recorded values, e.g. frame times, queried by percentile
+    METRIC_HISTOGRAM
+};
+
+/// Built-in metric names, registered by the Metrics subsystem
+/// Frame time histogram in microseconds
+extern ATOMIC_API const char* METRIC_FRAME_TIME;
+/// Draw calls on the last frame
+extern ATOMIC_API const char* METRIC_DRAW_CALLS;
+/// Batches on the last frame
+extern ATOMIC_API const char* METRIC_BATCHES;
+/// Primitives on the last frame
+extern ATOMIC_API const char* METRIC_PRIMITIVES;
+/// Resources loaded
+extern ATOMIC_API const char* METRIC_RESOURCE_LOADS;
+/// Network message bytes received
+extern ATOMIC_API const char* METRIC_NETWORK_BYTES_IN;
+/// Network message bytes sent
+extern ATOMIC_API const char* METRIC_NETWORK_BYTES_OUT;
+/// Instancing buffer bytes uploaded on the last frame
+extern ATOMIC_API const char* METRIC_INSTANCE_BYTES_UPLOADED;
+/// Instances drawn with instancing on the last frame
+extern ATOMIC_API const char* METRIC_INSTANCES;
+/// Animated bones evaluated
+extern ATOMIC_API const char* METRIC_BONES_EVALUATED;
+/// Resource cache lookups that found the resource loaded
+extern ATOMIC_API const char* METRIC_RESOURCE_CACHE_HITS;
+/// Resource cache lookups that had to load the resource
+extern ATOMIC_API const char* METRIC_RESOURCE_CACHE_MISSES;
+/// Resources released from the cache to stay within memory budgets
+extern ATOMIC_API const char* METRIC_RESOURCE_EVICTIONS;
+/// Bytes of resources released from the cache to stay within memory budgets
+extern ATOMIC_API const char* METRIC_RESOURCE_EVICTED_BYTES;
+/// Resources reduced in quality to stay within memory budgets
+extern ATOMIC_API const char* METRIC_RESOURCE_DEMOTIONS;
+/// Resource cache memory use in bytes on the last frame
+extern ATOMIC_API const char* METRIC_RESOURCE_MEMORY;
+
+/// Built-in metric ids, registered in this order by the Metrics subsystem so that engine code can record without a name lookup
+enum BuiltinMetricID
+{
+    METRICID_FRAME_TIME = 0,
+    METRICID_DRAW_CALLS,
+    METRICID_BATCHES,
+    METRICID_PRIMITIVES,
+    METRICID_RESOURCE_LOADS,
+    METRICID_NETWORK_BYTES_IN,
+    METRICID_NETWORK_BYTES_OUT,
+    METRICID_INSTANCE_BYTES_UPLOADED,
+    METRICID_INSTANCES,
+    METRICID_BONES_EVALUATED,
+    METRICID_RESOURCE_CACHE_HITS,
+    METRICID_RESOURCE_CACHE_MISSES,
+    METRICID_RESOURCE_EVICTIONS,
+    METRICID_RESOURCE_EVICTED_BYTES,
+    METRICID_RESOURCE_DEMOTIONS,
+    METRICID_RESOURCE_MEMORY
+};
+
+/// Maximum number of counter and gauge metrics
+static const unsigned MAX_METRICS = 64;
+/// Maximum number of histogram metrics
+static const unsigned MAX_HISTOGRAM_METRICS = 16;
+/// Histogram buckets: values below 32 are exact, above that 16 buckets per power of two
+static const unsigned NUM_HISTOGRAM_BUCKETS = 464;
+/// Maximum number of threads accumulating metrics
+static const unsigned MAX_THREADS_METRICS = 64;
+
 class ATOMIC_API MetricsSnapshot : public RefCounted
 {
     friend class Metrics;
@@ -45,6 +125,17 @@ public:
     /// Register instance(s) of classname in metrics snapshot
     void RegisterInstance(const String& classname, InstantiationType instantiationType, int count = 1);
 
+    /// Return value of a counter or gauge metric, 0 if not captured
+    double GetValue(const String& name) const;
+    /// Return value below which the given percentage (0-100) of a histogram metric's recorded values fall, 0 if no values
+    float GetPercentile(const String& name, float percentile) const;
+    /// Return mean of a histogram metric's recorded values
+    float GetMean(const String& name) const;
+    /// Return number of values recorded in a histogram metric
+    unsigned GetCount(const String& name) const;
+    /// Return counters, gauges and histogram percentiles as text
+    String PrintMetrics() const;
+
 private:
 
     struct InstanceMetric
@@ -85,6 +176,33 @@ private:
         }
     };
 
+    struct ValueMetric
+    {
+        String name;
+        MetricType type;
+        double value;
+
+        ValueMetric()
+        {
+            type = METRIC_COUNTER;
+            value = 0.0;
+        }
+    };
+
+    struct HistogramMetric
+    {
+        String name;
+        unsigned count;
+        double sum;
+        PODVector<unsigned> buckets;
+
+        HistogramMetric()
+        {
+            count = 0;
+            sum = 0.0;
+        }
+    };
+
     static bool CompareInstanceMetrics(const InstanceMetric& lhs, const InstanceMetric& rhs);
 
     // StringHash(classname) => InstanceMetrics
@@ -96,6 +214,12 @@ private:
     // StringHash(resource name) => ResourceMetrics
     HashMap<StringHash, ResourceMetric> resourceMetrics_;
 
+    // StringHash(metric name) => counter and gauge values
+    HashMap<StringHash, ValueMetric> valueMetrics_;
+
+    // StringHash(metric name) => histogram buckets
+    HashMap<StringHash, HistogramMetric> histogramMetrics_;
+
 };
 
 /// Metrics subsystem
@@ -118,8 +242,19 @@ public:
     /// Get whether the Metrics subsystem is enabled or not
     bool GetEnabled() const { return enabled_; }    
 
-    // Captures a snapshot of metrics data
-    void Capture(MetricsSnapshot* snapshot);
+    /// Captures a snapshot of counters, gauges and histograms, plus instance data when enabled. Optionally resets the histograms so the next capture covers a new interval
+    void Capture(MetricsSnapshot* snapshot, bool resetHistograms = false);
+
+    /// Register a counter, gauge or histogram metric by name, or return the existing one. Returns M_MAX_UNSIGNED if out of metric slots or the name is registered with another type. Register from the main thread before recording from other threads
+    unsigned RegisterMetric(const String& name, MetricType type);
+    /// Return metric id by name, M_MAX_UNSIGNED if not registered
+    unsigned GetMetricID(const String& name) const;
+    /// Add to a counter metric, can be called from any thread
+    void AddToCounter(unsigned metric, unsigned value = 1);
+    /// Set a gauge metric, can be called from any thread
+    void SetGauge(unsigned metric, float value);
+    /// Record a value in a histogram metric, can be called from any thread
+    void RecordValue(unsigned metric, unsigned value);
 
     /// Prints names of registered node instances output string
     String PrintNodeNames() const;
@@ -140,8 +275,31 @@ private:
         InstantiationType instantiationType;
     };
 
+    // Metric accumulation of one thread, only written by that thread except for histogram reset
+    struct ThreadData
+    {
+        ThreadData(ThreadID id);
+
+        ThreadID threadID;
+        std::atomic<long long> counters[MAX_METRICS];
+        std::atomic<unsigned> buckets[MAX_HISTOGRAM_METRICS][NUM_HISTOGRAM_BUCKETS];
+        std::atomic<unsigned long long> sums[MAX_HISTOGRAM_METRICS];
+    };
+
+    // A registered metric, counters and gauges index into ThreadData::counters, histograms into ThreadData::buckets
+    struct MetricInfo
+    {
+        String name;
+        MetricType type;
+        unsigned slot;
+    };
+
     void Disable();
 
+    ThreadData* GetThreadData();
+    void CaptureMetrics(MetricsSnapshot* snapshot, bool resetHistograms);
+    void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+
     void CaptureInstances(MetricsSnapshot* snapshot);
     void ProcessInstances();
 
@@ -167,6 +325,23 @@ private:
     // Lookup from string hashes to avoid String thrashing in the metrics subsystem with large numbers of instances
     HashMap<StringHash, String> names_;
 
+    // Registered metrics, indexed by metric id
+    Vector<MetricInfo> metricInfos_;
+    // StringHash(metric name) => metric id
+    HashMap<StringHash, unsigned> metricIDs_;
+    unsigned numValueSlots_;
+    unsigned numHistogramSlots_;
+    // Gauges are not accumulated, so they are set directly
+    std::atomic<float> gauges_[MAX_METRICS];
+
+    // Per-thread accumulation, only appended to so that lookup needs no locking
+    ThreadData* threadData_[MAX_THREADS_METRICS];
+    std::atomic<unsigned> numThreadData_;
+    Mutex threadDataMutex_;
+
+    // Measures frame to frame time
+    HiresTimer frameTimer_;
+
 };
 
 
@@ -28,6 +28,7 @@
 #include "../IO/Log.h"
 #include "../IO/MemoryBuffer.h"
 #include "../IO/PackageFile.h"
+#include "../Metrics/Metrics.h"
 #include "../Network/Connection.h"
 #include "../Network/Network.h"
 #include "../Network/NetworkEvents.h"
@@ -128,6 +129,12 @@ void Connection::SendMessage(int msgID, bool reliable, bool inOrder, const unsig
         return;
     }
 
+    // ATOMIC BEGIN
+    Metrics* metrics = GetSubsystem<Metrics>();
+    if (metrics)
+        metrics->AddToCounter(METRICID_NETWORK_BYTES_OUT, numBytes);
+    // ATOMIC END
+
     msg->reliable = reliable;
     msg->inOrder = inOrder;
     msg->priority = 0;
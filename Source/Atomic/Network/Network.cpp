@@ -31,6 +31,7 @@
 #include "../IO/IOEvents.h"
 #include "../IO/Log.h"
 #include "../IO/MemoryBuffer.h"
+#include "../Metrics/Metrics.h"
 #include "../Network/HttpRequest.h"
 #include "../Network/Network.h"
 #include "../Network/NetworkEvents.h"
@@ -129,6 +130,12 @@ void Network::HandleMessage(kNet::MessageConnection* source, kNet::packet_id_t p
     Connection* connection = GetConnection(source);
     if (connection)
     {
+        // ATOMIC BEGIN
+        Metrics* metrics = GetSubsystem<Metrics>();
+        if (metrics)
+            metrics->AddToCounter(METRICID_NETWORK_BYTES_IN, (unsigned)numBytes);
+        // ATOMIC END
+
         MemoryBuffer msg(data, (unsigned)numBytes);
         if (connection->ProcessMessage((int)msgId, msg))
             return;
@@ -24,7 +24,9 @@
 
 #include "../Precompiled.h"
 
+#include "../Container/Sort.h"
 #include "../Core/Context.h"
+#include "../Core/ProcessUtils.h"
 #include "../Core/Profiler.h"
 #include "../IO/Log.h"
 #include "../Resource/BackgroundLoader.h"
@@ -36,92 +38,216 @@
 namespace Atomic
 {
 
+// ATOMIC BEGIN
+static const unsigned MAX_DEFAULT_LOADER_THREADS = 4;
+
+/// Background loader thread. Begins loading queued resources until stopped.
+class BackgroundLoaderThread : public Thread, public RefCounted
+{
+    ATOMIC_REFCOUNTED(BackgroundLoaderThread)
+
+public:
+    /// Construct.
+    BackgroundLoaderThread(BackgroundLoader* owner) :
+        owner_(owner)
+    {
+    }
+
+    /// Destruct. Stop the thread while the derived object still exists.
+    virtual ~BackgroundLoaderThread()
+    {
+        Stop();
+    }
+
+    /// Resource background loading loop.
+    virtual void ThreadFunction()
+    {
+        while (shouldRun_ && !owner_->shutDown_)
+        {
+            // If no resources to load found, sleep before polling the queue again
+            if (!owner_->LoadNextResource())
+                Time::Sleep(5);
+        }
+    }
+
+private:
+    /// Background loader.
+    BackgroundLoader* owner_;
+};
+
+static bool CompareQueueEntries(const BackgroundLoadQueueEntry& lhs, const BackgroundLoadQueueEntry& rhs)
+{
+    if (lhs.priority_ != rhs.priority_)
+        return lhs.priority_ > rhs.priority_;
+    else
+        return lhs.order_ < rhs.order_;
+}
+
+static void PushHeap(PODVector<BackgroundLoadQueueEntry>& heap, const BackgroundLoadQueueEntry& entry)
+{
+    unsigned i = heap.Size();
+    heap.Push(entry);
+
+    while (i > 0)
+    {
+        unsigned parent = (i - 1) / 2;
+        if (!CompareQueueEntries(heap[i], heap[parent]))
+            break;
+        Swap(heap[i], heap[parent]);
+        i = parent;
+    }
+}
+
+static BackgroundLoadQueueEntry PopHeap(PODVector<BackgroundLoadQueueEntry>& heap)
+{
+    BackgroundLoadQueueEntry top = heap.Front();
+    heap.Front() = heap.Back();
+    heap.Pop();
+
+    unsigned i = 0;
+    for (;;)
+    {
+        unsigned best = i;
+        unsigned left = i * 2 + 1;
+        unsigned right = left + 1;
+        if (left < heap.Size() && CompareQueueEntries(heap[left], heap[best]))
+            best = left;
+        if (right < heap.Size() && CompareQueueEntries(heap[right], heap[best]))
+            best = right;
+        if (best == i)
+            break;
+        Swap(heap[i], heap[best]);
+        i = best;
+    }
+
+    return top;
+}
+
+static inline Pair<StringHash, StringHash> GetEntryKey(const BackgroundLoadQueueEntry& entry)
+{
+    return MakePair(StringHash(entry.type_), StringHash(entry.nameHash_));
+}
+
+static inline bool IsReadyToFinish(const BackgroundLoadItem& item)
+{
+    AsyncLoadState state = item.resource_->GetAsyncLoadState();
+    return item.dependencies_.Empty() && state != ASYNC_QUEUED && state != ASYNC_LOADING;
+}
+
 BackgroundLoader::BackgroundLoader(ResourceCache* owner) :
-    owner_(owner)
+    owner_(owner),
+    numThreads_(Clamp(GetNumPhysicalCPUs(), 2U, MAX_DEFAULT_LOADER_THREADS + 1) - 1),
+    nextOrder_(0),
+    shutDown_(false)
 {
 }
 
 BackgroundLoader::~BackgroundLoader()
 {
+    // Stop the loader threads first so that none of them accesses the queue while it is cleared. The threads poll the
+    // shutdown flag between resources and at most every few milliseconds while idle, so they need no separate wakeup.
+    // They are stopped outside the mutex, as they may need it to finish the resource they are loading
+    Vector<SharedPtr<BackgroundLoaderThread> > stoppedThreads;
+    {
+        MutexLock lock(backgroundLoadMutex_);
+        shutDown_ = true;
+        stoppedThreads.Swap(threads_);
+    }
+
+    for (unsigned i = 0; i < stoppedThreads.Size(); ++i)
+        stoppedThreads[i]->Stop();
+    stoppedThreads.Clear();
+
     MutexLock lock(backgroundLoadMutex_);
 
     backgroundLoadQueue_.Clear();
+    loadQueue_.Clear();
 }
 
-void BackgroundLoader::ThreadFunction()
+bool BackgroundLoader::LoadNextResource()
 {
-    while (shouldRun_)
-    {
-        backgroundLoadMutex_.Acquire();
+    backgroundLoadMutex_.Acquire();
 
-        // Search for a queued resource that has not been loaded yet
-        HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator i = backgroundLoadQueue_.Begin();
-        while (i != backgroundLoadQueue_.End())
+    // Pop the highest priority resource that has not begun loading yet. Of equal priorities, the earliest queued wins.
+    // Entries left behind by cancelled, already loading or reprioritized items are discarded on the way
+    HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator best = backgroundLoadQueue_.End();
+    while (!loadQueue_.Empty())
+    {
+        BackgroundLoadQueueEntry entry = PopHeap(loadQueue_);
+        HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator i = backgroundLoadQueue_.Find(GetEntryKey(entry));
+        if (i != backgroundLoadQueue_.End() && i->second_.resource_->GetAsyncLoadState() == ASYNC_QUEUED &&
+            !i->second_.cancelled_ && i->second_.priority_ == entry.priority_ && i->second_.order_ == entry.order_)
         {
-            if (i->second_.resource_->GetAsyncLoadState() == ASYNC_QUEUED)
-                break;
-            else
-                ++i;
+            best = i;
+            break;
         }
+    }
 
-        if (i == backgroundLoadQueue_.End())
+    if (best == backgroundLoadQueue_.End())
+    {
+        backgroundLoadMutex_.Release();
+        return false;
+    }
+
+    BackgroundLoadItem& item = best->second_;
+    Resource* resource = item.resource_;
+    // Claim the item while still holding the mutex so that no other loader thread picks it. We can be sure that the
+    // item is not removed from the queue as long as it is in the "loading" state
+    resource->SetAsyncLoadState(ASYNC_LOADING);
+    backgroundLoadMutex_.Release();
+
+    bool success = false;
+    SharedPtr<File> file = owner_->GetFile(resource->GetName(), item.sendEventOnFailure_);
+    if (file)
+        success = resource->BeginLoad(*file);
+
+    // Process dependencies now
+    // Need to lock the queue again when manipulating other entries
+    Pair<StringHash, StringHash> key = MakePair(resource->GetType(), resource->GetNameHash());
+    backgroundLoadMutex_.Acquire();
+    if (item.dependents_.Size())
+    {
+        for (HashSet<Pair<StringHash, StringHash> >::Iterator i = item.dependents_.Begin(); i != item.dependents_.End(); ++i)
         {
-            // No resources to load found
-            backgroundLoadMutex_.Release();
-            Time::Sleep(5);
+            HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator j = backgroundLoadQueue_.Find(*i);
+            if (j != backgroundLoadQueue_.End())
+                j->second_.dependencies_.Erase(key);
         }
-        else
-        {
-            BackgroundLoadItem& item = i->second_;
-            Resource* resource = item.resource_;
-            // We can be sure that the item is not removed from the queue as long as it is in the
-            // "queued" or "loading" state
-            backgroundLoadMutex_.Release();
-
-            bool success = false;
-            SharedPtr<File> file = owner_->GetFile(resource->GetName(), item.sendEventOnFailure_);
-            if (file)
-            {
-                resource->SetAsyncLoadState(ASYNC_LOADING);
-                success = resource->BeginLoad(*file);
-            }
 
-            // Process dependencies now
-            // Need to lock the queue again when manipulating other entries
-            Pair<StringHash, StringHash> key = MakePair(resource->GetType(), resource->GetNameHash());
-            backgroundLoadMutex_.Acquire();
-            if (item.dependents_.Size())
-            {
-                for (HashSet<Pair<StringHash, StringHash> >::Iterator i = item.dependents_.Begin();
-                     i != item.dependents_.End(); ++i)
-                {
-                    HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator j = backgroundLoadQueue_.Find(*i);
-                    if (j != backgroundLoadQueue_.End())
-                        j->second_.dependencies_.Erase(key);
-                }
+        item.dependents_.Clear();
+    }
 
-                item.dependents_.Clear();
-            }
+    resource->SetAsyncLoadState(success ? ASYNC_SUCCESS : ASYNC_FAIL);
+    backgroundLoadMutex_.Release();
 
-            resource->SetAsyncLoadState(success ? ASYNC_SUCCESS : ASYNC_FAIL);
-            backgroundLoadMutex_.Release();
-        }
-    }
+    return true;
 }
 
-bool BackgroundLoader::QueueResource(StringHash type, const String& name, bool sendEventOnFailure, Resource* caller)
+bool BackgroundLoader::QueueResource(StringHash type, const String& name, bool sendEventOnFailure, Resource* caller, int priority)
 {
     StringHash nameHash(name);
     Pair<StringHash, StringHash> key = MakePair(type, nameHash);
 
     MutexLock lock(backgroundLoadMutex_);
 
-    // Check if already exists in the queue
-    if (backgroundLoadQueue_.Find(key) != backgroundLoadQueue_.End())
-        return false;
+    // Check if already exists in the queue. A cancelled resource that has not been finished yet is requested again
+    HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator existing = backgroundLoadQueue_.Find(key);
+    if (existing != backgroundLoadQueue_.End())
+    {
+        if (!existing->second_.cancelled_)
+            return false;
+
+        existing->second_.cancelled_ = false;
+        existing->second_.sendEventOnFailure_ = sendEventOnFailure;
+        existing->second_.priority_ = priority;
+        return true;
+    }
 
     BackgroundLoadItem& item = backgroundLoadQueue_[key];
     item.sendEventOnFailure_ = sendEventOnFailure;
+    item.priority_ = priority;
+    item.order_ = nextOrder_++;
+    item.cancelled_ = false;
 
     // Make sure the pointer is non-null and is a Resource subclass
     item.resource_ = DynamicCast<Resource>(owner_->GetContext()->CreateObject(type));
@@ -147,7 +273,8 @@ bool BackgroundLoader::QueueResource(StringHash type, const String& name, bool s
     item.resource_->SetName(name);
     item.resource_->SetAsyncLoadState(ASYNC_QUEUED);
 
-    // If this is a resource calling for the background load of more resources, mark the dependency as necessary
+    // If this is a resource calling for the background load of more resources, mark the dependency as necessary.
+    // The caller can not finish before its dependencies, so they are loaded with at least the caller's priority
     if (caller)
     {
         Pair<StringHash, StringHash> callerKey = MakePair(caller->GetType(), caller->GetNameHash());
@@ -156,6 +283,7 @@ bool BackgroundLoader::QueueResource(StringHash type, const String& name, bool s
         {
             BackgroundLoadItem& callerItem = j->second_;
             item.dependents_.Insert(callerKey);
+            item.priority_ = Max(item.priority_, callerItem.priority_);
             callerItem.dependencies_.Insert(key);
         }
         else
@@ -163,13 +291,58 @@ bool BackgroundLoader::QueueResource(StringHash type, const String& name, bool s
                        " requested for a background loaded resource but was not in the background load queue");
     }
 
-    // Start the background loader thread now
-    if (!IsStarted())
-        Run();
+    PushLoadEntry(key, item);
+
+    // Start the background loader threads now
+    StartThreads();
 
     return true;
 }
 
+bool BackgroundLoader::SetResourcePriority(StringHash type, StringHash nameHash, int priority)
+{
+    Pair<StringHash, StringHash> key = MakePair(type, nameHash);
+
+    MutexLock lock(backgroundLoadMutex_);
+
+    HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator i = backgroundLoadQueue_.Find(key);
+    if (i == backgroundLoadQueue_.End())
+        return false;
+
+    if (i->second_.priority_ != priority)
+    {
+        i->second_.priority_ = priority;
+        PushLoadEntry(key, i->second_);
+    }
+    for (HashSet<Pair<StringHash, StringHash> >::Iterator j = i->second_.dependencies_.Begin(); j != i->second_.dependencies_.End(); ++j)
+        RaisePriority(*j, priority);
+
+    return true;
+}
+
+bool BackgroundLoader::CancelResource(StringHash type, StringHash nameHash)
+{
+    Pair<StringHash, StringHash> key = MakePair(type, nameHash);
+
+    MutexLock lock(backgroundLoadMutex_);
+
+    HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator i = backgroundLoadQueue_.Find(key);
+    if (i == backgroundLoadQueue_.End() || !i->second_.dependents_.Empty())
+        return false;
+
+    // A resource that has not begun loading can be removed right away. Otherwise it is discarded when finishing
+    if (i->second_.resource_->GetAsyncLoadState() == ASYNC_QUEUED)
+    {
+        ATOMIC_LOGDEBUG("Cancelled background loading of resource " + i->second_.resource_->GetName());
+        backgroundLoadQueue_.Erase(i);
+    }
+    else
+        i->second_.cancelled_ = true;
+
+    return true;
+}
+// ATOMIC END
+
 void BackgroundLoader::WaitForResource(StringHash type, StringHash nameHash)
 {
     backgroundLoadMutex_.Acquire();
@@ -179,6 +352,11 @@ void BackgroundLoader::WaitForResource(StringHash type, StringHash nameHash)
     HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator i = backgroundLoadQueue_.Find(key);
     if (i != backgroundLoadQueue_.End())
     {
+        // ATOMIC BEGIN
+        // The resource is needed now: make sure it is not discarded, and load it and its dependencies before anything else
+        i->second_.cancelled_ = false;
+        RaisePriority(key, M_MAX_INT);
+        // ATOMIC END
         backgroundLoadMutex_.Release();
 
         {
@@ -217,37 +395,58 @@ void BackgroundLoader::WaitForResource(StringHash type, StringHash nameHash)
 
 void BackgroundLoader::FinishResources(int maxMs)
 {
-    if (IsStarted())
+    // ATOMIC BEGIN
     {
-        HiresTimer timer;
+        MutexLock lock(backgroundLoadMutex_);
+        if (threads_.Empty())
+            return;
+    }
 
-        backgroundLoadMutex_.Acquire();
+    HiresTimer timer;
 
-        for (HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator i = backgroundLoadQueue_.Begin();
-             i != backgroundLoadQueue_.End();)
+    // Collect the resources that are ready to finish, and finish them highest priority first
+    PODVector<BackgroundLoadQueueEntry> entries;
+    backgroundLoadMutex_.Acquire();
+    for (HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator i = backgroundLoadQueue_.Begin();
+         i != backgroundLoadQueue_.End(); ++i)
+    {
+        if (IsReadyToFinish(i->second_))
         {
-            Resource* resource = i->second_.resource_;
-            unsigned numDeps = i->second_.dependencies_.Size();
-            AsyncLoadState state = resource->GetAsyncLoadState();
-            if (numDeps > 0 || state == ASYNC_QUEUED || state == ASYNC_LOADING)
-                ++i;
-            else
-            {
-                // Finishing a resource may need it to wait for other resources to load, in which case we can not
-                // hold on to the mutex
-                backgroundLoadMutex_.Release();
-                FinishBackgroundLoading(i->second_);
-                backgroundLoadMutex_.Acquire();
-                i = backgroundLoadQueue_.Erase(i);
-            }
-
-            // Break when the time limit passed so that we keep sufficient FPS
-            if (timer.GetUSec(false) >= maxMs * 1000)
-                break;
+            BackgroundLoadQueueEntry entry;
+            entry.type_ = i->first_.first_.Value();
+            entry.nameHash_ = i->first_.second_.Value();
+            entry.priority_ = i->second_.priority_;
+            entry.order_ = i->second_.order_;
+            entries.Push(entry);
         }
+    }
+    backgroundLoadMutex_.Release();
+
+    Sort(entries.Begin(), entries.End(), CompareQueueEntries);
 
+    for (unsigned i = 0; i < entries.Size(); ++i)
+    {
+        // Items are only removed from the queue in the main thread. An entry may however have been finished already, if
+        // finishing an earlier resource waited for it
+        backgroundLoadMutex_.Acquire();
+        HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator j = backgroundLoadQueue_.Find(GetEntryKey(entries[i]));
+        backgroundLoadMutex_.Release();
+        if (j == backgroundLoadQueue_.End())
+            continue;
+
+        // Finishing a resource may need it to wait for other resources to load, in which case we can not
+        // hold on to the mutex
+        FinishBackgroundLoading(j->second_);
+
+        backgroundLoadMutex_.Acquire();
+        backgroundLoadQueue_.Erase(j);
         backgroundLoadMutex_.Release();
+
+        // Break when the time limit passed so that we keep sufficient FPS
+        if (timer.GetUSec(false) >= maxMs * 1000)
+            break;
     }
+    // ATOMIC END
 }
 
 unsigned BackgroundLoader::GetNumQueuedResources() const
@@ -256,10 +455,90 @@ unsigned BackgroundLoader::GetNumQueuedResources() const
     return backgroundLoadQueue_.Size();
 }
 
+// ATOMIC BEGIN
+void BackgroundLoader::SetNumThreads(unsigned num)
+{
+    num = Max(num, 1U);
+    if (num == numThreads_)
+        return;
+
+    // Surplus threads are stopped outside the mutex, as they may need it to finish the resource they are loading
+    Vector<SharedPtr<BackgroundLoaderThread> > stoppedThreads;
+
+    {
+        MutexLock lock(backgroundLoadMutex_);
+
+        numThreads_ = num;
+        if (!threads_.Empty())
+        {
+            while (threads_.Size() > numThreads_)
+            {
+                stoppedThreads.Push(threads_.Back());
+                threads_.Pop();
+            }
+            StartThreads();
+        }
+    }
+
+    for (unsigned i = 0; i < stoppedThreads.Size(); ++i)
+        stoppedThreads[i]->Stop();
+    stoppedThreads.Clear();
+}
+
+void BackgroundLoader::RaisePriority(const Pair<StringHash, StringHash>& key, int priority)
+{
+    HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator i = backgroundLoadQueue_.Find(key);
+    if (i == backgroundLoadQueue_.End() || i->second_.priority_ >= priority)
+        return;
+
+    i->second_.priority_ = priority;
+    PushLoadEntry(key, i->second_);
+    for (HashSet<Pair<StringHash, StringHash> >::Iterator j = i->second_.dependencies_.Begin(); j != i->second_.dependencies_.End(); ++j)
+        RaisePriority(*j, priority);
+}
+
+void BackgroundLoader::PushLoadEntry(const Pair<StringHash, StringHash>& key, const BackgroundLoadItem& item)
+{
+    // Items that have already begun loading need no entry
+    if (item.resource_->GetAsyncLoadState() != ASYNC_QUEUED)
+        return;
+
+    BackgroundLoadQueueEntry entry;
+    entry.type_ = key.first_.Value();
+    entry.nameHash_ = key.second_.Value();
+    entry.priority_ = item.priority_;
+    entry.order_ = item.order_;
+    PushHeap(loadQueue_, entry);
+}
+
+void BackgroundLoader::StartThreads()
+{
+    if (shutDown_)
+        return;
+
+    while (threads_.Size() < numThreads_)
+    {
+        SharedPtr<BackgroundLoaderThread> thread(new BackgroundLoaderThread(this));
+        thread->Run();
+        threads_.Push(thread);
+    }
+}
+// ATOMIC END
+
 void BackgroundLoader::FinishBackgroundLoading(BackgroundLoadItem& item)
 {
     Resource* resource = item.resource_;
 
+    // ATOMIC BEGIN
+    // Discard a cancelled resource without storing it to the cache or sending events
+    if (item.cancelled_)
+    {
+        ATOMIC_LOGDEBUG("Discarding cancelled background loaded resource " + resource->GetName());
+        resource->SetAsyncLoadState(ASYNC_DONE);
+        return;
+    }
+    // ATOMIC END
+
     bool success = resource->GetAsyncLoadState() == ASYNC_SUCCESS;
     // If BeginLoad() phase was successful, call EndLoad() and get the final success/failure result
     if (success)
@@ -35,6 +35,9 @@ namespace Atomic
 
 class Resource;
 class ResourceCache;
+// ATOMIC BEGIN
+class BackgroundLoaderThread;
+// ATOMIC END
 
 /// Queue item for background loading of a resource.
 struct BackgroundLoadItem
@@ -47,34 +50,74 @@ struct BackgroundLoadItem
     HashSet<Pair<StringHash, StringHash> > dependents_;
     /// Whether to send failure event.
     bool sendEventOnFailure_;
+    // ATOMIC BEGIN
+    /// Load priority. Higher priority items begin loading and are finished first.
+    int priority_;
+    /// Queue order, used to keep items of equal priority first in, first out.
+    unsigned order_;
+    /// Cancelled flag. A cancelled item that has already begun loading is discarded once loading ends.
+    bool cancelled_;
+    // ATOMIC END
 };
 
+// ATOMIC BEGIN
+/// Entry of the background load priority queue. The key is stored as plain hash values so that entries can be moved with memcpy.
+struct BackgroundLoadQueueEntry
+{
+    /// Resource type hash.
+    unsigned type_;
+    /// Resource name hash.
+    unsigned nameHash_;
+    /// Load priority of the item when the entry was pushed.
+    int priority_;
+    /// Queue order of the item.
+    unsigned order_;
+};
+// ATOMIC END
+
 /// Background loader of resources. Owned by the ResourceCache.
-class BackgroundLoader : public RefCounted, public Thread
+// ATOMIC BEGIN
+class BackgroundLoader : public RefCounted
 {
-    ATOMIC_REFCOUNTED(BackgroundLoader
-                      )
+    ATOMIC_REFCOUNTED(BackgroundLoader)
+
+    friend class BackgroundLoaderThread;
+
 public:
     /// Construct.
     BackgroundLoader(ResourceCache* owner);
 
-    /// Destruct. Forcibly clear the load queue.
+    /// Destruct. Stop the loader threads and forcibly clear the load queue.
     ~BackgroundLoader();
 
-    /// Resource background loading loop.
-    virtual void ThreadFunction();
-
     /// Queue loading of a resource. The name must be sanitated to ensure consistent format. Return true if queued (not a duplicate and resource was a known type).
-    bool QueueResource(StringHash type, const String& name, bool sendEventOnFailure, Resource* caller);
+    bool QueueResource(StringHash type, const String& name, bool sendEventOnFailure, Resource* caller, int priority);
+    /// Change the priority of a queued resource. The resources it depends on are raised to at least the same priority. Return true if the resource was in the queue.
+    bool SetResourcePriority(StringHash type, StringHash nameHash, int priority);
+    /// Cancel loading of a queued resource. Resources that other queued resources depend on can not be cancelled. Return true if cancelled. Must be called from the main thread.
+    bool CancelResource(StringHash type, StringHash nameHash);
     /// Wait and finish possible loading of a resource when being requested from the cache.
     void WaitForResource(StringHash type, StringHash nameHash);
-    /// Process resources that are ready to finish.
+    /// Process resources that are ready to finish, highest priority first.
     void FinishResources(int maxMs);
 
+    /// Set number of loader threads. Default is one less than the number of physical CPU cores, but at least 1 and at most 4.
+    void SetNumThreads(unsigned num);
+
     /// Return amount of resources in the load queue.
     unsigned GetNumQueuedResources() const;
+    /// Return number of loader threads.
+    unsigned GetNumThreads() const { return numThreads_; }
 
 private:
+    /// Begin loading of the highest priority queued resource in the calling loader thread. Return false if there was nothing to load.
+    bool LoadNextResource();
+    /// Raise the priority of a queued resource and recursively the resources it depends on. The queue mutex must be held.
+    void RaisePriority(const Pair<StringHash, StringHash>& key, int priority);
+    /// Push a queued item to the load priority queue. The queue mutex must be held.
+    void PushLoadEntry(const Pair<StringHash, StringHash>& key, const BackgroundLoadItem& item);
+    /// Start the loader threads if not started yet. The queue mutex must be held.
+    void StartThreads();
     /// Finish one background loaded resource.
     void FinishBackgroundLoading(BackgroundLoadItem& item);
 
@@ -84,6 +127,17 @@ private:
     mutable Mutex backgroundLoadMutex_;
     /// Resources that are queued for background loading.
     HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem> backgroundLoadQueue_;
+    /// Binary heap of resources waiting to begin loading, highest priority first. Entries whose item was removed, has begun loading or has changed priority since are skipped when popped.
+    PODVector<BackgroundLoadQueueEntry> loadQueue_;
+    /// Loader threads. Started on the first background load request.
+    Vector<SharedPtr<BackgroundLoaderThread> > threads_;
+    /// Number of loader threads to use.
+    unsigned numThreads_;
+    /// Queue order counter.
+    unsigned nextOrder_;
+    /// Shutdown flag. Set on destruction to make the loader threads exit.
+    volatile bool shutDown_;
 };
+// ATOMIC END
 
 }
@@ -2224,6 +2224,16 @@ unsigned char* Image::GetImageData(Deserializer& source, int& width, int& height
 {
     unsigned dataSize = source.GetSize();
 
+    // ATOMIC BEGIN
+    // Decode straight from memory mapped package data without copying
+    const unsigned char* directData = source.GetDirectData();
+    if (directData)
+    {
+        source.Seek(dataSize);
+        return stbi_load_from_memory(directData, dataSize, &width, &height, (int*)&components, 0);
+    }
+    // ATOMIC END
+
     SharedArrayPtr<unsigned char> buffer(new unsigned char[dataSize]);
     source.Read(buffer.Get(), dataSize);
     return stbi_load_from_memory(buffer.Get(), dataSize, &width, &height, (int*)&components, 0);
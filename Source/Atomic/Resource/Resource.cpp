@@ -25,6 +25,7 @@
 #include "../Core/Profiler.h"
 #include "../IO/File.h"
 #include "../IO/Log.h"
+#include "../Metrics/Metrics.h"
 #include "../Resource/Resource.h"
 
 namespace Atomic
@@ -33,6 +34,9 @@ namespace Atomic
 Resource::Resource(Context* context) :
     Object(context),
     memoryUse_(0),
+    // ATOMIC BEGIN
+    lastAccessTime_(Time::GetSystemTime()),
+    // ATOMIC END
     asyncLoadState_(ASYNC_DONE)
 {
 }
@@ -62,6 +66,12 @@ bool Resource::Load(Deserializer& source)
         profiler->EndBlock();
 #endif
 
+    // ATOMIC BEGIN
+    Metrics* metrics = GetSubsystem<Metrics>();
+    if (metrics && success)
+        metrics->AddToCounter(METRICID_RESOURCE_LOADS);
+    // ATOMIC END
+
     return success;
 }
 
@@ -109,6 +119,9 @@ void Resource::SetMemoryUse(unsigned size)
 void Resource::ResetUseTimer()
 {
     useTimer_.Reset();
+    // ATOMIC BEGIN
+    lastAccessTime_ = Time::GetSystemTime();
+    // ATOMIC END
 }
 
 void Resource::SetAsyncLoadState(AsyncLoadState newState)
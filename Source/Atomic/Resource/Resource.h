@@ -63,6 +63,14 @@ public:
     virtual bool EndLoad();
     /// Save resource. Return true if successful.
     virtual bool Save(Serializer& dest) const;
+    // ATOMIC BEGIN
+    /// Reduce memory use by lowering quality, for example by dropping the highest mip level of a texture. Called by the ResourceCache from the main thread when over memory budget and the resource is still in use. Return true if memory use was reduced.
+    virtual bool ReduceQuality() { return false; }
+    /// Restore the quality lowered by ReduceQuality(). Called by the ResourceCache from the main thread once the estimated full quality memory use fits the budget again. Return true if restored.
+    virtual bool RestoreQuality() { return false; }
+    /// Return the estimated memory use at full quality. Equal to the memory use unless ReduceQuality() has lowered it.
+    virtual unsigned GetRestoredMemoryUse() const { return GetMemoryUse(); }
+    // ATOMIC END
 
     /// Load resource from file.
     bool LoadFile(const String& fileName);
@@ -73,7 +81,7 @@ public:
     void SetName(const String& name);
     /// Set memory use in bytes, possibly approximate.
     void SetMemoryUse(unsigned size);
-    /// Reset last used timer.
+    /// Reset last used timer and update the last access time.
     void ResetUseTimer();
     /// Set the asynchronous loading state. Called by ResourceCache. Resources in the middle of asynchronous loading are not normally returned to user.
     void SetAsyncLoadState(AsyncLoadState newState);
@@ -93,6 +101,11 @@ public:
     /// Return the asynchronous loading state.
     AsyncLoadState GetAsyncLoadState() const { return asyncLoadState_; }
 
+    // ATOMIC BEGIN
+    /// Return system time in milliseconds of the last access through the resource cache. Unlike the use timer, this is not affected by references held elsewhere.
+    unsigned GetLastAccessTime() const { return lastAccessTime_; }
+    // ATOMIC END
+
 private:
     /// Name.
     String name_;
@@ -102,6 +115,10 @@ private:
     Timer useTimer_;
     /// Memory use in bytes.
     unsigned memoryUse_;
+    // ATOMIC BEGIN
+    /// System time in milliseconds of the last access.
+    unsigned lastAccessTime_;
+    // ATOMIC END
     /// Asynchronous loading state.
     AsyncLoadState asyncLoadState_;
 };
@@ -30,6 +30,7 @@
 #include "../IO/FileWatcher.h"
 #include "../IO/Log.h"
 #include "../IO/PackageFile.h"
+#include "../Metrics/Metrics.h"
 #include "../Resource/BackgroundLoader.h"
 #include "../Resource/Image.h"
 #include "../Resource/JSONFile.h"
@@ -77,6 +78,9 @@ ResourceCache::ResourceCache(Context* context) :
     autoReloadResources_(false),
     returnFailedResources_(false),
     searchPackagesFirst_(true),
+    // ATOMIC BEGIN
+    memoryMapPackageFiles_(false),
+    // ATOMIC END
     isRouting_(false),
     finishBackgroundResourcesMs_(5)
 {
@@ -161,7 +165,9 @@ bool ResourceCache::AddPackageFile(PackageFile* package, unsigned priority)
 bool ResourceCache::AddPackageFile(const String& fileName, unsigned priority)
 {
     SharedPtr<PackageFile> package(new PackageFile(context_));
-    return package->Open(fileName) && AddPackageFile(package);
+    // ATOMIC BEGIN
+    return package->Open(fileName, 0, memoryMapPackageFiles_) && AddPackageFile(package);
+    // ATOMIC END
 }
 
 bool ResourceCache::AddManualResource(Resource* resource)
@@ -180,7 +186,10 @@ bool ResourceCache::AddManualResource(Resource* resource)
     }
 
     resource->ResetUseTimer();
-    resourceGroups_[resource->GetType()].resources_[resource->GetNameHash()] = resource;
+    {
+        MutexLock lock(resourceMutex_);
+        resourceGroups_[resource->GetType()].resources_[resource->GetNameHash()] = resource;
+    }
     UpdateResourceGroup(resource->GetType());
     return true;
 }
@@ -250,6 +259,8 @@ void ResourceCache::RemovePackageFile(const String& fileName, bool releaseResour
 
 void ResourceCache::ReleaseResource(StringHash type, const String& name, bool force)
 {
+    MutexLock lock(resourceMutex_);
+
     StringHash nameHash(name);
     const SharedPtr<Resource>& existingRes = FindResource(type, nameHash);
     if (!existingRes)
@@ -270,10 +281,12 @@ void ResourceCache::ReleaseResources(StringHash type, bool force)
     HashMap<StringHash, ResourceGroup>::Iterator i = resourceGroups_.Find(type);
     if (i != resourceGroups_.End())
     {
-        for (HashMap<StringHash, SharedPtr<Resource> >::Iterator j = i->second_.resources_.Begin();
+        MutexLock lock(resourceMutex_);
+
+        for (FlatHashMap<StringHash, SharedPtr<Resource> >::Iterator j = i->second_.resources_.Begin();
              j != i->second_.resources_.End();)
         {
-            HashMap<StringHash, SharedPtr<Resource> >::Iterator current = j++;
+            FlatHashMap<StringHash, SharedPtr<Resource> >::Iterator current = j++;
             // If other references exist, do not release, unless forced
             if ((current->second_.Refs() == 1 && current->second_.WeakRefs() == 0) || force)
             {
@@ -294,10 +307,12 @@ void ResourceCache::ReleaseResources(StringHash type, const String& partialName,
     HashMap<StringHash, ResourceGroup>::Iterator i = resourceGroups_.Find(type);
     if (i != resourceGroups_.End())
     {
-        for (HashMap<StringHash, SharedPtr<Resource> >::Iterator j = i->second_.resources_.Begin();
+        MutexLock lock(resourceMutex_);
+
+        for (FlatHashMap<StringHash, SharedPtr<Resource> >::Iterator j = i->second_.resources_.Begin();
              j != i->second_.resources_.End();)
         {
-            HashMap<StringHash, SharedPtr<Resource> >::Iterator current = j++;
+            FlatHashMap<StringHash, SharedPtr<Resource> >::Iterator current = j++;
             if (current->second_->GetName().Contains(partialName))
             {
                 // If other references exist, do not release, unless forced
@@ -326,10 +341,11 @@ void ResourceCache::ReleaseResources(const String& partialName, bool force)
         {
             bool released = false;
 
-            for (HashMap<StringHash, SharedPtr<Resource> >::Iterator j = i->second_.resources_.Begin();
+            resourceMutex_.Acquire();
+            for (FlatHashMap<StringHash, SharedPtr<Resource> >::Iterator j = i->second_.resources_.Begin();
                  j != i->second_.resources_.End();)
             {
-                HashMap<StringHash, SharedPtr<Resource> >::Iterator current = j++;
+                FlatHashMap<StringHash, SharedPtr<Resource> >::Iterator current = j++;
                 if (current->second_->GetName().Contains(partialName))
                 {
                     // If other references exist, do not release, unless forced
@@ -340,6 +356,8 @@ void ResourceCache::ReleaseResources(const String& partialName, bool force)
                     }
                 }
             }
+            resourceMutex_.Release();
+
             if (released)
                 UpdateResourceGroup(i->first_);
         }
@@ -357,10 +375,11 @@ void ResourceCache::ReleaseAllResources(bool force)
         {
             bool released = false;
 
-            for (HashMap<StringHash, SharedPtr<Resource> >::Iterator j = i->second_.resources_.Begin();
+            resourceMutex_.Acquire();
+            for (FlatHashMap<StringHash, SharedPtr<Resource> >::Iterator j = i->second_.resources_.Begin();
                  j != i->second_.resources_.End();)
             {
-                HashMap<StringHash, SharedPtr<Resource> >::Iterator current = j++;
+                FlatHashMap<StringHash, SharedPtr<Resource> >::Iterator current = j++;
                 // If other references exist, do not release, unless forced
                 if ((current->second_.Refs() == 1 && current->second_.WeakRefs() == 0) || force)
                 {
@@ -368,6 +387,8 @@ void ResourceCache::ReleaseAllResources(bool force)
                     released = true;
                 }
             }
+            resourceMutex_.Release();
+
             if (released)
                 UpdateResourceGroup(i->first_);
         }
@@ -464,7 +485,13 @@ void ResourceCache::ReloadResourceWithDependencies(const String& fileName)
 
 void ResourceCache::SetMemoryBudget(StringHash type, unsigned long long budget)
 {
-    resourceGroups_[type].memoryBudget_ = budget;
+    {
+        MutexLock lock(resourceMutex_);
+        resourceGroups_[type].memoryBudget_ = budget;
+    }
+    // ATOMIC BEGIN
+    UpdateResourceGroup(type);
+    // ATOMIC END
 }
 
 void ResourceCache::SetAutoReloadResources(bool enable)
@@ -572,6 +599,16 @@ SharedPtr<File> ResourceCache::GetFile(const String& nameIn, bool sendEventOnFai
 
 Resource* ResourceCache::GetExistingResource(StringHash type, const String& nameIn)
 {
+    // ATOMIC BEGIN
+    // Names that are already sanitated, such as those of resource references, are found without a sanitated copy
+    if (Thread::IsMainThread())
+    {
+        Resource* existing = FindResourceByExactName(type, nameIn);
+        if (existing)
+            return existing;
+    }
+    // ATOMIC END
+
     String name = SanitateResourceName(nameIn);
 
     if (!Thread::IsMainThread())
@@ -592,6 +629,20 @@ Resource* ResourceCache::GetExistingResource(StringHash type, const String& name
 
 Resource* ResourceCache::GetResource(StringHash type, const String& nameIn, bool sendEventOnFailure)
 {
+    // ATOMIC BEGIN
+    // Names that are already sanitated, such as those of resource references, are found without a sanitated copy, so
+    // that cache hits do not allocate. A resource in the cache is not in the background load queue, so no wait is needed
+    if (Thread::IsMainThread())
+    {
+        Resource* existing = FindResourceByExactName(type, nameIn);
+        if (existing)
+        {
+            MarkResourceHit(type, existing);
+            return existing;
+        }
+    }
+    // ATOMIC END
+
     String name = SanitateResourceName(nameIn);
 
     if (!Thread::IsMainThread())
@@ -611,9 +662,22 @@ Resource* ResourceCache::GetResource(StringHash type, const String& nameIn, bool
     backgroundLoader_->WaitForResource(type, nameHash);
 #endif
 
+    // ATOMIC BEGIN
+    Metrics* metrics = GetSubsystem<Metrics>();
+
     const SharedPtr<Resource>& existing = FindResource(type, nameHash);
     if (existing)
+    {
+        MarkResourceHit(type, existing);
         return existing;
+    }
+
+    resourceMutex_.Acquire();
+    ++resourceGroups_[type].misses_;
+    resourceMutex_.Release();
+    if (metrics)
+        metrics->AddToCounter(METRICID_RESOURCE_CACHE_MISSES);
+    // ATOMIC END
 
     SharedPtr<Resource> resource;
     // Make sure the pointer is non-null and is a Resource subclass
@@ -662,13 +726,17 @@ Resource* ResourceCache::GetResource(StringHash type, const String& nameIn, bool
 
     // Store to cache
     resource->ResetUseTimer();
-    resourceGroups_[type].resources_[nameHash] = resource;
+    {
+        MutexLock lock(resourceMutex_);
+        resourceGroups_[type].resources_[nameHash] = resource;
+    }
     UpdateResourceGroup(type);
 
     return resource;
 }
 
-bool ResourceCache::BackgroundLoadResource(StringHash type, const String& nameIn, bool sendEventOnFailure, Resource* caller)
+// ATOMIC BEGIN
+bool ResourceCache::BackgroundLoadResource(StringHash type, const String& nameIn, bool sendEventOnFailure, Resource* caller, int priority)
 {
 #ifdef ATOMIC_THREADING
     // If empty name, fail immediately
@@ -678,16 +746,54 @@ bool ResourceCache::BackgroundLoadResource(StringHash type, const String& nameIn
 
     // First check if already exists as a loaded resource
     StringHash nameHash(name);
-    if (FindResource(type, nameHash) != noResource)
-        return false;
+    {
+        MutexLock lock(resourceMutex_);
+        if (FindResource(type, nameHash) != noResource)
+            return false;
+    }
 
-    return backgroundLoader_->QueueResource(type, name, sendEventOnFailure, caller);
+    return backgroundLoader_->QueueResource(type, name, sendEventOnFailure, caller, priority);
 #else
     // When threading not supported, fall back to synchronous loading
     return GetResource(type, nameIn, sendEventOnFailure);
 #endif
 }
 
+bool ResourceCache::SetBackgroundLoadPriority(StringHash type, const String& name, int priority)
+{
+#ifdef ATOMIC_THREADING
+    return backgroundLoader_->SetResourcePriority(type, StringHash(SanitateResourceName(name)), priority);
+#else
+    return false;
+#endif
+}
+
+bool ResourceCache::CancelBackgroundLoadResource(StringHash type, const String& name)
+{
+#ifdef ATOMIC_THREADING
+    return backgroundLoader_->CancelResource(type, StringHash(SanitateResourceName(name)));
+#else
+    return false;
+#endif
+}
+
+void ResourceCache::SetNumBackgroundLoadThreads(unsigned num)
+{
+#ifdef ATOMIC_THREADING
+    backgroundLoader_->SetNumThreads(num);
+#endif
+}
+
+unsigned ResourceCache::GetNumBackgroundLoadThreads() const
+{
+#ifdef ATOMIC_THREADING
+    return backgroundLoader_->GetNumThreads();
+#else
+    return 0;
+#endif
+}
+// ATOMIC END
+
 SharedPtr<Resource> ResourceCache::GetTempResource(StringHash type, const String& nameIn, bool sendEventOnFailure)
 {
     String name = SanitateResourceName(nameIn);
@@ -779,7 +885,7 @@ void ResourceCache::GetResources(PODVector<Resource*>& result, StringHash type)
     HashMap<StringHash, ResourceGroup>::ConstIterator i = resourceGroups_.Find(type);
     if (i != resourceGroups_.End())
     {
-        for (HashMap<StringHash, SharedPtr<Resource> >::ConstIterator j = i->second_.resources_.Begin();
+        for (FlatHashMap<StringHash, SharedPtr<Resource> >::ConstIterator j = i->second_.resources_.Begin();
              j != i->second_.resources_.End(); ++j)
             result.Push(j->second_);
     }
@@ -989,7 +1095,7 @@ String ResourceCache::PrintMemoryUsage() const
         else
             average = 0;
         unsigned long long largest = 0;
-        for (HashMap<StringHash, SharedPtr<Resource> >::ConstIterator resIt = cit->second_.resources_.Begin(); resIt != cit->second_.resources_.End(); ++resIt)
+        for (FlatHashMap<StringHash, SharedPtr<Resource> >::ConstIterator resIt = cit->second_.resources_.Begin(); resIt != cit->second_.resources_.End(); ++resIt)
         {
             if (resIt->second_->GetMemoryUse() > largest)
                 largest = resIt->second_->GetMemoryUse();
@@ -1036,7 +1142,7 @@ const SharedPtr<Resource>& ResourceCache::FindResource(StringHash type, StringHa
     HashMap<StringHash, ResourceGroup>::Iterator i = resourceGroups_.Find(type);
     if (i == resourceGroups_.End())
         return noResource;
-    HashMap<StringHash, SharedPtr<Resource> >::Iterator j = i->second_.resources_.Find(nameHash);
+    FlatHashMap<StringHash, SharedPtr<Resource> >::Iterator j = i->second_.resources_.Find(nameHash);
     if (j == i->second_.resources_.End())
         return noResource;
 
@@ -1049,7 +1155,7 @@ const SharedPtr<Resource>& ResourceCache::FindResource(StringHash nameHash)
 
     for (HashMap<StringHash, ResourceGroup>::Iterator i = resourceGroups_.Begin(); i != resourceGroups_.End(); ++i)
     {
-        HashMap<StringHash, SharedPtr<Resource> >::Iterator j = i->second_.resources_.Find(nameHash);
+        FlatHashMap<StringHash, SharedPtr<Resource> >::Iterator j = i->second_.resources_.Find(nameHash);
         if (j != i->second_.resources_.End())
             return j->second_;
     }
@@ -1057,8 +1163,36 @@ const SharedPtr<Resource>& ResourceCache::FindResource(StringHash nameHash)
     return noResource;
 }
 
+// ATOMIC BEGIN
+Resource* ResourceCache::FindResourceByExactName(StringHash type, const String& name)
+{
+    if (name.Empty())
+        return 0;
+
+    Resource* resource = FindResource(type, StringHash(name));
+    return resource && resource->GetName() == name ? resource : 0;
+}
+
+void ResourceCache::MarkResourceHit(StringHash type, Resource* resource)
+{
+    // Update the last access time for least recently used eviction
+    resource->ResetUseTimer();
+
+    {
+        MutexLock lock(resourceMutex_);
+        ++resourceGroups_[type].hits_;
+    }
+
+    Metrics* metrics = GetSubsystem<Metrics>();
+    if (metrics)
+        metrics->AddToCounter(METRICID_RESOURCE_CACHE_HITS);
+}
+// ATOMIC END
+
 void ResourceCache::ReleasePackageResources(PackageFile* package, bool force)
 {
+    MutexLock lock(resourceMutex_);
+
     HashSet<StringHash> affectedGroups;
 
     const HashMap<String, PackageEntry>& entries = package->GetEntries();
@@ -1069,7 +1203,7 @@ void ResourceCache::ReleasePackageResources(PackageFile* package, bool force)
         // We do not know the actual resource type, so search all type containers
         for (HashMap<StringHash, ResourceGroup>::Iterator j = resourceGroups_.Begin(); j != resourceGroups_.End(); ++j)
         {
-            HashMap<StringHash, SharedPtr<Resource> >::Iterator k = j->second_.resources_.Find(nameHash);
+            FlatHashMap<StringHash, SharedPtr<Resource> >::Iterator k = j->second_.resources_.Find(nameHash);
             if (k != j->second_.resources_.End())
             {
                 // If other references exist, do not release, unless forced
@@ -1087,45 +1221,153 @@ void ResourceCache::ReleasePackageResources(PackageFile* package, bool force)
         UpdateResourceGroup(*i);
 }
 
+// ATOMIC BEGIN
+/// Resource eviction candidate.
+struct EvictionEntry
+{
+    /// Resource.
+    Resource* resource_;
+    /// Milliseconds since last access.
+    unsigned age_;
+};
+
+static bool CompareEvictionEntries(const EvictionEntry& lhs, const EvictionEntry& rhs)
+{
+    return lhs.age_ > rhs.age_;
+}
+
 void ResourceCache::UpdateResourceGroup(StringHash type)
 {
     HashMap<StringHash, ResourceGroup>::Iterator i = resourceGroups_.Find(type);
     if (i == resourceGroups_.End())
         return;
 
-    for (;;)
+    ResourceGroup& group = i->second_;
+
+    unsigned long long totalSize = 0;
+    for (FlatHashMap<StringHash, SharedPtr<Resource> >::Iterator j = group.resources_.Begin(); j != group.resources_.End(); ++j)
+        totalSize += j->second_->GetMemoryUse();
+
+    group.memoryUse_ = totalSize;
+
+    if (!group.memoryBudget_ || group.memoryUse_ <= group.memoryBudget_)
+        return;
+
+    // Over budget: order the resources least recently used first
+    unsigned now = Time::GetSystemTime();
+    PODVector<EvictionEntry> entries;
+    entries.Reserve(group.resources_.Size());
+    for (FlatHashMap<StringHash, SharedPtr<Resource> >::Iterator j = group.resources_.Begin(); j != group.resources_.End(); ++j)
     {
-        unsigned totalSize = 0;
-        unsigned oldestTimer = 0;
-        HashMap<StringHash, SharedPtr<Resource> >::Iterator oldestResource = i->second_.resources_.End();
+        EvictionEntry entry;
+        entry.resource_ = j->second_;
+        entry.age_ = now - j->second_->GetLastAccessTime();
+        entries.Push(entry);
+    }
+    Sort(entries.Begin(), entries.End(), CompareEvictionEntries);
 
-        for (HashMap<StringHash, SharedPtr<Resource> >::Iterator j = i->second_.resources_.Begin();
-             j != i->second_.resources_.End(); ++j)
+    Metrics* metrics = GetSubsystem<Metrics>();
+
+    // First release resources that are not referenced elsewhere than in the cache
+    for (unsigned j = 0; j < entries.Size() && group.memoryUse_ > group.memoryBudget_; ++j)
+    {
+        Resource* resource = entries[j].resource_;
+        if (resource->Refs() > 1)
+            continue;
+
+        unsigned memoryUse = resource->GetMemoryUse();
+        ATOMIC_LOGDEBUG("Resource group " + resource->GetTypeName() + " over memory budget, releasing resource " +
+                 resource->GetName());
+
+        group.memoryUse_ -= memoryUse;
+        ++group.evictions_;
+        group.evictedBytes_ += memoryUse;
+        if (metrics)
         {
-            totalSize += j->second_->GetMemoryUse();
-            unsigned useTimer = j->second_->GetUseTimer();
-            if (useTimer > oldestTimer)
+            metrics->AddToCounter(METRICID_RESOURCE_EVICTIONS);
+            metrics->AddToCounter(METRICID_RESOURCE_EVICTED_BYTES, memoryUse);
+        }
+
+        entries[j].resource_ = 0;
+        MutexLock lock(resourceMutex_);
+        group.resources_.Erase(resource->GetNameHash());
+    }
+
+    // If still over budget, reduce the quality of resources in use, for example textures to lower mip levels. This
+    // reloads resources, so it is done on the following frames one resource at a time instead of during this load
+    if (group.memoryUse_ > group.memoryBudget_)
+        group.reduceQuality_ = true;
+}
+
+void ResourceCache::UpdateResourceQuality()
+{
+    Metrics* metrics = GetSubsystem<Metrics>();
+
+    for (HashMap<StringHash, ResourceGroup>::Iterator i = resourceGroups_.Begin(); i != resourceGroups_.End(); ++i)
+    {
+        ResourceGroup& group = i->second_;
+
+        if (group.reduceQuality_ && group.memoryBudget_ && group.memoryUse_ > group.memoryBudget_)
+        {
+            // Reduce the least recently used resource that still can be reduced
+            unsigned now = Time::GetSystemTime();
+            PODVector<EvictionEntry> entries;
+            entries.Reserve(group.resources_.Size());
+            for (FlatHashMap<StringHash, SharedPtr<Resource> >::Iterator j = group.resources_.Begin(); j != group.resources_.End(); ++j)
             {
-                oldestTimer = useTimer;
-                oldestResource = j;
+                EvictionEntry entry;
+                entry.resource_ = j->second_;
+                entry.age_ = now - j->second_->GetLastAccessTime();
+                entries.Push(entry);
             }
-        }
+            Sort(entries.Begin(), entries.End(), CompareEvictionEntries);
 
-        i->second_.memoryUse_ = totalSize;
+            group.reduceQuality_ = false;
+            for (unsigned j = 0; j < entries.Size(); ++j)
+            {
+                Resource* resource = entries[j].resource_;
+                unsigned memoryUse = resource->GetMemoryUse();
+                if (resource->ReduceQuality() && resource->GetMemoryUse() < memoryUse)
+                {
+                    group.memoryUse_ -= memoryUse - resource->GetMemoryUse();
+                    ++group.demotions_;
+                    if (metrics)
+                        metrics->AddToCounter(METRICID_RESOURCE_DEMOTIONS);
 
-        // If memory budget defined and is exceeded, remove the oldest resource and loop again
-        // (resources in use always return a zero timer and can not be removed)
-        if (i->second_.memoryBudget_ && i->second_.memoryUse_ > i->second_.memoryBudget_ &&
-            oldestResource != i->second_.resources_.End())
+                    WeakPtr<Resource> demoted(resource);
+                    if (!group.demotedResources_.Contains(demoted))
+                        group.demotedResources_.Push(demoted);
+
+                    // Keep reducing on the next frames while over budget
+                    group.reduceQuality_ = group.memoryUse_ > group.memoryBudget_;
+                    break;
+                }
+            }
+        }
+        else if (!group.demotedResources_.Empty() && (!group.memoryBudget_ || group.memoryUse_ <= group.memoryBudget_))
         {
-            ATOMIC_LOGDEBUG("Resource group " + oldestResource->second_->GetTypeName() + " over memory budget, releasing resource " +
-                     oldestResource->second_->GetName());
-            i->second_.resources_.Erase(oldestResource);
+            // Back under budget: restore the most recently demoted resource if its full quality fits, so that it
+            // is not demoted again right away. Forget resources that were released or already restored
+            Resource* resource = group.demotedResources_.Back();
+            if (!resource || group.resources_.Find(resource->GetNameHash()) == group.resources_.End() ||
+                resource->GetRestoredMemoryUse() <= resource->GetMemoryUse())
+            {
+                group.demotedResources_.Pop();
+                continue;
+            }
+
+            unsigned memoryUse = resource->GetMemoryUse();
+            unsigned long long restoredUse = group.memoryUse_ - memoryUse + resource->GetRestoredMemoryUse();
+            if (group.memoryBudget_ && restoredUse > group.memoryBudget_)
+                continue;
+
+            group.demotedResources_.Pop();
+            if (resource->RestoreQuality())
+                group.memoryUse_ = group.memoryUse_ - memoryUse + resource->GetMemoryUse();
         }
-        else
-            break;
     }
 }
+// ATOMIC END
 
 void ResourceCache::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
 {
@@ -1153,6 +1395,13 @@ void ResourceCache::HandleBeginFrame(StringHash eventType, VariantMap& eventData
         backgroundLoader_->FinishResources(finishBackgroundResourcesMs_);
     }
 #endif
+
+    // ATOMIC BEGIN
+    {
+        ATOMIC_PROFILE(UpdateResourceQuality);
+        UpdateResourceQuality();
+    }
+    // ATOMIC END
 }
 
 File* ResourceCache::SearchResourceDirs(const String& nameIn)
@@ -1254,7 +1503,7 @@ String ResourceCache::PrintResources(const String& typeName) const
 
     for (HashMap<StringHash, ResourceGroup>::ConstIterator cit = resourceGroups_.Begin(); cit != resourceGroups_.End(); ++cit)
     {
-        for (HashMap<StringHash, SharedPtr<Resource> >::ConstIterator resIt = cit->second_.resources_.Begin(); resIt != cit->second_.resources_.End(); ++resIt)
+        for (FlatHashMap<StringHash, SharedPtr<Resource> >::ConstIterator resIt = cit->second_.resources_.Begin(); resIt != cit->second_.resources_.End(); ++resIt)
         {
             Resource* resource = resIt->second_;
 
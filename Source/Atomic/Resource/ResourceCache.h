@@ -23,6 +23,9 @@
 #pragma once
 
 #include "../Container/HashSet.h"
+// ATOMIC BEGIN
+#include "../Container/FlatHashMap.h"
+// ATOMIC END
 #include "../Container/List.h"
 #include "../Core/Mutex.h"
 #include "../IO/File.h"
@@ -38,13 +41,30 @@ class PackageFile;
 /// Sets to priority so that a package or file is pushed to the end of the vector.
 static const unsigned PRIORITY_LAST = 0xffffffff;
 
+// ATOMIC BEGIN
+/// Background load priority for resources that are needed right away, for example visible now.
+static const int BACKGROUND_LOAD_PRIORITY_HIGH = 100;
+/// Default background load priority.
+static const int BACKGROUND_LOAD_PRIORITY_NORMAL = 0;
+/// Background load priority for speculative prefetching.
+static const int BACKGROUND_LOAD_PRIORITY_PREFETCH = -100;
+// ATOMIC END
+
 /// Container of resources with specific type.
 struct ResourceGroup
 {
     /// Construct with defaults.
     ResourceGroup() :
         memoryBudget_(0),
-        memoryUse_(0)
+        memoryUse_(0),
+        // ATOMIC BEGIN
+        hits_(0),
+        misses_(0),
+        evictions_(0),
+        demotions_(0),
+        evictedBytes_(0),
+        reduceQuality_(false)
+        // ATOMIC END
     {
     }
 
@@ -52,8 +72,24 @@ struct ResourceGroup
     unsigned long long memoryBudget_;
     /// Current memory use.
     unsigned long long memoryUse_;
+    // ATOMIC BEGIN
+    /// Number of GetResource() calls that found the resource loaded.
+    unsigned hits_;
+    /// Number of GetResource() calls that had to load the resource.
+    unsigned misses_;
+    /// Number of resources released to stay within the memory budget.
+    unsigned evictions_;
+    /// Number of resources reduced in quality to stay within the memory budget.
+    unsigned demotions_;
+    /// Total bytes of resources released to stay within the memory budget.
+    unsigned long long evictedBytes_;
+    /// Resources reduced in quality, most recently demoted last. Restored last demoted first once they fit the budget.
+    Vector<WeakPtr<Resource> > demotedResources_;
+    /// Set when eviction alone could not meet the memory budget. Quality reduction is then attempted once per frame until it no longer succeeds.
+    bool reduceQuality_;
+    // ATOMIC END
     /// Resources.
-    HashMap<StringHash, SharedPtr<Resource> > resources_;
+    FlatHashMap<StringHash, SharedPtr<Resource> > resources_;
 };
 
 /// Resource request types.
@@ -137,7 +173,7 @@ public:
     bool ReloadResource(Resource* resource);
     /// Reload a resource based on filename. Causes also reload of dependent resources if necessary.
     void ReloadResourceWithDependencies(const String& fileName);
-    /// Set memory budget for a specific resource type, default 0 is unlimited.
+    /// Set memory budget for a specific resource type, default 0 is unlimited. When over budget, the least recently used resources not referenced elsewhere are released first, then least recently used resources still in use are reduced in quality if they support it.
     void SetMemoryBudget(StringHash type, unsigned long long budget);
     /// Enable or disable automatic reloading of resources as files are modified. Default false.
     void SetAutoReloadResources(bool enable);
@@ -149,6 +185,12 @@ public:
 
     /// Set how many milliseconds maximum per frame to spend on finishing background loaded resources.
     void SetFinishBackgroundResourcesMs(int ms) { finishBackgroundResourcesMs_ = Max(ms, 1); }
+    // ATOMIC BEGIN
+    /// Set number of background loader threads. Default is one less than the number of physical CPU cores, but at least 1 and at most 4.
+    void SetNumBackgroundLoadThreads(unsigned num);
+    /// Set whether package files added by name are memory mapped, so that uncompressed entries are read without copying and compressed entries are decompressed in parallel. Default false.
+    void SetMemoryMapPackageFiles(bool enable) { memoryMapPackageFiles_ = enable; }
+    // ATOMIC END
 
     /// Add a resource router object. By default there is none, so the routing process is skipped.
     void AddResourceRouter(ResourceRouter* router, bool addAsFirst = false);
@@ -163,8 +205,15 @@ public:
     Resource* GetResource(StringHash type, const String& name, bool sendEventOnFailure = true);
     /// Load a resource without storing it in the resource cache. Return null if not found or if fails. Can be called from outside the main thread if the resource itself is safe to load completely (it does not possess for example GPU data.)
     SharedPtr<Resource> GetTempResource(StringHash type, const String& name, bool sendEventOnFailure = true);
-    /// Background load a resource. An event will be sent when complete. Return true if successfully stored to the load queue, false if eg. already exists. Can be called from outside the main thread.
-    bool BackgroundLoadResource(StringHash type, const String& name, bool sendEventOnFailure = true, Resource* caller = 0);
+    // ATOMIC BEGIN
+    /// Background load a resource. An event will be sent when complete. Higher priority resources are loaded and finished first. Return true if successfully stored to the load queue, false if eg. already exists. Can be called from outside the main thread.
+    bool BackgroundLoadResource(StringHash type, const String& name, bool sendEventOnFailure = true, Resource* caller = 0,
+        int priority = BACKGROUND_LOAD_PRIORITY_NORMAL);
+    /// Change the priority of a resource in the background load queue. The resources it depends on are raised to at least the same priority. Return true if the resource was queued. Can be called from outside the main thread.
+    bool SetBackgroundLoadPriority(StringHash type, const String& name, int priority);
+    /// Cancel background loading of a resource. It will not be stored to the cache and no event is sent for it. Resources that other queued resources depend on can not be cancelled. Return true if cancelled.
+    bool CancelBackgroundLoadResource(StringHash type, const String& name);
+    // ATOMIC END
     /// Return number of pending background-loaded resources.
     unsigned GetNumBackgroundLoadResources() const;
     /// Return all loaded resources of a specific type.
@@ -189,8 +238,15 @@ public:
     template <class T> SharedPtr<T> GetTempResource(const String& name, bool sendEventOnFailure = true);
     /// Template version of releasing a resource by name.
     template <class T> void ReleaseResource(const String& name, bool force = false);
+    // ATOMIC BEGIN
     /// Template version of queueing a resource background load.
-    template <class T> bool BackgroundLoadResource(const String& name, bool sendEventOnFailure = true, Resource* caller = 0);
+    template <class T> bool BackgroundLoadResource(const String& name, bool sendEventOnFailure = true, Resource* caller = 0,
+        int priority = BACKGROUND_LOAD_PRIORITY_NORMAL);
+    /// Template version of changing the priority of a queued background load.
+    template <class T> bool SetBackgroundLoadPriority(const String& name, int priority);
+    /// Template version of cancelling a resource background load.
+    template <class T> bool CancelBackgroundLoadResource(const String& name);
+    // ATOMIC END
     /// Template version of returning loaded resources of a specific type.
     template <class T> void GetResources(PODVector<T*>& result) const;
     /// Return whether a file exists by name.
@@ -215,6 +271,12 @@ public:
 
     /// Return how many milliseconds maximum to spend on finishing background loaded resources.
     int GetFinishBackgroundResourcesMs() const { return finishBackgroundResourcesMs_; }
+    // ATOMIC BEGIN
+    /// Return number of background loader threads.
+    unsigned GetNumBackgroundLoadThreads() const;
+    /// Return whether package files added by name are memory mapped.
+    bool GetMemoryMapPackageFiles() const { return memoryMapPackageFiles_; }
+    // ATOMIC END
 
     /// Return a resource router by index.
     ResourceRouter* GetResourceRouter(unsigned index) const;
@@ -255,10 +317,20 @@ private:
     const SharedPtr<Resource>& FindResource(StringHash type, StringHash nameHash);
     /// Find a resource by name only. Searches all type groups.
     const SharedPtr<Resource>& FindResource(StringHash nameHash);
+    // ATOMIC BEGIN
+    /// Find a resource by its stored name without sanitating the name. Return null if not found or if the name differs from the stored name, for example by case or path separators.
+    Resource* FindResourceByExactName(StringHash type, const String& name);
+    /// Update the last access time and the hit count of a loaded resource that is returned to the caller.
+    void MarkResourceHit(StringHash type, Resource* resource);
+    // ATOMIC END
     /// Release resources loaded from a package file.
     void ReleasePackageResources(PackageFile* package, bool force = false);
     /// Update a resource group. Recalculate memory use and release resources if over memory budget.
     void UpdateResourceGroup(StringHash type);
+    // ATOMIC BEGIN
+    /// Reduce the quality of one resource in each group over memory budget, or restore one previously reduced resource that fits the budget again. Called once per frame.
+    void UpdateResourceQuality();
+    // ATOMIC END
     /// Handle begin frame event. Automatic resource reloads and the finalization of background loaded resources are processed here.
     void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
     /// Search FileSystem for file.
@@ -268,7 +340,7 @@ private:
 
     /// Mutex for thread-safe access to the resource directories, resource packages and resource dependencies.
     mutable Mutex resourceMutex_;
-    /// Resources by type.
+    /// Resources by type. Modified only in the main thread with resourceMutex_ held, so background loader threads must hold it while reading.
     HashMap<StringHash, ResourceGroup> resourceGroups_;
     /// Resource load directories.
     Vector<String> resourceDirs_;
@@ -288,6 +360,10 @@ private:
     bool returnFailedResources_;
     /// Search priority flag.
     bool searchPackagesFirst_;
+    // ATOMIC BEGIN
+    /// Memory map package files flag.
+    bool memoryMapPackageFiles_;
+    // ATOMIC END
     /// Resource routing flag to prevent endless recursion.
     mutable bool isRouting_;
     /// How many milliseconds maximum per frame to spend on finishing background loaded resources.
@@ -318,12 +394,26 @@ template <class T> SharedPtr<T> ResourceCache::GetTempResource(const String& nam
     return StaticCast<T>(GetTempResource(type, name, sendEventOnFailure));
 }
 
-template <class T> bool ResourceCache::BackgroundLoadResource(const String& name, bool sendEventOnFailure, Resource* caller)
+// ATOMIC BEGIN
+template <class T> bool ResourceCache::BackgroundLoadResource(const String& name, bool sendEventOnFailure, Resource* caller, int priority)
 {
     StringHash type = T::GetTypeStatic();
-    return BackgroundLoadResource(type, name, sendEventOnFailure, caller);
+    return BackgroundLoadResource(type, name, sendEventOnFailure, caller, priority);
 }
 
+template <class T> bool ResourceCache::SetBackgroundLoadPriority(const String& name, int priority)
+{
+    StringHash type = T::GetTypeStatic();
+    return SetBackgroundLoadPriority(type, name, priority);
+}
+
+template <class T> bool ResourceCache::CancelBackgroundLoadResource(const String& name)
+{
+    StringHash type = T::GetTypeStatic();
+    return CancelBackgroundLoadResource(type, name);
+}
+// ATOMIC END
+
 template <class T> void ResourceCache::GetResources(PODVector<T*>& result) const
 {
     PODVector<Resource*>& resources = reinterpret_cast<PODVector<Resource*>&>(result);
@@ -498,8 +498,8 @@ bool XMLElement::SetVariantMap(const VariantMap& value)
 
 // ATOMIC BEGIN
         // Check for significant string, to make variant map XML more friendly than using a hash
-        String sigString;
-        if (StringHash::GetSignificantString(i->first_, sigString))
+        const String& sigString = StringHash::GetSignificantString(i->first_);
+        if (!sigString.Empty())
         {
             variantElem.SetString("name", sigString);
         }
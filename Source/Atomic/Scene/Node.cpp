@@ -744,6 +744,12 @@ void Node::SetOwner(Connection* owner)
 
 void Node::MarkDirty()
 {
+// ATOMIC BEGIN
+    // Register with the scene so that the world transform is recomputed in its batched update pass
+    if (!dirty_ && scene_)
+        scene_->MarkTransformDirty(this);
+// ATOMIC END
+
     Node *cur = this;
     for (;;)
     {
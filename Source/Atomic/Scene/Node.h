@@ -75,6 +75,9 @@ class ATOMIC_API Node : public Animatable
     ATOMIC_OBJECT(Node, Animatable);
 
     friend class Connection;
+// ATOMIC BEGIN
+    friend class TransformHierarchy;
+// ATOMIC END
 
 public:
     /// Construct.
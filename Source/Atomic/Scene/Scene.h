@@ -23,11 +23,20 @@
 #pragma once
 
 #include "../Container/HashSet.h"
+// ATOMIC BEGIN
+#include "../Container/FlatHashMap.h"
+// ATOMIC END
 #include "../Core/Mutex.h"
+// ATOMIC BEGIN
+#include "../Core/EventChannel.h"
+// ATOMIC END
 #include "../Resource/XMLElement.h"
 #include "../Resource/JSONFile.h"
 #include "../Scene/Node.h"
 #include "../Scene/SceneResolver.h"
+// ATOMIC BEGIN
+#include "../Scene/TransformHierarchy.h"
+// ATOMIC END
 
 namespace Atomic
 {
@@ -81,6 +90,19 @@ struct AsyncProgress
     unsigned totalNodes_;
 };
 
+// ATOMIC BEGIN
+
+/// Payload of the typed scene update and post-update channels.
+struct SceneUpdateEventData
+{
+    /// Scene being updated.
+    Scene* scene_;
+    /// Scaled timestep in seconds.
+    float timeStep_;
+};
+
+// ATOMIC END
+
 /// Root scene node, represents the whole scene.
 class ATOMIC_API Scene : public Node
 {
@@ -211,6 +233,13 @@ public:
     /// Return a node user variable name, or empty if not registered.
     const String& GetVarName(StringHash hash) const;
 
+// ATOMIC BEGIN
+    /// Return the typed scene update channel. Sent by Update() before E_SCENEUPDATE, without building an event data map. Events sent by other code do not reach it.
+    EventChannel<SceneUpdateEventData>& GetUpdateChannel() { return updateChannel_; }
+    /// Return the typed scene post-update channel. Sent by Update() before E_SCENEPOSTUPDATE, without building an event data map. Events sent by other code do not reach it.
+    EventChannel<SceneUpdateEventData>& GetPostUpdateChannel() { return postUpdateChannel_; }
+// ATOMIC END
+
     /// Update scene. Called by HandleUpdate.
     void Update(float timeStep);
     /// Begin a threaded update. During threaded update components can choose to delay dirty processing.
@@ -219,6 +248,12 @@ public:
     void EndThreadedUpdate();
     /// Add a component to the delayed dirty notify queue. Is thread-safe.
     void DelayedMarkedDirty(Component* component);
+// ATOMIC BEGIN
+    /// Register a node whose world transform became dirty for the batched update. Is thread-safe during threaded update.
+    void MarkTransformDirty(Node* node);
+    /// Update the world transforms of all dirty nodes in one batched pass, using worker threads for wide hierarchy levels. Called automatically before octree update; calling it earlier avoids lazy recursive evaluation on access.
+    void UpdateWorldTransforms();
+// ATOMIC END
 
     /// Return threaded update flag.
     bool IsThreadedUpdate() const { return threadedUpdate_; }
@@ -277,19 +312,23 @@ private:
     void PreloadResourcesJSON(const JSONValue& value);
 
     /// Replicated scene nodes by ID.
-    HashMap<unsigned, Node*> replicatedNodes_;
+    FlatHashMap<unsigned, Node*> replicatedNodes_;
     /// Local scene nodes by ID.
-    HashMap<unsigned, Node*> localNodes_;
+    FlatHashMap<unsigned, Node*> localNodes_;
     /// Replicated components by ID.
-    HashMap<unsigned, Component*> replicatedComponents_;
+    FlatHashMap<unsigned, Component*> replicatedComponents_;
     /// Local components by ID.
-    HashMap<unsigned, Component*> localComponents_;
+    FlatHashMap<unsigned, Component*> localComponents_;
     /// Cached tagged nodes by tag.
     HashMap<StringHash, PODVector<Node*> > taggedNodes_;
     /// Asynchronous loading progress.
     AsyncProgress asyncProgress_;
     /// Node and component ID resolver for asynchronous loading.
     SceneResolver resolver_;
+// ATOMIC BEGIN
+    /// Batched world transform updater.
+    TransformHierarchy transformHierarchy_;
+// ATOMIC END
     /// Source file name.
     mutable String fileName_;
     /// Required package files for networking.
@@ -306,6 +345,12 @@ private:
     Mutex sceneMutex_;
     /// Preallocated event data map for smoothing update events.
     VariantMap smoothingData_;
+// ATOMIC BEGIN
+    /// Typed scene update channel.
+    EventChannel<SceneUpdateEventData> updateChannel_;
+    /// Typed scene post-update channel.
+    EventChannel<SceneUpdateEventData> postUpdateChannel_;
+// ATOMIC END
     /// Next free non-local node ID.
     unsigned replicatedNodeID_;
     /// Next free non-local component ID.
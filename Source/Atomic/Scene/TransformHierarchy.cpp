@@ -0,0 +1,211 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../Precompiled.h"
+
+#include "../Container/Sort.h"
+#include "../Core/WorkQueue.h"
+#include "../Scene/Scene.h"
+#include "../Scene/TransformHierarchy.h"
+
+#include "../DebugNew.h"
+
+namespace Atomic
+{
+
+TransformHierarchy::TransformHierarchy() :
+    compactSize_(MIN_DIRTY_COMPACT_SIZE)
+{
+}
+
+TransformHierarchy::~TransformHierarchy()
+{
+}
+
+void TransformHierarchy::MarkDirty(Node* node, bool threaded)
+{
+    if (threaded)
+    {
+        MutexLock lock(dirtyMutex_);
+        AddDirtyNodeID(node->id_);
+    }
+    else
+        AddDirtyNodeID(node->id_);
+}
+
+void TransformHierarchy::Update(Scene* scene, WorkQueue* queue)
+{
+    if (dirtyNodeIDs_.Empty())
+        return;
+
+    if (!Gather(scene))
+        return;
+
+    worldTransforms_.Resize(nodes_.Size());
+    worldRotations_.Resize(nodes_.Size());
+
+    // Each level only depends on the previous one, so the nodes within a level can be updated in any order
+    for (unsigned level = 0; level + 1 < levelStarts_.Size(); ++level)
+    {
+        unsigned begin = levelStarts_[level];
+        unsigned end = levelStarts_[level + 1];
+
+        if (queue && end - begin >= TRANSFORM_PARALLEL_THRESHOLD)
+        {
+            queue->ParallelFor(begin, end, TRANSFORMS_PER_UPDATE_RANGE, [this](unsigned rangeBegin, unsigned rangeEnd, unsigned threadIndex)
+            {
+                UpdateRange(rangeBegin, rangeEnd);
+            });
+        }
+        else
+            UpdateRange(begin, end);
+    }
+}
+
+void TransformHierarchy::Clear()
+{
+    dirtyNodeIDs_.Clear();
+    compactSize_ = MIN_DIRTY_COMPACT_SIZE;
+    nodes_.Clear();
+    parents_.Clear();
+    levelStarts_.Clear();
+}
+
+bool TransformHierarchy::Gather(Scene* scene)
+{
+    nodes_.Clear();
+    parents_.Clear();
+    levelStarts_.Clear();
+
+    // A node may have been registered more than once if it was cleaned by a lazy update in between
+    Sort(dirtyNodeIDs_.Begin(), dirtyNodeIDs_.End());
+
+    // The first level is formed by the topmost dirty nodes. Nodes whose parent is also dirty are reached through it,
+    // and nodes that have been cleaned lazily or removed from the scene meanwhile are skipped
+    for (unsigned i = 0; i < dirtyNodeIDs_.Size(); ++i)
+    {
+        if (i && dirtyNodeIDs_[i] == dirtyNodeIDs_[i - 1])
+            continue;
+
+        Node* node = scene->GetNode(dirtyNodeIDs_[i]);
+        if (!node || !node->dirty_)
+            continue;
+
+        Node* parent = node->parent_;
+        if (parent && parent != scene && parent->dirty_)
+            continue;
+
+        nodes_.Push(node);
+        parents_.Push(-1);
+    }
+
+    dirtyNodeIDs_.Clear();
+    compactSize_ = MIN_DIRTY_COMPACT_SIZE;
+
+    if (nodes_.Empty())
+        return false;
+
+    // Expand level by level. All children of a dirty node are dirty as well
+    unsigned levelBegin = 0;
+    while (levelBegin < nodes_.Size())
+    {
+        unsigned levelEnd = nodes_.Size();
+        levelStarts_.Push(levelBegin);
+
+        for (unsigned i = levelBegin; i < levelEnd; ++i)
+        {
+            const Vector<SharedPtr<Node> >& children = nodes_[i]->children_;
+            for (Vector<SharedPtr<Node> >::ConstIterator j = children.Begin(); j != children.End(); ++j)
+            {
+                nodes_.Push(*j);
+                parents_.Push((int)i);
+            }
+        }
+
+        levelBegin = levelEnd;
+    }
+
+    levelStarts_.Push(nodes_.Size());
+    return true;
+}
+
+void TransformHierarchy::UpdateRange(unsigned begin, unsigned end)
+{
+    Node** nodes = &nodes_[0];
+    const int* parents = &parents_[0];
+    Matrix3x4* worldTransforms = &worldTransforms_[0];
+    Quaternion* worldRotations = &worldRotations_[0];
+
+    for (unsigned i = begin; i < end; ++i)
+    {
+        Node* node = nodes[i];
+        int parentIndex = parents[i];
+
+        if (parentIndex >= 0)
+        {
+            worldTransforms[i] = worldTransforms[parentIndex] * node->GetTransform();
+            worldRotations[i] = worldRotations[parentIndex] * node->rotation_;
+        }
+        else
+        {
+            // Topmost dirty node: the parent is up to date, or is the scene, which is assumed to have identity transform
+            Node* parent = node->parent_;
+            if (!parent || parent == node->scene_)
+            {
+                worldTransforms[i] = node->GetTransform();
+                worldRotations[i] = node->rotation_;
+            }
+            else
+            {
+                worldTransforms[i] = parent->worldTransform_ * node->GetTransform();
+                worldRotations[i] = parent->worldRotation_ * node->rotation_;
+            }
+        }
+
+        node->worldTransform_ = worldTransforms[i];
+        node->worldRotation_ = worldRotations[i];
+        node->dirty_ = false;
+    }
+}
+
+void TransformHierarchy::AddDirtyNodeID(unsigned id)
+{
+    dirtyNodeIDs_.Push(id);
+
+    // A node cleaned by a lazy update registers again when it becomes dirty again. If the pass does not run (the scene
+    // is neither updated nor rendered) remove the duplicates whenever the list has doubled, which bounds it by the
+    // number of distinct node IDs
+    if (dirtyNodeIDs_.Size() < compactSize_)
+        return;
+
+    Sort(dirtyNodeIDs_.Begin(), dirtyNodeIDs_.End());
+    unsigned dest = 0;
+    for (unsigned i = 0; i < dirtyNodeIDs_.Size(); ++i)
+    {
+        if (!dest || dirtyNodeIDs_[i] != dirtyNodeIDs_[dest - 1])
+            dirtyNodeIDs_[dest++] = dirtyNodeIDs_[i];
+    }
+    dirtyNodeIDs_.Resize(dest);
+    compactSize_ = Max(dest * 2, MIN_DIRTY_COMPACT_SIZE);
+}
+
+}
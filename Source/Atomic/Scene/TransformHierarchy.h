@@ -0,0 +1,93 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Container/Vector.h"
+#include "../Core/Mutex.h"
+#include "../Math/Matrix3x4.h"
+#include "../Math/Quaternion.h"
+
+namespace Atomic
+{
+
+class Node;
+class Scene;
+class WorkQueue;
+
+/// Minimum number of nodes on one hierarchy level to update it with worker threads.
+static const unsigned TRANSFORM_PARALLEL_THRESHOLD = 1024;
+/// Number of nodes per work item when updating a hierarchy level with worker threads.
+static const unsigned TRANSFORMS_PER_UPDATE_RANGE = 256;
+/// Minimum number of registered node IDs before duplicates are removed between passes.
+static const unsigned MIN_DIRTY_COMPACT_SIZE = 4096;
+
+/// Batched world transform update for the scene node hierarchy. Nodes marked dirty register with it, and once per frame their subtrees are gathered level by level into flat arrays (node, parent index, world transform and rotation) and updated in one linear pass, instead of lazy recursive evaluation on access. Levels with many nodes are split across worker threads.
+class ATOMIC_API TransformHierarchy
+{
+public:
+    /// Construct.
+    TransformHierarchy();
+    /// Destruct.
+    ~TransformHierarchy();
+
+    /// Register a node whose transform became dirty. Is thread-safe if threaded is true.
+    void MarkDirty(Node* node, bool threaded);
+    /// Update the world transforms of all dirty nodes of the scene. Main thread only.
+    void Update(Scene* scene, WorkQueue* queue);
+    /// Forget all registered nodes.
+    void Clear();
+
+    /// Return whether nodes have been marked dirty since the last pass.
+    bool HasDirtyNodes() const { return !dirtyNodeIDs_.Empty(); }
+    /// Return number of nodes updated by the last pass.
+    unsigned GetNumUpdatedNodes() const { return nodes_.Size(); }
+    /// Return number of hierarchy levels in the last pass.
+    unsigned GetNumLevels() const { return levelStarts_.Size() ? levelStarts_.Size() - 1 : 0; }
+
+private:
+    /// Gather the dirty subtrees in breadth-first order. Return false if nothing to update.
+    bool Gather(Scene* scene);
+    /// Update the world transforms of a range of gathered nodes, whose parents have already been updated.
+    void UpdateRange(unsigned begin, unsigned end);
+    /// Register a dirty node ID. Called with the mutex held if registering from worker threads.
+    void AddDirtyNodeID(unsigned id);
+
+    /// IDs of nodes marked dirty since the last pass. IDs instead of pointers, as nodes may be destroyed in between.
+    PODVector<unsigned> dirtyNodeIDs_;
+    /// Mutex for registering from worker threads.
+    Mutex dirtyMutex_;
+    /// Registered ID count at which duplicates are next removed.
+    unsigned compactSize_;
+    /// Gathered nodes in level order.
+    PODVector<Node*> nodes_;
+    /// Index of the parent in the gathered nodes, or -1 for the topmost dirty nodes.
+    PODVector<int> parents_;
+    /// World transforms of the gathered nodes.
+    PODVector<Matrix3x4> worldTransforms_;
+    /// World rotations of the gathered nodes.
+    PODVector<Quaternion> worldRotations_;
+    /// Start offsets of each level in the gathered nodes, followed by the total count.
+    PODVector<unsigned> levelStarts_;
+};
+
+}
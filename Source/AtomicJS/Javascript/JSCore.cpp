@@ -20,6 +20,7 @@
 // THE SOFTWARE.
 //
 
+#include <Atomic/Core/Context.h>
 #include <Atomic/Core/ProcessUtils.h>
 
 #include "JSCore.h"
@@ -180,10 +181,10 @@ static int Object_SendEvent(duk_context* ctx)
 
             if (duk_is_object(ctx, -2))
             {
-                VariantMap sendEventVMap;
-                js_object_to_variantmap(ctx, -2, sendEventVMap);
+                ScopedEventDataMap sendEventVMap(sender->GetContext());
+                js_object_to_variantmap(ctx, -2, *sendEventVMap);
 
-                sender->SendEvent(duk_to_string(ctx, -1), sendEventVMap);
+                sender->SendEvent(duk_to_string(ctx, -1), *sendEventVMap);
             } else {
                 sender->SendEvent(duk_to_string(ctx, -1));
             }
@@ -197,10 +198,10 @@ static int Object_SendEvent(duk_context* ctx)
     {
         if (duk_is_object(ctx, 1)) {
 
-            VariantMap sendEventVMap;
-            js_object_to_variantmap(ctx, 1, sendEventVMap);
+            ScopedEventDataMap sendEventVMap(sender->GetContext());
+            js_object_to_variantmap(ctx, 1, *sendEventVMap);
 
-            sender->SendEvent(duk_to_string(ctx, 0), sendEventVMap);
+            sender->SendEvent(duk_to_string(ctx, 0), *sendEventVMap);
 
         }
 
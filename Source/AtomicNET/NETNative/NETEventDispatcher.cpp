@@ -20,6 +20,7 @@
 // THE SOFTWARE.
 //
 
+#include <Atomic/Core/Context.h>
 #include <Atomic/Core/CoreEvents.h>
 #include <Atomic/Physics/PhysicsEvents.h>
 #include <Atomic/Script/ScriptPhysics.h>
@@ -55,15 +56,17 @@ namespace Atomic
 
         if (eventType == E_NODECOLLISION)
         {
-            VariantMap ncEventData = eventData;
+            // Use a pooled map, as collision events are sent in large numbers
+            ScopedEventDataMap ncEventData(context);
+            *ncEventData = eventData;
 
             SharedPtr<PhysicsNodeCollision> nodeCollison(new PhysicsNodeCollision());
             nodeCollison->SetFromNodeCollisionEvent(eventData);
-            ncEventData[StringHash("PhysicsNodeCollision")] = nodeCollison;
+            (*ncEventData)[StringHash("PhysicsNodeCollision")] = nodeCollison;
 
-            ncEventData[eventType] = ncEventData;
+            (*ncEventData)[eventType] = *ncEventData;
 
-            NETCore::DispatchEvent(sender, eventType.Value(), &ncEventData);
+            NETCore::DispatchEvent(sender, eventType.Value(), &ncEventData.Get());
 
             return;
 
@@ -145,8 +145,8 @@ namespace Atomic
                 if (varType == VAR_NONE)
                 {
                     // FIXME: We need to be able to test if a type is a ResourceRef, this isn't really the way to achieve that
-                    const HashMap<StringHash, SharedPtr<ObjectFactory>>& factories = context_->GetObjectFactories();
-                    HashMap<StringHash, SharedPtr<ObjectFactory>>::ConstIterator itr = factories.Begin();
+                    const FlatHashMap<StringHash, SharedPtr<ObjectFactory>>& factories = context_->GetObjectFactories();
+                    FlatHashMap<StringHash, SharedPtr<ObjectFactory>>::ConstIterator itr = factories.Begin();
 
                     while (itr != factories.End())
                     {
@@ -28,9 +28,6 @@
 #include <Atomic/IO/FileSystem.h>
 #include <Atomic/Container/ArrayPtr.h>
 
-#include <LZ4/lz4.h>
-#include <LZ4/lz4hc.h>
-
 #include "BuildBase.h"
 #include "ResourcePackager.h"
 
@@ -61,28 +58,30 @@ bool ResourcePackager::WritePackageFile(const String& destFilePath)
         return false;
     }
 
-    // Write ID, number of files & placeholder for checksum
-    WriteHeader(dest);
-
+    packageEntries_.Resize(resourceEntries_.Size());
     for (unsigned i = 0; i < resourceEntries_.Size(); i++)
     {
-        BuildResourceEntry* entry = resourceEntries_[i];
-
-        // Write entry (correct offset is still unknown, will be filled in later)
-        dest->WriteString(entry->packagePath_);
-        dest->WriteUInt(entry->offset_);
-        dest->WriteUInt(entry->size_);
-        dest->WriteUInt(entry->checksum_);
+        PackageEntry& packageEntry = packageEntries_[i];
+        packageEntry.offset_ = 0;
+        packageEntry.size_ = resourceEntries_[i]->size_;
+        packageEntry.checksum_ = 0;
+        packageEntry.packedSize_ = 0;
+        packageEntry.codec_ = PACKAGE_CODEC_NONE;
     }
 
+    // Write the directory (correct offsets & checksums are still unknown, will be filled in later)
+    if (!WriteDirectory(dest))
+        return false;
+
     unsigned totalDataSize = 0;
+    unsigned numDuplicates = 0;
+    HashMap<unsigned long long, unsigned> contentEntries;
 
     // Write file data, calculate checksums & correct offsets
     for (unsigned i = 0; i < resourceEntries_.Size(); i++)
     {
         BuildResourceEntry* entry = resourceEntries_[i];
-
-        entry->offset_ = dest->GetSize();
+        PackageEntry& packageEntry = packageEntries_[i];
 
         File srcFile(context_, entry->absolutePath_);
         if (!srcFile.IsOpen())
@@ -109,80 +108,74 @@ bool ResourcePackager::WritePackageFile(const String& destFilePath)
             entry->checksum_ = SDBMHash(entry->checksum_, buffer[j]);
         }
 
-        // might not want to compress for WebGL
-        //if (!compress_)
-        //{
-        //    PrintLine(entries_[i].name_ + " size " + String(dataSize));
-        //    dest.Write(&buffer[0], entries_[i].size_);
-        //}
-        //else
-        //{
-
-        unsigned compressedBlockSize_ = 32768;
+        packageEntry.checksum_ = entry->checksum_;
 
-        SharedArrayPtr<unsigned char> compressBuffer(new unsigned char[LZ4_compressBound(compressedBlockSize_)]);
+        // Store identical contents only once
+        unsigned original = PackageFile::FindDuplicateEntry(packageEntries_, i, &buffer[0], contentEntries);
+        if (original != M_MAX_UNSIGNED)
+        {
+            entry->offset_ = packageEntry.offset_;
+            numDuplicates++;
+            buildBase_->BuildLog(entry->absolutePath_ + " same as " + resourceEntries_[original]->absolutePath_, false);
+            continue;
+        }
 
-        unsigned pos = 0;
-        unsigned totalPackedBytes = 0;
+        entry->offset_ = packageEntry.offset_ = dest->GetSize();
 
-        while (pos < dataSize)
+        VectorBuffer packed;
+        packageEntry.codec_ = PACKAGE_CODEC_LZ4HC;
+        if (!PackageFile::CompressEntry(&buffer[0], dataSize, packageEntry.codec_, packed))
         {
-            unsigned unpackedSize = compressedBlockSize_;
-            if (pos + unpackedSize > dataSize)
-                unpackedSize = dataSize - pos;
-
-            unsigned packedSize = LZ4_compressHC((const char*)&buffer[pos], (char*)compressBuffer.Get(), unpackedSize);
-            if (!packedSize)
-            {
-                buildBase_->FailBuild(ToString("LZ4 compression failed for file %s at offset %u", entry->absolutePath_.CString(), pos));
-                return false;
-            }
-
-            dest->WriteUShort(unpackedSize);
-            dest->WriteUShort(packedSize);
-            dest->Write(compressBuffer.Get(), packedSize);
-            totalPackedBytes += 6 + packedSize;
-
-            pos += unpackedSize;
+            buildBase_->FailBuild("LZ4 compression failed for file " + entry->absolutePath_);
+            return false;
         }
 
-        buildBase_->BuildLog(entry->absolutePath_ + " in " + String(dataSize) + " out " + String(totalPackedBytes), false);
+        if (packageEntry.codec_ == PACKAGE_CODEC_NONE)
+        {
+            dest->Write(&buffer[0], dataSize);
+            packageEntry.packedSize_ = dataSize;
+            buildBase_->BuildLog(entry->absolutePath_ + " size " + String(dataSize), false);
         }
-    //}
+        else
+        {
+            dest->Write(packed.GetData(), packed.GetSize());
+            packageEntry.packedSize_ = packed.GetSize();
+            buildBase_->BuildLog(entry->absolutePath_ + " in " + String(dataSize) + " out " + String(packed.GetSize()), false);
+        }
+    }
 
     // Write package size to the end of file to allow finding it linked to an executable file
     unsigned currentSize = dest->GetSize();
     dest->WriteUInt(currentSize + sizeof(unsigned));
 
-    // Write header again with correct offsets & checksums
+    // Write the directory again with correct offsets & checksums
     dest->Seek(0);
-    WriteHeader(dest);
-
-    for (unsigned i = 0; i < resourceEntries_.Size(); i++)
-    {
-        BuildResourceEntry* entry = resourceEntries_[i];
-
-        dest->WriteString(entry->packagePath_);
-        dest->WriteUInt(entry->offset_);
-        dest->WriteUInt(entry->size_);
-        dest->WriteUInt(entry->checksum_);
-    }
+    if (!WriteDirectory(dest))
+        return false;
 
     buildBase_->BuildLog("Resource Package:");
     buildBase_->BuildLog("Number of files " + String(resourceEntries_.Size()));
+    buildBase_->BuildLog("Duplicate files " + String(numDuplicates));
     buildBase_->BuildLog("File data size " + String(totalDataSize));
     buildBase_->BuildLog("Package size " + String(dest->GetSize()));
 
     return true;
 }
 
-void ResourcePackager::WriteHeader(File* dest)
+bool ResourcePackager::WriteDirectory(File* dest)
 {
-    dest->WriteFileID("ULZ4");
-    dest->WriteUInt(resourceEntries_.Size());
-    dest->WriteUInt(checksum_);
-}
+    Vector<String> names;
+    for (unsigned i = 0; i < resourceEntries_.Size(); i++)
+        names.Push(resourceEntries_[i]->packagePath_);
 
+    if (!PackageFile::WriteDirectory(*dest, names, packageEntries_, checksum_))
+    {
+        buildBase_->FailBuild("Could not write package directory to " + dest->GetName());
+        return false;
+    }
+
+    return true;
+}
 
 void ResourcePackager::GeneratePackage(const String& destFilePath)
 {
@@ -25,6 +25,8 @@
 #include <Atomic/Core/Object.h>
 #include "Atomic/Container/Vector.h"
 #include <Atomic/IO/File.h>
+#include <Atomic/IO/PackageFile.h>
+#include <Atomic/IO/VectorBuffer.h>
 
 #include "BuildTypes.h"
 
@@ -50,10 +52,11 @@ public:
 
 private:
 
-    void WriteHeader(File* dest);
+    bool WriteDirectory(File* dest);
     bool WritePackageFile(const String& destFilePath);
 
     PODVector<BuildResourceEntry*> resourceEntries_;
+    PODVector<PackageEntry> packageEntries_;
 
     WeakPtr<BuildBase> buildBase_;
 
@@ -109,6 +109,7 @@ bool localIDs_ = false;
 bool saveBinary_ = false;
 bool createZone_ = true;
 bool noAnimations_ = false;
+bool compressAnimations_ = false;
 bool noHierarchy_ = false;
 bool noMaterials_ = false;
 bool noTextures_ = false;
@@ -224,6 +225,7 @@ void Run(const Vector<String>& arguments)
             "-i          Use local ID's for scene nodes\n"
             "-l          Output a material list file for models\n"
             "-na         Do not output animations\n"
+            "-ca         Save animations in the compressed format with quantized keyframes\n"
             "-nm         Do not output materials\n"
             "-nt         Do not output material textures\n"
             "-nc         Do not use material diffuse color value, instead output white\n"
@@ -389,6 +391,8 @@ void Run(const Vector<String>& arguments)
                 noOverwriteNewerTexture_ = true;
             else if (argument == "am")
                 checkUniqueModel_ = false;
+            else if (argument == "ca")
+                compressAnimations_ = true;
         }
     }
     
@@ -1197,6 +1201,8 @@ void BuildAndSaveAnimations(OutModel* model)
         }
         
         outAnim->SetTracks(tracks);
+        if (compressAnimations_)
+            outAnim->Compress();
         
         File outFile(context_);
         if (!outFile.Open(animOutName, FILE_WRITE))
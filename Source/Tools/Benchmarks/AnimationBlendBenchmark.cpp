@@ -0,0 +1,141 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Atomic/Core/ProcessUtils.h>
+#include <Atomic/Core/Timer.h>
+#include <Atomic/Math/MathSIMD.h>
+#include <Atomic/Math/Random.h>
+
+#include "Benchmarks.h"
+
+#include <Atomic/DebugNew.h>
+
+/// Sampled animation channels of a set of tracks, laid out like AnimationChannelSamples.
+struct BlendChannels
+{
+    /// Resize all channels.
+    void Resize(unsigned count)
+    {
+        positionsFrom_.Resize(count);
+        positionsTo_.Resize(count);
+        rotationsFrom_.Resize(count);
+        rotationsTo_.Resize(count);
+        factors_.Resize(count);
+        weights_.Resize(count);
+    }
+
+    /// Key frame positions before the sample time.
+    PODVector<Vector3> positionsFrom_;
+    /// Key frame positions after the sample time.
+    PODVector<Vector3> positionsTo_;
+    /// Key frame rotations before the sample time.
+    PODVector<Quaternion> rotationsFrom_;
+    /// Key frame rotations after the sample time.
+    PODVector<Quaternion> rotationsTo_;
+    /// Interpolation factors between the key frames.
+    PODVector<float> factors_;
+    /// Blend weights.
+    PODVector<float> weights_;
+};
+
+static Quaternion GetRandomRotation()
+{
+    return Quaternion(Random(-180.0f, 180.0f), Random(-180.0f, 180.0f), Random(-180.0f, 180.0f));
+}
+
+void RunAnimationBlendBenchmark(const BenchmarkSettings& settings)
+{
+    PrintLine("  Tracks  Scalar(ms)  SIMD(ms)  Speedup");
+
+    PODVector<unsigned> counts = GetObjectCounts(settings);
+    for (unsigned c = 0; c < counts.Size(); ++c)
+    {
+        unsigned numTracks = counts[c];
+
+        SetRandomSeed(1);
+        BlendChannels channels;
+        channels.Resize(numTracks);
+        PODVector<Vector3> initialPositions(numTracks);
+        PODVector<Quaternion> initialRotations(numTracks);
+        for (unsigned i = 0; i < numTracks; ++i)
+        {
+            channels.positionsFrom_[i] = Vector3(Random(-1.0f, 1.0f), Random(-1.0f, 1.0f), Random(-1.0f, 1.0f));
+            channels.positionsTo_[i] = Vector3(Random(-1.0f, 1.0f), Random(-1.0f, 1.0f), Random(-1.0f, 1.0f));
+            channels.rotationsFrom_[i] = GetRandomRotation();
+            channels.rotationsTo_[i] = GetRandomRotation();
+            channels.factors_[i] = Random(1.0f);
+            channels.weights_[i] = Random(1.0f);
+            initialPositions[i] = Vector3(Random(-1.0f, 1.0f), Random(-1.0f, 1.0f), Random(-1.0f, 1.0f));
+            initialRotations[i] = GetRandomRotation();
+        }
+
+        // Interpolate between the key frames, then blend onto the current bone transforms, as two animation states would
+        PODVector<Vector3> scalarPositions;
+        PODVector<Quaternion> scalarRotations;
+        HiresTimer timer;
+        long long scalarUSec = 0;
+        for (unsigned i = 0; i < settings.iterations_; ++i)
+        {
+            scalarPositions = initialPositions;
+            scalarRotations = initialRotations;
+            timer.Reset();
+            for (unsigned j = 0; j < numTracks; ++j)
+            {
+                Vector3 position = channels.positionsFrom_[j].Lerp(channels.positionsTo_[j], channels.factors_[j]);
+                Quaternion rotation = channels.rotationsFrom_[j].Slerp(channels.rotationsTo_[j], channels.factors_[j]);
+                scalarPositions[j] = scalarPositions[j].Lerp(position, channels.weights_[j]);
+                scalarRotations[j] = scalarRotations[j].Slerp(rotation, channels.weights_[j]);
+            }
+            scalarUSec += timer.GetUSec(false);
+        }
+
+        PODVector<Vector3> simdPositions;
+        PODVector<Quaternion> simdRotations;
+        PODVector<Vector3> sampledPositions(numTracks);
+        PODVector<Quaternion> sampledRotations(numTracks);
+        long long simdUSec = 0;
+        for (unsigned i = 0; i < settings.iterations_; ++i)
+        {
+            simdPositions = initialPositions;
+            simdRotations = initialRotations;
+            timer.Reset();
+            LerpVectors(&channels.positionsFrom_[0], &channels.positionsTo_[0], &channels.factors_[0], &sampledPositions[0],
+                numTracks);
+            SlerpQuaternions(&channels.rotationsFrom_[0], &channels.rotationsTo_[0], &channels.factors_[0],
+                &sampledRotations[0], numTracks);
+            LerpVectors(&simdPositions[0], &sampledPositions[0], &channels.weights_[0], &simdPositions[0], numTracks);
+            SlerpQuaternions(&simdRotations[0], &sampledRotations[0], &channels.weights_[0], &simdRotations[0], numTracks);
+            simdUSec += timer.GetUSec(false);
+        }
+
+        for (unsigned i = 0; i < numTracks; ++i)
+        {
+            if (simdPositions[i] != scalarPositions[i] || simdRotations[i] != scalarRotations[i])
+                ErrorExit("SIMD blending results differ from Vector3::Lerp and Quaternion::Slerp");
+        }
+
+        float scalarMs = GetAverageMs(scalarUSec, settings.iterations_);
+        float simdMs = GetAverageMs(simdUSec, settings.iterations_);
+        PrintLine(FormatRow("%8u  %10.3f  %8.3f  %6.2fx", numTracks, scalarMs, simdMs, simdMs > 0.0f ? scalarMs / simdMs : 0.0f));
+    }
+}
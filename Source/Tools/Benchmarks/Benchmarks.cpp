@@ -0,0 +1,176 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Atomic/Atomic.h>
+
+#include <Atomic/Core/ProcessUtils.h>
+#include <Atomic/Core/StringUtils.h>
+#include <Atomic/Core/Timer.h>
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include "Benchmarks.h"
+
+#include <cstdarg>
+#include <cstdio>
+
+#include <Atomic/DebugNew.h>
+
+/// Registered benchmark.
+struct Benchmark
+{
+    /// Name used on the command line.
+    const char* name_;
+    /// Description.
+    const char* description_;
+    /// Benchmark function.
+    void (*function_)(const BenchmarkSettings& settings);
+};
+
+static const Benchmark benchmarks_[] =
+{
+    { "workqueue", "WorkQueue ParallelFor, work items and task graph for 1..N threads", RunWorkQueueBenchmark },
+    { "frustum", "Frustum and PackedFrustum bounding box culling for 1..N objects", RunFrustumBenchmark },
+    { "spatial", "DynamicBVH and Octree updates, frustum and box queries for 1..N moving drawables", RunSpatialIndexBenchmark },
+    { "blend", "Scalar and SIMD animation position and rotation blending for 1..N tracks", RunAnimationBlendBenchmark },
+    { "commands", "Render command recording with redundant state elimination and null backend replay for 1..N draws", RunRenderCommandBenchmark },
+    { "occlusion", "Occlusion buffer rasterization, depth hierarchy and occludee tests for 1..N threads", RunOcclusionBenchmark },
+    { "particles", "Particle emitter simulation updates for 1..N particles", RunParticleBenchmark },
+    { "events", "Scene update dispatch through SendEvent and a typed EventChannel for 1..N receivers", RunEventDispatchBenchmark },
+    { "hashmap", "HashMap and FlatHashMap insert, find, iterate and erase for 1..N keys", RunHashMapBenchmark },
+    { "sort", "Batch queue radix sorting back to front and front to back against a comparison sort for 1..N batches", RunSortBenchmark },
+    { 0, 0, 0 }
+};
+
+int main(int argc, char** argv);
+void Run(const Vector<String>& arguments);
+
+int main(int argc, char** argv)
+{
+    Vector<String> arguments;
+
+    #ifdef WIN32
+    arguments = ParseArguments(GetCommandLineW());
+    #else
+    arguments = ParseArguments(argc, argv);
+    #endif
+
+    Run(arguments);
+    return 0;
+}
+
+void Run(const Vector<String>& arguments)
+{
+    BenchmarkSettings settings;
+    settings.maxThreads_ = Max(GetNumLogicalCPUs(), 1U);
+    settings.maxObjects_ = 100000;
+    settings.iterations_ = 10;
+
+    String name;
+    for (unsigned i = 0; i < arguments.Size(); ++i)
+    {
+        if (arguments[i].Length() > 1 && arguments[i][0] == '-')
+        {
+            String value = i + 1 < arguments.Size() ? arguments[i + 1] : String::EMPTY;
+            switch (arguments[i][1])
+            {
+            case 't':
+                settings.maxThreads_ = Max(ToUInt(value), 1U);
+                ++i;
+                break;
+
+            case 'o':
+                settings.maxObjects_ = Max(ToUInt(value), 1U);
+                ++i;
+                break;
+
+            case 'i':
+                settings.iterations_ = Max(ToUInt(value), 1U);
+                ++i;
+                break;
+
+            default:
+                ErrorExit("Unknown option " + arguments[i]);
+            }
+        }
+        else
+            name = arguments[i];
+    }
+
+    if (name == "help")
+    {
+        String usage =
+            "Usage: Benchmarks [benchmark] [options]\n"
+            "\n"
+            "Runs all benchmarks unless one is named. Timings are averages per iteration.\n"
+            "\n"
+            "Options:\n"
+            "-t <n>  Maximum number of threads, default is the number of logical CPUs\n"
+            "-o <n>  Maximum number of objects, default 100000\n"
+            "-i <n>  Iterations per measurement, default 10\n"
+            "\n"
+            "Benchmarks:\n";
+        for (const Benchmark* benchmark = benchmarks_; benchmark->name_; ++benchmark)
+            usage += FormatRow("%-12s %s\n", benchmark->name_, benchmark->description_);
+        PrintLine(usage);
+        return;
+    }
+
+    // The time subsystem initializes the high-resolution timer frequency
+    SharedPtr<Context> context(new Context());
+    context->RegisterSubsystem(new Time(context));
+
+    bool found = false;
+    for (const Benchmark* benchmark = benchmarks_; benchmark->name_; ++benchmark)
+    {
+        if (name.Empty() || name == benchmark->name_)
+        {
+            PrintLine(String("\n") + benchmark->name_ + ": " + benchmark->description_);
+            benchmark->function_(settings);
+            found = true;
+        }
+    }
+
+    if (!found)
+        ErrorExit("Unknown benchmark " + name + ", run with 'help' for the list");
+}
+
+PODVector<unsigned> GetObjectCounts(const BenchmarkSettings& settings)
+{
+    PODVector<unsigned> counts;
+    for (unsigned count = 1000; count < settings.maxObjects_ && count <= M_MAX_UNSIGNED / 10; count *= 10)
+        counts.Push(count);
+    counts.Push(settings.maxObjects_);
+    return counts;
+}
+
+String FormatRow(const char* format, ...)
+{
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof buffer, format, args);
+    va_end(args);
+    return String(buffer);
+}
@@ -0,0 +1,69 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Atomic/Container/Vector.h>
+#include <Atomic/Core/Context.h>
+
+using namespace Atomic;
+
+/// Settings shared by all benchmarks.
+struct BenchmarkSettings
+{
+    /// Maximum number of threads to scale up to.
+    unsigned maxThreads_;
+    /// Maximum number of objects to scale up to.
+    unsigned maxObjects_;
+    /// Number of timed iterations per measurement.
+    unsigned iterations_;
+};
+
+/// Measure WorkQueue ParallelFor, work item and task graph throughput for 1..N threads.
+void RunWorkQueueBenchmark(const BenchmarkSettings& settings);
+/// Measure scalar and packed frustum culling of bounding boxes for 1..N objects.
+void RunFrustumBenchmark(const BenchmarkSettings& settings);
+/// Measure DynamicBVH against Octree updates and queries for 1..N moving drawables.
+void RunSpatialIndexBenchmark(const BenchmarkSettings& settings);
+/// Measure scalar and SIMD animation track interpolation and blending for 1..N tracks.
+void RunAnimationBlendBenchmark(const BenchmarkSettings& settings);
+/// Measure render command recording with redundant state elimination and null backend replay for 1..N draws.
+void RunRenderCommandBenchmark(const BenchmarkSettings& settings);
+/// Measure occlusion buffer rasterization, depth hierarchy building and occludee tests for 1..N threads.
+void RunOcclusionBenchmark(const BenchmarkSettings& settings);
+/// Measure particle emitter updates through the octree's threaded drawable update for 1..N particles.
+void RunParticleBenchmark(const BenchmarkSettings& settings);
+/// Measure scene update dispatch through Object::SendEvent against a typed EventChannel for 1..N receivers.
+void RunEventDispatchBenchmark(const BenchmarkSettings& settings);
+/// Measure HashMap against FlatHashMap inserts, finds, iteration and erases for 1..N keys.
+void RunHashMapBenchmark(const BenchmarkSettings& settings);
+/// Measure batch queue radix sorting against a comparison sort for 1..N batches.
+void RunSortBenchmark(const BenchmarkSettings& settings);
+
+/// Return the object counts to measure: powers of ten from 1000, followed by the maximum.
+PODVector<unsigned> GetObjectCounts(const BenchmarkSettings& settings);
+
+/// Format a string with printf syntax. Unlike ToString() this supports field widths for aligned table output.
+String FormatRow(const char* format, ...);
+
+/// Return the average of a timed span in milliseconds.
+inline float GetAverageMs(long long usec, unsigned iterations) { return (float)usec / (1000.0f * (float)Max(iterations, 1U)); }
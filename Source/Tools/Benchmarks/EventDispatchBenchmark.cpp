@@ -0,0 +1,133 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Atomic/Core/EventChannel.h>
+#include <Atomic/Core/ProcessUtils.h>
+#include <Atomic/Core/Timer.h>
+#include <Atomic/Scene/Scene.h>
+#include <Atomic/Scene/SceneEvents.h>
+
+#include "Benchmarks.h"
+
+#include <Atomic/DebugNew.h>
+
+/// Timestep sent with each update.
+static const float EVENT_TIME_STEP = 1.0f / 60.0f;
+/// Number of sends of an event without receivers per iteration.
+static const unsigned NUM_EMPTY_SENDS = 100000;
+
+/// Receiver of the scene update event and channel that accumulates the timesteps, like a LogicComponent.
+class BenchmarkReceiver : public Object
+{
+    ATOMIC_OBJECT(BenchmarkReceiver, Object);
+
+public:
+    /// Construct.
+    BenchmarkReceiver(Context* context) :
+        Object(context),
+        elapsedTime_(0.0f)
+    {
+    }
+
+    /// Subscribe to the scene update event of a sender.
+    void SubscribeToSceneUpdate(Object* sender)
+    {
+        SubscribeToEvent(sender, E_SCENEUPDATE, ATOMIC_HANDLER(BenchmarkReceiver, HandleSceneUpdate));
+    }
+
+    /// Handle the scene update event.
+    void HandleSceneUpdate(StringHash eventType, VariantMap& eventData)
+    {
+        using namespace SceneUpdate;
+        elapsedTime_ += eventData[P_TIMESTEP].GetFloat();
+    }
+
+    /// Handle the scene update channel.
+    void HandleSceneUpdateChannel(const SceneUpdateEventData& data) { elapsedTime_ += data.timeStep_; }
+
+    /// Accumulated timesteps.
+    float elapsedTime_;
+};
+
+void RunEventDispatchBenchmark(const BenchmarkSettings& settings)
+{
+    SharedPtr<Context> context(new Context());
+
+    PrintLine("Receivers  SendEvent(ms)  Channel(ms)  Speedup  Unsubscribed(ns)");
+
+    PODVector<unsigned> counts = GetObjectCounts(settings);
+    for (unsigned c = 0; c < counts.Size(); ++c)
+    {
+        unsigned numReceivers = counts[c];
+
+        // The sender stands in for the scene, which LogicComponents subscribe to specifically
+        SharedPtr<BenchmarkReceiver> sender(new BenchmarkReceiver(context));
+        EventChannel<SceneUpdateEventData> channel;
+        Vector<SharedPtr<BenchmarkReceiver> > receivers(numReceivers);
+        for (unsigned i = 0; i < numReceivers; ++i)
+        {
+            receivers[i] = new BenchmarkReceiver(context);
+            receivers[i]->SubscribeToSceneUpdate(sender);
+            channel.Subscribe(receivers[i].Get(), &BenchmarkReceiver::HandleSceneUpdateChannel);
+        }
+
+        HiresTimer timer;
+        for (unsigned i = 0; i < settings.iterations_; ++i)
+        {
+            using namespace SceneUpdate;
+
+            VariantMap& eventData = sender->GetEventDataMap();
+            eventData[P_SCENE] = (Scene*)0;
+            eventData[P_TIMESTEP] = EVENT_TIME_STEP;
+            sender->SendEvent(E_SCENEUPDATE, eventData);
+        }
+        float sendEventMs = GetAverageMs(timer.GetUSec(true), settings.iterations_);
+
+        for (unsigned i = 0; i < settings.iterations_; ++i)
+        {
+            SceneUpdateEventData data;
+            data.scene_ = 0;
+            data.timeStep_ = EVENT_TIME_STEP;
+            channel.Send(data);
+        }
+        float channelMs = GetAverageMs(timer.GetUSec(true), settings.iterations_);
+
+        // Events nobody listens to, such as the post-update of a sender without receivers, take the early out
+        for (unsigned i = 0; i < settings.iterations_; ++i)
+        {
+            for (unsigned j = 0; j < NUM_EMPTY_SENDS; ++j)
+                sender->SendEvent(E_SCENEPOSTUPDATE);
+        }
+        float unsubscribedNs = GetAverageMs(timer.GetUSec(true), settings.iterations_) * 1000000.0f / NUM_EMPTY_SENDS;
+
+        // Both paths must have delivered every update to every receiver
+        float expectedTime = 2.0f * settings.iterations_ * EVENT_TIME_STEP;
+        for (unsigned i = 0; i < numReceivers; ++i)
+        {
+            if (!Equals(receivers[i]->elapsedTime_, expectedTime))
+                ErrorExit("Event channel and SendEvent deliveries differ");
+        }
+
+        PrintLine(FormatRow("%9u  %13.3f  %11.3f  %6.2fx  %16.2f", numReceivers, sendEventMs, channelMs,
+            channelMs > 0.0f ? sendEventMs / channelMs : 0.0f, unsubscribedNs));
+    }
+}
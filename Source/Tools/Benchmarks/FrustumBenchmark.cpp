@@ -0,0 +1,96 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Atomic/Core/ProcessUtils.h>
+#include <Atomic/Core/Timer.h>
+#include <Atomic/Math/Frustum.h>
+#include <Atomic/Math/MathSIMD.h>
+#include <Atomic/Math/Random.h>
+
+#include "Benchmarks.h"
+
+#include <Atomic/DebugNew.h>
+
+/// Half extent of the cube the boxes are scattered in.
+static const float FRUSTUM_SCENE_SIZE = 500.0f;
+
+void RunFrustumBenchmark(const BenchmarkSettings& settings)
+{
+    // A camera at the origin looking along +Z sees roughly a tenth of the boxes
+    Frustum frustum;
+    frustum.Define(60.0f, 16.0f / 9.0f, 1.0f, 0.1f, FRUSTUM_SCENE_SIZE, Matrix3x4::IDENTITY);
+    PackedFrustum packedFrustum(frustum);
+
+    PrintLine(" Objects  Frustum(ms)  Packed(ms)  PackedArray(ms)  Speedup  Visible");
+
+    PODVector<unsigned> counts = GetObjectCounts(settings);
+    for (unsigned c = 0; c < counts.Size(); ++c)
+    {
+        unsigned numObjects = counts[c];
+
+        SetRandomSeed(1);
+        PODVector<BoundingBox> boxes(numObjects);
+        PODVector<Intersection> results(numObjects);
+        for (unsigned i = 0; i < numObjects; ++i)
+        {
+            Vector3 center(Random(-FRUSTUM_SCENE_SIZE, FRUSTUM_SCENE_SIZE), Random(-FRUSTUM_SCENE_SIZE, FRUSTUM_SCENE_SIZE),
+                Random(-FRUSTUM_SCENE_SIZE, FRUSTUM_SCENE_SIZE));
+            Vector3 halfSize(Random(0.5f, 5.0f), Random(0.5f, 5.0f), Random(0.5f, 5.0f));
+            boxes[i] = BoundingBox(center - halfSize, center + halfSize);
+        }
+
+        // Count the visible boxes of each variant, which also keeps the tests from being optimized away
+        unsigned scalarVisible = 0;
+        unsigned packedVisible = 0;
+        unsigned arrayVisible = 0;
+
+        HiresTimer timer;
+        for (unsigned i = 0; i < settings.iterations_; ++i)
+        {
+            for (unsigned j = 0; j < numObjects; ++j)
+                scalarVisible += frustum.IsInside(boxes[j]) != OUTSIDE;
+        }
+        float scalarMs = GetAverageMs(timer.GetUSec(true), settings.iterations_);
+
+        for (unsigned i = 0; i < settings.iterations_; ++i)
+        {
+            for (unsigned j = 0; j < numObjects; ++j)
+                packedVisible += packedFrustum.IsInside(boxes[j]) != OUTSIDE;
+        }
+        float packedMs = GetAverageMs(timer.GetUSec(true), settings.iterations_);
+
+        for (unsigned i = 0; i < settings.iterations_; ++i)
+        {
+            packedFrustum.IsInside(&boxes[0], numObjects, &results[0]);
+            for (unsigned j = 0; j < numObjects; ++j)
+                arrayVisible += results[j] != OUTSIDE;
+        }
+        float arrayMs = GetAverageMs(timer.GetUSec(true), settings.iterations_);
+
+        if (packedVisible != scalarVisible || arrayVisible != scalarVisible)
+            ErrorExit("Packed frustum results differ from Frustum");
+
+        PrintLine(FormatRow("%8u  %11.3f  %10.3f  %15.3f  %6.2fx  %7u", numObjects, scalarMs, packedMs, arrayMs,
+            arrayMs > 0.0f ? scalarMs / arrayMs : 0.0f, scalarVisible / settings.iterations_));
+    }
+}
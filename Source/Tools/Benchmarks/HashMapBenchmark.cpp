@@ -0,0 +1,121 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Atomic/Container/FlatHashMap.h>
+#include <Atomic/Container/HashMap.h>
+#include <Atomic/Core/ProcessUtils.h>
+#include <Atomic/Core/Timer.h>
+#include <Atomic/Math/Random.h>
+
+#include "Benchmarks.h"
+
+#include <Atomic/DebugNew.h>
+
+/// Timings of one map type at one element count.
+struct HashMapTimings
+{
+    /// Average milliseconds to insert all keys into an empty map.
+    float insertMs_;
+    /// Average milliseconds to find all keys and as many missing keys.
+    float findMs_;
+    /// Average milliseconds to iterate all pairs.
+    float iterateMs_;
+    /// Average milliseconds to erase all keys.
+    float eraseMs_;
+    /// Sum of found and iterated values, for comparing the map types.
+    unsigned long long checksum_;
+};
+
+/// Measure a map type with the given keys. Odd keys are never inserted and are used for missed finds.
+template <class MapType> static HashMapTimings MeasureHashMap(const PODVector<unsigned>& keys, const BenchmarkSettings& settings)
+{
+    HashMapTimings timings;
+    timings.checksum_ = 0;
+    long long insertUSec = 0;
+    long long findUSec = 0;
+    long long iterateUSec = 0;
+    long long eraseUSec = 0;
+
+    HiresTimer timer;
+    for (unsigned i = 0; i < settings.iterations_; ++i)
+    {
+        MapType map;
+
+        timer.Reset();
+        for (unsigned j = 0; j < keys.Size(); ++j)
+            map[keys[j] & ~1U] = j;
+        insertUSec += timer.GetUSec(true);
+
+        for (unsigned j = 0; j < keys.Size(); ++j)
+        {
+            typename MapType::ConstIterator found = map.Find(keys[j] & ~1U);
+            if (found != map.End())
+                timings.checksum_ += found->second_;
+            timings.checksum_ += map.Contains(keys[j] | 1U);
+        }
+        findUSec += timer.GetUSec(true);
+
+        for (typename MapType::ConstIterator j = map.Begin(); j != map.End(); ++j)
+            timings.checksum_ += j->second_;
+        iterateUSec += timer.GetUSec(true);
+
+        for (unsigned j = 0; j < keys.Size(); ++j)
+            map.Erase(keys[j] & ~1U);
+        eraseUSec += timer.GetUSec(true);
+
+        if (!map.Empty())
+            ErrorExit("Map is not empty after erasing all keys");
+    }
+
+    timings.insertMs_ = GetAverageMs(insertUSec, settings.iterations_);
+    timings.findMs_ = GetAverageMs(findUSec, settings.iterations_);
+    timings.iterateMs_ = GetAverageMs(iterateUSec, settings.iterations_);
+    timings.eraseMs_ = GetAverageMs(eraseUSec, settings.iterations_);
+    return timings;
+}
+
+void RunHashMapBenchmark(const BenchmarkSettings& settings)
+{
+    PrintLine(" Objects  Map           Insert(ms)  Find(ms)  Iterate(ms)  Erase(ms)");
+
+    PODVector<unsigned> counts = GetObjectCounts(settings);
+    for (unsigned c = 0; c < counts.Size(); ++c)
+    {
+        unsigned numObjects = counts[c];
+
+        // Random keys, like node and component IDs after many scene edits
+        SetRandomSeed(1);
+        PODVector<unsigned> keys(numObjects);
+        for (unsigned i = 0; i < numObjects; ++i)
+            keys[i] = ((unsigned)Rand() << 16) ^ (unsigned)Rand();
+
+        HashMapTimings hashTimings = MeasureHashMap<HashMap<unsigned, unsigned> >(keys, settings);
+        HashMapTimings flatTimings = MeasureHashMap<FlatHashMap<unsigned, unsigned> >(keys, settings);
+        if (hashTimings.checksum_ != flatTimings.checksum_)
+            ErrorExit("FlatHashMap results differ from HashMap");
+
+        PrintLine(FormatRow("%8u  HashMap      %10.3f  %8.3f  %11.3f  %9.3f", numObjects, hashTimings.insertMs_,
+            hashTimings.findMs_, hashTimings.iterateMs_, hashTimings.eraseMs_));
+        PrintLine(FormatRow("%8s  FlatHashMap  %10.3f  %8.3f  %11.3f  %9.3f", "", flatTimings.insertMs_,
+            flatTimings.findMs_, flatTimings.iterateMs_, flatTimings.eraseMs_));
+    }
+}
@@ -0,0 +1,151 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Atomic/Core/ProcessUtils.h>
+#include <Atomic/Core/Timer.h>
+#include <Atomic/Core/WorkQueue.h>
+#include <Atomic/Graphics/Camera.h>
+#include <Atomic/Graphics/OcclusionBuffer.h>
+#include <Atomic/Math/Random.h>
+#include <Atomic/Scene/Node.h>
+
+#include "Benchmarks.h"
+
+#include <Atomic/DebugNew.h>
+
+/// Occlusion buffer width, matching the renderer default.
+static const int OCCLUSION_BUFFER_WIDTH = 256;
+/// Occlusion buffer height for a 16:9 view.
+static const int OCCLUSION_BUFFER_HEIGHT = 144;
+/// Number of box occluders rasterized each frame.
+static const unsigned NUM_OCCLUDERS = 1000;
+/// Distance the occluders and occludees are scattered to in front of the camera.
+static const float OCCLUSION_SCENE_DEPTH = 500.0f;
+
+/// Return the corners of the 12 triangles of a unit cube centered at the origin.
+static PODVector<Vector3> GetCubeTriangles()
+{
+    static const unsigned indices[] =
+    {
+        0, 3, 1, 0, 2, 3,  4, 7, 6, 4, 5, 7,  0, 5, 4, 0, 1, 5,
+        2, 7, 3, 2, 6, 7,  0, 6, 2, 0, 4, 6,  1, 7, 5, 1, 3, 7
+    };
+
+    PODVector<Vector3> vertices;
+    for (unsigned i = 0; i < sizeof indices / sizeof indices[0]; ++i)
+    {
+        unsigned corner = indices[i];
+        vertices.Push(Vector3(corner & 1 ? 0.5f : -0.5f, corner & 2 ? 0.5f : -0.5f, corner & 4 ? 0.5f : -0.5f));
+    }
+    return vertices;
+}
+
+/// Return a random box in front of a camera at the origin looking along +Z.
+static BoundingBox GetRandomBox(float minDistance, float minHalfSize, float maxHalfSize)
+{
+    float z = Random(minDistance, OCCLUSION_SCENE_DEPTH);
+    Vector3 center(Random(-z, z) * 0.5f, Random(-z, z) * 0.3f, z);
+    Vector3 halfSize(Random(minHalfSize, maxHalfSize), Random(minHalfSize, maxHalfSize), Random(minHalfSize, maxHalfSize));
+    return BoundingBox(center - halfSize, center + halfSize);
+}
+
+void RunOcclusionBenchmark(const BenchmarkSettings& settings)
+{
+    // Fixed occluders and occludees, so that every thread count renders and tests the same scene. Occluders are kept away
+    // from the camera, as a few close ones would cover the whole buffer
+    SetRandomSeed(1);
+    PODVector<Vector3> cube = GetCubeTriangles();
+    PODVector<Matrix3x4> occluders(NUM_OCCLUDERS);
+    for (unsigned i = 0; i < NUM_OCCLUDERS; ++i)
+    {
+        BoundingBox box = GetRandomBox(100.0f, 2.0f, 10.0f);
+        occluders[i] = Matrix3x4(box.Center(), Quaternion::IDENTITY, box.Size());
+    }
+    PODVector<BoundingBox> occludees(settings.maxObjects_);
+    for (unsigned i = 0; i < occludees.Size(); ++i)
+        occludees[i] = GetRandomBox(10.0f, 0.5f, 2.0f);
+
+    PODVector<int> baseDepths;
+    unsigned baseVisible = 0;
+
+    PrintLine(FormatRow("%u occluders, %u occludees, %dx%d buffer", NUM_OCCLUDERS, occludees.Size(), OCCLUSION_BUFFER_WIDTH,
+        OCCLUSION_BUFFER_HEIGHT));
+    PrintLine("Threads  Draw(ms)  Hierarchy(ms)  Test(ms)  Visible");
+
+    for (unsigned numThreads = 1; numThreads <= settings.maxThreads_; ++numThreads)
+    {
+        // Worker threads can only be created once per queue, so use a fresh context for each thread count
+        SharedPtr<Context> context(new Context());
+        WorkQueue* queue = new WorkQueue(context);
+        context->RegisterSubsystem(queue);
+        queue->CreateThreads(numThreads - 1);
+        context->RegisterFactory<Camera>();
+
+        SharedPtr<Node> cameraNode(new Node(context));
+        Camera* camera = cameraNode->CreateComponent<Camera>();
+        camera->SetFarClip(OCCLUSION_SCENE_DEPTH * 2.0f);
+        camera->SetAspectRatio((float)OCCLUSION_BUFFER_WIDTH / (float)OCCLUSION_BUFFER_HEIGHT);
+
+        SharedPtr<OcclusionBuffer> buffer(new OcclusionBuffer(context));
+        buffer->SetSize(OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT, numThreads > 1);
+        buffer->SetView(camera);
+        buffer->SetMaxTriangles(NUM_OCCLUDERS * cube.Size() / 3);
+
+        long long drawUSec = 0;
+        long long hierarchyUSec = 0;
+        long long testUSec = 0;
+        unsigned visible = 0;
+
+        HiresTimer timer;
+        for (unsigned i = 0; i < settings.iterations_; ++i)
+        {
+            timer.Reset();
+            buffer->Clear();
+            for (unsigned j = 0; j < NUM_OCCLUDERS; ++j)
+                buffer->AddTriangles(occluders[j], &cube[0], sizeof(Vector3), 0, cube.Size());
+            buffer->DrawTriangles();
+            drawUSec += timer.GetUSec(true);
+
+            buffer->BuildDepthHierarchy();
+            hierarchyUSec += timer.GetUSec(true);
+
+            visible = 0;
+            for (unsigned j = 0; j < occludees.Size(); ++j)
+                visible += buffer->IsVisible(occludees[j]);
+            testUSec += timer.GetUSec(true);
+        }
+
+        // The depth buffer and visibility must not depend on the number of threads
+        unsigned numPixels = (unsigned)(OCCLUSION_BUFFER_WIDTH * OCCLUSION_BUFFER_HEIGHT);
+        if (numThreads == 1)
+        {
+            baseDepths.Resize(numPixels);
+            memcpy(&baseDepths[0], buffer->GetBuffer(), numPixels * sizeof(int));
+            baseVisible = visible;
+        }
+        else if (visible != baseVisible || memcmp(&baseDepths[0], buffer->GetBuffer(), numPixels * sizeof(int)))
+            ErrorExit("Threaded occlusion results differ from single-threaded");
+
+        PrintLine(FormatRow("%7u  %8.3f  %13.3f  %8.3f  %7u", numThreads, GetAverageMs(drawUSec, settings.iterations_),
+            GetAverageMs(hierarchyUSec, settings.iterations_), GetAverageMs(testUSec, settings.iterations_), visible));
+    }
+}
@@ -0,0 +1,139 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Atomic/Core/ProcessUtils.h>
+#include <Atomic/Core/Timer.h>
+#include <Atomic/Core/WorkQueue.h>
+#include <Atomic/Graphics/Octree.h>
+#include <Atomic/Graphics/ParticleEffect.h>
+#include <Atomic/Graphics/ParticleEmitter.h>
+#include <Atomic/Math/Random.h>
+#include <Atomic/Scene/Scene.h>
+
+#include "Benchmarks.h"
+
+#include <Atomic/DebugNew.h>
+
+/// Particles per emitter. Billboard sets are limited by their 16-bit index buffer, so large counts use several emitters.
+static const unsigned PARTICLES_PER_EMITTER = 1000;
+/// Frames simulated before timing, so that the emitters are full. Emitters emit at most 100 particles per frame.
+static const unsigned PARTICLE_WARMUP_FRAMES = 20;
+/// Simulation time step.
+static const float PARTICLE_TIME_STEP = 1.0f / 60.0f;
+
+/// Return an effect that keeps a full emitter of moving, scaling, fading particles alive for the whole benchmark.
+static SharedPtr<ParticleEffect> CreateBenchmarkEffect(Context* context, unsigned numParticles)
+{
+    SharedPtr<ParticleEffect> effect(new ParticleEffect(context));
+    effect->SetNumParticles(numParticles);
+    effect->SetUpdateInvisible(true);
+    effect->SetEmitterType(EMITTER_SPHERE);
+    effect->SetEmitterSize(Vector3::ONE);
+    effect->SetMinDirection(-Vector3::ONE);
+    effect->SetMaxDirection(Vector3::ONE);
+    effect->SetMinEmissionRate(100000.0f);
+    effect->SetMaxEmissionRate(100000.0f);
+    effect->SetMinTimeToLive(1000.0f);
+    effect->SetMaxTimeToLive(1000.0f);
+    effect->SetMinVelocity(1.0f);
+    effect->SetMaxVelocity(5.0f);
+    effect->SetMinRotationSpeed(-90.0f);
+    effect->SetMaxRotationSpeed(90.0f);
+    effect->SetConstantForce(Vector3(0.0f, -9.81f, 0.0f));
+    effect->SetDampingForce(0.5f);
+    effect->SetSizeAdd(0.1f);
+    effect->AddColorFrame(ColorFrame(Color::WHITE, 0.0f));
+    effect->AddColorFrame(ColorFrame(Color::RED, 10.0f));
+    effect->AddColorFrame(ColorFrame(Color::TRANSPARENT, 1000.0f));
+    return effect;
+}
+
+void RunParticleBenchmark(const BenchmarkSettings& settings)
+{
+    SharedPtr<Context> context(new Context());
+    WorkQueue* queue = new WorkQueue(context);
+    context->RegisterSubsystem(queue);
+    queue->CreateThreads(settings.maxThreads_ - 1);
+    context->RegisterFactory<Octree>();
+    context->RegisterFactory<ParticleEmitter>();
+
+    PrintLine(FormatRow("Threads: %u", settings.maxThreads_));
+    PrintLine("Particles  Emitters  Update(ms)  Per particle(ns)");
+
+    PODVector<unsigned> counts = GetObjectCounts(settings);
+    for (unsigned c = 0; c < counts.Size(); ++c)
+    {
+        unsigned numParticles = Min(counts[c], PARTICLES_PER_EMITTER);
+        unsigned numEmitters = Max(counts[c] / PARTICLES_PER_EMITTER, 1U);
+        SharedPtr<ParticleEffect> effect = CreateBenchmarkEffect(context, numParticles);
+
+        SharedPtr<Scene> scene(new Scene(context));
+        Octree* octree = scene->CreateComponent<Octree>();
+
+        SetRandomSeed(1);
+        PODVector<ParticleEmitter*> emitters(numEmitters);
+        for (unsigned i = 0; i < numEmitters; ++i)
+        {
+            Node* node = scene->CreateChild(String::EMPTY, LOCAL);
+            node->SetPosition(Vector3(Random(-100.0f, 100.0f), 0.0f, Random(-100.0f, 100.0f)));
+            emitters[i] = node->CreateComponent<ParticleEmitter>();
+            emitters[i]->SetEffect(effect);
+        }
+
+        FrameInfo frame;
+        frame.frameNumber_ = 0;
+        frame.timeStep_ = PARTICLE_TIME_STEP;
+        frame.viewSize_ = IntVector2(1920, 1080);
+        frame.camera_ = 0;
+
+        // The scene post-update marks the emitters for update, the octree then updates them in worker threads
+        for (unsigned i = 0; i < PARTICLE_WARMUP_FRAMES; ++i)
+        {
+            scene->Update(PARTICLE_TIME_STEP);
+            octree->Update(frame);
+        }
+
+        unsigned activeParticles = 0;
+        for (unsigned i = 0; i < numEmitters; ++i)
+        {
+            const Vector<SharedPtr<Billboard> >& billboards = emitters[i]->GetBillboards();
+            for (unsigned j = 0; j < billboards.Size(); ++j)
+                activeParticles += billboards[j]->enabled_;
+        }
+        if (activeParticles != numParticles * numEmitters)
+            ErrorExit("Particle emitters did not fill up during warmup");
+
+        long long updateUSec = 0;
+        HiresTimer timer;
+        for (unsigned i = 0; i < settings.iterations_; ++i)
+        {
+            scene->Update(PARTICLE_TIME_STEP);
+            timer.Reset();
+            octree->Update(frame);
+            updateUSec += timer.GetUSec(false);
+        }
+
+        float updateMs = GetAverageMs(updateUSec, settings.iterations_);
+        PrintLine(FormatRow("%9u  %8u  %10.3f  %16.2f", activeParticles, numEmitters, updateMs,
+            updateMs * 1000000.0f / (float)activeParticles));
+    }
+}
@@ -0,0 +1,121 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Atomic/Core/ProcessUtils.h>
+#include <Atomic/Core/Timer.h>
+#include <Atomic/Graphics/RenderCommandBuffer.h>
+#include <Atomic/Math/Matrix3x4.h>
+#include <Atomic/Math/Random.h>
+
+#include "Benchmarks.h"
+
+#include <Atomic/DebugNew.h>
+
+static const unsigned NUM_MATERIALS = 32;
+static const unsigned NUM_GEOMETRIES = 64;
+static const StringHash PARAM_COLOR("MatDiffColor");
+static const StringHash PARAM_MODEL("Model");
+
+/// Draw call as a sorted batch queue would submit it.
+struct BenchmarkDraw
+{
+    /// Material index, which selects the shaders, texture and color.
+    unsigned material_;
+    /// Geometry index, which selects the vertex and index buffers.
+    unsigned geometry_;
+    /// World transform.
+    Matrix3x4 transform_;
+};
+
+static bool CompareDraws(const BenchmarkDraw& lhs, const BenchmarkDraw& rhs)
+{
+    return lhs.material_ != rhs.material_ ? lhs.material_ < rhs.material_ : lhs.geometry_ < rhs.geometry_;
+}
+
+void RunRenderCommandBenchmark(const BenchmarkSettings& settings)
+{
+    PrintLine("   Draws  Recorded  Dropped  Record(ms)  Replay(ms)");
+
+    // The null backend never dereferences the recorded objects, so stand-ins are enough
+    PODVector<char> objects(NUM_MATERIALS * 3 + NUM_GEOMETRIES * 2);
+    char* shaders = &objects[0];
+    char* textures = shaders + NUM_MATERIALS * 2;
+    char* buffers = textures + NUM_MATERIALS;
+
+    PODVector<unsigned> counts = GetObjectCounts(settings);
+    for (unsigned c = 0; c < counts.Size(); ++c)
+    {
+        unsigned numDraws = counts[c];
+
+        SetRandomSeed(1);
+        PODVector<BenchmarkDraw> draws(numDraws);
+        for (unsigned i = 0; i < numDraws; ++i)
+        {
+            draws[i].material_ = Rand() % NUM_MATERIALS;
+            draws[i].geometry_ = Rand() % NUM_GEOMETRIES;
+            draws[i].transform_ = Matrix3x4(Vector3(Random(-100.0f, 100.0f), 0.0f, Random(-100.0f, 100.0f)),
+                Quaternion(Random(360.0f), Vector3::UP), 1.0f);
+        }
+        Sort(draws.Begin(), draws.End(), CompareDraws);
+
+        SharedPtr<RenderCommandBuffer> buffer(new RenderCommandBuffer());
+        RenderCommandStats stats;
+        HiresTimer timer;
+        long long recordUSec = 0;
+        long long replayUSec = 0;
+
+        for (unsigned i = 0; i < settings.iterations_; ++i)
+        {
+            buffer->Clear();
+            timer.Reset();
+            // Every draw sets its full state, as Batch::Prepare does; the buffer drops what did not change
+            for (unsigned j = 0; j < numDraws; ++j)
+            {
+                const BenchmarkDraw& draw = draws[j];
+                unsigned material = draw.material_;
+                buffer->SetShaders((ShaderVariation*)&shaders[material * 2], (ShaderVariation*)&shaders[material * 2 + 1]);
+                buffer->SetBlendMode(material & 1 ? BLEND_ALPHA : BLEND_REPLACE);
+                buffer->SetCullMode(CULL_CCW);
+                buffer->SetDepthTest(CMP_LESSEQUAL);
+                buffer->SetDepthWrite(!(material & 1));
+                buffer->SetTexture(0, (Texture*)&textures[material]);
+                buffer->SetShaderParameter(PARAM_COLOR, Color((float)material / NUM_MATERIALS, 1.0f, 1.0f));
+                buffer->SetShaderParameter(PARAM_MODEL, draw.transform_);
+                buffer->SetVertexBuffer((VertexBuffer*)&buffers[draw.geometry_ * 2]);
+                buffer->SetIndexBuffer((IndexBuffer*)&buffers[draw.geometry_ * 2 + 1]);
+                buffer->Draw(TRIANGLE_LIST, 0, 36, 0, 24);
+            }
+            recordUSec += timer.GetUSec(false);
+
+            timer.Reset();
+            stats = buffer->Execute(0);
+            replayUSec += timer.GetUSec(false);
+        }
+
+        if (stats.numDrawCommands_ != numDraws || stats.numPrimitives_ != numDraws * 12)
+            ErrorExit("Replayed draw count differs from the recorded draws");
+
+        PrintLine(FormatRow("%8u  %8u  %7u  %10.3f  %10.3f", numDraws, buffer->GetNumCommands(), buffer->GetNumRedundantCommands(),
+            GetAverageMs(recordUSec, settings.iterations_), GetAverageMs(replayUSec, settings.iterations_)));
+    }
+}
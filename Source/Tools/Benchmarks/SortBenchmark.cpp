@@ -0,0 +1,123 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Atomic/Core/ProcessUtils.h>
+#include <Atomic/Core/Timer.h>
+#include <Atomic/Graphics/Batch.h>
+#include <Atomic/Math/Random.h>
+
+#include "Benchmarks.h"
+
+#include <Atomic/DebugNew.h>
+
+static const unsigned NUM_RENDER_ORDERS = 4;
+static const unsigned NUM_SHADERS = 64;
+static const unsigned NUM_MATERIALS = 256;
+static const unsigned NUM_GEOMETRIES = 1024;
+static const float MAX_DISTANCE = 1000.0f;
+
+/// Back to front order as the batch queue defines it, for the comparison sort baseline.
+static bool CompareBackToFront(Batch* lhs, Batch* rhs)
+{
+    if (lhs->renderOrder_ != rhs->renderOrder_)
+        return lhs->renderOrder_ < rhs->renderOrder_;
+    else if (lhs->distance_ != rhs->distance_)
+        return lhs->distance_ > rhs->distance_;
+    else
+        return lhs->sortKey_ < rhs->sortKey_;
+}
+
+/// Return whether two batch orders are the same. Batches with equal sort fields may be in any order.
+static bool IsSameOrder(const PODVector<Batch*>& lhs, const PODVector<Batch*>& rhs)
+{
+    if (lhs.Size() != rhs.Size())
+        return false;
+
+    for (unsigned i = 0; i < lhs.Size(); ++i)
+    {
+        if (lhs[i]->renderOrder_ != rhs[i]->renderOrder_ || lhs[i]->distance_ != rhs[i]->distance_ ||
+            lhs[i]->sortKey_ != rhs[i]->sortKey_)
+            return false;
+    }
+
+    return true;
+}
+
+void RunSortBenchmark(const BenchmarkSettings& settings)
+{
+    PrintLine(" Batches  Comparison(ms)  BackToFront(ms)  FrontToBack(ms)");
+
+    PODVector<unsigned> counts = GetObjectCounts(settings);
+    for (unsigned c = 0; c < counts.Size(); ++c)
+    {
+        unsigned numObjects = counts[c];
+
+        // Batches of a few render orders with state keys drawn from limited shader, material and geometry sets
+        SetRandomSeed(1);
+        BatchQueue queue;
+        queue.Clear(0);
+        PODVector<unsigned long long> sortKeys(numObjects);
+        for (unsigned i = 0; i < numObjects; ++i)
+        {
+            Batch batch;
+            batch.renderOrder_ = (unsigned char)(Rand() % NUM_RENDER_ORDERS);
+            batch.distance_ = Random(MAX_DISTANCE);
+            sortKeys[i] = ((unsigned long long)(Rand() % NUM_SHADERS) << 32) | ((Rand() % NUM_MATERIALS) << 16) |
+                (Rand() % NUM_GEOMETRIES);
+            batch.sortKey_ = sortKeys[i];
+            queue.batches_.Push(batch);
+        }
+
+        PODVector<Batch*> compared(numObjects);
+        long long compareUSec = 0;
+        long long backToFrontUSec = 0;
+        long long frontToBackUSec = 0;
+
+        HiresTimer timer;
+        for (unsigned i = 0; i < settings.iterations_; ++i)
+        {
+            for (unsigned j = 0; j < numObjects; ++j)
+                compared[j] = &queue.batches_[j];
+
+            timer.Reset();
+            Sort(compared.Begin(), compared.End(), CompareBackToFront);
+            compareUSec += timer.GetUSec(true);
+
+            queue.SortBackToFront();
+            backToFrontUSec += timer.GetUSec(true);
+
+            if (!IsSameOrder(compared, queue.sortedBatches_))
+                ErrorExit("Radix sorted batches differ from the comparison sort");
+
+            // Front to back sorting remaps the state keys, so restore them for the next iteration
+            timer.Reset();
+            queue.SortFrontToBack();
+            frontToBackUSec += timer.GetUSec(true);
+
+            for (unsigned j = 0; j < numObjects; ++j)
+                queue.batches_[j].sortKey_ = sortKeys[j];
+        }
+
+        PrintLine(FormatRow("%8u  %14.3f  %15.3f  %15.3f", numObjects, GetAverageMs(compareUSec, settings.iterations_),
+            GetAverageMs(backToFrontUSec, settings.iterations_), GetAverageMs(frontToBackUSec, settings.iterations_)));
+    }
+}
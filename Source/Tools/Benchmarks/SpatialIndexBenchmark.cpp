@@ -0,0 +1,207 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Atomic/Core/ProcessUtils.h>
+#include <Atomic/Core/Timer.h>
+#include <Atomic/Core/WorkQueue.h>
+#include <Atomic/Graphics/Drawable.h>
+#include <Atomic/Graphics/Octree.h>
+#include <Atomic/Graphics/OctreeQuery.h>
+#include <Atomic/Math/Random.h>
+#include <Atomic/Scene/Scene.h>
+
+#include "Benchmarks.h"
+
+#include <Atomic/DebugNew.h>
+
+/// Half extent of the cube the drawables are scattered in. Fits the default octree size.
+static const float SPATIAL_SCENE_SIZE = 500.0f;
+/// One in this many drawables moves each frame.
+static const unsigned SPATIAL_MOVING_DIVISOR = 10;
+/// Number of small box queries per frame.
+static const unsigned SPATIAL_BOX_QUERIES = 100;
+
+/// Drawable with a fixed local bounding box and no geometry.
+class BenchmarkDrawable : public Drawable
+{
+    ATOMIC_OBJECT(BenchmarkDrawable, Drawable);
+
+public:
+    /// Construct.
+    BenchmarkDrawable(Context* context) :
+        Drawable(context, DRAWABLE_GEOMETRY)
+    {
+    }
+
+    /// Set local bounding box.
+    void SetBoundingBox(const BoundingBox& box)
+    {
+        boundingBox_ = box;
+        OnMarkedDirty(node_);
+    }
+
+protected:
+    /// Recalculate the world-space bounding box.
+    virtual void OnWorldBoundingBoxUpdate()
+    {
+        worldBoundingBox_ = boundingBox_.Transformed(node_->GetWorldTransform());
+    }
+};
+
+/// Timings of one spatial index at one object count.
+struct SpatialIndexTimings
+{
+    /// Average milliseconds to move the moving drawables and update the index.
+    float updateMs_;
+    /// Average milliseconds for one frustum query.
+    float frustumMs_;
+    /// Average milliseconds for the small box queries.
+    float boxMs_;
+    /// Total number of query results, for comparing the indices.
+    unsigned results_;
+};
+
+static Vector3 GetRandomPosition(float size)
+{
+    return Vector3(Random(-size, size), Random(-size, size), Random(-size, size));
+}
+
+static SpatialIndexTimings MeasureSpatialIndex(Octree* octree, const PODVector<Node*>& nodes, const PODVector<Vector3>& positions,
+    const BenchmarkSettings& settings)
+{
+    SpatialIndexTimings timings;
+    timings.results_ = 0;
+
+    FrameInfo frame;
+    frame.frameNumber_ = 0;
+    frame.timeStep_ = 1.0f / 60.0f;
+    frame.viewSize_ = IntVector2(1920, 1080);
+    frame.camera_ = 0;
+
+    // Start from the same positions for each index
+    for (unsigned i = 0; i < nodes.Size(); ++i)
+        nodes[i]->SetPosition(positions[i]);
+    octree->Update(frame);
+
+    Frustum frustum;
+    frustum.Define(60.0f, 16.0f / 9.0f, 1.0f, 0.1f, SPATIAL_SCENE_SIZE, Matrix3x4::IDENTITY);
+
+    // Same pseudo-random movement and queries for each index
+    SetRandomSeed(2);
+    PODVector<Drawable*> result;
+    long long updateUSec = 0;
+    long long frustumUSec = 0;
+    long long boxUSec = 0;
+    HiresTimer timer;
+
+    for (unsigned i = 0; i < settings.iterations_; ++i)
+    {
+        ++frame.frameNumber_;
+
+        timer.Reset();
+        for (unsigned j = i % SPATIAL_MOVING_DIVISOR; j < nodes.Size(); j += SPATIAL_MOVING_DIVISOR)
+            nodes[j]->Translate(GetRandomPosition(1.0f), TS_WORLD);
+        octree->Update(frame);
+        updateUSec += timer.GetUSec(true);
+
+        result.Clear();
+        FrustumOctreeQuery frustumQuery(result, frustum, DRAWABLE_GEOMETRY);
+        octree->GetDrawables(frustumQuery);
+        timings.results_ += result.Size();
+        frustumUSec += timer.GetUSec(true);
+
+        for (unsigned j = 0; j < SPATIAL_BOX_QUERIES; ++j)
+        {
+            Vector3 center = GetRandomPosition(SPATIAL_SCENE_SIZE);
+            result.Clear();
+            BoxOctreeQuery boxQuery(result, BoundingBox(center - Vector3::ONE * 20.0f, center + Vector3::ONE * 20.0f),
+                DRAWABLE_GEOMETRY);
+            octree->GetDrawables(boxQuery);
+            timings.results_ += result.Size();
+        }
+        boxUSec += timer.GetUSec(true);
+    }
+
+    timings.updateMs_ = GetAverageMs(updateUSec, settings.iterations_);
+    timings.frustumMs_ = GetAverageMs(frustumUSec, settings.iterations_);
+    timings.boxMs_ = GetAverageMs(boxUSec, settings.iterations_);
+    return timings;
+}
+
+void RunSpatialIndexBenchmark(const BenchmarkSettings& settings)
+{
+    SharedPtr<Context> context(new Context());
+    context->RegisterSubsystem(new WorkQueue(context));
+    context->RegisterFactory<Octree>();
+    context->RegisterFactory<BenchmarkDrawable>();
+
+    PrintLine(" Objects  Index   Build(ms)  Update(ms)  Frustum(ms)  Boxes(ms)");
+
+    PODVector<unsigned> counts = GetObjectCounts(settings);
+    for (unsigned c = 0; c < counts.Size(); ++c)
+    {
+        unsigned numObjects = counts[c];
+
+        SharedPtr<Scene> scene(new Scene(context));
+        Octree* octree = scene->CreateComponent<Octree>();
+
+        SetRandomSeed(1);
+        PODVector<Node*> nodes(numObjects);
+        PODVector<Vector3> positions(numObjects);
+        for (unsigned i = 0; i < numObjects; ++i)
+        {
+            Node* node = scene->CreateChild(String::EMPTY, LOCAL);
+            positions[i] = GetRandomPosition(SPATIAL_SCENE_SIZE);
+            node->SetPosition(positions[i]);
+            BenchmarkDrawable* drawable = node->CreateComponent<BenchmarkDrawable>();
+            Vector3 halfSize(Random(0.5f, 5.0f), Random(0.5f, 5.0f), Random(0.5f, 5.0f));
+            drawable->SetBoundingBox(BoundingBox(-halfSize, halfSize));
+            nodes[i] = node;
+        }
+
+        FrameInfo frame;
+        frame.frameNumber_ = 0;
+        frame.timeStep_ = 0.0f;
+        frame.viewSize_ = IntVector2(1920, 1080);
+        frame.camera_ = 0;
+
+        // Octree first, as the drawables start out queued for insertion into it
+        HiresTimer timer;
+        octree->Update(frame);
+        float octreeBuildMs = timer.GetUSec(true) / 1000.0f;
+        SpatialIndexTimings octreeTimings = MeasureSpatialIndex(octree, nodes, positions, settings);
+
+        timer.Reset();
+        octree->SetSpatialIndex(SPATIAL_INDEX_BVH);
+        float bvhBuildMs = timer.GetUSec(true) / 1000.0f;
+        SpatialIndexTimings bvhTimings = MeasureSpatialIndex(octree, nodes, positions, settings);
+
+        if (octreeTimings.results_ != bvhTimings.results_)
+            ErrorExit("DynamicBVH query results differ from Octree");
+
+        PrintLine(FormatRow("%8u  Octree  %9.3f  %10.3f  %11.3f  %9.3f", numObjects, octreeBuildMs, octreeTimings.updateMs_,
+            octreeTimings.frustumMs_, octreeTimings.boxMs_));
+        PrintLine(FormatRow("%8s  BVH     %9.3f  %10.3f  %11.3f  %9.3f", "", bvhBuildMs, bvhTimings.updateMs_,
+            bvhTimings.frustumMs_, bvhTimings.boxMs_));
+    }
+}
@@ -0,0 +1,114 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Atomic/Core/ProcessUtils.h>
+#include <Atomic/Core/StringUtils.h>
+#include <Atomic/Core/TaskGraph.h>
+#include <Atomic/Core/Timer.h>
+#include <Atomic/Core/WorkQueue.h>
+
+#include "Benchmarks.h"
+
+#include <Atomic/DebugNew.h>
+
+static const unsigned PARALLEL_FOR_ELEMENTS = 1 << 20;
+static const unsigned PARALLEL_FOR_GRAIN = 4096;
+static const unsigned NUM_SMALL_ITEMS = 20000;
+static const unsigned SMALL_ITEM_STEPS = 256;
+static const unsigned TASK_GRAPH_STAGES = 8;
+static const unsigned TASK_GRAPH_WIDTH = 4;
+
+static void SmallItemWork(const WorkItem* item, unsigned threadIndex)
+{
+    float value = 0.0f;
+    for (unsigned i = 0; i < SMALL_ITEM_STEPS; ++i)
+        value += Sqrt((float)(i + threadIndex));
+    *((float*)item->start_) = value;
+}
+
+void RunWorkQueueBenchmark(const BenchmarkSettings& settings)
+{
+    PODVector<float> data(PARALLEL_FOR_ELEMENTS);
+    PODVector<float> results(NUM_SMALL_ITEMS);
+    float baseParallelForMs = 0.0f;
+
+    PrintLine("Threads  ParallelFor(ms)  Speedup  WorkItems(ms)  TaskGraph(ms)");
+
+    for (unsigned numThreads = 1; numThreads <= settings.maxThreads_; ++numThreads)
+    {
+        // Worker threads can only be created once per queue, so use a fresh context for each thread count
+        SharedPtr<Context> context(new Context());
+        WorkQueue* queue = new WorkQueue(context);
+        context->RegisterSubsystem(queue);
+        queue->CreateThreads(numThreads - 1);
+
+        ParallelForFunction elementWork = [&data](unsigned begin, unsigned end, unsigned threadIndex)
+        {
+            for (unsigned i = begin; i < end; ++i)
+                data[i] = Sqrt((float)i) * Sin((float)i);
+        };
+
+        HiresTimer timer;
+        for (unsigned i = 0; i < settings.iterations_; ++i)
+            queue->ParallelFor(0, PARALLEL_FOR_ELEMENTS, PARALLEL_FOR_GRAIN, elementWork);
+        float parallelForMs = GetAverageMs(timer.GetUSec(true), settings.iterations_);
+
+        for (unsigned i = 0; i < settings.iterations_; ++i)
+        {
+            for (unsigned j = 0; j < NUM_SMALL_ITEMS; ++j)
+            {
+                SharedPtr<WorkItem> item = queue->GetFreeItem();
+                item->workFunction_ = SmallItemWork;
+                item->start_ = &results[j];
+                item->priority_ = M_MAX_UNSIGNED;
+                queue->AddWorkItem(item);
+            }
+            queue->Complete(M_MAX_UNSIGNED);
+        }
+        float workItemsMs = GetAverageMs(timer.GetUSec(true), settings.iterations_);
+
+        // Stages of parallel tasks, each depending on all tasks of the previous stage
+        TaskGraph graph(context);
+        unsigned stageSize = PARALLEL_FOR_ELEMENTS / (TASK_GRAPH_STAGES * TASK_GRAPH_WIDTH);
+        for (unsigned stage = 0; stage < TASK_GRAPH_STAGES; ++stage)
+        {
+            for (unsigned j = 0; j < TASK_GRAPH_WIDTH; ++j)
+            {
+                unsigned begin = (stage * TASK_GRAPH_WIDTH + j) * stageSize;
+                unsigned task = graph.AddParallelTask(begin, begin + stageSize, PARALLEL_FOR_GRAIN, elementWork);
+                for (unsigned k = 0; stage && k < TASK_GRAPH_WIDTH; ++k)
+                    graph.AddDependency(task, (stage - 1) * TASK_GRAPH_WIDTH + k);
+            }
+        }
+
+        timer.Reset();
+        for (unsigned i = 0; i < settings.iterations_; ++i)
+            graph.Run();
+        float taskGraphMs = GetAverageMs(timer.GetUSec(true), settings.iterations_);
+
+        if (numThreads == 1)
+            baseParallelForMs = parallelForMs;
+
+        PrintLine(FormatRow("%7u  %15.3f  %6.2fx  %13.3f  %13.3f", numThreads, parallelForMs,
+            parallelForMs > 0.0f ? baseParallelForMs / parallelForMs : 0.0f, workItemsMs, taskGraphMs));
+    }
+}
@@ -0,0 +1,121 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Atomic/Graphics/Animation.h>
+#include <Atomic/IO/VectorBuffer.h>
+#include <Atomic/Resource/ResourceCache.h>
+
+#include "EngineTests.h"
+
+#include <Atomic/DebugNew.h>
+
+static const float FRAME_INTERVAL = 1.0f / 30.0f;
+static const float SHORT_CLIP_LENGTH = 10.0f;
+static const float LONG_CLIP_LENGTH = 3000.0f;
+static const float MAX_TIME_ERROR = 0.0005f;
+
+/// Create a single track clip with a keyframe per frame. The position changes direction every frame, so no keyframe can be dropped.
+static SharedPtr<Animation> CreateClip(Context* context, float length, PODVector<float>& times)
+{
+    SharedPtr<Animation> animation(new Animation(context));
+    animation->SetLength(length);
+    AnimationTrack* track = animation->CreateTrack("Bone");
+    track->channelMask_ = CHANNEL_POSITION | CHANNEL_ROTATION;
+
+    times.Clear();
+    unsigned numKeyFrames = (unsigned)(length / FRAME_INTERVAL) + 1;
+    for (unsigned i = 0; i < numKeyFrames; ++i)
+    {
+        AnimationKeyFrame keyFrame;
+        keyFrame.time_ = Min(i * FRAME_INTERVAL, length);
+        keyFrame.position_ = Vector3(Sin(i * 97.0f), (float)(i & 1), 0.0f);
+        keyFrame.rotation_ = Quaternion(i * 13.0f, Vector3::UP);
+        track->AddKeyFrame(keyFrame);
+        times.Push(keyFrame.time_);
+    }
+
+    return animation;
+}
+
+/// Compress a clip, save it as UANC and load it back. Return the loaded clip, or null if the round trip failed.
+static SharedPtr<Animation> RoundTrip(Context* context, Animation* animation)
+{
+    animation->Compress();
+
+    VectorBuffer buffer;
+    if (!animation->Save(buffer) || buffer.GetSize() < 4 || memcmp(buffer.GetData(), "UANC", 4))
+        return SharedPtr<Animation>();
+
+    buffer.Seek(0);
+    SharedPtr<Animation> loaded(new Animation(context));
+    return loaded->Load(buffer) ? loaded : SharedPtr<Animation>();
+}
+
+/// Return whether the keyframe times of a track are increasing and within the time error of the original times.
+static bool CheckTimes(const AnimationTrack* track, const PODVector<float>& times)
+{
+    if (track->GetNumKeyFrames() != times.Size())
+        return false;
+
+    for (unsigned i = 0; i < times.Size(); ++i)
+    {
+        float time = track->GetKeyFrameTime(i);
+        if (Abs(time - times[i]) > MAX_TIME_ERROR || (i && time <= track->GetKeyFrameTime(i - 1)))
+            return false;
+    }
+    return true;
+}
+
+void RunAnimationTests(Context* context)
+{
+    // Loading looks up the optional trigger file through the resource cache
+    context->RegisterSubsystem(new ResourceCache(context));
+
+    PODVector<float> times;
+
+    {
+        SharedPtr<Animation> loaded = RoundTrip(context, CreateClip(context, SHORT_CLIP_LENGTH, times));
+        AnimationTrack* track = loaded ? loaded->GetTrack(String("Bone")) : 0;
+        Check(track && track->IsCompressed(), "Short compressed clip round trips through UANC");
+        Check(track && !(track->fullPrecisionMask_ & FULL_PRECISION_TIME), "Short clip keeps quantized times");
+        Check(track && CheckTimes(track, times), "Short clip times are within the time tolerance");
+    }
+
+    {
+        // The 16-bit time step of this clip is longer than a frame, so quantized times would merge keyframes
+        SharedPtr<Animation> loaded = RoundTrip(context, CreateClip(context, LONG_CLIP_LENGTH, times));
+        AnimationTrack* track = loaded ? loaded->GetTrack(String("Bone")) : 0;
+        Check(track && track->IsCompressed(), "Long compressed clip round trips through UANC");
+        Check(track && (track->fullPrecisionMask_ & FULL_PRECISION_TIME), "Long clip keeps full precision times");
+        Check(track && CheckTimes(track, times), "Long clip keyframes keep distinct times");
+
+        bool decoded = track != 0;
+        for (unsigned i = 0; decoded && i < times.Size(); ++i)
+        {
+            AnimationKeyFrame keyFrame;
+            track->DecodeKeyFrame(i, keyFrame);
+            decoded = keyFrame.time_ == times[i] && Abs(keyFrame.position_.y_ - (float)(i & 1)) < DEFAULT_POSITION_TOLERANCE;
+        }
+        Check(decoded, "Long clip keyframes decode after full precision times");
+    }
+}
@@ -0,0 +1,257 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Atomic/Core/CoreEvents.h>
+#include <Atomic/Core/Mutex.h>
+#include <Atomic/Core/Timer.h>
+#include <Atomic/IO/File.h>
+#include <Atomic/IO/FileSystem.h>
+#include <Atomic/Resource/Image.h>
+#include <Atomic/Resource/ResourceCache.h>
+
+#include "EngineTests.h"
+
+#include <Atomic/DebugNew.h>
+
+static const unsigned NUM_IMAGES = 32;
+static const int IMAGE_SIZE = 64;
+static const unsigned MAX_FRAMES = 5000;
+
+static String GetImageName(unsigned index)
+{
+    return "Images/" + String(index) + ".png";
+}
+
+/// Queue all images for background loading. Return the number queued.
+static unsigned QueueImages(ResourceCache* cache)
+{
+    unsigned queued = 0;
+    for (unsigned i = 0; i < NUM_IMAGES; ++i)
+    {
+        if (cache->BackgroundLoadResource<Image>(GetImageName(i)))
+            ++queued;
+    }
+    return queued;
+}
+
+/// Send frame begin events until the background load queue is empty. Release the unreferenced resources each frame if requested, so that the main thread modifies the cache while the loader threads search it.
+static void FinishLoading(Context* context, ResourceCache* cache, bool releaseEachFrame)
+{
+    for (unsigned i = 0; i < MAX_FRAMES && cache->GetNumBackgroundLoadResources(); ++i)
+    {
+        VariantMap& eventData = context->GetEventDataMap();
+        eventData[BeginFrame::P_FRAMENUMBER] = i;
+        eventData[BeginFrame::P_TIMESTEP] = 0.016f;
+        cache->SendEvent(E_BEGINFRAME, eventData);
+
+        if (releaseEachFrame)
+            cache->ReleaseAllResources();
+
+        Time::Sleep(1);
+    }
+}
+
+static unsigned GetNumLoadedImages(ResourceCache* cache)
+{
+    unsigned loaded = 0;
+    for (unsigned i = 0; i < NUM_IMAGES; ++i)
+    {
+        if (cache->GetExistingResource<Image>(GetImageName(i)))
+            ++loaded;
+    }
+    return loaded;
+}
+
+static String GetOrderName(const String& name)
+{
+    return "Order/" + name + ".txt";
+}
+
+static ResourceCache* orderCache = 0;
+static volatile bool gateEntered = false;
+static volatile bool gateOpen = false;
+static Mutex loadOrderMutex;
+static Vector<String> loadOrder;
+
+/// Resource that records the order in which loading begins. Loading the gate resource blocks until the gate is opened, so that the queue can be filled while the only loader thread is busy. The resource file may name another resource to queue as a dependency.
+class LoadOrderTestResource : public Resource
+{
+    ATOMIC_OBJECT(LoadOrderTestResource, Resource);
+
+public:
+    /// Construct.
+    LoadOrderTestResource(Context* context) :
+        Resource(context)
+    {
+    }
+
+    /// Record the load order and queue the dependency, if any.
+    virtual bool BeginLoad(Deserializer& source)
+    {
+        String name = GetFileName(GetName());
+        if (name == "Gate")
+        {
+            gateEntered = true;
+            while (!gateOpen)
+                Time::Sleep(1);
+            return true;
+        }
+
+        {
+            MutexLock lock(loadOrderMutex);
+            loadOrder.Push(name);
+        }
+
+        String dependency = source.ReadLine();
+        if (!dependency.Empty())
+            orderCache->BackgroundLoadResource<LoadOrderTestResource>(GetOrderName(dependency), true, this);
+
+        return true;
+    }
+};
+
+/// Occupy the only loader thread with the gate resource, so that the resources queued next wait until FinishOrderedLoad().
+static void BeginOrderedLoad()
+{
+    orderCache->ReleaseAllResources(true);
+    loadOrder.Clear();
+    gateEntered = false;
+    gateOpen = false;
+
+    orderCache->BackgroundLoadResource<LoadOrderTestResource>(GetOrderName("Gate"));
+    for (unsigned i = 0; i < MAX_FRAMES && !gateEntered; ++i)
+        Time::Sleep(1);
+}
+
+static void QueueOrdered(const String& name, int priority)
+{
+    orderCache->BackgroundLoadResource<LoadOrderTestResource>(GetOrderName(name), true, 0, priority);
+}
+
+/// Open the gate, finish loading and return the names in the order loading began.
+static String FinishOrderedLoad(Context* context)
+{
+    gateOpen = true;
+    FinishLoading(context, orderCache, false);
+    return String::Joined(loadOrder, " ");
+}
+
+static void RunLoadOrderTests(Context* context, const String& dir)
+{
+    context->RegisterFactory<LoadOrderTestResource>();
+
+    const char* names[] = { "Gate", "A", "B", "C", "D", "Parent", "Child" };
+    for (unsigned i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+    {
+        File file(context, dir + GetOrderName(names[i]), FILE_WRITE);
+        file.WriteLine(String(names[i]) == "Parent" ? "Child" : "");
+    }
+
+    SharedPtr<ResourceCache> cache(new ResourceCache(context));
+    cache->AddResourceDir(dir);
+    cache->SetNumBackgroundLoadThreads(1);
+    orderCache = cache;
+
+    BeginOrderedLoad();
+    QueueOrdered("A", 0);
+    QueueOrdered("B", 5);
+    QueueOrdered("C", 10);
+    QueueOrdered("D", 5);
+    Check(FinishOrderedLoad(context) == "C B D A", "Queued resources begin loading highest priority first, first in first out within a priority");
+
+    // Raise one resource above the rest and lower another below them while all wait behind the gate
+    BeginOrderedLoad();
+    QueueOrdered("A", 0);
+    QueueOrdered("B", 5);
+    QueueOrdered("C", 10);
+    Check(cache->SetBackgroundLoadPriority<LoadOrderTestResource>(GetOrderName("A"), 20), "Priority of a queued resource can be changed");
+    cache->SetBackgroundLoadPriority<LoadOrderTestResource>(GetOrderName("C"), -1);
+    Check(!cache->SetBackgroundLoadPriority<LoadOrderTestResource>(GetOrderName("D"), 20), "Priority of an unqueued resource can not be changed");
+    Check(FinishOrderedLoad(context) == "A B C", "Changed priorities decide the load order");
+
+    // Cancel a queued resource before it begins loading
+    BeginOrderedLoad();
+    QueueOrdered("A", 10);
+    QueueOrdered("B", 0);
+    Check(cache->CancelBackgroundLoadResource<LoadOrderTestResource>(GetOrderName("A")), "Queued resource can be cancelled");
+    Check(!cache->CancelBackgroundLoadResource<LoadOrderTestResource>(GetOrderName("D")), "Unqueued resource can not be cancelled");
+    Check(FinishOrderedLoad(context) == "B", "Cancelled resource does not begin loading");
+    Check(!cache->GetExistingResource<LoadOrderTestResource>(GetOrderName("A")), "Cancelled resource is not stored in the cache");
+    Check(!cache->CancelBackgroundLoadResource<LoadOrderTestResource>(GetOrderName("B")), "Finished resource can not be cancelled");
+
+    // The dependency is queued with the default priority, but inherits the priority of the parent that requested it
+    BeginOrderedLoad();
+    QueueOrdered("A", 10);
+    QueueOrdered("Parent", 50);
+    Check(FinishOrderedLoad(context) == "Parent Child A", "Dependency begins loading with the priority of the resource depending on it");
+    Check(cache->GetExistingResource<LoadOrderTestResource>(GetOrderName("Child")) != 0, "Dependency is stored in the cache");
+
+    orderCache = 0;
+}
+
+void RunBackgroundLoaderTests(Context* context)
+{
+    FileSystem* fileSystem = context->GetSubsystem<FileSystem>();
+    String dir = fileSystem->GetCurrentDir() + "BackgroundLoaderTests/";
+    fileSystem->CreateDir(dir + "Images");
+    fileSystem->CreateDir(dir + "Order");
+
+    for (unsigned i = 0; i < NUM_IMAGES; ++i)
+    {
+        SharedPtr<Image> image(new Image(context));
+        image->SetSize(IMAGE_SIZE, IMAGE_SIZE, 4);
+        image->Clear(Color((float)i / NUM_IMAGES, 0.5f, 0.25f));
+        image->SavePNG(dir + GetImageName(i));
+    }
+
+    SharedPtr<ResourceCache> cache(new ResourceCache(context));
+    cache->AddResourceDir(dir);
+    cache->SetNumBackgroundLoadThreads(3);
+
+    Check(QueueImages(cache) == NUM_IMAGES, "All images are queued for background loading");
+    Check(QueueImages(cache) == 0, "Images already in the queue are not queued again");
+    FinishLoading(context, cache, false);
+    Check(!cache->GetNumBackgroundLoadResources(), "Background load queue drains");
+    Check(GetNumLoadedImages(cache) == NUM_IMAGES, "All background loaded images are stored in the cache");
+    Check(QueueImages(cache) == 0, "Images already in the cache are not queued again");
+
+    // Reload while the main thread releases resources and the loader thread count shrinks mid-load
+    cache->ReleaseAllResources(true);
+    Check(QueueImages(cache) == NUM_IMAGES, "Released images can be queued again");
+    cache->SetNumBackgroundLoadThreads(1);
+    FinishLoading(context, cache, true);
+    Check(!cache->GetNumBackgroundLoadResources(), "Background load queue drains while resources are released");
+    Check(cache->GetNumBackgroundLoadThreads() == 1, "Loader thread count can be reduced while loading");
+
+    // Destroy the cache while its loader threads are busy. The threads must stop before the loader is destroyed
+    cache->ReleaseAllResources(true);
+    cache->SetNumBackgroundLoadThreads(3);
+    QueueImages(cache);
+    WeakPtr<ResourceCache> weakCache(cache);
+    cache.Reset();
+    Check(weakCache.Expired(), "Cache with loads in progress is destroyed");
+
+    RunLoadOrderTests(context, dir);
+
+    fileSystem->RemoveDir(dir, true);
+}
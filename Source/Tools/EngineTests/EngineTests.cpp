@@ -0,0 +1,133 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Atomic/Atomic.h>
+
+#include <Atomic/Core/ProcessUtils.h>
+#include <Atomic/Core/StringUtils.h>
+#include <Atomic/IO/FileSystem.h>
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include "EngineTests.h"
+
+#include <Atomic/DebugNew.h>
+
+/// Registered test group.
+struct TestGroup
+{
+    /// Name used on the command line.
+    const char* name_;
+    /// Description.
+    const char* description_;
+    /// Test function.
+    void (*function_)(Context* context);
+};
+
+static const TestGroup testGroups_[] =
+{
+    { "shadercache", "Shader program binary cache keys and stale binary rejection", RunShaderCacheTests },
+    { "rendercommands", "Render command buffer recording, redundant state elimination and null backend replay", RunRenderCommandTests },
+    { "terrainstreamer", "Terrain tile quadtree streaming, level balance and edge stitching", RunTerrainStreamerTests },
+    { "backgroundloader", "Background resource loading, concurrent cache release and loader shutdown", RunBackgroundLoaderTests },
+    { "resourcebudget", "Memory budget quality reduction once per frame and restoration under budget", RunResourceBudgetTests },
+    { "packagefile", "Compressed package reads, corrupt block rejection and version 2 directory index round trips", RunPackageFileTests },
+    { "instancedata", "Persistent instance buffer slot ranges, dirty range merging and upload counters", RunInstanceDataTests },
+    { "animation", "Compressed animation UANC round trips and keyframe time precision of long clips", RunAnimationTests },
+    { "flathashmap", "FlatHashMap operations against HashMap, erased slot reuse and non-POD contents", RunFlatHashMapTests },
+    { 0, 0, 0 }
+};
+
+/// Number of checks made.
+static unsigned numChecks_ = 0;
+/// Number of failed checks.
+static unsigned numFailed_ = 0;
+
+int main(int argc, char** argv);
+int Run(const Vector<String>& arguments);
+
+int main(int argc, char** argv)
+{
+    Vector<String> arguments;
+
+    #ifdef WIN32
+    arguments = ParseArguments(GetCommandLineW());
+    #else
+    arguments = ParseArguments(argc, argv);
+    #endif
+
+    return Run(arguments);
+}
+
+int Run(const Vector<String>& arguments)
+{
+    String name = arguments.Size() ? arguments[0] : String::EMPTY;
+
+    if (name == "help")
+    {
+        String usage =
+            "Usage: EngineTests [group]\n"
+            "\n"
+            "Runs all headless test groups unless one is named. Returns a nonzero exit code if any check fails.\n"
+            "\n"
+            "Groups:\n";
+        for (const TestGroup* group = testGroups_; group->name_; ++group)
+            usage += String(group->name_) + " - " + group->description_ + "\n";
+        PrintLine(usage);
+        return EXIT_SUCCESS;
+    }
+
+    SharedPtr<Context> context(new Context());
+    context->RegisterSubsystem(new FileSystem(context));
+
+    bool found = false;
+    for (const TestGroup* group = testGroups_; group->name_; ++group)
+    {
+        if (name.Empty() || name == group->name_)
+        {
+            unsigned checksBefore = numChecks_;
+            unsigned failedBefore = numFailed_;
+            group->function_(context);
+            PrintLine(String(group->name_) + ": " + String(numChecks_ - checksBefore) + " checks, " +
+                String(numFailed_ - failedBefore) + " failed");
+            found = true;
+        }
+    }
+
+    if (!found)
+        ErrorExit("Unknown test group " + name + ", run with 'help' for the list");
+
+    return numFailed_ ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+void Check(bool condition, const char* description)
+{
+    ++numChecks_;
+    if (!condition)
+    {
+        ++numFailed_;
+        PrintLine(String("FAILED: ") + description, true);
+    }
+}
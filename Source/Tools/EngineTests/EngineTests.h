@@ -0,0 +1,50 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Atomic/Core/Context.h>
+
+using namespace Atomic;
+
+/// Test the shader program binary cache key and cache file validation.
+void RunShaderCacheTests(Context* context);
+/// Test render command recording, redundant state elimination and null backend replay.
+void RunRenderCommandTests(Context* context);
+/// Test terrain tile quadtree selection, level balance and edge stitching flags with generated heightmap tiles.
+void RunTerrainStreamerTests(Context* context);
+/// Test background resource loading, concurrent cache release and loader shutdown with loads in progress.
+void RunBackgroundLoaderTests(Context* context);
+/// Test memory budget quality reduction and restoration pacing.
+void RunResourceBudgetTests(Context* context);
+/// Test compressed package entry reads, rejection of corrupt blocks, and version 2 package directory index round trips.
+void RunPackageFileTests(Context* context);
+/// Test instance buffer slot assignment and that only changed and never uploaded slots are uploaded.
+void RunInstanceDataTests(Context* context);
+/// Test compressed animation round trips through the UANC format, including clips too long for quantized keyframe times.
+void RunAnimationTests(Context* context);
+/// Test FlatHashMap inserts, erases, iteration and copies against HashMap.
+void RunFlatHashMapTests(Context* context);
+
+/// Record the result of a check. Print the description if it failed.
+void Check(bool condition, const char* description);
@@ -0,0 +1,159 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Atomic/Container/FlatHashMap.h>
+#include <Atomic/Container/HashMap.h>
+#include <Atomic/Container/Str.h>
+#include <Atomic/Math/Random.h>
+
+#include "EngineTests.h"
+
+#include <Atomic/DebugNew.h>
+
+static const unsigned NUM_RANDOM_OPERATIONS = 20000;
+static const unsigned RANDOM_KEY_RANGE = 4096;
+static const unsigned NUM_CHURN_OPERATIONS = 100000;
+static const unsigned CHURN_LIVE_SIZE = 100;
+
+/// Return whether a flat hash map holds exactly the pairs of a reference hash map.
+template <class T, class U> static bool MatchesReference(const FlatHashMap<T, U>& map, const HashMap<T, U>& reference)
+{
+    if (map.Size() != reference.Size())
+        return false;
+
+    for (typename HashMap<T, U>::ConstIterator i = reference.Begin(); i != reference.End(); ++i)
+    {
+        typename FlatHashMap<T, U>::ConstIterator j = map.Find(i->first_);
+        if (j == map.End() || j->second_ != i->second_)
+            return false;
+    }
+
+    unsigned count = 0;
+    for (typename FlatHashMap<T, U>::ConstIterator i = map.Begin(); i != map.End(); ++i, ++count)
+    {
+        if (!reference.Contains(i->first_))
+            return false;
+    }
+    return count == reference.Size();
+}
+
+void RunFlatHashMapTests(Context* context)
+{
+    {
+        FlatHashMap<unsigned, unsigned> map;
+        Check(map.Find(1) == map.End() && !map.Contains(1) && !map.Erase(1) && map.Empty(), "Empty map finds nothing");
+    }
+
+    // Random inserts, overwrites and erases must leave the same pairs as HashMap, including across rehashes and
+    // probe chains with erased slots
+    {
+        FlatHashMap<unsigned, unsigned> map;
+        HashMap<unsigned, unsigned> reference;
+        SetRandomSeed(1);
+        bool erasedMatch = true;
+        for (unsigned i = 0; i < NUM_RANDOM_OPERATIONS; ++i)
+        {
+            unsigned key = (unsigned)Rand() % RANDOM_KEY_RANGE;
+            if (Rand() % 3)
+            {
+                map[key] = i;
+                reference[key] = i;
+            }
+            else
+                erasedMatch &= map.Erase(key) == reference.Erase(key);
+        }
+        Check(erasedMatch, "Erase finds the same keys as HashMap");
+        Check(MatchesReference(map, reference), "Random inserts and erases match HashMap");
+
+        unsigned value = 0;
+        unsigned missing = RANDOM_KEY_RANGE;
+        Check(map.TryGetValue(reference.Begin()->first_, value) && value == reference.Begin()->second_ &&
+            !map.TryGetValue(missing, value), "TryGetValue finds only existing keys");
+        Check(map.Keys().Size() == map.Size() && map.Values().Size() == map.Size(), "Keys and values cover every pair");
+
+        // Erasing through iterators while iterating must visit every pair once
+        for (FlatHashMap<unsigned, unsigned>::Iterator i = map.Begin(); i != map.End();)
+        {
+            if (i->first_ & 1)
+            {
+                reference.Erase(i->first_);
+                i = map.Erase(i);
+            }
+            else
+                ++i;
+        }
+        Check(MatchesReference(map, reference), "Erasing odd keys while iterating keeps the even keys");
+
+        map.Clear();
+        Check(map.Empty() && map.Begin() == map.End() && !map.Contains(reference.Begin()->first_), "Clear removes all pairs");
+    }
+
+    // Erased slots are reclaimed on rehash, so a map with constant size must not grow under insert and erase churn
+    {
+        FlatHashMap<unsigned, unsigned> map;
+        for (unsigned i = 0; i < NUM_CHURN_OPERATIONS; ++i)
+        {
+            map[i] = i;
+            if (i >= CHURN_LIVE_SIZE)
+                map.Erase(i - CHURN_LIVE_SIZE);
+        }
+        bool intact = map.Size() == CHURN_LIVE_SIZE;
+        for (unsigned i = NUM_CHURN_OPERATIONS - CHURN_LIVE_SIZE; i < NUM_CHURN_OPERATIONS; ++i)
+            intact &= map.Contains(i);
+        Check(intact, "Churned map keeps its live keys");
+        Check(map.Capacity() <= CHURN_LIVE_SIZE * 4, "Churned map does not grow with erased slots");
+    }
+
+    {
+        FlatHashMap<unsigned, unsigned> map;
+        map.Reserve(1000);
+        unsigned capacity = map.Capacity();
+        for (unsigned i = 0; i < 1000; ++i)
+            map[i * 7919] = i;
+        Check(capacity && map.Capacity() == capacity, "Reserved map does not rehash");
+    }
+
+    // Non-POD keys and values are copied and destroyed correctly
+    {
+        FlatHashMap<String, String> map;
+        HashMap<String, String> reference;
+        for (unsigned i = 0; i < 1000; ++i)
+        {
+            String key = "Key" + String(i);
+            map[key] = "Value" + String(i * 3);
+            reference[key] = "Value" + String(i * 3);
+        }
+
+        FlatHashMap<String, String> copy(map);
+        FlatHashMap<String, String> assigned;
+        assigned["Old"] = "Old";
+        assigned = map;
+        map["Key0"] = "Changed";
+        map.Erase("Key1");
+        Check(MatchesReference(copy, reference) && MatchesReference(assigned, reference),
+            "Copies are independent of the original");
+
+        FlatHashMap<String, String> swapped;
+        swapped.Swap(copy);
+        Check(copy.Empty() && MatchesReference(swapped, reference), "Swap exchanges the contents");
+    }
+}
@@ -0,0 +1,115 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Atomic/Graphics/InstanceDataStore.h>
+#include <Atomic/Graphics/VertexBuffer.h>
+
+#include "EngineTests.h"
+
+#include <Atomic/DebugNew.h>
+
+static const unsigned NUM_MOVING_INSTANCES = 10;
+static const unsigned NUM_ZERO_INSTANCES = 4;
+static const unsigned NUM_LARGE_INSTANCES = 2000;
+
+/// Add an instanced batch group to a queue. The render order tells the groups apart.
+static BatchGroup& AddGroup(BatchQueue& queue, unsigned char renderOrder, const PODVector<Matrix3x4>& transforms)
+{
+    Batch batch;
+    batch.zone_ = 0;
+    batch.pass_ = 0;
+    batch.material_ = 0;
+    batch.geometry_ = 0;
+    batch.renderOrder_ = renderOrder;
+    batch.geometryType_ = GEOM_INSTANCED;
+
+    BatchGroup& group = queue.batchGroups_.Insert(MakePair(BatchGroupKey(batch), BatchGroup(batch)))->second_;
+    for (unsigned i = 0; i < transforms.Size(); ++i)
+        group.instances_.Push(InstanceData(&transforms[i], 0, 0.0f));
+    return group;
+}
+
+/// Write a queue's instance data on a new frame and upload the changes.
+static void UpdateStore(InstanceDataStore* store, BatchQueue& queue, unsigned frameNumber)
+{
+    store->BeginFrame(frameNumber);
+    store->SetInstancingData(queue);
+    store->Upload();
+}
+
+void RunInstanceDataTests(Context* context)
+{
+    // Without a Graphics subsystem the vertex buffer only has its CPU copy, which is enough to follow the uploads
+    PODVector<VertexElement> elements;
+    elements.Push(VertexElement(TYPE_VECTOR4, SEM_TEXCOORD, 4, true));
+    elements.Push(VertexElement(TYPE_VECTOR4, SEM_TEXCOORD, 5, true));
+    elements.Push(VertexElement(TYPE_VECTOR4, SEM_TEXCOORD, 6, true));
+
+    SharedPtr<InstanceDataStore> store(new InstanceDataStore(context));
+    Check(store->SetVertexElements(elements), "Instance buffer is created");
+
+    PODVector<Matrix3x4> moving(NUM_MOVING_INSTANCES);
+    for (unsigned i = 0; i < NUM_MOVING_INSTANCES; ++i)
+        moving[i] = Matrix3x4(Vector3((float)(i + 1), 0.0f, 0.0f), Quaternion::IDENTITY, 1.0f);
+    PODVector<Matrix3x4> zero(NUM_ZERO_INSTANCES);
+    for (unsigned i = 0; i < NUM_ZERO_INSTANCES; ++i)
+        zero[i] = Matrix3x4::ZERO;
+
+    BatchQueue queue;
+    BatchGroup& movingGroup = AddGroup(queue, 0, moving);
+    BatchGroup& zeroGroup = AddGroup(queue, 1, zero);
+
+    // The ranges of 16 and 4 slots are new, so they are uploaded whole in one merged range, including the zero instances
+    UpdateStore(store, queue, 1);
+    Check(movingGroup.startIndex_ != M_MAX_UNSIGNED && zeroGroup.startIndex_ != M_MAX_UNSIGNED, "Instanced groups get slot ranges");
+    Check(store->GetNumInstances() == NUM_MOVING_INSTANCES + NUM_ZERO_INSTANCES, "Written instances are counted");
+    Check(store->GetNumUploads() == 1 && store->GetNumUploadedInstances() == 20, "New slot ranges are uploaded whole once");
+    Check(store->GetUploadedBytes() == 20 * store->GetVertexBuffer()->GetVertexSize(), "Uploaded bytes are counted");
+
+    UpdateStore(store, queue, 2);
+    Check(store->GetNumUploads() == 0 && store->GetNumUploadedInstances() == 0, "Unchanged instances are not uploaded");
+
+    // Changed slots within the merge distance are uploaded as one range, farther ones separately
+    moving[3].m03_ += 1.0f;
+    moving[7].m03_ += 1.0f;
+    UpdateStore(store, queue, 3);
+    Check(store->GetNumUploads() == 1 && store->GetNumUploadedInstances() == 5, "Nearby changed instances upload as one range");
+
+    moving[0].m03_ += 1.0f;
+    moving[9].m03_ += 1.0f;
+    UpdateStore(store, queue, 4);
+    Check(store->GetNumUploads() == 2 && store->GetNumUploadedInstances() == 2, "Distant changed instances upload separately");
+
+    // Growing the buffer discards the GPU contents, so every allocated slot is uploaded again along with the new range
+    PODVector<Matrix3x4> large(NUM_LARGE_INSTANCES);
+    for (unsigned i = 0; i < NUM_LARGE_INSTANCES; ++i)
+        large[i] = Matrix3x4(Vector3(0.0f, (float)i, 0.0f), Quaternion::IDENTITY, 1.0f);
+    BatchGroup& largeGroup = AddGroup(queue, 2, large);
+    UpdateStore(store, queue, 5);
+    Check(largeGroup.startIndex_ == 20 && store->GetVertexBuffer()->GetVertexCount() == 4096, "Instance buffer grows to fit");
+    Check(store->GetNumUploads() == 1 && store->GetNumUploadedInstances() == 20 + 2048,
+        "All allocated slots are uploaded after the buffer grows");
+
+    UpdateStore(store, queue, 6);
+    Check(store->GetNumUploads() == 0, "Nothing is uploaded once the grown buffer is in sync");
+}
@@ -0,0 +1,324 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Atomic/IO/File.h>
+#include <Atomic/IO/FileSystem.h>
+#include <Atomic/IO/PackageFile.h>
+#include <Atomic/IO/VectorBuffer.h>
+
+#include <ThirdParty/LZ4/lz4.h>
+
+#include "EngineTests.h"
+
+#include <Atomic/DebugNew.h>
+
+static const unsigned COMPRESSED_BLOCK_SIZE = 32768;
+static const unsigned LARGE_FILE_SIZE = 100000;
+static const unsigned SMALL_FILE_SIZE = 1000;
+static const unsigned PARTIAL_READ_SIZE = 1000;
+static const unsigned NUM_INDEXED_FILES = 300;
+/// Offset of the displacement table in a version 2 package: file ID, number of files, checksum and name table size.
+static const unsigned INDEX_DISPLACEMENTS_OFFSET = 16;
+
+/// Return compressible test file contents that differ per seed.
+static PODVector<unsigned char> GetFileContents(unsigned size, unsigned seed)
+{
+    PODVector<unsigned char> data(size);
+    for (unsigned i = 0; i < size; ++i)
+        data[i] = (unsigned char)((i * seed + (i >> 6)) & 0x3f);
+    return data;
+}
+
+/// Compress data into LZ4 blocks in the package file format. Optionally overwrite the first block with garbage.
+static void CompressBlocks(VectorBuffer& dest, const PODVector<unsigned char>& data, bool corrupt)
+{
+    SharedArrayPtr<unsigned char> compressBuffer(new unsigned char[LZ4_compressBound(COMPRESSED_BLOCK_SIZE)]);
+
+    for (unsigned pos = 0; pos < data.Size(); pos += COMPRESSED_BLOCK_SIZE)
+    {
+        unsigned unpackedSize = Min(data.Size() - pos, COMPRESSED_BLOCK_SIZE);
+        int packedSize = LZ4_compress_default((const char*)&data[pos], (char*)compressBuffer.Get(), unpackedSize,
+            LZ4_compressBound(COMPRESSED_BLOCK_SIZE));
+        if (corrupt && !pos)
+            memset(compressBuffer.Get(), 0xff, (size_t)packedSize);
+
+        dest.WriteUShort((unsigned short)unpackedSize);
+        dest.WriteUShort((unsigned short)packedSize);
+        dest.Write(compressBuffer.Get(), (unsigned)packedSize);
+    }
+}
+
+/// Write a compressed version 1 package.
+static bool WriteCompressedPackage(Context* context, const String& fileName, const Vector<String>& names,
+    const Vector<PODVector<unsigned char> >& contents, bool corrupt)
+{
+    unsigned directorySize = 3 * sizeof(unsigned);
+    for (unsigned i = 0; i < names.Size(); ++i)
+        directorySize += names[i].Length() + 1 + 3 * sizeof(unsigned);
+
+    VectorBuffer data;
+    PODVector<unsigned> offsets;
+    for (unsigned i = 0; i < names.Size(); ++i)
+    {
+        offsets.Push(directorySize + data.GetSize());
+        CompressBlocks(data, contents[i], corrupt);
+    }
+
+    File file(context, fileName, FILE_WRITE);
+    file.WriteFileID("ULZ4");
+    file.WriteUInt(names.Size());
+    file.WriteUInt(0);
+    for (unsigned i = 0; i < names.Size(); ++i)
+    {
+        file.WriteString(names[i]);
+        file.WriteUInt(offsets[i]);
+        file.WriteUInt(contents[i].Size());
+        file.WriteUInt(0);
+    }
+    return file.Write(data.GetData(), data.GetSize()) == data.GetSize();
+}
+
+/// Write a version 2 package with a hashed directory index. Every third entry is compressed.
+static bool WriteIndexedPackage(Context* context, const String& fileName, const Vector<String>& names,
+    const Vector<PODVector<unsigned char> >& contents)
+{
+    PODVector<PackageEntry> entries(names.Size());
+    memset(&entries[0], 0, entries.Size() * sizeof(PackageEntry));
+
+    // The directory size does not depend on the entries, so measure it with placeholder entries first
+    VectorBuffer directory;
+    if (!PackageFile::WriteDirectory(directory, names, entries, 0))
+        return false;
+
+    VectorBuffer data;
+    for (unsigned i = 0; i < names.Size(); ++i)
+    {
+        PackageEntry& entry = entries[i];
+        entry.offset_ = directory.GetSize() + data.GetSize();
+        entry.size_ = contents[i].Size();
+        entry.codec_ = i % 3 ? PACKAGE_CODEC_NONE : PACKAGE_CODEC_LZ4;
+        if (entry.codec_ == PACKAGE_CODEC_NONE)
+            data.Write(&contents[i][0], contents[i].Size());
+        else
+            CompressBlocks(data, contents[i], false);
+        entry.packedSize_ = directory.GetSize() + data.GetSize() - entry.offset_;
+    }
+
+    File file(context, fileName, FILE_WRITE);
+    if (!PackageFile::WriteDirectory(file, names, entries, 0))
+        return false;
+    return file.Write(data.GetData(), data.GetSize()) == data.GetSize();
+}
+
+/// Copy a package file with one directory displacement replaced.
+static void WritePatchedPackage(Context* context, const String& srcFileName, const String& destFileName, int displacement)
+{
+    File src(context, srcFileName);
+    PODVector<unsigned char> data(src.GetSize());
+    src.Read(&data[0], data.Size());
+    memcpy(&data[INDEX_DISPLACEMENTS_OFFSET], &displacement, sizeof displacement);
+
+    File dest(context, destFileName, FILE_WRITE);
+    dest.Write(&data[0], data.Size());
+}
+
+/// Read a package entry whole, or in a partial read followed by the rest. Return true if the contents match.
+static bool ReadEntry(Context* context, PackageFile* package, const String& name, const PODVector<unsigned char>& expected,
+    bool partial)
+{
+    File file(context, package, name);
+    if (!file.IsOpen() || file.GetSize() != expected.Size())
+        return false;
+
+    PODVector<unsigned char> data(expected.Size());
+    unsigned firstSize = partial ? Min(PARTIAL_READ_SIZE, data.Size()) : data.Size();
+    if (file.Read(&data[0], firstSize) != firstSize)
+        return false;
+    if (firstSize < data.Size() && file.Read(&data[firstSize], data.Size() - firstSize) != data.Size() - firstSize)
+        return false;
+
+    return !memcmp(&data[0], &expected[0], data.Size());
+}
+
+/// Read a package entry whole. Return true if the read returned fewer bytes than the entry size.
+static bool ReadFails(Context* context, PackageFile* package, const String& name)
+{
+    File file(context, package, name);
+    PODVector<unsigned char> data(file.GetSize());
+    return data.Empty() || file.Read(&data[0], data.Size()) != data.Size();
+}
+
+void RunPackageFileTests(Context* context)
+{
+    FileSystem* fileSystem = context->GetSubsystem<FileSystem>();
+    String dir = fileSystem->GetCurrentDir() + "PackageFileTests/";
+    fileSystem->CreateDir(dir);
+
+    Vector<String> names;
+    Vector<PODVector<unsigned char> > contents;
+    names.Push("Data/Large.bin");
+    contents.Push(GetFileContents(LARGE_FILE_SIZE, 7));
+    names.Push("Data/Small.bin");
+    contents.Push(GetFileContents(SMALL_FILE_SIZE, 13));
+
+    Check(WriteCompressedPackage(context, dir + "Compressed.pak", names, contents, false), "Compressed package is written");
+    Check(WriteCompressedPackage(context, dir + "Corrupt.pak", names, contents, true), "Corrupt package is written");
+
+    for (unsigned mapped = 0; mapped < 2; ++mapped)
+    {
+        SharedPtr<PackageFile> package(new PackageFile(context));
+        Check(package->Open(dir + "Compressed.pak", 0, mapped != 0) && package->IsCompressed(), "Compressed package opens");
+        Check(package->IsMemoryMapped() == (mapped != 0), "Package is memory mapped when requested");
+
+        bool intact = true;
+        for (unsigned i = 0; i < names.Size(); ++i)
+        {
+            intact &= ReadEntry(context, package, names[i], contents[i], false);
+            intact &= ReadEntry(context, package, names[i], contents[i], true);
+        }
+        Check(intact, mapped ? "Mapped compressed entries read back intact" : "Compressed entries read back intact");
+
+        // A corrupt block must fail the read instead of decompressing past the block
+        SharedPtr<PackageFile> corruptPackage(new PackageFile(context));
+        Check(corruptPackage->Open(dir + "Corrupt.pak", 0, mapped != 0), "Corrupt package opens");
+        bool failed = true;
+        for (unsigned i = 0; i < names.Size(); ++i)
+            failed &= ReadFails(context, corruptPackage, names[i]);
+        Check(failed, mapped ? "Corrupt mapped blocks fail the read" : "Corrupt blocks fail the read");
+    }
+
+    // Packaging helpers store incompressible entries as is, and entries with identical contents once
+    {
+        PODVector<unsigned char> noise(LARGE_FILE_SIZE);
+        unsigned seed = 1;
+        for (unsigned i = 0; i < noise.Size(); ++i)
+        {
+            seed = seed * 1103515245 + 12345;
+            noise[i] = (unsigned char)(seed >> 16);
+        }
+
+        PackageCodec codec = PACKAGE_CODEC_LZ4HC;
+        VectorBuffer packed;
+        Check(PackageFile::CompressEntry(&contents[0][0], contents[0].Size(), codec, packed) &&
+            codec == PACKAGE_CODEC_LZ4HC && packed.GetSize() < contents[0].Size(), "Compressible entry is compressed");
+        packed.Clear();
+        Check(PackageFile::CompressEntry(&noise[0], noise.Size(), codec, packed) && codec == PACKAGE_CODEC_NONE,
+            "Incompressible entry is stored as is");
+
+        const PODVector<unsigned char>* entryContents[] = { &contents[0], &contents[1], &contents[0] };
+        PODVector<PackageEntry> entries(3);
+        memset(&entries[0], 0, entries.Size() * sizeof(PackageEntry));
+        HashMap<unsigned long long, unsigned> contentEntries;
+        unsigned originals[3];
+        for (unsigned i = 0; i < entries.Size(); ++i)
+        {
+            const PODVector<unsigned char>& data = *entryContents[i];
+            PackageEntry& entry = entries[i];
+            entry.offset_ = (i + 1) * LARGE_FILE_SIZE;
+            entry.size_ = data.Size();
+            for (unsigned j = 0; j < data.Size(); ++j)
+                entry.checksum_ = SDBMHash(entry.checksum_, data[j]);
+            originals[i] = PackageFile::FindDuplicateEntry(entries, i, &data[0], contentEntries);
+        }
+        Check(originals[0] == M_MAX_UNSIGNED && originals[1] == M_MAX_UNSIGNED, "Distinct entries are not duplicates");
+        Check(originals[2] == 0 && entries[2].offset_ == entries[0].offset_, "Identical entry shares the earlier entry's data");
+    }
+
+    // Version 2 package round trip. Enough entries for the perfect hash builder to see both multi-entry buckets that
+    // need a displacement search and single entry buckets that are placed directly
+    Vector<String> indexedNames;
+    Vector<PODVector<unsigned char> > indexedContents;
+    for (unsigned i = 0; i < NUM_INDEXED_FILES; ++i)
+    {
+        indexedNames.Push("Dir" + String(i % 10) + "/File" + String(i) + ".bin");
+        indexedContents.Push(GetFileContents(10 + i * 7, i + 1));
+    }
+    Check(WriteIndexedPackage(context, dir + "Indexed.pak", indexedNames, indexedContents), "Indexed package is written");
+
+    Vector<String> duplicateNames = indexedNames;
+    duplicateNames.Push(indexedNames[0]);
+    PODVector<PackageEntry> duplicateEntries(duplicateNames.Size());
+    memset(&duplicateEntries[0], 0, duplicateEntries.Size() * sizeof(PackageEntry));
+    VectorBuffer duplicateDirectory;
+    Check(!PackageFile::WriteDirectory(duplicateDirectory, duplicateNames, duplicateEntries, 0),
+        "Directory with duplicate names is not written");
+
+    for (unsigned mapped = 0; mapped < 2; ++mapped)
+    {
+        SharedPtr<PackageFile> package(new PackageFile(context));
+        Check(package->Open(dir + "Indexed.pak", 0, mapped != 0) && package->HasDirectoryIndex(), "Indexed package opens");
+        Check(package->GetNumFiles() == NUM_INDEXED_FILES, "Indexed package has all entries");
+
+        bool found = true;
+        bool intact = true;
+        bool viewed = true;
+        for (unsigned i = 0; i < NUM_INDEXED_FILES; ++i)
+        {
+            const PackageEntry* entry = package->GetEntry(indexedNames[i]);
+            found &= entry && entry->size_ == indexedContents[i].Size();
+            intact &= ReadEntry(context, package, indexedNames[i], indexedContents[i], false);
+
+            unsigned size;
+            const unsigned char* view = package->GetEntryData(indexedNames[i], size);
+            if (mapped && i % 3)
+                viewed &= view && size == indexedContents[i].Size() && !memcmp(view, &indexedContents[i][0], size);
+            else
+                viewed &= !view;
+        }
+        Check(found, "Every entry is found through the directory index");
+        Check(intact, mapped ? "Mapped indexed entries read back intact" : "Indexed entries read back intact");
+        Check(viewed, "Only uncompressed entries of mapped packages have data views");
+        Check(!package->Exists("Dir0/Missing.bin") && !package->Exists("Dir0/File0.bi") && !package->Exists(""),
+            "Names not in the package are not found");
+
+        const HashMap<String, PackageEntry>& entries = package->GetEntries();
+        bool matches = entries.Size() == NUM_INDEXED_FILES;
+        for (unsigned i = 0; i < NUM_INDEXED_FILES && matches; ++i)
+        {
+            HashMap<String, PackageEntry>::ConstIterator j = entries.Find(indexedNames[i]);
+            matches &= j != entries.End() && j->second_.offset_ == package->GetEntry(indexedNames[i])->offset_;
+        }
+        Check(matches, "Entry map matches the directory index");
+    }
+
+    // A file opened from a mapped package keeps the mapping alive after the package is destroyed
+    {
+        SharedPtr<PackageFile> package(new PackageFile(context));
+        package->Open(dir + "Indexed.pak", 0, true);
+        SharedPtr<File> file(new File(context, package, indexedNames[1]));
+        package.Reset();
+
+        PODVector<unsigned char> data(indexedContents[1].Size());
+        Check(file->IsOpen() && file->Read(&data[0], data.Size()) == data.Size() &&
+            !memcmp(&data[0], &indexedContents[1][0], data.Size()), "Mapped file reads after its package is destroyed");
+    }
+
+    // Displacements the lookup can not use must reject the directory
+    WritePatchedPackage(context, dir + "Indexed.pak", dir + "BadSlot.pak", -(int)NUM_INDEXED_FILES - 1);
+    WritePatchedPackage(context, dir + "Indexed.pak", dir + "MinInt.pak", M_MIN_INT);
+    SharedPtr<PackageFile> badPackage(new PackageFile(context));
+    Check(!badPackage->Open(dir + "BadSlot.pak"), "Direct slot outside the directory is rejected");
+    Check(!badPackage->Open(dir + "MinInt.pak"), "Minimum integer displacement is rejected");
+
+    fileSystem->RemoveDir(dir, true);
+}
@@ -0,0 +1,140 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Atomic/Graphics/RenderCommandBuffer.h>
+#include <Atomic/Math/Matrix3x4.h>
+
+#include "EngineTests.h"
+
+#include <Atomic/DebugNew.h>
+
+static const StringHash PARAM_COLOR("MatDiffColor");
+static const StringHash PARAM_MODEL("Model");
+
+void RunRenderCommandTests(Context* context)
+{
+    // The null backend never dereferences the recorded objects, so stand-ins are enough
+    char objects[8];
+    ShaderVariation* vs = (ShaderVariation*)&objects[0];
+    ShaderVariation* ps = (ShaderVariation*)&objects[1];
+    ShaderVariation* otherPs = (ShaderVariation*)&objects[2];
+    Texture* texture = (Texture*)&objects[3];
+    VertexBuffer* vertexBuffer = (VertexBuffer*)&objects[4];
+    IndexBuffer* indexBuffer = (IndexBuffer*)&objects[5];
+
+    SharedPtr<RenderCommandBuffer> buffer(new RenderCommandBuffer());
+
+    {
+        buffer->SetBlendMode(BLEND_ALPHA);
+        buffer->SetBlendMode(BLEND_ALPHA);
+        buffer->SetBlendMode(BLEND_ALPHA, true);
+        buffer->SetDepthTest(CMP_LESSEQUAL);
+        buffer->SetDepthTest(CMP_LESSEQUAL);
+        buffer->SetScissorTest(false, IntRect(0, 0, 10, 10));
+        buffer->SetScissorTest(false, IntRect(5, 5, 20, 20));
+        buffer->SetScissorTest(true, IntRect(5, 5, 20, 20));
+        Check(buffer->GetNumCommands() == 5, "Repeated state commands are dropped");
+        Check(buffer->GetNumRedundantCommands() == 3, "Dropped state commands are counted");
+
+        buffer->ResetState();
+        buffer->SetBlendMode(BLEND_ALPHA, true);
+        Check(buffer->GetNumCommands() == 6, "State is recorded again after ResetState");
+    }
+
+    {
+        buffer->Clear();
+        buffer->SetTexture(0, texture);
+        buffer->SetTexture(0, texture);
+        buffer->SetTexture(1, texture);
+        buffer->SetTexture(0, 0);
+        buffer->SetTexture(MAX_TEXTURE_UNITS, texture);
+        buffer->SetVertexBuffer(vertexBuffer);
+        buffer->SetVertexBuffer(vertexBuffer);
+        buffer->SetIndexBuffer(indexBuffer);
+        buffer->SetIndexBuffer(indexBuffer);
+        Check(buffer->GetNumCommands() == 5, "Repeated resource bindings are dropped");
+
+        PODVector<VertexBuffer*> buffers;
+        buffers.Push(vertexBuffer);
+        buffer->SetVertexBuffers(buffers);
+        buffer->SetVertexBuffer(vertexBuffer);
+        Check(buffer->GetNumCommands() == 7, "Vertex buffer is bound again after binding a buffer list");
+    }
+
+    {
+        buffer->Clear();
+        buffer->SetShaders(vs, ps);
+        buffer->SetShaderParameter(PARAM_COLOR, Color::RED);
+        buffer->SetShaderParameter(PARAM_COLOR, Color::RED);
+        buffer->SetShaderParameter(PARAM_COLOR, Color::BLUE);
+        buffer->SetShaderParameter(PARAM_MODEL, Matrix3x4::IDENTITY);
+        buffer->SetShaderParameter(PARAM_MODEL, Matrix3x4::IDENTITY);
+        buffer->SetShaders(vs, ps);
+        buffer->SetShaderParameter(PARAM_COLOR, Color::BLUE);
+        Check(buffer->GetNumCommands() == 4, "Repeated shader parameters are dropped while the shaders stay the same");
+
+        buffer->SetShaders(vs, otherPs);
+        buffer->SetShaderParameter(PARAM_COLOR, Color::BLUE);
+        Check(buffer->GetNumCommands() == 6, "Shader parameters are recorded again after a shader change");
+
+        // The same hash with a different type must not be treated as a repeat
+        buffer->SetShaderParameter(PARAM_COLOR, Vector4(0.0f, 0.0f, 1.0f, 1.0f));
+        Check(buffer->GetNumCommands() == 7, "Shader parameter of another type is recorded");
+    }
+
+    {
+        buffer->Clear();
+        buffer->SetShaders(vs, ps);
+        buffer->SetCullMode(CULL_CCW);
+        buffer->SetShaderParameter(PARAM_MODEL, Matrix3x4::IDENTITY);
+        buffer->Draw(TRIANGLE_LIST, 0, 36, 0, 24);
+        buffer->Draw(LINE_LIST, 0, 10);
+        buffer->Draw(TRIANGLE_STRIP, 0, 6);
+        buffer->Draw(TRIANGLE_LIST, 0, 0);
+        buffer->DrawInstanced(TRIANGLE_LIST, 0, 6, 0, 4, 100);
+        buffer->DrawInstanced(TRIANGLE_LIST, 0, 6, 0, 4, 0);
+
+        const PODVector<RenderCommand>& commands = buffer->GetCommands();
+        Check(commands.Size() == 7, "Empty draws are not recorded");
+        Check(commands[0].type_ == RCMD_SHADERS && commands[1].type_ == RCMD_CULLMODE &&
+            commands[2].type_ == RCMD_SHADERPARAMETER && commands[3].type_ == RCMD_DRAWINDEXED &&
+            commands[4].type_ == RCMD_DRAW && commands[6].type_ == RCMD_DRAWINSTANCED, "Commands are kept in recording order");
+
+        RenderCommandStats stats = buffer->Execute(0);
+        Check(stats.numStateCommands_ == 2, "Null backend counts state commands");
+        Check(stats.numParameterCommands_ == 1, "Null backend counts shader parameter commands");
+        Check(stats.numDrawCommands_ == 4, "Null backend counts draw commands");
+        Check(stats.numPrimitives_ == 12 + 5 + 4 + 200, "Null backend counts primitives of all primitive types and instances");
+
+        RenderCommandStats again = buffer->Execute(0);
+        Check(again.numStateCommands_ == stats.numStateCommands_ && again.numPrimitives_ == stats.numPrimitives_,
+            "Replay does not consume the buffer");
+    }
+
+    {
+        buffer->Clear();
+        Check(buffer->GetNumCommands() == 0 && buffer->GetNumRedundantCommands() == 0, "Clear removes commands and counts");
+        buffer->SetShaders(vs, ps);
+        Check(buffer->GetNumCommands() == 1, "Clear forgets the recorded state");
+    }
+}
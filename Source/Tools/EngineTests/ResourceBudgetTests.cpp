@@ -0,0 +1,222 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Atomic/Core/CoreEvents.h>
+#include <Atomic/Core/Timer.h>
+#include <Atomic/Resource/ResourceCache.h>
+
+#include "EngineTests.h"
+
+#include <Atomic/DebugNew.h>
+
+static const unsigned NUM_RESOURCES = 10;
+static const unsigned RESOURCE_SIZE = 1024;
+static const unsigned MIN_RESOURCE_SIZE = 256;
+static const unsigned MAX_FRAMES = 100;
+static const unsigned ACCESS_INTERVAL_MS = 5;
+
+/// Resource whose quality reduction halves the memory use down to a minimum size, and counts the reduction and restore attempts.
+class BudgetTestResource : public Resource
+{
+    ATOMIC_OBJECT(BudgetTestResource, Resource);
+
+public:
+    /// Construct.
+    BudgetTestResource(Context* context) :
+        Resource(context),
+        reductions_(0),
+        restorations_(0)
+    {
+        SetMemoryUse(RESOURCE_SIZE);
+    }
+
+    /// Halve the memory use unless at the minimum size.
+    virtual bool ReduceQuality()
+    {
+        ++reductions_;
+        if (GetMemoryUse() <= MIN_RESOURCE_SIZE)
+            return false;
+        SetMemoryUse(GetMemoryUse() / 2);
+        return true;
+    }
+
+    /// Restore the full size.
+    virtual bool RestoreQuality()
+    {
+        ++restorations_;
+        SetMemoryUse(RESOURCE_SIZE);
+        return true;
+    }
+
+    /// Return the full size.
+    virtual unsigned GetRestoredMemoryUse() const { return RESOURCE_SIZE; }
+
+    /// Number of ReduceQuality() calls.
+    unsigned reductions_;
+    /// Number of RestoreQuality() calls.
+    unsigned restorations_;
+};
+
+static void SendFrames(Context* context, ResourceCache* cache, unsigned count)
+{
+    for (unsigned i = 0; i < count; ++i)
+    {
+        VariantMap& eventData = context->GetEventDataMap();
+        eventData[BeginFrame::P_FRAMENUMBER] = i;
+        eventData[BeginFrame::P_TIMESTEP] = 0.016f;
+        cache->SendEvent(E_BEGINFRAME, eventData);
+    }
+}
+
+static const ResourceGroup& GetGroup(ResourceCache* cache)
+{
+    static const ResourceGroup noGroup;
+    HashMap<StringHash, ResourceGroup>::ConstIterator i = cache->GetAllResources().Find(BudgetTestResource::GetTypeStatic());
+    return i != cache->GetAllResources().End() ? i->second_ : noGroup;
+}
+
+static unsigned GetNumDemotions(ResourceCache* cache)
+{
+    return GetGroup(cache).demotions_;
+}
+
+static unsigned GetNumReductionCalls(const Vector<SharedPtr<BudgetTestResource> >& resources)
+{
+    unsigned calls = 0;
+    for (unsigned i = 0; i < resources.Size(); ++i)
+        calls += resources[i]->reductions_;
+    return calls;
+}
+
+static unsigned GetNumRestoreCalls(const Vector<SharedPtr<BudgetTestResource> >& resources)
+{
+    unsigned calls = 0;
+    for (unsigned i = 0; i < resources.Size(); ++i)
+        calls += resources[i]->restorations_;
+    return calls;
+}
+
+/// Add an unreferenced resource to the cache, after a pause so that its last access time differs from the previous ones.
+static void AddUnreferenced(Context* context, ResourceCache* cache, const String& name)
+{
+    Time::Sleep(ACCESS_INTERVAL_MS);
+    SharedPtr<BudgetTestResource> resource(new BudgetTestResource(context));
+    resource->SetName(name);
+    resource->ResetUseTimer();
+    cache->AddManualResource(resource);
+}
+
+static bool IsCached(ResourceCache* cache, const String& name)
+{
+    return cache->GetExistingResource<BudgetTestResource>(name) != 0;
+}
+
+static void RunEvictionTests(Context* context)
+{
+    SharedPtr<ResourceCache> cache(new ResourceCache(context));
+    StringHash type = BudgetTestResource::GetTypeStatic();
+    cache->SetMemoryBudget(type, 4 * RESOURCE_SIZE);
+
+    for (unsigned i = 0; i < 4; ++i)
+        AddUnreferenced(context, cache, "Lru/" + String(i));
+    Check(GetGroup(cache).evictions_ == 0, "Resources within the budget are not evicted");
+
+    // Use the oldest resource, so that the second oldest becomes the least recently used
+    Time::Sleep(ACCESS_INTERVAL_MS);
+    Check(cache->GetResource<BudgetTestResource>("Lru/0", false) != 0, "Cached resource is found");
+    Check(GetGroup(cache).hits_ == 1 && GetGroup(cache).misses_ == 0, "Finding a cached resource counts a hit");
+    Check(!cache->GetResource<BudgetTestResource>("Lru/Missing", false), "Missing resource is not found");
+    Check(GetGroup(cache).hits_ == 1 && GetGroup(cache).misses_ == 1, "Loading an uncached resource counts a miss");
+
+    AddUnreferenced(context, cache, "Lru/4");
+    Check(!IsCached(cache, "Lru/1") && IsCached(cache, "Lru/0") && IsCached(cache, "Lru/2"),
+        "Least recently used unreferenced resource is evicted first");
+    AddUnreferenced(context, cache, "Lru/5");
+    Check(!IsCached(cache, "Lru/2") && IsCached(cache, "Lru/0") && IsCached(cache, "Lru/3"),
+        "Eviction continues in least recently used order");
+    Check(GetGroup(cache).evictions_ == 2 && GetGroup(cache).evictedBytes_ == 2 * RESOURCE_SIZE,
+        "Evictions and evicted bytes are counted");
+    Check(cache->GetMemoryUse(type) == 4 * RESOURCE_SIZE, "Eviction meets the budget");
+
+    // A referenced resource is skipped even when least recently used
+    SharedPtr<BudgetTestResource> referenced(cache->GetExistingResource<BudgetTestResource>("Lru/3"));
+    AddUnreferenced(context, cache, "Lru/6");
+    Check(IsCached(cache, "Lru/3") && !IsCached(cache, "Lru/0"), "Referenced resources are not evicted");
+    Check(GetGroup(cache).evictions_ == 3, "Each eviction is counted once");
+}
+
+void RunResourceBudgetTests(Context* context)
+{
+    SharedPtr<ResourceCache> cache(new ResourceCache(context));
+    StringHash type = BudgetTestResource::GetTypeStatic();
+    cache->SetMemoryBudget(type, NUM_RESOURCES * RESOURCE_SIZE * 3 / 4);
+
+    // The test keeps references to the resources, so they can not be evicted and are reduced in quality instead
+    Vector<SharedPtr<BudgetTestResource> > resources;
+    for (unsigned i = 0; i < NUM_RESOURCES; ++i)
+    {
+        SharedPtr<BudgetTestResource> resource(new BudgetTestResource(context));
+        resource->SetName("Budget/" + String(i));
+        cache->AddManualResource(resource);
+        resources.Push(resource);
+    }
+
+    Check(cache->GetMemoryUse(type) == NUM_RESOURCES * RESOURCE_SIZE, "Resources in use are not evicted when over budget");
+    Check(GetNumReductionCalls(resources) == 0, "Quality is not reduced while resources are added");
+
+    SendFrames(context, cache, 1);
+    Check(GetNumDemotions(cache) == 1, "At most one resource is reduced in quality per frame");
+
+    SendFrames(context, cache, MAX_FRAMES);
+    Check(cache->GetMemoryUse(type) <= cache->GetMemoryBudget(type), "Quality reduction meets the budget");
+    Check(cache->GetMemoryUse(type) > cache->GetMemoryBudget(type) - RESOURCE_SIZE / 2, "Quality reduction stops once within the budget");
+
+    // Shrink the budget below what reduction can reach. Once no resource can be reduced further, stop trying
+    cache->SetMemoryBudget(type, NUM_RESOURCES * MIN_RESOURCE_SIZE / 2);
+    SendFrames(context, cache, MAX_FRAMES);
+    Check(cache->GetMemoryUse(type) == NUM_RESOURCES * MIN_RESOURCE_SIZE, "All resources are reduced to the minimum size");
+    unsigned calls = GetNumReductionCalls(resources);
+    SendFrames(context, cache, MAX_FRAMES);
+    Check(GetNumReductionCalls(resources) == calls, "Quality reduction is not retried when nothing can be reduced");
+
+    // Raise the budget so that only part of the resources fit at full quality
+    unsigned long long budget = NUM_RESOURCES * MIN_RESOURCE_SIZE + 3 * (RESOURCE_SIZE - MIN_RESOURCE_SIZE);
+    cache->SetMemoryBudget(type, budget);
+    SendFrames(context, cache, 1);
+    Check(cache->GetMemoryUse(type) == NUM_RESOURCES * MIN_RESOURCE_SIZE + RESOURCE_SIZE - MIN_RESOURCE_SIZE,
+        "At most one resource is restored per frame");
+    Check(GetNumRestoreCalls(resources) == 1, "Quality is restored once back under budget");
+    SendFrames(context, cache, MAX_FRAMES);
+    Check(cache->GetMemoryUse(type) == budget, "Resources are restored while they fit the budget");
+    Check(GetNumRestoreCalls(resources) == 3, "Quality is not restored when the full size does not fit the budget");
+    unsigned demotions = GetNumDemotions(cache);
+    SendFrames(context, cache, MAX_FRAMES);
+    Check(GetNumDemotions(cache) == demotions, "Restored resources are not reduced again");
+
+    cache->SetMemoryBudget(type, 0);
+    SendFrames(context, cache, MAX_FRAMES);
+    Check(cache->GetMemoryUse(type) == NUM_RESOURCES * RESOURCE_SIZE, "All resources are restored without a budget");
+    Check(GetNumRestoreCalls(resources) == NUM_RESOURCES, "Each demoted resource is restored once");
+
+    RunEvictionTests(context);
+}
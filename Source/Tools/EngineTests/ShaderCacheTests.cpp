@@ -0,0 +1,113 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Atomic/Graphics/ShaderPrecache.h>
+#include <Atomic/IO/MemoryBuffer.h>
+#include <Atomic/IO/VectorBuffer.h>
+
+#include "EngineTests.h"
+
+#include <Atomic/DebugNew.h>
+
+static const char* TEST_DRIVER = "Vendor Renderer 4.5.0 Driver 1.0";
+
+/// Return the source hash of a shader the way OpenGL shader variations compute it: over the final code including defines.
+static unsigned long long GetSourceHash(const String& defines, const String& code)
+{
+    String shaderCode = defines + code;
+    return FNV1aHash64(shaderCode.CString(), shaderCode.Length());
+}
+
+/// Return a program binary cache file written with a key and payload.
+static VectorBuffer GetBinaryFile(const String& key, const PODVector<unsigned char>& payload)
+{
+    VectorBuffer file;
+    WriteShaderProgramBinary(file, key, 0x1234, &payload[0], payload.Size());
+    file.Seek(0);
+    return file;
+}
+
+void RunShaderCacheTests(Context* context)
+{
+    String vsCode = "void VS() { gl_Position = vec4(0.0); }\n";
+    String psCode = "void PS() { gl_FragColor = vec4(1.0); }\n";
+    unsigned long long vsHash = GetSourceHash("#define COMPILEVS\n", vsCode);
+    unsigned long long psHash = GetSourceHash("#define COMPILEPS\n", psCode);
+    String key = GetShaderProgramCacheKey(vsHash, psHash, TEST_DRIVER);
+
+    Check(key.Length() == 16, "Key is 16 hex digits");
+    Check(key == GetShaderProgramCacheKey(vsHash, psHash, TEST_DRIVER), "Key is deterministic");
+    Check(key != GetShaderProgramCacheKey(vsHash, psHash, "Vendor Renderer 4.5.0 Driver 1.1"), "Key changes with the driver");
+    Check(key != GetShaderProgramCacheKey(GetSourceHash("#define COMPILEVS\n", vsCode + " "), psHash, TEST_DRIVER),
+        "Key changes with the vertex shader source");
+    Check(key != GetShaderProgramCacheKey(vsHash, GetSourceHash("#define COMPILEPS\n", psCode + "//\n"), TEST_DRIVER),
+        "Key changes with the pixel shader source");
+    Check(key != GetShaderProgramCacheKey(GetSourceHash("#define COMPILEVS\n#define SKINNED\n", vsCode), psHash, TEST_DRIVER),
+        "Key changes with the vertex shader defines");
+    Check(key != GetShaderProgramCacheKey(vsHash, GetSourceHash("#define COMPILEPS\n#define DIFFMAP\n", psCode), TEST_DRIVER),
+        "Key changes with the pixel shader defines");
+    Check(key != GetShaderProgramCacheKey(psHash, vsHash, TEST_DRIVER), "Key depends on the shader stage order");
+    Check(key != GetShaderProgramCacheKey(vsHash, psHash, TEST_DRIVER, SHADER_PROGRAM_CACHE_VERSION + 1),
+        "Key changes with the cache version");
+
+    PODVector<unsigned char> payload(64);
+    for (unsigned i = 0; i < payload.Size(); ++i)
+        payload[i] = (unsigned char)(i * 7);
+
+    unsigned format = 0;
+    PODVector<unsigned char> data;
+
+    {
+        VectorBuffer file = GetBinaryFile(key, payload);
+        Check(ReadShaderProgramBinary(file, key, format, data), "Binary with a matching key is read");
+        Check(format == 0x1234, "Binary format is preserved");
+        Check(data.Size() == payload.Size() && !memcmp(&data[0], &payload[0], payload.Size()), "Binary data is preserved");
+    }
+
+    {
+        String otherKey = GetShaderProgramCacheKey(vsHash, psHash, "Vendor Renderer 4.5.0 Driver 1.1");
+        VectorBuffer file = GetBinaryFile(otherKey, payload);
+        Check(!ReadShaderProgramBinary(file, key, format, data), "Binary written for another key is discarded");
+    }
+
+    {
+        // Patch the version field that follows the file ID
+        VectorBuffer file = GetBinaryFile(key, payload);
+        unsigned staleVersion = SHADER_PROGRAM_CACHE_VERSION - 1;
+        memcpy(file.GetModifiableData() + 4, &staleVersion, sizeof staleVersion);
+        Check(!ReadShaderProgramBinary(file, key, format, data), "Binary of another cache version is discarded");
+    }
+
+    {
+        VectorBuffer file = GetBinaryFile(key, payload);
+        MemoryBuffer truncated(file.GetData(), file.GetSize() - 1);
+        Check(!ReadShaderProgramBinary(truncated, key, format, data), "Truncated binary is discarded");
+    }
+
+    {
+        VectorBuffer file;
+        file.WriteFileID("UANI");
+        file.Seek(0);
+        Check(!ReadShaderProgramBinary(file, key, format, data), "File of another type is discarded");
+    }
+}
@@ -0,0 +1,274 @@
+//
+// Copyright (c) 2014-2017, THUNDERBEAST GAMES LLC All rights reserved
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Atomic/Core/CoreEvents.h>
+#include <Atomic/Core/Timer.h>
+#include <Atomic/Core/WorkQueue.h>
+#include <Atomic/Graphics/Terrain.h>
+#include <Atomic/Graphics/TerrainPatch.h>
+#include <Atomic/Graphics/TerrainStreamer.h>
+#include <Atomic/IO/File.h>
+#include <Atomic/IO/FileSystem.h>
+#include <Atomic/Resource/Image.h>
+#include <Atomic/Resource/ResourceCache.h>
+#include <Atomic/Scene/Scene.h>
+
+#include "EngineTests.h"
+
+#include <Atomic/DebugNew.h>
+
+static const int GRID_TILES = 16;
+static const int TILE_SIZE = 16;
+static const unsigned TILE_LEVELS = 5;
+static const unsigned MAX_UPDATES = 2000;
+
+/// Write the heightmap tile pyramid. Every level samples the same height function, so coarser level edges equal every other pixel of the finer level.
+static void WriteTiles(Context* context, const String& dir)
+{
+    for (unsigned level = 0; level < TILE_LEVELS; ++level)
+    {
+        int numLevelTiles = ((GRID_TILES - 1) >> level) + 1;
+        for (int z = 0; z < numLevelTiles; ++z)
+        {
+            for (int x = 0; x < numLevelTiles; ++x)
+            {
+                SharedPtr<Image> image(new Image(context));
+                image->SetSize(TILE_SIZE + 1, TILE_SIZE + 1, 1);
+                for (int j = 0; j <= TILE_SIZE; ++j)
+                {
+                    for (int i = 0; i <= TILE_SIZE; ++i)
+                    {
+                        float worldX = (float)((x * TILE_SIZE + i) << level);
+                        float worldZ = (float)((z * TILE_SIZE + j) << level);
+                        image->SetPixel(i, j, Color(0.5f + 0.4f * Sin(worldX * 2.0f) * Cos(worldZ * 3.0f), 0.0f, 0.0f));
+                    }
+                }
+                image->SavePNG(dir + String(level) + "_" + String(x) + "_" + String(z) + ".png");
+            }
+        }
+    }
+}
+
+/// Update the scene until no tiles are pending and the visible tiles no longer change.
+static void UpdateStreaming(Context* context, Scene* scene, TerrainStreamer* streamer)
+{
+    unsigned stableUpdates = 0;
+    unsigned lastVisible = M_MAX_UNSIGNED;
+
+    for (unsigned i = 0; i < MAX_UPDATES && stableUpdates < 10; ++i)
+    {
+        VariantMap& eventData = context->GetEventDataMap();
+        eventData[BeginFrame::P_FRAMENUMBER] = i;
+        eventData[BeginFrame::P_TIMESTEP] = 0.016f;
+        context->GetSubsystem<ResourceCache>()->SendEvent(E_BEGINFRAME, eventData);
+        scene->Update(0.016f);
+
+        unsigned visible = streamer->GetNumVisibleTiles();
+        if (!streamer->GetNumPendingTiles() && visible == lastVisible)
+            ++stableUpdates;
+        else
+            stableUpdates = 0;
+        lastVisible = visible;
+
+        Time::Sleep(1);
+    }
+}
+
+/// Check that the visible tiles cover the grid exactly once, that adjacent tiles are at most one level apart and that finer tiles stitch to coarser ones.
+static void CheckVisibleTiles(TerrainStreamer* streamer, const IntVector2& focusTile)
+{
+    int levels[GRID_TILES][GRID_TILES];
+    int coverage[GRID_TILES][GRID_TILES];
+    memset(coverage, 0, sizeof coverage);
+
+    for (unsigned level = 0; level < TILE_LEVELS; ++level)
+    {
+        int numLevelTiles = ((GRID_TILES - 1) >> level) + 1;
+        for (int z = 0; z < numLevelTiles; ++z)
+        {
+            for (int x = 0; x < numLevelTiles; ++x)
+            {
+                Terrain* terrain = streamer->GetTileTerrain(IntVector2(x, z), level);
+                if (!terrain || !terrain->GetNode()->IsEnabled())
+                    continue;
+
+                for (int j = z << level; j < Min((z + 1) << level, GRID_TILES); ++j)
+                {
+                    for (int i = x << level; i < Min((x + 1) << level, GRID_TILES); ++i)
+                    {
+                        ++coverage[j][i];
+                        levels[j][i] = (int)level;
+                    }
+                }
+            }
+        }
+    }
+
+    bool covered = true;
+    for (int z = 0; z < GRID_TILES; ++z)
+    {
+        for (int x = 0; x < GRID_TILES; ++x)
+            covered &= coverage[z][x] == 1;
+    }
+    Check(covered, "Visible tiles cover every grid cell exactly once");
+    if (!covered)
+        return;
+
+    Check(levels[focusTile.y_][focusTile.x_] == 0, "Focus tile is shown at the finest level");
+
+    static const IntVector2 offsets[] = { IntVector2(0, 1), IntVector2(0, -1), IntVector2(-1, 0), IntVector2(1, 0) };
+    static const unsigned edges[] = { TERRAIN_EDGE_NORTH, TERRAIN_EDGE_SOUTH, TERRAIN_EDGE_WEST, TERRAIN_EDGE_EAST };
+    bool balanced = true;
+    bool stitched = true;
+
+    for (int z = 0; z < GRID_TILES; ++z)
+    {
+        for (int x = 0; x < GRID_TILES; ++x)
+        {
+            int level = levels[z][x];
+            Terrain* terrain = streamer->GetTileTerrain(IntVector2(x >> level, z >> level), (unsigned)level);
+
+            for (unsigned i = 0; i < 4; ++i)
+            {
+                int nx = x + offsets[i].x_;
+                int nz = z + offsets[i].y_;
+                if (nx < 0 || nz < 0 || nx >= GRID_TILES || nz >= GRID_TILES)
+                    continue;
+
+                int neighborLevel = levels[nz][nx];
+                balanced &= Abs(neighborLevel - level) <= 1;
+                if (neighborLevel > level)
+                    stitched &= (terrain->GetCoarseEdges() & edges[i]) != 0;
+                else if (neighborLevel < level)
+                    stitched &= (terrain->GetFineEdges() & edges[i]) != 0;
+            }
+        }
+    }
+
+    Check(balanced, "Adjacent visible tiles are at most one level apart");
+    Check(stitched, "Tile edges towards other levels are marked for stitching");
+}
+
+void RunTerrainStreamerTests(Context* context)
+{
+    FileSystem* fileSystem = context->GetSubsystem<FileSystem>();
+    String dir = fileSystem->GetCurrentDir() + "TerrainStreamerTests/";
+    fileSystem->CreateDir(dir + "Tiles");
+
+    context->RegisterSubsystem(new WorkQueue(context));
+    context->GetSubsystem<WorkQueue>()->CreateThreads(2);
+    context->RegisterSubsystem(new ResourceCache(context));
+    context->RegisterSubsystem(new Time(context));
+    Image::RegisterObject(context);
+    Node::RegisterObject(context);
+    Scene::RegisterObject(context);
+    Terrain::RegisterObject(context);
+    TerrainPatch::RegisterObject(context);
+    TerrainStreamer::RegisterObject(context);
+
+    WriteTiles(context, dir + "Tiles/");
+    context->GetSubsystem<ResourceCache>()->AddResourceDir(dir);
+
+    {
+        SharedPtr<Scene> scene(new Scene(context));
+        Node* focus = scene->CreateChild("Focus");
+        TerrainStreamer* streamer = scene->CreateChild("Terrain")->CreateComponent<TerrainStreamer>();
+        streamer->SetNumTiles(IntVector2(GRID_TILES, GRID_TILES));
+        streamer->SetTileSize(TILE_SIZE);
+        streamer->SetPatchSize(8);
+        streamer->SetMaxLodLevels(2);
+        streamer->SetNumTileLevels(TILE_LEVELS);
+        streamer->SetLoadDistance(1);
+        streamer->SetMaxTilesPerFrame(8);
+        streamer->SetTileName("Tiles/{lod}_{x}_{z}.png");
+        streamer->SetFocusNode(focus);
+
+        // Start in a grid corner, then move to the middle so that tiles split and merge
+        focus->SetPosition(Vector3(10.0f, 0.0f, 10.0f));
+        UpdateStreaming(context, scene, streamer);
+        CheckVisibleTiles(streamer, IntVector2(0, 0));
+        Check(streamer->GetNumVisibleTiles() < (unsigned)(GRID_TILES * GRID_TILES / 4), "Distant tiles are shown at coarser levels");
+
+        PODVector<TerrainPatch*> patches;
+        scene->GetComponents<TerrainPatch>(patches, true);
+        unsigned numLocked = 0;
+        for (unsigned i = 0; i < patches.Size(); ++i)
+        {
+            if (patches[i]->IsEnabledEffective() && patches[i]->IsLodLocked())
+                ++numLocked;
+        }
+        Check(numLocked > 0, "Patches along level borders are locked to the finest LOD");
+
+        Vector3 middle((float)(GRID_TILES * TILE_SIZE / 2 + 5), 0.0f, (float)(GRID_TILES * TILE_SIZE / 2 + 3));
+        focus->SetPosition(middle);
+        UpdateStreaming(context, scene, streamer);
+        CheckVisibleTiles(streamer, streamer->WorldToTile(middle));
+        Check(streamer->GetTileTerrain(IntVector2(0, 0)) == 0, "Tiles far from the focus are unloaded");
+        Check(streamer->GetHeight(middle) > 0.0f, "Height is sampled from the visible tile");
+
+        // A single level streams a plain grid around the focus
+        streamer->SetNumTileLevels(1);
+        UpdateStreaming(context, scene, streamer);
+        Check(streamer->GetNumVisibleTiles() == 9, "Single level shows the focus tile and its neighbors");
+    }
+
+    // Corrupt the heightmap of the corner tile. Its load fails in the background, so its parent must stay shown
+    context->GetSubsystem<ResourceCache>()->ReleaseAllResources(true);
+    {
+        File file(context, dir + "Tiles/0_0_0.png", FILE_WRITE);
+        file.WriteString("Not a PNG image");
+    }
+
+    {
+        SharedPtr<Scene> scene(new Scene(context));
+        Node* focus = scene->CreateChild("Focus");
+        TerrainStreamer* streamer = scene->CreateChild("Terrain")->CreateComponent<TerrainStreamer>();
+        streamer->SetNumTiles(IntVector2(GRID_TILES, GRID_TILES));
+        streamer->SetTileSize(TILE_SIZE);
+        streamer->SetPatchSize(8);
+        streamer->SetNumTileLevels(TILE_LEVELS);
+        streamer->SetLoadDistance(1);
+        streamer->SetMaxTilesPerFrame(8);
+        streamer->SetTileName("Tiles/{lod}_{x}_{z}.png");
+        streamer->SetFocusNode(focus);
+
+        focus->SetPosition(Vector3(10.0f, 0.0f, 10.0f));
+        UpdateStreaming(context, scene, streamer);
+        Check(streamer->GetNumPendingTiles() == 0, "Failed heightmap loads do not leave tiles pending");
+
+        Terrain* parent = streamer->GetTileTerrain(IntVector2(0, 0), 1);
+        Check(parent && parent->GetNode()->IsEnabled(), "Parent of a failed tile stays shown");
+        bool childrenHidden = true;
+        for (int z = 0; z < 2; ++z)
+        {
+            for (int x = 0; x < 2; ++x)
+            {
+                Terrain* child = streamer->GetTileTerrain(IntVector2(x, z), 0);
+                childrenHidden &= !child || !child->GetNode()->IsEnabled();
+            }
+        }
+        Check(childrenHidden, "Siblings of a failed tile are not shown over its parent");
+    }
+
+    fileSystem->RemoveDir(dir, true);
+}
@@ -26,6 +26,8 @@
 #include <Atomic/Container/ArrayPtr.h>
 #include <Atomic/IO/File.h>
 #include <Atomic/IO/FileSystem.h>
+#include <Atomic/IO/PackageFile.h>
+#include <Atomic/IO/VectorBuffer.h>
 #include <Atomic/Core/ProcessUtils.h>
 
 #ifdef WIN32
@@ -34,30 +36,18 @@
 
 #include <cstdio>
 #include <cstring>
-#include <ThirdParty/LZ4/lz4.h>
-#include <ThirdParty/LZ4/lz4hc.h>
 
 #include <Atomic/DebugNew.h>
 
 using namespace Atomic;
 
-static const unsigned COMPRESSED_BLOCK_SIZE = 32768;
-
-struct FileEntry
-{
-    String name_;
-    unsigned offset_;
-    unsigned size_;
-    unsigned checksum_;
-};
-
 SharedPtr<Context> context_(new Context());
 SharedPtr<FileSystem> fileSystem_(new FileSystem(context_));
 String basePath_;
-Vector<FileEntry> entries_;
+Vector<String> entryNames_;
+PODVector<PackageEntry> entries_;
 unsigned checksum_ = 0;
-bool compress_ = false;
-unsigned blockSize_ = COMPRESSED_BLOCK_SIZE;
+PackageCodec codec_ = PACKAGE_CODEC_NONE;
 
 String ignoreExtensions_[] = {
     ".bak",
@@ -69,7 +59,7 @@ int main(int argc, char** argv);
 void Run(const Vector<String>& arguments);
 void ProcessFile(const String& fileName, const String& rootDir);
 void WritePackageFile(const String& fileName, const String& rootDir);
-void WriteHeader(File& dest);
+void WriteDirectory(File& dest);
 
 int main(int argc, char** argv)
 {
@@ -92,7 +82,11 @@ void Run(const Vector<String>& arguments)
             "Usage: PackageTool <directory to process> <package name> [basepath] [options]\n"
             "\n"
             "Options:\n"
-            "-c      Enable package file LZ4 compression\n"
+            "-c      Enable package file LZ4 high compression\n"
+            "-f      Enable package file LZ4 fast compression\n"
+            "\n"
+            "Entries that do not compress well are stored uncompressed. Entries with\n"
+            "identical contents are stored once.\n"
         );
     
     const String& dirName = arguments[0];
@@ -110,7 +104,11 @@ void Run(const Vector<String>& arguments)
                     switch (arguments[i][1])
                     {
                     case 'c':
-                        compress_ = true;
+                        codec_ = PACKAGE_CODEC_LZ4HC;
+                        break;
+
+                    case 'f':
+                        codec_ = PACKAGE_CODEC_LZ4;
                         break;
                     }
                 }
@@ -155,11 +153,13 @@ void ProcessFile(const String& fileName, const String& rootDir)
     if (!file.GetSize())
         return;
     
-    FileEntry newEntry;
-    newEntry.name_ = fileName;
+    PackageEntry newEntry;
     newEntry.offset_ = 0; // Offset not yet known
     newEntry.size_ = file.GetSize();
     newEntry.checksum_ = 0; // Will be calculated later
+    newEntry.packedSize_ = 0;
+    newEntry.codec_ = PACKAGE_CODEC_NONE;
+    entryNames_.Push(fileName);
     entries_.Push(newEntry);
 }
 
@@ -171,31 +171,24 @@ void WritePackageFile(const String& fileName, const String& rootDir)
     if (!dest.Open(fileName, FILE_WRITE))
         ErrorExit("Could not open output file " + fileName);
     
-    // Write ID, number of files & placeholder for checksum
-    WriteHeader(dest);
-    
-    for (unsigned i = 0; i < entries_.Size(); ++i)
-    {
-        // Write entry (correct offset is still unknown, will be filled in later)
-        dest.WriteString(entries_[i].name_);
-        dest.WriteUInt(entries_[i].offset_);
-        dest.WriteUInt(entries_[i].size_);
-        dest.WriteUInt(entries_[i].checksum_);
-    }
+    // Write the directory (correct offsets & checksums are still unknown, will be filled in later)
+    WriteDirectory(dest);
     
     unsigned totalDataSize = 0;
+    unsigned numDuplicates = 0;
+    HashMap<unsigned long long, unsigned> contentEntries;
     
     // Write file data, calculate checksums & correct offsets
     for (unsigned i = 0; i < entries_.Size(); ++i)
     {
-        entries_[i].offset_ = dest.GetSize();
-        String fileFullPath = rootDir + "/" + entries_[i].name_;
+        PackageEntry& entry = entries_[i];
+        String fileFullPath = rootDir + "/" + entryNames_[i];
         
         File srcFile(context_, fileFullPath);
         if (!srcFile.IsOpen())
             ErrorExit("Could not open file " + fileFullPath);
         
-        unsigned dataSize = entries_[i].size_;
+        unsigned dataSize = entry.size_;
         totalDataSize += dataSize;
         SharedArrayPtr<unsigned char> buffer(new unsigned char[dataSize]);
         
@@ -206,40 +199,36 @@ void WritePackageFile(const String& fileName, const String& rootDir)
         for (unsigned j = 0; j < dataSize; ++j)
         {
             checksum_ = SDBMHash(checksum_, buffer[j]);
-            entries_[i].checksum_ = SDBMHash(entries_[i].checksum_, buffer[j]);
+            entry.checksum_ = SDBMHash(entry.checksum_, buffer[j]);
         }
         
-        if (!compress_)
+        // Store identical contents only once
+        unsigned original = PackageFile::FindDuplicateEntry(entries_, i, &buffer[0], contentEntries);
+        if (original != M_MAX_UNSIGNED)
         {
-            PrintLine(entries_[i].name_ + " size " + String(dataSize));
-            dest.Write(&buffer[0], entries_[i].size_);
+            ++numDuplicates;
+            PrintLine(entryNames_[i] + " same as " + entryNames_[original]);
+            continue;
+        }
+        
+        entry.offset_ = dest.GetSize();
+        
+        VectorBuffer packed;
+        entry.codec_ = codec_;
+        if (!PackageFile::CompressEntry(&buffer[0], dataSize, entry.codec_, packed))
+            ErrorExit("LZ4 compression failed for file " + entryNames_[i]);
+        
+        if (entry.codec_ == PACKAGE_CODEC_NONE)
+        {
+            PrintLine(entryNames_[i] + " size " + String(dataSize));
+            dest.Write(&buffer[0], dataSize);
+            entry.packedSize_ = dataSize;
         }
         else
         {
-            SharedArrayPtr<unsigned char> compressBuffer(new unsigned char[LZ4_compressBound(blockSize_)]);
-            
-            unsigned pos = 0;
-            unsigned totalPackedBytes = 0;
-            
-            while (pos < dataSize)
-            {
-                unsigned unpackedSize = blockSize_;
-                if (pos + unpackedSize > dataSize)
-                    unpackedSize = dataSize - pos;
-                
-                unsigned packedSize = LZ4_compressHC((const char*)&buffer[pos], (char*)compressBuffer.Get(), unpackedSize);
-                if (!packedSize)
-                    ErrorExit("LZ4 compression failed for file " + entries_[i].name_ + " at offset " + String(pos));
-                
-                dest.WriteUShort(unpackedSize);
-                dest.WriteUShort(packedSize);
-                dest.Write(compressBuffer.Get(), packedSize);
-                totalPackedBytes += 6 + packedSize;
-                
-                pos += unpackedSize;
-            }
-            
-            PrintLine(entries_[i].name_ + " in " + String(dataSize) + " out " + String(totalPackedBytes));
+            PrintLine(entryNames_[i] + " in " + String(dataSize) + " out " + String(packed.GetSize()));
+            dest.Write(packed.GetData(), packed.GetSize());
+            entry.packedSize_ = packed.GetSize();
         }
     }
     
@@ -247,29 +236,18 @@ void WritePackageFile(const String& fileName, const String& rootDir)
     unsigned currentSize = dest.GetSize();
     dest.WriteUInt(currentSize + sizeof(unsigned));
     
-    // Write header again with correct offsets & checksums
+    // Write the directory again with correct offsets & checksums
     dest.Seek(0);
-    WriteHeader(dest);
-    
-    for (unsigned i = 0; i < entries_.Size(); ++i)
-    {
-        dest.WriteString(entries_[i].name_);
-        dest.WriteUInt(entries_[i].offset_);
-        dest.WriteUInt(entries_[i].size_);
-        dest.WriteUInt(entries_[i].checksum_);
-    }
+    WriteDirectory(dest);
     
     PrintLine("Number of files " + String(entries_.Size()));
+    PrintLine("Duplicate files " + String(numDuplicates));
     PrintLine("File data size " + String(totalDataSize));
     PrintLine("Package size " + String(dest.GetSize()));
 }
 
-void WriteHeader(File& dest)
+void WriteDirectory(File& dest)
 {
-    if (!compress_)
-        dest.WriteFileID("UPAK");
-    else
-        dest.WriteFileID("ULZ4");
-    dest.WriteUInt(entries_.Size());
-    dest.WriteUInt(checksum_);
+    if (!PackageFile::WriteDirectory(dest, entryNames_, entries_, checksum_))
+        ErrorExit("Could not write package directory");
 }